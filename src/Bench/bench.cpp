@@ -0,0 +1,321 @@
+#include "emulatorController.h"
+#include "romList.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Headless benchmark over rom directories
+ * usage: theboy_bench [--frames N] [--repeat N] [--json out.json] [--baseline base.json] [--threshold pct] [dirs or roms...]
+ * Every rom runs the same emulated frames with no pacing, the best of the repeats is kept.
+ * A second run with the sampled component timing gives the time split.
+ * With a baseline, exits with 2 when a metric drops more than the threshold
+ */
+using namespace TheBoy;
+
+
+/// <summary>
+/// Benchmark result of a rom, or the whole set
+/// </summary>
+typedef struct BenchResult {
+	std::string name;
+	bit32 frames;
+	double seconds;
+	bit64 ticks;
+	bit64 instructions;
+
+	/// <summary>
+	/// Time split, percent of the sampled time
+	/// </summary>
+	double cpuPct;
+	double ppuPct;
+	double timerPct;
+	double dmaPct;
+
+	double fps() const { return seconds > 0.0 ? frames / seconds : 0.0; }
+	double mhz() const { return seconds > 0.0 ? ticks / seconds / 1000000.0 : 0.0; }
+	double ips() const { return seconds > 0.0 ? instructions / seconds : 0.0; }
+} BenchResult;
+
+
+/// <summary>
+/// Metrics checked against the baseline, all of them higher is better
+/// </summary>
+static const char* CompareMetrics[] = { "fps", "mhz", "ips" };
+
+
+/// <summary>
+/// Runs a rom for a number of frames
+/// </summary>
+/// <param name="path">Rom path</param>
+/// <param name="frames">Frames to run</param>
+/// <param name="timing">Enables the sampled component timing</param>
+/// <param name="out">Run result, the split is only filled with timing</param>
+/// <returns>If the rom was loaded</returns>
+static bool runRom(const std::string& path, bit32 frames, bool timing, BenchResult* out) {
+	EmulatorController emulator;
+	if (!emulator.Load(path.c_str(), true)) { return false; }
+	emulator.setComponentTiming(timing);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	bit32 done = 0;
+	while (done < frames && emulator.runFrame()) { done++; }
+	out->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	out->frames = done;
+	out->ticks = emulator.getTicks();
+	out->instructions = emulator.getInstructions();
+
+	if (timing) {
+		// Every part is sampled on the same instructions, the split is over their sum and adds up to 100
+		ComponentTimes times = emulator.getComponentTimes();
+		double totalNs = times.cpuNs + times.ppuNs + times.timerNs + times.dmaNs;
+		if (totalNs > 0.0) {
+			out->cpuPct = times.cpuNs * 100.0 / totalNs;
+			out->ppuPct = times.ppuNs * 100.0 / totalNs;
+			out->timerPct = times.timerNs * 100.0 / totalNs;
+			out->dmaPct = times.dmaNs * 100.0 / totalNs;
+		}
+	}
+	return true;
+}
+
+
+/// <summary>
+/// Benchmarks a rom, best of the repeats plus a timed run for the split
+/// </summary>
+/// <param name="path">Rom path</param>
+/// <param name="name">Report name</param>
+/// <param name="frames">Frames to run</param>
+/// <param name="repeat">Repeats, the fastest is kept</param>
+/// <param name="out">Benchmark result</param>
+/// <returns>If the rom was loaded</returns>
+static bool benchRom(const std::string& path, const std::string& name, bit32 frames, int repeat, BenchResult* out) {
+	BenchResult best{};
+	for (int i = 0; i < repeat; i++) {
+		BenchResult res{};
+		if (!runRom(path, frames, false, &res)) { return false; }
+		if (i == 0 || res.seconds < best.seconds) { best = res; }
+	}
+
+	BenchResult split{};
+	if (!runRom(path, frames, true, &split)) { return false; }
+	best.cpuPct = split.cpuPct;
+	best.ppuPct = split.ppuPct;
+	best.timerPct = split.timerPct;
+	best.dmaPct = split.dmaPct;
+
+	best.name = name;
+	*out = best;
+	return true;
+}
+
+
+/// <summary>
+/// Writes a result as a single line json object
+/// </summary>
+static void writeResult(FILE* out, const BenchResult& res) {
+	fprintf(out, "{\"name\": \"%s\", \"frames\": %u, \"seconds\": %.4f, \"fps\": %.2f, \"mhz\": %.3f, \"ips\": %.0f, "
+		"\"cpu\": %.1f, \"ppu\": %.1f, \"timer\": %.1f, \"dma\": %.1f}",
+		res.name.c_str(), res.frames, res.seconds, res.fps(), res.mhz(), res.ips(),
+		res.cpuPct, res.ppuPct, res.timerPct, res.dmaPct);
+}
+
+
+/// <summary>
+/// Writes the json report, one rom per line so the baseline reader stays trivial
+/// </summary>
+/// <returns>If the file was written</returns>
+static bool writeJson(const char* path, bit32 frames, const std::vector<BenchResult>& results, const BenchResult& total) {
+	FILE* out = fopen(path, "w");
+	if (!out) {
+		printf("[BENCH] ::: Failed to open %s\n", path);
+		return false;
+	}
+
+	fprintf(out, "{\n  \"frames\": %u,\n  \"roms\": [\n", frames);
+	for (size_t i = 0; i < results.size(); i++) {
+		fprintf(out, "    ");
+		writeResult(out, results[i]);
+		fprintf(out, "%s\n", i + 1 < results.size() ? "," : "");
+	}
+	fprintf(out, "  ],\n  \"total\": ");
+	writeResult(out, total);
+	fprintf(out, "\n}\n");
+	fclose(out);
+	return true;
+}
+
+
+/// <summary>
+/// Finds a number value on a json line
+/// </summary>
+/// <returns>If the key was found</returns>
+static bool findNumber(const std::string& line, const char* key, double* value) {
+	std::string tag = std::string("\"") + key + "\":";
+	size_t pos = line.find(tag);
+	if (pos == std::string::npos) { return false; }
+	*value = atof(line.c_str() + pos + tag.size());
+	return true;
+}
+
+
+/// <summary>
+/// Reads the metrics of a report written by writeJson
+/// </summary>
+/// <param name="path">Baseline path</param>
+/// <param name="metrics">Name to metric values, the whole set is "total"</param>
+/// <returns>If the file was read</returns>
+static bool readBaseline(const char* path, std::map<std::string, std::map<std::string, double>>& metrics) {
+	std::ifstream file(path);
+	if (!file.is_open()) {
+		printf("[BENCH] ::: No baseline at %s\n", path);
+		return false;
+	}
+
+	std::string line;
+	while (std::getline(file, line)) {
+		size_t pos = line.find("\"name\": \"");
+		if (pos == std::string::npos) { continue; }
+		pos += 9;
+		std::string name = line.substr(pos, line.find('"', pos) - pos);
+
+		for (const char* key : CompareMetrics) {
+			double value;
+			if (findNumber(line, key, &value)) { metrics[name][key] = value; }
+		}
+	}
+	return true;
+}
+
+
+/// <summary>
+/// Gets a result metric by name
+/// </summary>
+static double metricOf(const BenchResult& res, const std::string& key) {
+	if (key == "fps") { return res.fps(); }
+	if (key == "mhz") { return res.mhz(); }
+	return res.ips();
+}
+
+
+/// <summary>
+/// Compares the results with a baseline
+/// </summary>
+/// <returns>Regressed metrics count</returns>
+static int compareBaseline(const std::map<std::string, std::map<std::string, double>>& base,
+	const std::vector<BenchResult>& results, const BenchResult& total, double threshold) {
+	int regressions = 0;
+	printf("[BENCH] ::: Baseline comparison, threshold %.1f%%\n", threshold);
+
+	std::vector<const BenchResult*> all;
+	for (const BenchResult& res : results) { all.push_back(&res); }
+	// The totals only compare over the same rom set
+	if (base.size() == results.size() + 1) { all.push_back(&total); }
+
+	for (const BenchResult* res : all) {
+		auto found = base.find(res->name);
+		if (found == base.end()) {
+			printf("  %-40s new, not in the baseline\n", res->name.c_str());
+			continue;
+		}
+		for (const char* key : CompareMetrics) {
+			auto value = found->second.find(key);
+			if (value == found->second.end() || value->second <= 0.0) { continue; }
+
+			double change = (metricOf(*res, key) - value->second) * 100.0 / value->second;
+			bool regressed = change < -threshold;
+			regressions += regressed ? 1 : 0;
+			printf("  %-40s %-4s %14.2f -> %14.2f  %+6.1f%%%s\n", res->name.c_str(), key,
+				value->second, metricOf(*res, key), change, regressed ? "  REGRESSION" : "");
+		}
+	}
+	return regressions;
+}
+
+
+int main(int argc, char* argv[]) {
+	bit32 frames = 600;
+	int repeat = 1;
+	double threshold = 5.0;
+	const char* jsonPath = nullptr;
+	const char* baselinePath = nullptr;
+	std::vector<std::string> targets;
+
+	for (int i = 1; i < argc; i++) {
+		bool hasValue = i + 1 < argc;
+		if (strcmp(argv[i], "--frames") == 0 && hasValue) { frames = static_cast<bit32>(atoi(argv[++i])); }
+		else if (strcmp(argv[i], "--repeat") == 0 && hasValue) { repeat = std::max(1, atoi(argv[++i])); }
+		else if (strcmp(argv[i], "--json") == 0 && hasValue) { jsonPath = argv[++i]; }
+		else if (strcmp(argv[i], "--baseline") == 0 && hasValue) { baselinePath = argv[++i]; }
+		else if (strcmp(argv[i], "--threshold") == 0 && hasValue) { threshold = atof(argv[++i]); }
+		else { targets.push_back(argv[i]); }
+	}
+	if (targets.empty()) { targets.push_back("ROMS/tests"); }
+
+	std::vector<RomEntry> roms;
+	for (const std::string& target : targets) { RomList::collect(target, roms); }
+	if (roms.empty()) {
+		printf("[BENCH] ::: No roms found\n");
+		return 1;
+	}
+
+	std::vector<BenchResult> results;
+	BenchResult total{};
+	total.name = "total";
+	double splitSeconds = 0.0;
+
+	for (const RomEntry& rom : roms) {
+		BenchResult res{};
+		if (!benchRom(rom.first, rom.second, frames, repeat, &res)) {
+			printf("[BENCH] ::: Failed to load %s\n", rom.first.c_str());
+			continue;
+		}
+		results.push_back(res);
+
+		total.frames += res.frames;
+		total.seconds += res.seconds;
+		total.ticks += res.ticks;
+		total.instructions += res.instructions;
+		// Split weighted by the rom run time
+		total.cpuPct += res.cpuPct * res.seconds;
+		total.ppuPct += res.ppuPct * res.seconds;
+		total.timerPct += res.timerPct * res.seconds;
+		total.dmaPct += res.dmaPct * res.seconds;
+		splitSeconds += res.seconds;
+	}
+	if (splitSeconds > 0.0) {
+		total.cpuPct /= splitSeconds;
+		total.ppuPct /= splitSeconds;
+		total.timerPct /= splitSeconds;
+		total.dmaPct /= splitSeconds;
+	}
+
+	printf("\n[BENCH] ::: %zu roms, %u frames each, best of %d\n", results.size(), frames, repeat);
+	printf("  %-40s | %9s | %8s | %10s | %5s | %5s | %5s | %5s\n", "rom", "frames/s", "MHz", "instr/s", "cpu%", "ppu%", "tmr%", "dma%");
+	std::vector<const BenchResult*> rows;
+	for (const BenchResult& res : results) { rows.push_back(&res); }
+	rows.push_back(&total);
+	for (const BenchResult* res : rows) {
+		printf("  %-40s | %9.1f | %8.3f | %10.0f | %5.1f | %5.1f | %5.1f | %5.1f\n", res->name.c_str(),
+			res->fps(), res->mhz(), res->ips(), res->cpuPct, res->ppuPct, res->timerPct, res->dmaPct);
+	}
+
+	if (jsonPath && !writeJson(jsonPath, frames, results, total)) { return 1; }
+
+	if (baselinePath) {
+		std::map<std::string, std::map<std::string, double>> base;
+		if (!readBaseline(baselinePath, base)) { return 1; }
+		int regressions = compareBaseline(base, results, total, threshold);
+		if (regressions > 0) {
+			printf("[BENCH] ::: %d metrics regressed\n", regressions);
+			return 2;
+		}
+		printf("[BENCH] ::: No regression\n");
+	}
+	return 0;
+}
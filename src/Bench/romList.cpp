@@ -0,0 +1,40 @@
+#include "romList.h"
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+namespace TheBoy {
+	namespace RomList {
+
+		/// <summary>
+		/// Collects the roms of a directory (recursive, sorted) or a single rom
+		/// Names are relative to the directory, a single rom uses its file name
+		/// </summary>
+		/// <param name="target">Directory or rom path</param>
+		/// <param name="roms">Found roms</param>
+		void collect(const std::string& target, std::vector<RomEntry>& roms) {
+			std::error_code err;
+			if (fs::is_regular_file(target, err)) {
+				roms.emplace_back(target, fs::path(target).filename().generic_string());
+				return;
+			}
+			if (!fs::is_directory(target, err)) {
+				printf("[ROMLIST] ::: %s not found\n", target.c_str());
+				return;
+			}
+
+			std::vector<RomEntry> found;
+			for (const fs::directory_entry& entry : fs::recursive_directory_iterator(target, err)) {
+				std::string ext = entry.path().extension().string();
+				std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+				if (!entry.is_regular_file() || (ext != ".gb" && ext != ".gbc")) { continue; }
+
+				found.emplace_back(entry.path().string(), fs::relative(entry.path(), target, err).generic_string());
+			}
+			std::sort(found.begin(), found.end());
+			roms.insert(roms.end(), found.begin(), found.end());
+		}
+	} // namespace RomList
+} // namespace TheBoy
@@ -0,0 +1,29 @@
+#pragma once
+#ifndef ROMLIST_H
+#define ROMLIST_H
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace TheBoy {
+	/// <summary>
+	/// Rom path and the name used on the reports
+	/// </summary>
+	typedef std::pair<std::string, std::string> RomEntry;
+
+
+	/// <summary>
+	/// Rom discovery shared by the headless tools
+	/// </summary>
+	namespace RomList {
+		/// <summary>
+		/// Collects the roms of a directory (recursive, sorted) or a single rom
+		/// Names are relative to the directory, a single rom uses its file name
+		/// </summary>
+		/// <param name="target">Directory or rom path</param>
+		/// <param name="roms">Found roms</param>
+		void collect(const std::string& target, std::vector<RomEntry>& roms);
+	} // namespace RomList
+} // namespace TheBoy
+#endif // !ROMLIST_H
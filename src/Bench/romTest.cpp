@@ -0,0 +1,476 @@
+#include "allocCounter.h"
+#include "emulatorController.h"
+#include "romList.h"
+#include "workStealingPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Headless test rom regression runner
+ * usage: theboy_romtest [--jobs N] [--timeout secs] [--rom-timeout name=secs] [--junit out.xml] [--json out.json] [--alloc-check] [dirs or roms...]
+ * Every rom runs on its own headless instance, the roms are spread over a work stealing pool.
+ * The serial output is captured from the IO link hook and the verdict comes from the Blargg markers,
+ * the serial "Passed"/"Failed" text or the memory signature at A000. A rom that stops on a dead loop (halt or
+ * a branch on itself, with no interrupt able to fire), or idles on a halt loop with nothing changing but its
+ * interrupts (a visual test showing its final screen), without any of them ends with no verdict.
+ * Timeouts are emulated seconds.
+ * --alloc-check runs every rom for a fixed frame count instead and fails the ones whose frames allocated on the heap,
+ * it needs the allocation counter (debug builds or ALLOC_COUNTER).
+ * Exits with 1 when a rom fails, ends with no verdict, times out or does not load
+ */
+using namespace TheBoy;
+
+
+/// <summary>
+/// Emulated clock, ticks per second
+/// </summary>
+static const double ClockHz = 4194304.0;
+
+
+/// <summary>
+/// Frames kept running after a serial verdict, the rest of the report text follows the marker
+/// </summary>
+static const bit32 TailFrames = 30;
+
+
+/// <summary>
+/// Test rom verdicts
+/// </summary>
+typedef enum VERDICT {
+	VERDICT_PASS,
+	VERDICT_FAIL,
+	VERDICT_ENDED,
+	VERDICT_TIMEOUT,
+	VERDICT_ERROR
+} VERDICT;
+
+
+/// <summary>
+/// Verdict names for the reports
+/// </summary>
+static const char* VerdictNames[] = { "PASS", "FAIL", "ENDED", "TIMEOUT", "ERROR" };
+
+
+/// <summary>
+/// Test result of a rom
+/// </summary>
+typedef struct RomTestResult {
+	std::string name;
+	VERDICT verdict;
+
+	/// <summary>
+	/// Serial output, or the memory text of the signature protocol
+	/// </summary>
+	std::string output;
+
+	/// <summary>
+	/// Emulated and wall seconds
+	/// </summary>
+	double emulated;
+	double seconds;
+	bit32 frames;
+} RomTestResult;
+
+
+/// <summary>
+/// Blargg memory protocol, the signature at A001 marks a valid status at A000 and the text from A004
+/// </summary>
+/// <param name="bus">Emulator bus</param>
+/// <param name="status">Status output, 0x80 while the test runs</param>
+/// <returns>If the signature is present</returns>
+static bool readSignature(AddressBus* bus, bit8* status) {
+	if (bus->abRead(0xA001) != 0xDE || bus->abRead(0xA002) != 0xB0 || bus->abRead(0xA003) != 0x61) { return false; }
+	*status = bus->abRead(0xA000);
+	return true;
+}
+
+
+/// <summary>
+/// Reads the text of the memory protocol
+/// </summary>
+static std::string readSignatureText(AddressBus* bus) {
+	std::string text;
+	for (bit16 addr = 0xA004; addr < 0xBFFF; addr++) {
+		bit8 val = bus->abRead(addr);
+		if (val == 0) { break; }
+		text.push_back(static_cast<char>(val));
+	}
+	return text;
+}
+
+
+/// <summary>
+/// Frame ends an end state must be seen on, unchanged, before the rom is taken as ended
+/// </summary>
+static const bit32 LoopFrames = 8;
+
+
+/// <summary>
+/// Frame ends an idle loop must be seen on, unchanged, its interrupts may still be doing work for a while
+/// </summary>
+static const bit32 IdleFrames = 300;
+
+
+/// <summary>
+/// Finds a loop branching on itself, a jr, jp or jp hl back to its own address, only nops allowed before it
+/// (jr -2, nop/jr -3, jp hl on itself...). Nothing in it can change the machine, only an interrupt leaves it
+/// </summary>
+/// <param name="bus">Emulator bus</param>
+/// <param name="regs">Cpu registers</param>
+/// <param name="halts">Halts are allowed along the nops (halt/nop/jr -4)</param>
+/// <returns>Loop start, -1 when the pc is not on such a loop</returns>
+static int deadLoopStart(AddressBus* bus, const Registers* regs, bool halts) {
+	auto filler = [bus, halts](int addr) {
+		bit8 op = bus->abRead(static_cast<bit16>(addr));
+		return op == 0x00 || (halts && op == 0x76);
+	};
+
+	bit16 pc = regs->PC;
+	bit16 at = pc;
+	while (filler(at) && at - pc < 3) { at++; }
+
+	int target;
+	bit8 op = bus->abRead(at);
+	if (op == 0x18) { target = at + 2 + static_cast<int8_t>(bus->abRead(at + 1)); }
+	else if (op == 0xC3) { target = bus->abRead(at + 1) | (bus->abRead(at + 2) << 8); }
+	else if (op == 0xE9) { target = (regs->H << 8) | regs->L; }
+	else { return -1; }
+
+	if (target > pc || at - target > 3) { return -1; }
+	for (int addr = target; addr < pc; addr++) {
+		if (!filler(addr)) { return -1; }
+	}
+	return target;
+}
+
+
+/// <summary>
+/// Hashes the video ram, FNV-1a
+/// </summary>
+/// <param name="ppu">Emulator ppu</param>
+/// <returns>Video ram hash</returns>
+static bit64 hashVram(Ppu* ppu) {
+	bit64 hash = 0xCBF29CE484222325ULL;
+	for (bit32 addr = 0x8000; addr < 0xA000; addr++) {
+		hash = (hash ^ ppu->read(static_cast<bit16>(addr))) * 0x100000001B3ULL;
+	}
+	return hash;
+}
+
+
+/// <summary>
+/// Tracks the known end states.
+/// Dead ends, no interrupt can move the cpu out of them: a halt with no interrupt enabled, or a loop branching
+/// on itself with IME or IE off. The loop, the serial output and the memory signature must stay the same on
+/// every frame end checked.
+/// Idle ends, only interrupts run: a loop of halts and nops branching on itself, or an interrupt just taken from
+/// one. The video ram must stay the same too, for IdleFrames
+/// </summary>
+typedef struct EndDetector {
+	int loopStart;
+	bool loopIdle;
+	bit32 loopFrames;
+	size_t serialSize;
+	bit32 signature;
+	bit64 vramHash;
+
+	/// <summary>
+	/// Checks the cpu at a frame end
+	/// </summary>
+	/// <param name="emulator">Emulator</param>
+	/// <param name="serial">Serial output so far</param>
+	/// <returns>If the rom reached an end state</returns>
+	bool check(EmulatorController& emulator, const std::string& serial) {
+		std::shared_ptr<Cpu> cpu = emulator.getCpu();
+		AddressBus* bus = emulator.getBus().get();
+		bool noInterrupt = (cpu->getCpuIERegister() & 0x1F) == 0;
+
+		int start = -1;
+		if (cpu->getHaltedState()) { start = noInterrupt ? cpu->getRegisters()->PC : -1; }
+		else if (noInterrupt || !cpu->getIntMasterState()) { start = deadLoopStart(bus, cpu->getRegisters(), false); }
+
+		bool idle = false;
+		if (start < 0) {
+			// Right on an interrupt vector, the loop is the one the interrupt was taken from
+			Registers regs = *cpu->getRegisters();
+			if (regs.PC >= 0x40 && regs.PC <= 0x60 && (regs.PC & 0x07) == 0) {
+				regs.PC = bus->abRead(regs.SP) | (bus->abRead(static_cast<bit16>(regs.SP + 1)) << 8);
+			}
+			start = deadLoopStart(bus, &regs, true);
+			idle = true;
+		}
+		if (start < 0) {
+			loopFrames = 0;
+			return false;
+		}
+
+		bit32 sig = 0;
+		for (bit16 addr = 0xA000; addr < 0xA004; addr++) { sig = (sig << 8) | bus->abRead(addr); }
+		bit64 vram = idle ? hashVram(emulator.getPpu().get()) : 0;
+		if (loopFrames > 0 && start == loopStart && idle == loopIdle && serial.size() == serialSize && sig == signature && vram == vramHash) {
+			return ++loopFrames >= (idle ? IdleFrames : LoopFrames);
+		}
+		loopStart = start;
+		loopIdle = idle;
+		loopFrames = 1;
+		serialSize = serial.size();
+		signature = sig;
+		vramHash = vram;
+		return false;
+	}
+} EndDetector;
+
+
+/// <summary>
+/// Runs a test rom until a verdict, a dead loop or the timeout
+/// </summary>
+/// <param name="path">Rom path</param>
+/// <param name="timeout">Timeout in emulated seconds</param>
+/// <param name="out">Test result</param>
+static void runTest(const std::string& path, double timeout, RomTestResult* out) {
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	out->verdict = VERDICT_ERROR;
+
+	EmulatorController emulator;
+	if (!emulator.Load(path.c_str(), true)) { return; }
+
+	// Replaces the controller debug buffer, the output is kept per rom
+	std::string serial;
+	emulator.getIO()->setSerialHook([&serial](bit8 val) { serial.push_back(static_cast<char>(val)); });
+
+	AddressBus* bus = emulator.getBus().get();
+	bit64 limit = static_cast<bit64>(timeout * ClockHz);
+	bit32 tail = 0;
+	bool memoryVerdict = false;
+	EndDetector ended{};
+	out->verdict = VERDICT_TIMEOUT;
+
+	while (emulator.getTicks() < limit && emulator.runFrame()) {
+		out->frames++;
+		if (tail > 0) {
+			if (--tail == 0) { break; }
+			continue;
+		}
+
+		if (serial.find("Passed") != std::string::npos) { out->verdict = VERDICT_PASS; }
+		else if (serial.find("Failed") != std::string::npos) { out->verdict = VERDICT_FAIL; }
+		if (out->verdict != VERDICT_TIMEOUT) {
+			tail = TailFrames;
+			continue;
+		}
+
+		bit8 status;
+		if (readSignature(bus, &status) && status != 0x80) {
+			out->verdict = status == 0 ? VERDICT_PASS : VERDICT_FAIL;
+			memoryVerdict = true;
+			break;
+		}
+
+		if (ended.check(emulator, serial)) {
+			out->verdict = VERDICT_ENDED;
+			break;
+		}
+	}
+
+	out->output = memoryVerdict ? readSignatureText(bus) : serial;
+	out->emulated = emulator.getTicks() / ClockHz;
+	out->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+/// <summary>
+/// Frames run by the allocation check
+/// </summary>
+static const bit32 AllocCheckFrames = 600;
+
+
+/// <summary>
+/// Runs a test rom for the allocation check frames, counting the heap allocations of the emulation
+/// Load allocates, only the frames are counted
+/// </summary>
+/// <param name="path">Rom path</param>
+/// <param name="out">Test result, a fail when any frame allocated</param>
+static void runAllocCheck(const std::string& path, RomTestResult* out) {
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	out->verdict = VERDICT_ERROR;
+
+	EmulatorController emulator;
+	if (!emulator.Load(path.c_str(), true)) { return; }
+
+	// The pool runs each rom on a single thread, the counter of this thread holds the emulation allocations
+	bit64 before = AllocCounter::thread();
+	while (out->frames < AllocCheckFrames && emulator.runFrame()) { out->frames++; }
+	bit64 allocs = AllocCounter::thread() - before;
+
+	out->verdict = allocs == 0 ? VERDICT_PASS : VERDICT_FAIL;
+	out->output = std::to_string(allocs) + " allocations in " + std::to_string(out->frames) + " frames";
+	out->emulated = emulator.getTicks() / ClockHz;
+	out->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+/// <summary>
+/// Escapes a text for the xml and json reports, control characters are dropped but the new lines
+/// </summary>
+static std::string escape(const std::string& text, bool xml) {
+	std::string out;
+	for (char c : text) {
+		if (c == '\n') { out += xml ? "\n" : "\\n"; }
+		else if (static_cast<unsigned char>(c) < 0x20 || static_cast<unsigned char>(c) >= 0x7F) { continue; }
+		else if (xml && c == '&') { out += "&amp;"; }
+		else if (xml && c == '<') { out += "&lt;"; }
+		else if (xml && c == '>') { out += "&gt;"; }
+		else if (xml && c == '"') { out += "&quot;"; }
+		else if (!xml && (c == '"' || c == '\\')) { out += '\\'; out += c; }
+		else { out += c; }
+	}
+	return out;
+}
+
+
+/// <summary>
+/// Writes the JUnit report, a fail or an end with no verdict is a failure, a timeout or a load error an error
+/// </summary>
+/// <returns>If the file was written</returns>
+static bool writeJunit(const char* path, const std::vector<RomTestResult>& results, double seconds) {
+	FILE* out = fopen(path, "w");
+	if (!out) {
+		printf("[ROMTEST] ::: Failed to open %s\n", path);
+		return false;
+	}
+
+	int failures = 0, errors = 0;
+	for (const RomTestResult& res : results) {
+		failures += res.verdict == VERDICT_FAIL || res.verdict == VERDICT_ENDED ? 1 : 0;
+		errors += res.verdict == VERDICT_TIMEOUT || res.verdict == VERDICT_ERROR ? 1 : 0;
+	}
+
+	fprintf(out, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+	fprintf(out, "<testsuite name=\"theboy_romtest\" tests=\"%zu\" failures=\"%d\" errors=\"%d\" time=\"%.3f\">\n",
+		results.size(), failures, errors, seconds);
+	for (const RomTestResult& res : results) {
+		fprintf(out, "  <testcase classname=\"roms\" name=\"%s\" time=\"%.3f\">\n", escape(res.name, true).c_str(), res.seconds);
+		if (res.verdict == VERDICT_FAIL) { fprintf(out, "    <failure message=\"Failed\"/>\n"); }
+		else if (res.verdict == VERDICT_ENDED) { fprintf(out, "    <failure message=\"Ended with no verdict after %.1f emulated seconds\"/>\n", res.emulated); }
+		else if (res.verdict == VERDICT_TIMEOUT) { fprintf(out, "    <error message=\"Timeout after %.1f emulated seconds\"/>\n", res.emulated); }
+		else if (res.verdict == VERDICT_ERROR) { fprintf(out, "    <error message=\"Failed to load\"/>\n"); }
+		if (!res.output.empty()) { fprintf(out, "    <system-out>%s</system-out>\n", escape(res.output, true).c_str()); }
+		fprintf(out, "  </testcase>\n");
+	}
+	fprintf(out, "</testsuite>\n");
+	fclose(out);
+	return true;
+}
+
+
+/// <summary>
+/// Writes the json report, one rom per line
+/// </summary>
+/// <returns>If the file was written</returns>
+static bool writeJson(const char* path, const std::vector<RomTestResult>& results, double seconds) {
+	FILE* out = fopen(path, "w");
+	if (!out) {
+		printf("[ROMTEST] ::: Failed to open %s\n", path);
+		return false;
+	}
+
+	fprintf(out, "{\n  \"seconds\": %.3f,\n  \"roms\": [\n", seconds);
+	for (size_t i = 0; i < results.size(); i++) {
+		const RomTestResult& res = results[i];
+		fprintf(out, "    {\"name\": \"%s\", \"verdict\": \"%s\", \"frames\": %u, \"emulated\": %.2f, \"seconds\": %.3f, \"output\": \"%s\"}%s\n",
+			escape(res.name, false).c_str(), VerdictNames[res.verdict], res.frames, res.emulated, res.seconds,
+			escape(res.output, false).c_str(), i + 1 < results.size() ? "," : "");
+	}
+	fprintf(out, "  ]\n}\n");
+	fclose(out);
+	return true;
+}
+
+
+/// <summary>
+/// Gets the timeout of a rom, an override matches the report name or a part of it
+/// </summary>
+static double timeoutOf(const std::string& name, double timeout, const std::map<std::string, double>& overrides) {
+	for (const std::pair<const std::string, double>& entry : overrides) {
+		if (name.find(entry.first) != std::string::npos) { return entry.second; }
+	}
+	return timeout;
+}
+
+
+int main(int argc, char* argv[]) {
+	int jobs = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+	double timeout = 120.0;
+	std::map<std::string, double> overrides;
+	const char* junitPath = nullptr;
+	const char* jsonPath = nullptr;
+	bool allocCheck = false;
+	std::vector<std::string> targets;
+
+	for (int i = 1; i < argc; i++) {
+		bool hasValue = i + 1 < argc;
+		if (strcmp(argv[i], "--jobs") == 0 && hasValue) { jobs = std::max(1, atoi(argv[++i])); }
+		else if (strcmp(argv[i], "--timeout") == 0 && hasValue) { timeout = atof(argv[++i]); }
+		else if (strcmp(argv[i], "--junit") == 0 && hasValue) { junitPath = argv[++i]; }
+		else if (strcmp(argv[i], "--json") == 0 && hasValue) { jsonPath = argv[++i]; }
+		else if (strcmp(argv[i], "--alloc-check") == 0) { allocCheck = true; }
+		else if (strcmp(argv[i], "--rom-timeout") == 0 && hasValue) {
+			std::string entry = argv[++i];
+			size_t split = entry.find('=');
+			if (split == std::string::npos) {
+				printf("[ROMTEST] ::: Expected name=seconds on --rom-timeout, got %s\n", entry.c_str());
+				return 1;
+			}
+			overrides[entry.substr(0, split)] = atof(entry.c_str() + split + 1);
+		}
+		else { targets.push_back(argv[i]); }
+	}
+	if (targets.empty()) { targets.push_back("ROMS/tests"); }
+	if (allocCheck && !AllocCounter::enabled()) {
+		printf("[ROMTEST] ::: Built without the allocation counter, use a debug build or ALLOC_COUNTER\n");
+		return 1;
+	}
+
+	std::vector<RomEntry> roms;
+	for (const std::string& target : targets) { RomList::collect(target, roms); }
+	if (roms.empty()) {
+		printf("[ROMTEST] ::: No roms found\n");
+		return 1;
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::vector<RomTestResult> results(roms.size());
+	{
+		WorkStealingPool pool(std::min(jobs, static_cast<int>(roms.size())));
+		for (size_t i = 0; i < roms.size(); i++) {
+			results[i].name = roms[i].second;
+			double romTimeout = timeoutOf(roms[i].second, timeout, overrides);
+			pool.submit([&roms, &results, i, romTimeout, allocCheck]() {
+				if (allocCheck) { runAllocCheck(roms[i].first, &results[i]); }
+				else { runTest(roms[i].first, romTimeout, &results[i]); }
+			});
+		}
+		pool.waitIdle();
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	int counts[VERDICT_ERROR + 1] = {};
+	printf("\n[ROMTEST] ::: %zu roms, %d jobs, %.2f s\n", roms.size(), jobs, seconds);
+	printf("  %-40s | %-7s | %8s | %8s\n", "rom", "verdict", "emul s", "wall s");
+	for (const RomTestResult& res : results) {
+		counts[res.verdict]++;
+		printf("  %-40s | %-7s | %8.2f | %8.3f%s%s\n", res.name.c_str(), VerdictNames[res.verdict], res.emulated, res.seconds,
+			allocCheck ? " | " : "", allocCheck ? res.output.c_str() : "");
+	}
+	printf("[ROMTEST] ::: %d passed, %d failed, %d ended, %d timed out, %d errors\n", counts[VERDICT_PASS],
+		counts[VERDICT_FAIL], counts[VERDICT_ENDED], counts[VERDICT_TIMEOUT], counts[VERDICT_ERROR]);
+
+	if (junitPath && !writeJunit(junitPath, results, seconds)) { return 1; }
+	if (jsonPath && !writeJson(jsonPath, results, seconds)) { return 1; }
+	return counts[VERDICT_FAIL] + counts[VERDICT_ENDED] + counts[VERDICT_TIMEOUT] + counts[VERDICT_ERROR] > 0 ? 1 : 0;
+}
@@ -0,0 +1,297 @@
+#include "traceRecorder.h"
+#include "mappedFile.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TRACEDIFF_SSE2 1
+#include <emmintrin.h>
+#else
+#define TRACEDIFF_SSE2 0
+#endif
+
+/**
+ * @brief Streaming trace diff against a reference emulator log
+ * usage: theboy_tracediff [--context N] <ours.trace | ours.log> <reference.log>
+ * Our side is a binary trace (TheBoy --trace <rom> <out.trace> [frames] --doctor) decoded to gameboy-doctor
+ * lines on the fly, or any text log. Both files are memory mapped and compared 16 bytes at a time, the
+ * line of the first differing byte is the divergence. Stops there and prints the lines before it, our
+ * records in full when the trace is binary.
+ * Exits with 0 when every reference line matched, 1 on a divergence, 2 on an error
+ */
+using namespace TheBoy;
+
+
+/// <summary>
+/// Records decoded per comparison chunk
+/// </summary>
+static const size_t ChunkRecords = 1 << 16;
+
+
+/// <summary>
+/// Offset of the first differing byte
+/// </summary>
+/// <param name="a">First buffer</param>
+/// <param name="b">Second buffer</param>
+/// <param name="len">Compared length</param>
+/// <returns>Offset, len when both are equal</returns>
+static size_t firstDifference(const bit8* a, const bit8* b, size_t len) {
+	size_t i = 0;
+#if TRACEDIFF_SSE2
+	// 64 bytes per round, the exact byte is only searched in the differing block
+	for (; i + 64 <= len; i += 64) {
+		__m128i e0 = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)),
+			_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)));
+		__m128i e1 = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i + 16)),
+			_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i + 16)));
+		__m128i e2 = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i + 32)),
+			_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i + 32)));
+		__m128i e3 = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i + 48)),
+			_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i + 48)));
+		__m128i all = _mm_and_si128(_mm_and_si128(e0, e1), _mm_and_si128(e2, e3));
+		if (_mm_movemask_epi8(all) != 0xFFFF) { break; }
+	}
+	for (; i + 16 <= len; i += 16) {
+		int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)),
+			_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i))));
+		if (mask != 0xFFFF) {
+			int bit = 0;
+			while (mask & (1 << bit)) { bit++; }
+			return i + bit;
+		}
+	}
+#endif
+	for (; i < len; i++) {
+		if (a[i] != b[i]) { return i; }
+	}
+	return len;
+}
+
+
+/// <summary>
+/// Counts the new lines of a buffer
+/// </summary>
+/// <param name="p">Buffer</param>
+/// <param name="len">Buffer length</param>
+/// <returns>New line count</returns>
+static size_t countLines(const bit8* p, size_t len) {
+	size_t lines = 0;
+	size_t i = 0;
+#if TRACEDIFF_SSE2
+	const __m128i nl = _mm_set1_epi8('\n');
+	for (; i + 16 <= len; i += 16) {
+		unsigned int mask = static_cast<unsigned int>(
+			_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i)), nl)));
+		while (mask) {
+			mask &= mask - 1;
+			lines++;
+		}
+	}
+#endif
+	for (; i < len; i++) {
+		if (p[i] == '\n') { lines++; }
+	}
+	return lines;
+}
+
+
+/// <summary>
+/// Text lines of a mapped log, found by walking back and forth from an offset
+/// </summary>
+typedef struct TextLog {
+	const bit8* data;
+	size_t size;
+
+	/// <summary>
+	/// Start of the line holding an offset
+	/// </summary>
+	size_t lineStart(size_t off) const {
+		while (off > 0 && data[off - 1] != '\n') { off--; }
+		return off;
+	}
+
+	/// <summary>
+	/// Line starting on an offset, without its new line
+	/// </summary>
+	std::string lineAt(size_t start) const {
+		size_t end = start;
+		while (end < size && data[end] != '\n' && data[end] != '\r') { end++; }
+		return std::string(reinterpret_cast<const char*>(data + start), end - start);
+	}
+} TextLog;
+
+
+/// <summary>
+/// Lists the "NAME:value" fields that differ between two doctor lines
+/// </summary>
+static std::string differingFields(const std::string& ours, const std::string& ref) {
+	std::string out;
+	size_t a = 0, b = 0;
+	while (a < ours.size() && b < ref.size()) {
+		size_t ae = ours.find(' ', a), be = ref.find(' ', b);
+		std::string fa = ours.substr(a, ae == std::string::npos ? std::string::npos : ae - a);
+		std::string fb = ref.substr(b, be == std::string::npos ? std::string::npos : be - b);
+		if (fa != fb) {
+			out += (out.empty() ? "" : " ") + fa.substr(0, fa.find(':'));
+		}
+		if (ae == std::string::npos || be == std::string::npos) { break; }
+		a = ae + 1;
+		b = be + 1;
+	}
+	return out.empty() ? "line length" : out;
+}
+
+
+/// <summary>
+/// Prints a divergence
+/// </summary>
+/// <param name="line">Diverging line, 1 based</param>
+/// <param name="context">Lines before it, already formatted</param>
+/// <param name="ours">Our line</param>
+/// <param name="ref">Reference line</param>
+static void printDivergence(size_t line, const std::vector<std::string>& context, const std::string& ours, const std::string& ref) {
+	printf("[TRACEDIFF] ::: Diverged on line %zu (instruction %zu)\n", line, line - 1);
+	for (size_t i = 0; i < context.size(); i++) {
+		printf("  %10zu  %s\n", line - context.size() + i, context[i].c_str());
+	}
+	printf("  ours        %s\n", ours.c_str());
+	printf("  reference   %s\n", ref.c_str());
+	printf("  differs     %s\n", differingFields(ours, ref).c_str());
+}
+
+
+/// <summary>
+/// Compares two text logs
+/// </summary>
+static int diffText(const MappedFile& ours, const MappedFile& ref, int context) {
+	TextLog a{ ours.data(), ours.size() };
+	TextLog b{ ref.data(), ref.size() };
+	size_t common = std::min(a.size, b.size);
+	size_t off = firstDifference(a.data, b.data, common);
+
+	if (off == common) {
+		size_t lines = countLines(b.data, b.size);
+		if (a.size >= b.size) {
+			printf("[TRACEDIFF] ::: All %zu reference lines matched\n", lines);
+			return 0;
+		}
+		printf("[TRACEDIFF] ::: Our log ended on line %zu, the reference goes on\n", countLines(a.data, a.size));
+		return 1;
+	}
+
+	size_t start = a.lineStart(off);
+	size_t line = countLines(a.data, start) + 1;
+
+	std::vector<std::string> before;
+	size_t p = start;
+	for (int i = 0; i < context && p > 0; i++) {
+		p = a.lineStart(p - 1);
+		before.insert(before.begin(), a.lineAt(p));
+	}
+	printDivergence(line, before, a.lineAt(start), b.lineAt(b.lineStart(off)));
+	return 1;
+}
+
+
+/// <summary>
+/// Compares a binary trace, decoded to doctor lines chunk by chunk, with a text log
+/// </summary>
+static int diffTrace(const MappedFile& ours, const MappedFile& ref, int context) {
+	const TraceRecord* records = reinterpret_cast<const TraceRecord*>(ours.data() + sizeof(TraceHeader));
+	size_t count = (ours.size() - sizeof(TraceHeader)) / sizeof(TraceRecord);
+	const size_t lineSize = TraceRecorder::DoctorLineSize;
+
+	std::vector<char> chunk(ChunkRecords * lineSize + 1);
+	size_t refOff = 0;
+	for (size_t first = 0; first < count; first += ChunkRecords) {
+		size_t n = std::min(ChunkRecords, count - first);
+		for (size_t i = 0; i < n; i++) {
+			TraceRecorder::format(records[first + i], TRACE_FORMAT_DOCTOR, &chunk[i * lineSize], lineSize + 1);
+		}
+
+		size_t len = n * lineSize;
+		size_t common = std::min(len, ref.size() - refOff);
+		size_t off = firstDifference(reinterpret_cast<const bit8*>(chunk.data()), ref.data() + refOff, common);
+		if (off < common) {
+			// Our lines are fixed size, the reference line is found from the same offset
+			size_t index = first + off / lineSize;
+			TextLog b{ ref.data(), ref.size() };
+			char line[160];
+
+			std::vector<std::string> before;
+			for (size_t i = (index > static_cast<size_t>(context)) ? index - context : 0; i < index; i++) {
+				int l = TraceRecorder::format(records[i], TRACE_FORMAT_TEXT, line, sizeof(line));
+				before.push_back(std::string(line, l > 0 ? l - 1 : 0));
+			}
+			TraceRecorder::format(records[index], TRACE_FORMAT_DOCTOR, line, sizeof(line));
+			printDivergence(index + 1, before, std::string(line, lineSize - 1), b.lineAt(b.lineStart(refOff + off)));
+
+			TraceRecorder::format(records[index], TRACE_FORMAT_TEXT, line, sizeof(line));
+			printf("  record      %s", line);
+			return 1;
+		}
+
+		refOff += common;
+		if (common < len) {
+			printf("[TRACEDIFF] ::: All %zu reference lines matched, our trace goes on\n", countLines(ref.data(), ref.size()));
+			return 0;
+		}
+	}
+
+	if (refOff < ref.size()) {
+		printf("[TRACEDIFF] ::: Our trace ended after %zu instructions, the reference goes on\n", count);
+		return 1;
+	}
+	printf("[TRACEDIFF] ::: All %zu instructions matched\n", count);
+	return 0;
+}
+
+
+int main(int argc, char* argv[]) {
+	int context = 8;
+	std::vector<const char*> paths;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--context") == 0 && i + 1 < argc) { context = std::max(0, atoi(argv[++i])); }
+		else { paths.push_back(argv[i]); }
+	}
+	if (paths.size() != 2) {
+		printf("usage: theboy_tracediff [--context N] <ours.trace | ours.log> <reference.log>\n");
+		return 2;
+	}
+
+	MappedFile ours, ref;
+	for (int i = 0; i < 2; i++) {
+		if (!(i == 0 ? ours : ref).open(paths[i])) {
+			printf("[TRACEDIFF] ::: Failed to map %s\n", paths[i]);
+			return 2;
+		}
+	}
+	// Lines are compared byte for byte, a Windows log never matches our new lines
+	if (ref.size() > 0 && memchr(ref.data(), '\r', std::min<size_t>(ref.size(), 256))) {
+		printf("[TRACEDIFF] ::: %s has \\r\\n line ends, convert it to \\n first\n", paths[1]);
+		return 2;
+	}
+	ours.adviseSequential();
+	ref.adviseSequential();
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	int res;
+	const TraceHeader* header = reinterpret_cast<const TraceHeader*>(ours.data());
+	if (ours.size() >= sizeof(TraceHeader) && memcmp(header->magic, "TBTR", 4) == 0) {
+		if (header->version != TraceHeader::CurrentVersion || header->recordSize != sizeof(TraceRecord)) {
+			printf("[TRACEDIFF] ::: Unknown trace format or version\n");
+			return 2;
+		}
+		res = diffTrace(ours, ref, context);
+	}
+	else {
+		res = diffText(ours, ref, context);
+	}
+
+	double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	printf("[TRACEDIFF] ::: %.1f MB compared in %.2f s\n", (ours.size() + ref.size()) / 1048576.0, sec);
+	return res;
+}
@@ -0,0 +1,104 @@
+#include "allocCounter.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace TheBoy {
+
+#if ALLOCCOUNT
+	/// <summary>
+	/// Counters, the thread one is constant initialized and safe from the first allocation
+	/// </summary>
+	static thread_local bit64 threadAllocs = 0;
+	static std::atomic<bit64> totalAllocs{ 0 };
+#endif
+
+
+	/// <summary>
+	/// Gets if the counting allocator is built in
+	/// </summary>
+	bool AllocCounter::enabled() {
+		return ALLOCCOUNT;
+	}
+
+
+	/// <summary>
+	/// Gets the allocations made by the calling thread
+	/// </summary>
+	bit64 AllocCounter::thread() {
+#if ALLOCCOUNT
+		return threadAllocs;
+#else
+		return 0;
+#endif
+	}
+
+
+	/// <summary>
+	/// Gets the allocations made by every thread
+	/// </summary>
+	bit64 AllocCounter::total() {
+#if ALLOCCOUNT
+		return totalAllocs.load(std::memory_order_relaxed);
+#else
+		return 0;
+#endif
+	}
+
+
+#if ALLOCCOUNT
+	/// <summary>
+	/// Counting allocation, the array and nothrow forms of the standard library call this one
+	/// </summary>
+	static void* countedAlloc(size_t size) {
+		threadAllocs++;
+		totalAllocs.fetch_add(1, std::memory_order_relaxed);
+		return malloc(size ? size : 1);
+	}
+#endif
+} // namespace TheBoy
+
+
+#if ALLOCCOUNT
+void* operator new(size_t size) {
+	void* p = TheBoy::countedAlloc(size);
+	if (!p) { throw std::bad_alloc(); }
+	return p;
+}
+
+void* operator new[](size_t size) {
+	return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+	return TheBoy::countedAlloc(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+	return TheBoy::countedAlloc(size);
+}
+
+void operator delete(void* p) noexcept {
+	free(p);
+}
+
+void operator delete[](void* p) noexcept {
+	free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+	free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+	free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept {
+	free(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept {
+	free(p);
+}
+#endif
@@ -0,0 +1,45 @@
+#pragma once
+#ifndef ALLOCCOUNTER_H
+#define ALLOCCOUNTER_H
+
+#include "common.h"
+
+/// <summary>
+/// Replaces the global operator new with a counting one (ALLOC_COUNTER cmake option, on in debug builds)
+/// Off, the default allocator is kept and the counters stay at 0
+/// </summary>
+#ifndef ALLOCCOUNT
+#ifdef NDEBUG
+#define ALLOCCOUNT false
+#else
+#define ALLOCCOUNT true
+#endif
+#endif
+
+namespace TheBoy {
+
+	/// <summary>
+	/// Heap allocation counter, counts every operator new of the process and of the calling thread
+	/// The emulation hot path (cpu step, bus, ppu dots, timer, dma, frame end) allocates nothing once loaded,
+	/// the counter is how it is checked
+	/// </summary>
+	namespace AllocCounter {
+		/// <summary>
+		/// Gets if the counting allocator is built in
+		/// </summary>
+		bool enabled();
+
+
+		/// <summary>
+		/// Gets the allocations made by the calling thread
+		/// </summary>
+		bit64 thread();
+
+
+		/// <summary>
+		/// Gets the allocations made by every thread
+		/// </summary>
+		bit64 total();
+	}
+} // namespace TheBoy
+#endif // !ALLOCCOUNTER_H
@@ -79,6 +79,12 @@ namespace TheBoy {
 		 */
 		bit64 ticks;
 
+
+		/**
+		 * @brief Holds the executed instructions count
+		 */
+		bit64 instructions;
+
 		/**
 		 * @brief Resets the Emulator state values
 		 */
@@ -86,6 +92,7 @@ namespace TheBoy {
 			paused = false;
 			running = true;
 			ticks = 0;
+			instructions = 0;
 		};
 
 	} EmulatorState;
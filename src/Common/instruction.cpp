@@ -6,7 +6,7 @@ namespace TheBoy {
 	 * @brief Defined instruction set for the LR35902 (GameBoy CPU)
 	 *  
 	 */
-	static Instruc instrucSet[0x100] = {
+	static const Instruc instrucSet[0x100] = {
 		/*0x00*/ {INST_NOP, OPMODE_NONE},
 		/*0x01*/ {INST_LD, OPMODE_R_V16, REG_BC},
 		/*0x02*/ {INST_LD, OPMODE_AR_R, REG_BC, REG_A},
@@ -271,9 +271,9 @@ namespace TheBoy {
 	/**
 	 * @brief Get the By Opcode object
 	 * @param opCd Opcode value for the instructions
-	 * @return Instruc* Pointer to Defined instruction value
+	 * @return const Instruc* Pointer to Defined instruction value
 	 */
-	Instruc* getByOpcode(bit8 opCd){
+	const Instruc* getByOpcode(bit8 opCd){
 		return &instrucSet[opCd];
 	}
 	
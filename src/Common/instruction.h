@@ -143,9 +143,9 @@ namespace TheBoy {
 	/**
 	 * @brief Get the By Opcode object
 	 * @param opCd Opcode value for the instructions
-	 * @return Instruc* Pointer to Defined instruction value
+	 * @return const Instruc* Pointer to Defined instruction value
 	 */
-	Instruc* getByOpcode(bit8 opCd);
+	const Instruc* getByOpcode(bit8 opCd);
 
 } // namespace TheBoy
 
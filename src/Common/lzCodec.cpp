@@ -0,0 +1,210 @@
+#include "lzCodec.h"
+#include <cstring>
+
+namespace TheBoy {
+	namespace LzCodec {
+
+		/// <summary>
+		/// Shortest match worth a sequence
+		/// </summary>
+		static const size_t MinMatch = 4;
+
+
+		/// <summary>
+		/// Trailing bytes always stored as literals, lets the match search read 8 bytes unchecked
+		/// </summary>
+		static const size_t LastLiterals = 8;
+
+
+		/// <summary>
+		/// Reads 4 bytes, unaligned
+		/// </summary>
+		static inline bit32 read32(const bit8* p) {
+			bit32 v;
+			memcpy(&v, p, sizeof(v));
+			return v;
+		}
+
+
+		/// <summary>
+		/// Reads 8 bytes, unaligned
+		/// </summary>
+		static inline bit64 read64(const bit8* p) {
+			bit64 v;
+			memcpy(&v, p, sizeof(v));
+			return v;
+		}
+
+
+		/// <summary>
+		/// Hash of the next 4 bytes
+		/// </summary>
+		static inline bit32 hash(bit32 seq) {
+			return (seq * 2654435761U) >> (32 - 12);
+		}
+
+
+		/// <summary>
+		/// Writes a length extension (255 per byte)
+		/// </summary>
+		static inline bit8* writeLength(bit8* op, size_t len) {
+			while (len >= 255) {
+				*op++ = 255;
+				len -= 255;
+			}
+			*op++ = static_cast<bit8>(len);
+			return op;
+		}
+
+
+		/// <summary>
+		/// Writes a sequence
+		/// </summary>
+		/// <param name="op">Output position</param>
+		/// <param name="lit">Literals start</param>
+		/// <param name="litLen">Literal count</param>
+		/// <param name="offset">Match offset, 0 for the last sequence</param>
+		/// <param name="matchLen">Match length</param>
+		/// <returns>Next output position</returns>
+		static bit8* writeSequence(bit8* op, const bit8* lit, size_t litLen, size_t offset, size_t matchLen) {
+			bit8* token = op++;
+			size_t ml = offset ? matchLen - MinMatch : 0;
+
+			*token = static_cast<bit8>(((litLen < 15 ? litLen : 15) << 4) | (ml < 15 ? ml : 15));
+			if (litLen >= 15) { op = writeLength(op, litLen - 15); }
+
+			memcpy(op, lit, litLen);
+			op += litLen;
+
+			if (offset) {
+				*op++ = static_cast<bit8>(offset & 0xFF);
+				*op++ = static_cast<bit8>(offset >> 8);
+				if (ml >= 15) { op = writeLength(op, ml - 15); }
+			}
+			return op;
+		}
+
+
+		/// <summary>
+		/// Worst case compressed size
+		/// </summary>
+		/// <param name="len">Source length</param>
+		/// <returns>Destination capacity that always fits</returns>
+		size_t bound(size_t len) {
+			return len + (len / 255) + 16;
+		}
+
+
+		/// <summary>
+		/// Compresses a buffer
+		/// </summary>
+		/// <param name="src">Source data</param>
+		/// <param name="len">Source length</param>
+		/// <param name="dst">Destination buffer</param>
+		/// <param name="cap">Destination capacity, at least bound(len)</param>
+		/// <param name="table">Scratch table with HashSize entries</param>
+		/// <returns>Compressed size, 0 if the capacity is too small</returns>
+		size_t compress(const bit8* src, size_t len, bit8* dst, size_t cap, bit32* table) {
+			if (cap < bound(len)) { return 0; }
+			memset(table, 0, HashSize * sizeof(bit32));
+
+			bit8* op = dst;
+			size_t anchor = 0;
+			size_t ip = 1;
+
+			if (len > MinMatch + LastLiterals) {
+				const size_t limit = len - LastLiterals;
+				table[hash(read32(src))] = 0;
+
+				while (ip + MinMatch <= limit) {
+					bit32 seq = read32(src + ip);
+					bit32& slot = table[hash(seq)];
+					size_t ref = slot;
+					slot = static_cast<bit32>(ip);
+
+					if (ref >= ip || ip - ref > 0xFFFF || read32(src + ref) != seq) {
+						ip++;
+						continue;
+					}
+
+					// Extend the match 8 bytes at a time, then byte by byte
+					size_t mLen = MinMatch;
+					while (ip + mLen + 8 <= limit && read64(src + ref + mLen) == read64(src + ip + mLen)) { mLen += 8; }
+					while (ip + mLen < limit && src[ref + mLen] == src[ip + mLen]) { mLen++; }
+
+					op = writeSequence(op, src + anchor, ip - anchor, ip - ref, mLen);
+					ip += mLen;
+					anchor = ip;
+				}
+			}
+
+			op = writeSequence(op, src + anchor, len - anchor, 0, 0);
+			return static_cast<size_t>(op - dst);
+		}
+
+
+		/// <summary>
+		/// Decompresses a buffer
+		/// </summary>
+		/// <param name="src">Compressed data</param>
+		/// <param name="len">Compressed length</param>
+		/// <param name="dst">Destination buffer</param>
+		/// <param name="cap">Destination capacity</param>
+		/// <returns>Decompressed size, 0 on corrupted input</returns>
+		size_t decompress(const bit8* src, size_t len, bit8* dst, size_t cap) {
+			size_t ip = 0;
+			size_t op = 0;
+
+			while (ip < len) {
+				bit8 token = src[ip++];
+
+				size_t litLen = token >> 4;
+				if (litLen == 15) {
+					bit8 b;
+					do {
+						if (ip >= len) { return 0; }
+						b = src[ip++];
+						litLen += b;
+					} while (b == 255);
+				}
+				if (ip + litLen > len || op + litLen > cap) { return 0; }
+				memcpy(dst + op, src + ip, litLen);
+				ip += litLen;
+				op += litLen;
+
+				// Last sequence has no match
+				if (ip >= len) { break; }
+
+				if (ip + 2 > len) { return 0; }
+				size_t offset = src[ip] | (src[ip + 1] << 8);
+				ip += 2;
+
+				size_t mLen = token & 0xF;
+				if (mLen == 15) {
+					bit8 b;
+					do {
+						if (ip >= len) { return 0; }
+						b = src[ip++];
+						mLen += b;
+					} while (b == 255);
+				}
+				mLen += MinMatch;
+
+				if (offset == 0 || offset > op || op + mLen > cap) { return 0; }
+
+				// Overlapping copies repeat the last bytes, a distance of 1 is a run
+				if (offset == 1) {
+					memset(dst + op, dst[op - 1], mLen);
+				}
+				else if (offset >= mLen) {
+					memcpy(dst + op, dst + op - offset, mLen);
+				}
+				else {
+					for (size_t i = 0; i < mLen; i++) { dst[op + i] = dst[op + i - offset]; }
+				}
+				op += mLen;
+			}
+			return op;
+		}
+	} // namespace LzCodec
+} // namespace TheBoy
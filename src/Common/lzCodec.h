@@ -0,0 +1,55 @@
+#pragma once
+#ifndef LZCODEC_H
+#define LZCODEC_H
+
+#include "common.h"
+
+namespace TheBoy {
+	/// <summary>
+	/// Small LZ77 byte codec (LZ4 like sequences), tuned for the save state deltas:
+	/// long zero runs become offset 1 matches, everything else is kept as literals.
+	/// No allocation, the caller owns every buffer
+	///
+	/// Sequence: token (literal length << 4 | match length - 4), literal length extension bytes,
+	///		literals, match offset (16bit little endian), match length extension bytes.
+	/// The last sequence only holds literals
+	/// </summary>
+	namespace LzCodec {
+		/// <summary>
+		/// Hash table entries needed by compress
+		/// </summary>
+		static const int HashSize = 1 << 12;
+
+
+		/// <summary>
+		/// Worst case compressed size
+		/// </summary>
+		/// <param name="len">Source length</param>
+		/// <returns>Destination capacity that always fits</returns>
+		size_t bound(size_t len);
+
+
+		/// <summary>
+		/// Compresses a buffer
+		/// </summary>
+		/// <param name="src">Source data</param>
+		/// <param name="len">Source length</param>
+		/// <param name="dst">Destination buffer</param>
+		/// <param name="cap">Destination capacity, at least bound(len)</param>
+		/// <param name="table">Scratch table with HashSize entries</param>
+		/// <returns>Compressed size, 0 if the capacity is too small</returns>
+		size_t compress(const bit8* src, size_t len, bit8* dst, size_t cap, bit32* table);
+
+
+		/// <summary>
+		/// Decompresses a buffer
+		/// </summary>
+		/// <param name="src">Compressed data</param>
+		/// <param name="len">Compressed length</param>
+		/// <param name="dst">Destination buffer</param>
+		/// <param name="cap">Destination capacity</param>
+		/// <returns>Decompressed size, 0 on corrupted input</returns>
+		size_t decompress(const bit8* src, size_t len, bit8* dst, size_t cap);
+	} // namespace LzCodec
+} // namespace TheBoy
+#endif // !LZCODEC_H
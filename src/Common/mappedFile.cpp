@@ -0,0 +1,121 @@
+#include "mappedFile.h"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace TheBoy {
+
+	/// <summary>
+	/// Mapped file constructor, closed
+	/// </summary>
+	MappedFile::MappedFile() {
+		bytes = nullptr;
+		length = 0;
+#ifdef _WIN32
+		file = INVALID_HANDLE_VALUE;
+		mapping = nullptr;
+#else
+		fd = -1;
+#endif
+	}
+
+
+	/// <summary>
+	/// Mapped file destructor, unmaps the file
+	/// </summary>
+	MappedFile::~MappedFile() {
+		close();
+	}
+
+
+	/// <summary>
+	/// Maps a whole file
+	/// </summary>
+	/// <param name="path">File path</param>
+	/// <returns>If the file was mapped</returns>
+	bool MappedFile::open(const char* path) {
+		close();
+
+#ifdef _WIN32
+		file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE) { return false; }
+
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize)) {
+			close();
+			return false;
+		}
+		length = static_cast<size_t>(fileSize.QuadPart);
+		if (length == 0) { return true; }
+
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!mapping) {
+			close();
+			return false;
+		}
+		bytes = static_cast<const bit8*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+#else
+		fd = ::open(path, O_RDONLY);
+		if (fd < 0) { return false; }
+
+		struct stat st;
+		if (fstat(fd, &st) != 0) {
+			close();
+			return false;
+		}
+		length = static_cast<size_t>(st.st_size);
+		if (length == 0) { return true; }
+
+		void* view = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+		bytes = (view == MAP_FAILED) ? nullptr : static_cast<const bit8*>(view);
+#endif
+
+		if (!bytes) {
+			close();
+			return false;
+		}
+		return true;
+	}
+
+
+	/// <summary>
+	/// Unmaps the file
+	/// </summary>
+	void MappedFile::close() {
+#ifdef _WIN32
+		if (bytes) { UnmapViewOfFile(bytes); }
+		if (mapping) { CloseHandle(mapping); }
+		if (file != INVALID_HANDLE_VALUE) { CloseHandle(file); }
+		file = INVALID_HANDLE_VALUE;
+		mapping = nullptr;
+#else
+		if (bytes) { munmap(const_cast<bit8*>(bytes), length); }
+		if (fd >= 0) { ::close(fd); }
+		fd = -1;
+#endif
+		bytes = nullptr;
+		length = 0;
+	}
+
+
+	/// <summary>
+	/// Hints the os the file is read from the start to the end
+	/// </summary>
+	void MappedFile::adviseSequential() {
+#ifndef _WIN32
+		if (bytes) { madvise(const_cast<bit8*>(bytes), length, MADV_SEQUENTIAL); }
+#endif
+	}
+} // namespace TheBoy
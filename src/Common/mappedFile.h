@@ -0,0 +1,83 @@
+#pragma once
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include "common.h"
+#include <cstddef>
+
+namespace TheBoy {
+	/// <summary>
+	/// Read only memory mapped file, the pages are loaded by the os on the first access
+	/// An empty file opens with no data
+	/// </summary>
+	class MappedFile {
+	public:
+		/// <summary>
+		/// Mapped file constructor, closed
+		/// </summary>
+		MappedFile();
+
+
+		/// <summary>
+		/// Mapped file destructor, unmaps the file
+		/// </summary>
+		~MappedFile();
+
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+
+		/// <summary>
+		/// Maps a whole file
+		/// </summary>
+		/// <param name="path">File path</param>
+		/// <returns>If the file was mapped</returns>
+		bool open(const char* path);
+
+
+		/// <summary>
+		/// Unmaps the file
+		/// </summary>
+		void close();
+
+
+		/// <summary>
+		/// Gets the mapped bytes
+		/// </summary>
+		/// <returns>File data, null when closed or empty</returns>
+		const bit8* data() const { return bytes; }
+
+
+		/// <summary>
+		/// Gets the file size
+		/// </summary>
+		/// <returns>Mapped bytes</returns>
+		size_t size() const { return length; }
+
+
+		/// <summary>
+		/// Hints the os the file is read from the start to the end
+		/// </summary>
+		void adviseSequential();
+
+	private:
+		/// <summary>
+		/// Mapped view
+		/// </summary>
+		const bit8* bytes;
+		size_t length;
+
+
+		/// <summary>
+		/// Platform handles, a file descriptor or the file and mapping handles
+		/// </summary>
+#ifdef _WIN32
+		void* file;
+		void* mapping;
+#else
+		int fd;
+#endif
+	};
+} // namespace TheBoy
+#endif // !MAPPEDFILE_H
@@ -0,0 +1,152 @@
+#include "perfCounters.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace TheBoy {
+
+	/// <summary>
+	/// Region names for the reports
+	/// </summary>
+	static const char* RegionNames[PERF_REGION_COUNT] = { "rom", "vram", "sram", "wram", "oam", "io", "hram", "other" };
+
+
+	/// <summary>
+	/// Lcd mode names for the reports
+	/// </summary>
+	static const char* ModeNames[4] = { "hblank", "vblank", "oam", "xfer" };
+
+
+	/// <summary>
+	/// Performance counters constructor, cleared
+	/// </summary>
+	PerfCounters::PerfCounters() {
+		reset();
+	}
+
+
+	/// <summary>
+	/// Clears every counter
+	/// </summary>
+	void PerfCounters::reset() {
+		memset(opcodes, 0, sizeof(opcodes));
+		memset(cbOpcodes, 0, sizeof(cbOpcodes));
+		cpuCycles = 0;
+		haltCycles = 0;
+		memset(ppuTicks, 0, sizeof(ppuTicks));
+		timerTicks = 0;
+		timerIncrements = 0;
+		dmaCycles = 0;
+		memset(reads, 0, sizeof(reads));
+		memset(writes, 0, sizeof(writes));
+	}
+
+
+	/// <summary>
+	/// Builds a text table of the counters, the most executed opcodes first
+	/// </summary>
+	/// <param name="topOpcodes">Opcode rows</param>
+	/// <returns>Table text</returns>
+	std::string PerfCounters::table(int topOpcodes) {
+		std::string out;
+		char line[160];
+
+		bit64 cycles = cpuCycles + haltCycles;
+		bit64 ppuTotal = ppuTicks[0] + ppuTicks[1] + ppuTicks[2] + ppuTicks[3];
+		double pct = cycles > 0 ? 100.0 / cycles : 0.0;
+		snprintf(line, sizeof(line), "cpu %llu m-cycles (%.1f%% halted), dma %.1f%%, timer on %.1f%% (%llu inc)\n",
+			static_cast<unsigned long long>(cycles), haltCycles * pct, dmaCycles * pct, timerTicks * pct / 4.0,
+			static_cast<unsigned long long>(timerIncrements));
+		out += line;
+
+		out += "ppu";
+		for (int i = 0; i < 4; i++) {
+			snprintf(line, sizeof(line), " %s %.1f%%", ModeNames[i], ppuTotal > 0 ? ppuTicks[i] * 100.0 / ppuTotal : 0.0);
+			out += line;
+		}
+		out += "\n";
+
+		bit64 accesses = 0;
+		for (int i = 0; i < PERF_REGION_COUNT; i++) { accesses += reads[i] + writes[i]; }
+		out += "bus r/w";
+		for (int i = 0; i < PERF_REGION_COUNT; i++) {
+			if (reads[i] + writes[i] == 0) { continue; }
+			snprintf(line, sizeof(line), " %s %.1f/%.1f%%", RegionNames[i],
+				accesses > 0 ? reads[i] * 100.0 / accesses : 0.0, accesses > 0 ? writes[i] * 100.0 / accesses : 0.0);
+			out += line;
+		}
+		out += "\n";
+
+		// Both tables ranked together, the CB ones as 0xCBxx
+		std::vector<std::pair<bit64, int>> ranked;
+		bit64 executed = 0;
+		for (int i = 0; i < 256; i++) {
+			if (opcodes[i] && i != 0xCB) { ranked.emplace_back(opcodes[i], i); }
+			if (cbOpcodes[i]) { ranked.emplace_back(cbOpcodes[i], 0xCB00 | i); }
+			executed += opcodes[i];
+		}
+		std::sort(ranked.begin(), ranked.end(), [](const std::pair<bit64, int>& a, const std::pair<bit64, int>& b) {
+			return a.first > b.first;
+		});
+
+		out += "top opcodes";
+		for (int i = 0; i < topOpcodes && i < static_cast<int>(ranked.size()); i++) {
+			snprintf(line, sizeof(line), ranked[i].second > 0xFF ? " %04X %.1f%%" : " %02X %.1f%%",
+				ranked[i].second, executed > 0 ? ranked[i].first * 100.0 / executed : 0.0);
+			out += line;
+		}
+		return out;
+	}
+
+
+	/// <summary>
+	/// Writes an array of counters
+	/// </summary>
+	static void writeArray(FILE* out, const char* name, const bit64* values, int count) {
+		fprintf(out, "  \"%s\": [", name);
+		for (int i = 0; i < count; i++) {
+			fprintf(out, "%s%llu", i ? ", " : "", static_cast<unsigned long long>(values[i]));
+		}
+		fprintf(out, "]");
+	}
+
+
+	/// <summary>
+	/// Writes the counters as json
+	/// </summary>
+	/// <param name="path">Target file path</param>
+	/// <returns>If the file was written</returns>
+	bool PerfCounters::writeJson(const char* path) {
+		FILE* out = fopen(path, "w");
+		if (!out) {
+			printf("[PERF] ::: Failed to open %s\n", path);
+			return false;
+		}
+
+		fprintf(out, "{\n  \"cpu\": {\"cycles\": %llu, \"halted\": %llu},\n",
+			static_cast<unsigned long long>(cpuCycles), static_cast<unsigned long long>(haltCycles));
+		fprintf(out, "  \"ppu\": {");
+		for (int i = 0; i < 4; i++) {
+			fprintf(out, "%s\"%s\": %llu", i ? ", " : "", ModeNames[i], static_cast<unsigned long long>(ppuTicks[i]));
+		}
+		fprintf(out, "},\n  \"timer\": {\"ticks\": %llu, \"increments\": %llu},\n",
+			static_cast<unsigned long long>(timerTicks), static_cast<unsigned long long>(timerIncrements));
+		fprintf(out, "  \"dma\": {\"cycles\": %llu},\n", static_cast<unsigned long long>(dmaCycles));
+
+		fprintf(out, "  \"bus\": {\n");
+		for (int i = 0; i < PERF_REGION_COUNT; i++) {
+			fprintf(out, "    \"%s\": {\"reads\": %llu, \"writes\": %llu}%s\n", RegionNames[i],
+				static_cast<unsigned long long>(reads[i]), static_cast<unsigned long long>(writes[i]),
+				i + 1 < PERF_REGION_COUNT ? "," : "");
+		}
+		fprintf(out, "  },\n");
+
+		writeArray(out, "opcodes", opcodes, 256);
+		fprintf(out, ",\n");
+		writeArray(out, "cbOpcodes", cbOpcodes, 256);
+		fprintf(out, "\n}\n");
+		fclose(out);
+		return true;
+	}
+} // namespace TheBoy
@@ -0,0 +1,139 @@
+#pragma once
+#ifndef PERFCOUNTERS_H
+#define PERFCOUNTERS_H
+
+#include "common.h"
+#include <string>
+
+/// <summary>
+/// Builds the performance counters into the cpu, bus, ppu, timer and dma hot paths (PERF_COUNTERS cmake option)
+/// Off, the hooks are not compiled at all
+/// </summary>
+#ifndef PERFCOUNT
+#define PERFCOUNT false
+#endif
+
+namespace TheBoy {
+
+	/// <summary>
+	/// Bus regions counted by the performance counters
+	/// </summary>
+	typedef enum PERF_REGION {
+		PERF_ROM,
+		PERF_VRAM,
+		PERF_SRAM,
+		PERF_WRAM,
+		PERF_OAM,
+		PERF_IO,
+		PERF_HRAM,
+		PERF_OTHER,
+		PERF_REGION_COUNT
+	} PERF_REGION;
+
+
+	/// <summary>
+	/// Executed opcodes, component cycles and bus accesses of an emulator instance
+	/// Plain counters written by the emulation thread, readers get a torn view at worst
+	/// </summary>
+	class PerfCounters {
+	public:
+		/// <summary>
+		/// Executed opcodes, the CB table separated
+		/// </summary>
+		bit64 opcodes[256];
+		bit64 cbOpcodes[256];
+
+
+		/// <summary>
+		/// Cpu machine cycles, running and halted
+		/// </summary>
+		bit64 cpuCycles;
+		bit64 haltCycles;
+
+
+		/// <summary>
+		/// Ppu ticks per Lcd mode (HBLANK, VBLANK, OAM, XFER)
+		/// </summary>
+		bit64 ppuTicks[4];
+
+
+		/// <summary>
+		/// Timer ticks with TIMA enabled, and TIMA increments
+		/// </summary>
+		bit64 timerTicks;
+		bit64 timerIncrements;
+
+
+		/// <summary>
+		/// Machine cycles with an OAM dma running
+		/// </summary>
+		bit64 dmaCycles;
+
+
+		/// <summary>
+		/// Bus accesses per region
+		/// </summary>
+		bit64 reads[PERF_REGION_COUNT];
+		bit64 writes[PERF_REGION_COUNT];
+
+
+		/// <summary>
+		/// Performance counters constructor, cleared
+		/// </summary>
+		PerfCounters();
+
+
+		/// <summary>
+		/// Clears every counter
+		/// </summary>
+		void reset();
+
+
+		/// <summary>
+		/// Gets the bus region of an address
+		/// </summary>
+		/// <param name="addr">Bus address</param>
+		/// <returns>Region</returns>
+		static PERF_REGION regionOf(bit16 addr) {
+			if (addr < 0x8000) { return PERF_ROM; }
+			if (addr < 0xA000) { return PERF_VRAM; }
+			if (addr < 0xC000) { return PERF_SRAM; }
+			if (addr < 0xE000) { return PERF_WRAM; }
+			if (addr >= 0xFE00 && addr < 0xFEA0) { return PERF_OAM; }
+			if (addr >= 0xFF00 && addr < 0xFF80) { return PERF_IO; }
+			if (addr >= 0xFF80 && addr < 0xFFFF) { return PERF_HRAM; }
+			return PERF_OTHER;
+		}
+
+
+		/// <summary>
+		/// Counts a bus read
+		/// </summary>
+		/// <param name="addr">Bus address</param>
+		void countRead(bit16 addr) { reads[regionOf(addr)]++; }
+
+
+		/// <summary>
+		/// Counts a bus write
+		/// </summary>
+		/// <param name="addr">Bus address</param>
+		void countWrite(bit16 addr) { writes[regionOf(addr)]++; }
+
+
+		/// <summary>
+		/// Builds a text table of the counters, the most executed opcodes first
+		/// </summary>
+		/// <param name="topOpcodes">Opcode rows</param>
+		/// <returns>Table text</returns>
+		std::string table(int topOpcodes);
+
+
+		/// <summary>
+		/// Writes the counters as json
+		/// </summary>
+		/// <param name="path">Target file path</param>
+		/// <returns>If the file was written</returns>
+		bool writeJson(const char* path);
+	};
+} // namespace TheBoy
+#endif // !PERFCOUNTERS_H
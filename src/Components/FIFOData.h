@@ -30,20 +30,14 @@ The order of the steps are as follows:
 
 
 	/// <summary>
-	/// Linked element representing the fetch information
-	/// </summary>
-	typedef struct FIFO_Value {
-		FIFO_Value* next = NULL;
-		bit32 color;
-	} FIFO_Value;
-
-
-	/// <summary>
-	/// FIFO Structure
+	/// FIFO Structure, fixed ring buffer
+	/// A tile is only pushed while 8 or less pixels are queued, so 16 entries are never exceeded
+	/// Holds no pointers, the whole fifo is copied as is by the save states
 	/// </summary>
 	typedef struct PIXELFIFO{
-		FIFO_Value* head;
-		FIFO_Value* tail;
+		static const bit32 Capacity = 16;
+		bit32 colors[Capacity];
+		bit32 head;
 		bit32 size;
 	} PIXELFIFO;
 
@@ -72,7 +66,7 @@ The order of the steps are as follows:
 			pushedX = 0;
 			fetchedX = 0;
 			pixelFifo.size = 0;
-			pixelFifo.head = pixelFifo.tail = NULL;
+			pixelFifo.head = 0;
 			currState = FIFOSTATE::FF_TILE;
 		}
 	} FIFO_DATA;
@@ -10,21 +10,15 @@ namespace TheBoy {
 		/// <param name="ctrl">Target Emulator controller</param>
 		/// <param name="value">Push value</param>
 		void FifoPush(EmulatorController* ctrl, bit32 value) {
-			FIFO_Value* next = new FIFO_Value();
-			next->next = NULL;
-			next->color = value;
-
-			// Initial entry, set the head and tail to the created next
-			if (ctrl->getPpu()->getFifo()->pixelFifo.head == NULL) {
-				ctrl->getPpu()->getFifo()->pixelFifo.head = ctrl->getPpu()->getFifo()->pixelFifo.tail = next;
-			}
-			else {
-				// If not defined the current tail next and the created next and define it as the new tail
-				ctrl->getPpu()->getFifo()->pixelFifo.tail->next = next;
-				ctrl->getPpu()->getFifo()->pixelFifo.tail = next;
+			PIXELFIFO& fifo = ctrl->getPpu()->getFifo()->pixelFifo;
+			if (fifo.size >= PIXELFIFO::Capacity) {
+				printf("[PIXEL PIPE] ::: ->  ERROR PUSHING FIFO VALUE! Fifo is full!\n");
+				fflush(stdout);
+				return;
 			}
 
-			ctrl->getPpu()->getFifo()->pixelFifo.size++;
+			fifo.colors[(fifo.head + fifo.size) % PIXELFIFO::Capacity] = value;
+			fifo.size++;
 		}
 
 		/// <summary>
@@ -33,17 +27,16 @@ namespace TheBoy {
 		/// <param name="ctrl">Target Emulator controller</param>
 		/// <returns>Defined value</returns>
 		bit32 FifoPop(EmulatorController* ctrl) {
-			if (ctrl->getPpu()->getFifo()->pixelFifo.size <= 0) {
+			PIXELFIFO& fifo = ctrl->getPpu()->getFifo()->pixelFifo;
+			if (fifo.size <= 0) {
 				printf("[PIXEL PIPE] ::: ->  ERROR POPING FIFO VALUE! Wrong size!\n");
 				fflush(stdout);
+				return 0;
 			}
 
-			FIFO_Value* popHead = ctrl->getPpu()->getFifo()->pixelFifo.head;
-			ctrl->getPpu()->getFifo()->pixelFifo.head = popHead->next;
-			ctrl->getPpu()->getFifo()->pixelFifo.size--;
-
-			bit32 val = popHead->color;
-			delete popHead;
+			bit32 val = fifo.colors[fifo.head];
+			fifo.head = (fifo.head + 1) % PIXELFIFO::Capacity;
+			fifo.size--;
 
 			return val;
 		}
@@ -61,10 +54,17 @@ namespace TheBoy {
 			case FIFOSTATE::FF_TILE: {
 				ctrl->getPpu()->setFetchedEntryCounter(0);
 
+				// Skipped frame, only the fetcher timing is kept
+				if (ctrl->getPpu()->isFrameSkipped()) {
+					ctrl->getPpu()->getFifo()->currState = FIFOSTATE::FF_DATA_LOW;
+					ctrl->getPpu()->getFifo()->fetchedX += 8;
+					break;
+				}
+
 				if (ctrl->getLcd()->getLCDCBgwEnable())
 				{
 					// Loading 8 pixels per iteration
-					ctrl->getPpu()->getFifo()->bg_fetched[0] = ctrl->getCpu()->requestBusRead(
+					ctrl->getPpu()->getFifo()->bg_fetched[0] = ctrl->getBus()->abRead(
 						ctrl->getLcd()->getLCDCBgMapArea() +
 						(ctrl->getPpu()->getFifo()->mapX / 8) +
 						((ctrl->getPpu()->getFifo()->mapY / 8) * 32)
@@ -95,8 +95,13 @@ namespace TheBoy {
 				*	then the tile data is read as $FF.
 				*/
 			case FIFOSTATE::FF_DATA_LOW: {
+				if (ctrl->getPpu()->isFrameSkipped()) {
+					ctrl->getPpu()->getFifo()->currState = FIFOSTATE::FF_DATA_HIGH;
+					break;
+				}
+
 				ctrl->getPpu()->getFifo()->bg_fetched[1] =
-					ctrl->getCpu()->requestBusRead(ctrl->getLcd()->getLCDCBgwDataArea() +
+					ctrl->getBus()->abRead(ctrl->getLcd()->getLCDCBgwDataArea() +
 						(ctrl->getPpu()->getFifo()->bg_fetched[0] * 16) + ctrl->getPpu()->getFifo()->tileY
 					);
 
@@ -110,8 +115,13 @@ namespace TheBoy {
 				The tile data retrieved in this step will be used in the push steps.
 				*/
 			case FIFOSTATE::FF_DATA_HIGH: {
+				if (ctrl->getPpu()->isFrameSkipped()) {
+					ctrl->getPpu()->getFifo()->currState = FIFOSTATE::FF_SLEEP;
+					break;
+				}
+
 				ctrl->getPpu()->getFifo()->bg_fetched[2] =
-					ctrl->getCpu()->requestBusRead(ctrl->getLcd()->getLCDCBgwDataArea() +
+					ctrl->getBus()->abRead(ctrl->getLcd()->getLCDCBgwDataArea() +
 						(ctrl->getPpu()->getFifo()->bg_fetched[0] * 16) + ctrl->getPpu()->getFifo()->tileY + 1
 					);
 
@@ -148,6 +158,17 @@ namespace TheBoy {
 		/// <param name="ctrl">Target Emulator controller</param>
 		void PipelinePushPixel(EmulatorController* ctrl) {
 			if (ctrl->getPpu()->getFifo()->pixelFifo.size > 8) {
+				// Skipped frame, the pixel is consumed without being composed or written
+				if (ctrl->getPpu()->isFrameSkipped()) {
+					ctrl->getPpu()->getFifo()->pixelFifo.size--;
+
+					if (ctrl->getPpu()->getFifo()->lineX >= ctrl->getLcd()->getLcdRegistors()->scrollX % 8) {
+						ctrl->getPpu()->getFifo()->pushedX++;
+					}
+					ctrl->getPpu()->getFifo()->lineX++;
+					return;
+				}
+
 				bit32 pData = FifoPop(ctrl);
 
 				if (ctrl->getPpu()->getFifo()->lineX >= ctrl->getLcd()->getLcdRegistors()->scrollX % 8) {
@@ -196,6 +217,15 @@ namespace TheBoy {
 			int x = ctrl->getPpu()->getFifo()->fetchedX -
 				(8 - (ctrl->getLcd()->getLcdRegistors()->scrollX % 8));
 
+			// Skipped frame, only the fifo size is tracked so the mode 3 length stays the same
+			if (ctrl->getPpu()->isFrameSkipped()) {
+				if (x >= 0) {
+					ctrl->getPpu()->getFifo()->pixelFifo.size += 8;
+					ctrl->getPpu()->getFifo()->fifoX += 8;
+				}
+				return true;
+			}
+
 			for (int i = 0; i < 8; i++)
 			{
 				int bit = 7 - i;
@@ -228,11 +258,9 @@ namespace TheBoy {
 		/// </summary>
 		/// <param name="ctrl">Target Emulator controller</param>
 		void PipelineFiFoReset(EmulatorController* ctrl) {
-			while (ctrl->getPpu()->getFifo()->pixelFifo.size)
-			{
-				FifoPop(ctrl);
-			}
-			ctrl->getPpu()->getFifo()->pixelFifo.head = NULL;
+			// Entries are not owned, dropping them is just moving back to an empty ring
+			ctrl->getPpu()->getFifo()->pixelFifo.size = 0;
+			ctrl->getPpu()->getFifo()->pixelFifo.head = 0;
 		}
 
 		/// <summary>
@@ -336,7 +364,7 @@ namespace TheBoy {
 				}
 
 				ctrl->getPpu()->getFifo()->fetch_data[(i * 2) + offset] =
-					ctrl->getCpu()->requestBusRead(0x8000 + (tileId * 16) + tileY + offset);
+					ctrl->getBus()->abRead(0x8000 + (tileId * 16) + tileY + offset);
 			}
 		}
 
@@ -369,7 +397,7 @@ namespace TheBoy {
 				if (ctrl->getLcd()->getLyValue() >= wY && ctrl->getLcd()->getLyValue() < (wY + Ppu::xRes))
 				{
 					bit8 wTileY = ctrl->getPpu()->getWindowLine() / 8;
-					ctrl->getPpu()->getFifo()->bg_fetched[0] = ctrl->getCpu()->requestBusRead(
+					ctrl->getPpu()->getFifo()->bg_fetched[0] = ctrl->getBus()->abRead(
 						ctrl->getLcd()->getLCDCWindMapArea() +
 						((ctrl->getPpu()->getFifo()->fetchedX + 7 - ctrl->getLcd()->getLcdRegistors()->WX) / 8) +
 						(wTileY * 32)
@@ -19,6 +19,10 @@ namespace TheBoy {
 		//printf("[ADDRESSBUS] ::: Reading from addr: %2.2X\n", addr);
 		//fflush(stdout);
 
+#if PERFCOUNT
+		emuCtrl->getPerf()->countRead(addr);
+#endif
+
 		// From cartridge, fixed bank and switchable via mapper
 		if(addr < 0x8000) {
 			return emuCtrl->getCartridge()->read(addr);
@@ -96,6 +100,10 @@ namespace TheBoy {
 		//printf("[ADDRESSBUS] ::: Writing to addr: %2.2X\n", addr);
 		//fflush(stdout);
 
+#if PERFCOUNT
+		emuCtrl->getPerf()->countWrite(addr);
+#endif
+
 		// From cartridge, fixed bank and switchable via mapper
 		if(addr < 0x8000){
 			emuCtrl->getCartridge()->write(addr, val);
@@ -0,0 +1,186 @@
+#include "batteryWriter.h"
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <unordered_map>
+#ifdef _WIN32
+#include <io.h>
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+namespace TheBoy {
+
+	/// <summary>
+	/// Writers created by this process, names their temporary files
+	/// </summary>
+	static std::atomic<bit32> writerCount{ 0 };
+
+
+	/// <summary>
+	/// Battery writer constructor, starts the thread
+	/// </summary>
+	/// <param name="path">Battery file path</param>
+	/// <param name="image">Initial file content, the loaded battery</param>
+	/// <param name="size">File size</param>
+	BatteryWriter::BatteryWriter(const std::string& path, const bit8* image, size_t size) {
+		this->path = path;
+		// Every instance of a rom saves to the same battery file, each writer renames its own temporary file
+		tempPath = path + "." + std::to_string(getpid()) + "-" + std::to_string(writerCount.fetch_add(1)) + ".tmp";
+		this->size = size;
+		staging.reset(new bit8[size]);
+		this->image.reset(new bit8[size]);
+		memcpy(staging.get(), image, size);
+		pending = false;
+		stopping = false;
+		writes = 0;
+		writer = std::thread(&BatteryWriter::writeLoop, this);
+	}
+
+
+	/// <summary>
+	/// Battery writer destructor, writes the pending image and stops the thread
+	/// </summary>
+	BatteryWriter::~BatteryWriter() {
+		{
+			std::lock_guard<std::mutex> lock(stagingLock);
+			stopping = true;
+		}
+		stagingCond.notify_one();
+		writer.join();
+	}
+
+
+	/// <summary>
+	/// Locks the staging image to copy the dirty data in it
+	/// </summary>
+	/// <param name="wait">Waits for the writer, only on shutdown</param>
+	/// <returns>Staging image, null when the writer holds it</returns>
+	bit8* BatteryWriter::acquire(bool wait) {
+		if (wait) { stagingLock.lock(); }
+		else if (!stagingLock.try_lock()) { return nullptr; }
+		return staging.get();
+	}
+
+
+	/// <summary>
+	/// Unlocks the staging image and wakes the writer
+	/// </summary>
+	void BatteryWriter::release() {
+		pending = true;
+		stagingLock.unlock();
+		stagingCond.notify_one();
+	}
+
+
+	/// <summary>
+	/// Gets the files written
+	/// </summary>
+	bit64 BatteryWriter::getWrites() {
+		std::lock_guard<std::mutex> lock(stagingLock);
+		return writes;
+	}
+
+
+	/// <summary>
+	/// Writer thread loop, the pending image is written before stopping
+	/// </summary>
+	void BatteryWriter::writeLoop() {
+		std::unique_lock<std::mutex> lock(stagingLock);
+		while (true) {
+			stagingCond.wait(lock, [this] { return pending || stopping; });
+			if (!pending) { break; }
+
+			// Only the copy is made under the lock, the disk is never waited on with it held
+			memcpy(image.get(), staging.get(), size);
+			pending = false;
+			lock.unlock();
+			bool written = writeFile();
+			lock.lock();
+			if (written) { writes++; }
+		}
+	}
+
+
+	/// <summary>
+	/// Writes the image to the temporary file and renames it over the battery file, writer thread only
+	/// </summary>
+	/// <returns>If the battery file was replaced</returns>
+	bool BatteryWriter::writeFile() {
+		FILE* file = fopen(tempPath.c_str(), "wb");
+		if (!file) {
+			printf("[CARTRIDGE] :: Failed to write the save cartridge to ( %s )\n", tempPath.c_str());
+			return false;
+		}
+
+		bool ok = fwrite(image.get(), 1, size, file) == size && fflush(file) == 0;
+		// On the disk before the rename, else a crash can leave the renamed file empty
+#ifdef _WIN32
+		ok = ok && _commit(_fileno(file)) == 0;
+#else
+		ok = ok && fsync(fileno(file)) == 0;
+#endif
+		ok = (fclose(file) == 0) && ok;
+
+		std::error_code err;
+		if (ok) { std::filesystem::rename(tempPath, path, err); }
+		if (!ok || err) {
+			printf("[CARTRIDGE] :: Failed to replace the save cartridge ( %s )\n", path.c_str());
+			std::filesystem::remove(tempPath, err);
+			return false;
+		}
+		return true;
+	}
+
+
+	/// <summary>
+	/// Running writers by canonical battery path, guarded by the cache lock
+	/// </summary>
+	static std::mutex cacheLock;
+	static std::unordered_map<std::string, std::weak_ptr<BatteryWriter>> cache;
+
+
+	/// <summary>
+	/// Gets the writer of a battery file, starting it when no instance holds it yet
+	/// </summary>
+	/// <param name="path">Battery file path</param>
+	/// <param name="image">Initial file content, only used by a new writer</param>
+	/// <param name="size">File size</param>
+	/// <returns>Shared writer</returns>
+	std::shared_ptr<BatteryWriter> BatteryCache::acquire(const std::string& path, const bit8* image, size_t size) {
+		std::error_code err;
+		std::string key = std::filesystem::weakly_canonical(path, err).string();
+		if (err) { key = path; }
+
+		std::lock_guard<std::mutex> lock(cacheLock);
+		std::shared_ptr<BatteryWriter> writer = cache[key].lock();
+		// Same path, same rom, a different size only comes from a rom replaced while running
+		if (writer && writer->getSize() == size) { return writer; }
+
+		writer = std::make_shared<BatteryWriter>(path, image, size);
+		cache[key] = writer;
+
+		// Drops the entries of the stopped writers
+		for (auto it = cache.begin(); it != cache.end();) {
+			if (it->second.expired()) { it = cache.erase(it); }
+			else { ++it; }
+		}
+		return writer;
+	}
+
+
+	/// <summary>
+	/// Gets the writers currently running
+	/// </summary>
+	size_t BatteryCache::count() {
+		std::lock_guard<std::mutex> lock(cacheLock);
+		size_t alive = 0;
+		for (const std::pair<const std::string, std::weak_ptr<BatteryWriter>>& entry : cache) {
+			alive += entry.second.expired() ? 0 : 1;
+		}
+		return alive;
+	}
+} // namespace TheBoy
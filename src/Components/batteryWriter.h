@@ -0,0 +1,131 @@
+#pragma once
+#ifndef BATTERYWRITER_H
+#define BATTERYWRITER_H
+
+#include "common.h"
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace TheBoy {
+
+	/// <summary>
+	/// Battery file writer, persists the cartridge ram from its own thread
+	/// The cartridges copy their dirty ranges to a staging image, the writer copies that image out and writes it
+	/// to a temporary file of its own renamed over the battery file, a crash or another process saving the rom
+	/// at the same time leaves either save whole, never a mix.
+	/// Every instance of a rom in the process shares one writer, the latest write to a range wins.
+	/// The emulation thread never waits: a staging image still being copied out is retried on the next save
+	/// </summary>
+	class BatteryWriter {
+	public:
+		/// <summary>
+		/// Battery writer constructor
+		/// </summary>
+		/// <param name="path">Battery file path</param>
+		/// <param name="image">Initial file content, the loaded battery</param>
+		/// <param name="size">File size</param>
+		BatteryWriter(const std::string& path, const bit8* image, size_t size);
+
+
+		/// <summary>
+		/// Battery writer destructor, writes the pending image and stops the thread
+		/// </summary>
+		~BatteryWriter();
+
+
+		/// <summary>
+		/// Locks the staging image to copy the dirty data in it
+		/// </summary>
+		/// <param name="wait">Waits for the writer, only on shutdown</param>
+		/// <returns>Staging image, null when the writer holds it</returns>
+		bit8* acquire(bool wait = false);
+
+
+		/// <summary>
+		/// Unlocks the staging image and wakes the writer
+		/// </summary>
+		void release();
+
+
+		/// <summary>
+		/// Gets the files written
+		/// </summary>
+		bit64 getWrites();
+
+
+		/// <summary>
+		/// Gets the battery file size
+		/// </summary>
+		size_t getSize() const { return size; }
+
+	private:
+		/// <summary>
+		/// Battery file path and its temporary file
+		/// </summary>
+		std::string path;
+		std::string tempPath;
+
+
+		/// <summary>
+		/// Staging image filled by the emulation thread and the copy being written
+		/// </summary>
+		std::unique_ptr<bit8[]> staging;
+		std::unique_ptr<bit8[]> image;
+		size_t size;
+
+
+		/// <summary>
+		/// Staging lock, held by the writer only while it copies the image out
+		/// </summary>
+		std::mutex stagingLock;
+		std::condition_variable stagingCond;
+		bool pending;
+		bool stopping;
+		bit64 writes;
+
+
+		/// <summary>
+		/// Writer thread
+		/// </summary>
+		std::thread writer;
+
+
+		/// <summary>
+		/// Writer thread loop
+		/// </summary>
+		void writeLoop();
+
+
+		/// <summary>
+		/// Writes the image to the temporary file and renames it over the battery file, writer thread only
+		/// </summary>
+		/// <returns>If the battery file was replaced</returns>
+		bool writeFile();
+	};
+
+
+	/// <summary>
+	/// Process wide battery writers, every instance of a rom shares one writer and its thread
+	/// The cache only keeps weak references, the writer stops with the last cartridge using it
+	/// </summary>
+	namespace BatteryCache {
+		/// <summary>
+		/// Gets the writer of a battery file, starting it when no instance holds it yet
+		/// </summary>
+		/// <param name="path">Battery file path</param>
+		/// <param name="image">Initial file content, only used by a new writer</param>
+		/// <param name="size">File size</param>
+		/// <returns>Shared writer</returns>
+		std::shared_ptr<BatteryWriter> acquire(const std::string& path, const bit8* image, size_t size);
+
+
+		/// <summary>
+		/// Gets the writers currently running
+		/// </summary>
+		size_t count();
+	}
+} // namespace TheBoy
+#endif // !BATTERYWRITER_H
@@ -1,4 +1,6 @@
 #include <fstream>
+#include "machineState.h"
+#include <algorithm>
 #include <iomanip>
 #include <cstring>
 
@@ -18,35 +20,42 @@ namespace TheBoy {
 	};
 
 
+	/**
+	 * @brief Destroy the Cartridge object, the battery is saved a last time
+	 */
+	Cartridge::~Cartridge() {
+		if (!batteryWriter) { return; }
+
+		// The clock moves without any write, its footer is always saved
+		if (needsSave || mapper->getFooterSize() > 0) { batterySave(true); }
+		batteryWriter.reset();
+	}
+
+
 	/**
 	 * @brief Tries to load the cartridge from the defined path
 	 * @return true If was able to load
 	 * @return false If failed to load
 	 */
 	bool Cartridge::loadCartridgeFromFile() {
-		std::fstream loadStream(path, std::ios::in | std::ifstream::ate | std::ifstream::binary);
+		// Mapped read only, every instance of the rom shares the same pages
+		romImage = RomCache::acquire(path);
 
-		if (!loadStream.is_open()) {
+		if (!romImage) {
 			std::cout << "[CARTRIDGE] :: Failed to load the cartridge from ( " <<
 				path << " )" << std::endl;
 			return false;
 		}
 		std::cout << "[CARTRIDGE] :: Valid cartridge path, reading ..." << std::endl;
 
-		rom_size = static_cast<bit32>(loadStream.tellg());
-		loadStream.seekg(0, std::ios_base::beg);
+		rom_data = romImage->data();
+		rom_size = static_cast<bit32>(romImage->size());
+		cart_state->newCartType = rom_data[0x33];
 
-		char* temp_data(new char[rom_size + 1] {});
-		loadStream.read(temp_data, rom_size);
-		loadStream.close();
-
-		temp_data[rom_size] = 0;
-
-		memcpy(&cart_state->newCartType, temp_data + size_t(0x33), 1);
-
-		rom_data = new bit8[rom_size]{};
-		memcpy(rom_data, temp_data, rom_size);
-		delete[] temp_data;
+		// Bank count rounded up to a power of 2, the unused bank bits are not wired
+		romBanks = std::max<bit32>(rom_size, RomImage::MinSize) / 0x4000;
+		romBankMask = 1;
+		while (romBankMask + 1 < romBanks) { romBankMask = (romBankMask << 1) | 1; }
 
 		assignCartData();
 		bool checkSum = cartridgeCheckSum();
@@ -58,6 +67,18 @@ namespace TheBoy {
 		if (hasBattery) {
 			// Load battery data
 			batteryLoad();
+
+			size_t size = batterySize();
+			if (size > 0) {
+				// A new writer starts from the loaded file, the saves only copy the ranges written since. Other
+				// instances of the rom already running share their writer
+				std::unique_ptr<bit8[]> image(new bit8[size]);
+				if (ramBankCount) { memcpy(image.get(), ramData.get(), ramBankCount * 0x2000); }
+				if (mapper->getFooterSize() > 0) { mapper->writeFooter(image.get() + ramBankCount * 0x2000); }
+				batteryWriter = BatteryCache::acquire(std::string(path) + ".batt", image.get(), size);
+			}
+			dirtyBegin = ramBankCount * 0x2000;
+			dirtyEnd = 0;
 		}
 
 		std::cout << "[CARTRIDGE] :: " << (checkSum ?
@@ -104,87 +125,59 @@ namespace TheBoy {
 	}
 
 
-	/**
-	 * @brief Reads data from the loaded cartridge
-	 * @param addr Cartridge address
-	 * @return bit8 Valeu on the defined address
-	 */
-	bit8 Cartridge::read(bit16 addr) {
-		if (!isMBCOne() || addr < 0x4000) { return rom_data[addr]; }
-
-		/// A000-BFFF - RAM Bank 00-03, if any (Read/Write)
-		if ((addr & 0xE000) == 0xA000) {
-			if (!enabledRam) { return 0xFF; }
-
-			if (!currRambank) { return 0xFF; }
-			return currRambank[addr - 0xA000];
-		}
-		return romBankX[addr - 0x4000];
-	}
-
-
 	/**
 	 * @brief Writes data to the defined cartridge address
 	 * @param addr Target address
 	 * @param val Value to be written
 	 */
 	void Cartridge::write(bit16 addr, bit8 val) {
-		if (!isMBCOne()) { return; }
-		// 0000-1FFF - RAM Enable (Write Only)
-		/*
-		* $00  Disable RAM (default)
-		* $0A  Enable RAM
-		*/
-		if (addr < 0x2000) {
-			enabledRam = (val & 0xF) == 0xA;
-		}
-
-		if ((addr & 0xE000) == 0x2000) {
-			// ROM Bank 2000-3FFF - ROM Bank Number (Write Only)
-			/*
-			* This 5-bit register (range $01-$1F) selects the ROM bank number
-			* for the 4000-7FFF region. Higher bits are discarded - writing $E1 (binary ~~111~~00001)
-			* to this register would select bank $01.
-			*/
-			if (val == 0) { val = 1; }
-			val &= 0b11111;
-			romBankVal = val;
-			romBankX = rom_data + (0x4000 * romBankVal);
+		// 0000-7FFF - Mapper registers
+		if (addr < 0x8000) {
+			mapper->write(addr, val);
+			return;
 		}
 
-		if ((addr & 0xE000) == 0x4000) {
-			// Ram Bank Number 4000-5FFF - RAM Bank Number
-			// - or - Upper Bits of ROM Bank Number (Write Only)
-			ramBankVal = val & 0b11;
-			if (bankingRam) {
-				if (needSave()) { batterySave(); }
-				currRambank = ramBanks[ramBankVal];
-			}
+		// A000-BFFF - RAM Bank, if any and enabled
+		if (ramMapped) {
+			ramMapped[addr - 0xA000] = val;
+			ramWritten(ramMapped + (addr - 0xA000));
+			return;
 		}
+		mapper->writeRam(addr, val);
+	}
 
-		if ((addr & 0xE000) == 0x6000) {
-			/// 6000-7FFF - Banking Mode Select (Write Only)
-			bankingMode = val & 1;
-			bankingRam = bankingMode;
-			if (bankingRam) {
-				if (needSave()) { batterySave(); }
-				currRambank = ramBanks[ramBankVal];
-			}
-		}
 
-		if ((addr & 0xE000) == 0xA000) {
-			// A000-BFFF - RAM Bank 00-03, if any (Read/Write)
-			if (!enabledRam) { return; }
-			if (!currRambank) { return; }
+	/// <summary>
+	/// Maps the rom banks, the bank numbers are wrapped on the rom size. Used by the mappers
+	/// </summary>
+	/// <param name="bank0">Bank on 0000-3FFF</param>
+	/// <param name="bankX">Bank on 4000-7FFF</param>
+	void Cartridge::mapRom(bit32 bank0, bit32 bankX) {
+		// Odd sized roms mirror their banks past the end
+		bank0 &= romBankMask;
+		bankX &= romBankMask;
+		romBank0 = rom_data + 0x4000 * (bank0 < romBanks ? bank0 : bank0 % romBanks);
+		romBankX = rom_data + 0x4000 * (bankX < romBanks ? bankX : bankX % romBanks);
+	}
 
-			currRambank[addr - 0xA000] = val;
 
-			if (hasBattery) {
-				needsSave = true;
-			}
+	/// <summary>
+	/// Selects the ram bank, wrapped on the ram size. Used by the mappers
+	/// </summary>
+	/// <param name="bank">Selected bank</param>
+	/// <param name="mapped">Maps it as plain memory on A000-BFFF, else the area goes through the mapper</param>
+	void Cartridge::mapRam(bit32 bank, bool mapped) {
+		if (ramBankCount == 0) {
+			currRambank = nullptr;
+			ramMapped = nullptr;
+			return;
 		}
+
+		currRambank = ramBanks[bank % ramBankCount];
+		ramMapped = mapped ? currRambank : nullptr;
 	}
 
+
 	/// <summary>
 	/// Get if it needs to be saved
 	/// </summary>
@@ -193,72 +186,114 @@ namespace TheBoy {
 	}
 
 	/// <summary>
-	/// Loads data from the battery mem
+	/// Gets the rom bank mapped on 4000-7FFF
+	/// </summary>
+	bit32 Cartridge::getRomBank() {
+		return static_cast<bit32>(romBankX - rom_data) / 0x4000;
+	}
+
+	/// <summary>
+	/// Gets the emulated tick, the mapper clocks count on it
+	/// </summary>
+	bit64 Cartridge::getTicks() {
+		return emulCtrl ? emulCtrl->getTicks() : 0;
+	}
+
+
+	/// <summary>
+	/// Gets if the mapper clocks catch up with the host time, headless runs stay deterministic
+	/// </summary>
+	bool Cartridge::getClockHostSync() {
+		return emulCtrl && !emulCtrl->isHeadless();
+	}
+
+
+	/// <summary>
+	/// Loads data from the battery mem, the ram and then the mapper footer when the file has one
 	/// </summary>
 	void Cartridge::batteryLoad() {
+		Mapper* m = mapper.get();
+		if (!currRambank && m->getFooterSize() == 0) { return; }
+
 		char fl[1048];
 		sprintf(fl, "%s.batt", path);
 		std::fstream stream(fl, std::ios::in | std::ios::binary | std::ios::ate);
-
 		if (!stream.is_open()) {
 			std::cout << "[CARTRIDGE] :: Failed to load the save cartridge from ( " <<
 				path << " )" << std::endl;
 			return;
 		}
-		bit32 temp_size = static_cast<bit32>(stream.tellg());
+		bit32 fileSize = static_cast<bit32>(stream.tellg());
 		stream.seekg(0, std::ios_base::beg);
-		char* buff(new char[temp_size + 1] {});
 
-		stream.read(buff, temp_size);
+		// The footer sizes are not multiples of 0x200, the ram part always is. Every bank is saved, the older
+		// files only hold one
+		bit32 footerSize = fileSize % 0x200;
+		bit32 ramSize = fileSize - footerSize;
+		if (ramBankCount) {
+			stream.read(reinterpret_cast<char*>(ramData.get()), std::min<bit32>(ramSize, ramBankCount * 0x2000));
+		}
+		if (footerSize > 0) {
+			bit8 footer[0x200];
+			stream.seekg(ramSize, std::ios_base::beg);
+			stream.read(reinterpret_cast<char*>(footer), footerSize);
+			if (!stream || !m->readFooter(footer, footerSize)) {
+				std::cout << "[CARTRIDGE] :: Ignored an unknown " << footerSize << " bytes battery footer" << std::endl;
+			}
+		}
 		stream.close();
-
-		std::cout << buff << std::endl;
-		buff[temp_size] = 0;
-		memcpy(currRambank, buff, temp_size);
-		delete[] buff;
 	}
 
 	/// <summary>
-	/// Saves data to the battery mem
+	/// Hands the written ram to the battery writer, never waits on the disk. A busy writer keeps the ram dirty
+	/// for the next save
 	/// </summary>
-	void Cartridge::batterySave() {
-		char fl[1048];
-		sprintf(fl, "%s.batt", path);
-		std::fstream stream(fl, std::ios::out | std::ios::binary | std::ios::trunc);
+	/// <param name="wait">Waits for a busy writer, only on shutdown</param>
+	void Cartridge::batterySave(bool wait) {
+		if (!batteryWriter) { return; }
 
-		if (!stream.is_open()) {
-			std::cout << "[CARTRIDGE] :: Failed to write the save cartridge from ( " <<
-				path << " )" << std::endl;
-			return;
+		bit8* image = batteryWriter->acquire(wait);
+		if (!image) { return; }
+
+		if (dirtyBegin < dirtyEnd) {
+			memcpy(image + dirtyBegin, ramData.get() + dirtyBegin, dirtyEnd - dirtyBegin);
 		}
-		char buff[0x2000];
-		memcpy(buff, currRambank, 0x2000);
-		stream.write(buff, 0x2000);
-		stream.close();
+		if (mapper->getFooterSize() > 0) { mapper->writeFooter(image + ramBankCount * 0x2000); }
+		batteryWriter->release();
+
+		dirtyBegin = ramBankCount * 0x2000;
+		dirtyEnd = 0;
+		needsSave = false;
 	}
 
+
 	/// <summary>
-	/// Get if the cart is a MBC1 
+	/// Turns the battery saves off, the speculative instances never touch the battery file
 	/// </summary>
-	bool Cartridge::isMBCOne() {
-		return static_cast<bool>(BETWEEN(cart_state->cart_type, 1, 3));
+	void Cartridge::disableBatterySaves() {
+		batteryWriter.reset();
+		needsSave = false;
 	}
 
+
 	/// <summary>
-	/// Get if the cart is a MBC3 type
+	/// Gets the battery file size, the ram banks and the mapper footer
 	/// </summary>
-	/// <returns>Is a mbc3 type</returns>
-	bool Cartridge::isMBCThree() {
-		return static_cast<bool>(BETWEEN(cart_state->cart_type, 15, 19));
+	size_t Cartridge::batterySize() {
+		return ramBankCount * 0x2000 + mapper->getFooterSize();
 	}
 
-
 	/// <summary>
 	/// Get if the cart has a battery
 	/// </summary>
 	bool Cartridge::cartHasBattery() {
-		// MBC1 only
-		return cart_state->cart_type == 3;
+		switch (cart_state->cart_type) {
+		case 0x03: case 0x06: case 0x09: case 0x0D: case 0x0F: case 0x10:
+		case 0x13: case 0x1B: case 0x1E: case 0x22: case 0xFF:
+			return true;
+		default:
+			return false;
+		}
 	}
 
 	/**
@@ -278,7 +313,7 @@ namespace TheBoy {
 		);
 
 
-		emulCtrl->getView()->setCartInfo(msgBuffer);
+		if (!emulCtrl->isHeadless()) { emulCtrl->getView()->setCartInfo(msgBuffer); }
 		delete[] msgBuffer;
 	}
 
@@ -304,7 +339,7 @@ namespace TheBoy {
 		char* msgBuf(new char[64] {});
 		sprintf_s(msgBuf, 64, "[CARTRIDGE] :: Checksum Result : %2.2X (%X)\n", cart_state->checksum, (x & 0xFF));
 
-		emulCtrl->getView()->setCartChecksum(msgBuf);
+		if (!emulCtrl->isHeadless()) { emulCtrl->getView()->setCartChecksum(msgBuf); }
 		delete[] msgBuf;
 
 		return (x & 0xFF);
@@ -340,21 +375,75 @@ namespace TheBoy {
 	/// Create cartridge banks
 	/// </summary>
 	void Cartridge::createBanks() {
-		for (int i = 0; i < 16; i++) {
-			ramBanks[i] = 0;
-			if ((cart_state->ram_size == 0x2 && i == 0) ||
-				(cart_state->ram_size == 0x3 && i < 4) ||
-				(cart_state->ram_size == 0x4 && i < 16) ||
-				(cart_state->ram_size == 0x5 && i < 8))
-			{
-				ramBanks[i] = new bit8[0x2000];
-				memset(ramBanks[i], 0, 0x2000);
-			}
+		// MBC2 has 512 half bytes built in, kept in a whole bank
+		switch (cart_state->ram_size) {
+		case 0x1: case 0x2: ramBankCount = 1; break;
+		case 0x3: ramBankCount = 4; break;
+		case 0x4: ramBankCount = 16; break;
+		case 0x5: ramBankCount = 8; break;
+		default: ramBankCount = (cart_state->cart_type == 0x05 || cart_state->cart_type == 0x06) ? 1 : 0; break;
+		}
+
+		ramData.reset(ramBankCount ? new bit8[ramBankCount * 0x2000]{} : nullptr);
+		for (bit32 i = 0; i < 16; i++) {
+			ramBanks[i] = (i < ramBankCount) ? ramData.get() + i * 0x2000 : nullptr;
 		}
 		currRambank = ramBanks[0];
-		// Pointing to bank 1
-		romBankX = rom_data + 0x4000;
+		ramMapped = nullptr;
+
+		mapper = Mapper::create(cart_state->cart_type, this);
+		std::cout << "[CARTRIDGE] :: Mapper " << mapper->getName() << ", " << ramBankCount << " ram banks" << std::endl;
+	}
+
+
+	/// <summary>
+	/// Copies the banking state and external ram to the machine state
+	/// </summary>
+	/// <param name="st">Target state</param>
+	void Cartridge::saveState(MachineState* st) {
+		CartState& s = st->cart;
+		mapper->saveState(&s);
+		s.needsSave = needsSave;
+		s.ramBankCount = static_cast<bit8>(ramBankCount);
+		if (ramBankCount) { memcpy(s.ramBanks, ramData.get(), ramBankCount * 0x2000); }
+
+		memcpy(st->header.title, cart_state->title, sizeof(st->header.title));
+		st->header.romChecksum = cart_state->checksum;
+		st->header.headerChecksum = cart_state->h_checksum;
+	}
+
+
+	/// <summary>
+	/// Restores the banking state and external ram from a machine state
+	/// </summary>
+	/// <param name="st">Source state</param>
+	void Cartridge::loadState(const MachineState* st) {
+		const CartState& s = st->cart;
+		// The battery follows the loaded ram, only the banks that differ are dirty. Rewind and run ahead load
+		// states every frame, mostly with the same ram
+		for (bit32 i = 0; i < ramBankCount; i++) {
+			if (memcmp(ramBanks[i], s.ramBanks[i], 0x2000) == 0) { continue; }
+			memcpy(ramBanks[i], s.ramBanks[i], 0x2000);
+			if (hasBattery) {
+				dirtyBegin = std::min(dirtyBegin, i * 0x2000);
+				dirtyEnd = std::max(dirtyEnd, (i + 1) * 0x2000);
+				needsSave = true;
+			}
+		}
+		mapper->loadState(&s);
 	}
 
 
+	/// <summary>
+	/// Checks if a machine state was taken from this cartridge
+	/// </summary>
+	/// <param name="st">Target state</param>
+	/// <returns>Same rom and external ram size</returns>
+	bool Cartridge::stateMatches(const MachineState* st) {
+		return memcmp(st->header.title, cart_state->title, sizeof(st->header.title)) == 0 &&
+			st->header.romChecksum == cart_state->checksum &&
+			st->header.headerChecksum == cart_state->h_checksum &&
+			st->cart.ramBankCount == ramBankCount;
+	}
+
 }
\ No newline at end of file
@@ -2,8 +2,12 @@
 #define CARTRIDGE_H
 
 #include "collections.h"
+#include "romCache.h"
+#include "mapper.h"
+#include "batteryWriter.h"
 
 namespace TheBoy {
+	struct MachineState;
 	class EmulatorController;
 
 	/**
@@ -43,9 +47,9 @@ namespace TheBoy {
 
 
 		/**
-		 * @brief Destroy the Cartridge object
+		 * @brief Destroy the Cartridge object, the battery is saved a last time
 		 */
-		~Cartridge() = default;
+		~Cartridge();
 
 
 		/**
@@ -80,10 +84,16 @@ namespace TheBoy {
 
 		/**
 		 * @brief Reads data from the loaded cartridge
+		 * Rom and plain ram reads go straight through the bank pointers, no mapper is involved
 		 * @param addr Cartridge address
 		 * @return bit8 Valeu on the defined address
 		 */
-		bit8 read(bit16 addr);
+		bit8 read(bit16 addr) {
+			if (addr < 0x4000) { return romBank0[addr]; }
+			if (addr < 0x8000) { return romBankX[addr - 0x4000]; }
+			if (ramMapped) { return ramMapped[addr - 0xA000]; }
+			return mapper->readRam(addr);
+		}
 
 
 		/**
@@ -93,6 +103,65 @@ namespace TheBoy {
 		 */
 		void write(bit16 addr, bit8 val);
 
+
+		/// <summary>
+		/// Maps the rom banks, the bank numbers are wrapped on the rom size. Used by the mappers
+		/// </summary>
+		/// <param name="bank0">Bank on 0000-3FFF</param>
+		/// <param name="bankX">Bank on 4000-7FFF</param>
+		void mapRom(bit32 bank0, bit32 bankX);
+
+
+		/// <summary>
+		/// Selects the ram bank, wrapped on the ram size. Used by the mappers
+		/// </summary>
+		/// <param name="bank">Selected bank</param>
+		/// <param name="mapped">Maps it as plain memory on A000-BFFF, else the area goes through the mapper</param>
+		void mapRam(bit32 bank, bool mapped);
+
+
+		/// <summary>
+		/// Gets the selected ram bank, null without ram. Used by the mappers
+		/// </summary>
+		bit8* getRam() { return currRambank; }
+
+
+		/// <summary>
+		/// Marks a ram byte as written, for the battery. Used by the mappers
+		/// </summary>
+		/// <param name="at">Written byte, in the ram banks</param>
+		void ramWritten(const bit8* at) {
+			if (!hasBattery) { return; }
+			bit32 off = static_cast<bit32>(at - ramData.get());
+			if (off < dirtyBegin) { dirtyBegin = off; }
+			if (off >= dirtyEnd) { dirtyEnd = off + 1; }
+			needsSave = true;
+		}
+
+
+		/// <summary>
+		/// Marks the mapper battery footer as changed. Used by the mappers
+		/// </summary>
+		void footerWritten() { if (hasBattery) { needsSave = true; } }
+
+
+		/// <summary>
+		/// Gets the cartridge mapper
+		/// </summary>
+		Mapper* getMapper() { return mapper.get(); }
+
+
+		/// <summary>
+		/// Gets the emulated tick, the mapper clocks count on it. Used by the mappers
+		/// </summary>
+		bit64 getTicks();
+
+
+		/// <summary>
+		/// Gets if the mapper clocks catch up with the host time spent between sessions, off when headless
+		/// </summary>
+		bool getClockHostSync();
+
 		/// <summary>
 		/// Get if the cart has a battery
 		/// </summary>
@@ -103,6 +172,11 @@ namespace TheBoy {
 		/// </summary>
 		bool needSave();
 
+		/// <summary>
+		/// Gets the rom bank mapped on 4000-7FFF
+		/// </summary>
+		bit32 getRomBank();
+
 		/// <summary>
 		/// Loads data from the battery mem
 		/// </summary>
@@ -110,9 +184,38 @@ namespace TheBoy {
 
 
 		/// <summary>
-		/// Saves data to the battery mem
+		/// Hands the written ram to the battery writer, never waits on the disk
+		/// </summary>
+		/// <param name="wait">Waits for a busy writer, only on shutdown</param>
+		void batterySave(bool wait = false);
+
+
+		/// <summary>
+		/// Turns the battery saves off, the speculative instances never touch the battery file
+		/// </summary>
+		void disableBatterySaves();
+
+		/// <summary>
+		/// Copies the banking state and external ram to the machine state
+		/// </summary>
+		/// <param name="st">Target state</param>
+		void saveState(MachineState* st);
+
+
+		/// <summary>
+		/// Restores the banking state and external ram from a machine state
 		/// </summary>
-		void batterySave();
+		/// <param name="st">Source state</param>
+		void loadState(const MachineState* st);
+
+
+		/// <summary>
+		/// Checks if a machine state was taken from this cartridge
+		/// </summary>
+		/// <param name="st">Target state</param>
+		/// <returns>Same rom and external ram size</returns>
+		bool stateMatches(const MachineState* st);
+
 
 	private:
 		/**
@@ -135,8 +238,20 @@ namespace TheBoy {
 		/**
 		 * @brief Pointer to the loaded rom byte data
 		 */
-		 //bit8 rom_data;
-		bit8* rom_data = nullptr;
+		const bit8* rom_data = nullptr;
+
+
+		/// <summary>
+		/// Shared rom image holding rom_data, mapped once for every instance of the rom
+		/// </summary>
+		std::shared_ptr<const RomImage> romImage;
+
+
+		/// <summary>
+		/// Rom banks in the image minus one, a power of 2 mask on the selected bank, and the whole banks in the image
+		/// </summary>
+		bit32 romBankMask = 1;
+		bit32 romBanks = 2;
 
 
 		/**
@@ -144,53 +259,37 @@ namespace TheBoy {
 		 */
 		std::shared_ptr<CartridgeState> cart_state;
 
-		/// For MBC1 Banking 
-
 		/// <summary>
-		/// A000-BFFF - RAM Bank 00-03, if any (Read/Write)
+		/// Memory bank controller, picked from the cartridge type on load
 		/// </summary>
-		bool enabledRam;
+		std::unique_ptr<Mapper> mapper;
 
 
 		/// <summary>
-		/// This area normally contains the first 16 KiB (bank 00) of the cartridge ROM.
-		/// In 1 MiB and larger cartridges(that use the 2 - bit second banking register for extended ROM banking),
-		/// entering mode 1 (see below) will allow that second banking register to apply to reads 
-		/// from this region in addition to the regular 4000 - 7FFF banked region,
-		/// resulting in accessing banks $20 / $40 / $60 for regular large ROM carts,
-		///  or banks $10 / $20 / $30 for an MBC1M multi - cart(see note below).
+		/// Rom banks mapped on 0000-3FFF and 4000-7FFF
 		/// </summary>
-		bool bankingRam;
+		const bit8* romBank0 = nullptr;
+		const bit8* romBankX = nullptr;
 
-		/// <summary>
-		/// Pointer to the bank x value
-		/// </summary>
-		bit8* romBankX;
 
 		/// <summary>
-		/// Defined Banking Mode
+		/// Ram bank mapped as plain memory on A000-BFFF, null when the area goes through the mapper
 		/// </summary>
-		bit8 bankingMode;
+		bit8* ramMapped = nullptr;
 
-		/// <summary>
-		/// Rom Bank Value
-		/// </summary>
-		bit8 romBankVal;
 
 		/// <summary>
-		/// Ram Bank Value
+		/// Selected ram bank, mapped or not
 		/// </summary>
-		bit8 ramBankVal;
+		bit8* currRambank = nullptr;
 
-		/// <summary>
-		/// In Use bank
-		/// </summary>
-		bit8* currRambank;
 
 		/// <summary>
-		/// Available banks
+		/// External ram, its banks point in it
 		/// </summary>
-		bit8* ramBanks[16];
+		std::unique_ptr<bit8[]> ramData;
+		bit8* ramBanks[16] = {};
+		bit32 ramBankCount = 0;
 
 
 		/// For Battery
@@ -206,6 +305,25 @@ namespace TheBoy {
 		bool needsSave;
 
 
+		/// <summary>
+		/// Ram written since the last save, offsets in the ram banks, empty when begin >= end
+		/// </summary>
+		bit32 dirtyBegin = 0;
+		bit32 dirtyEnd = 0;
+
+
+		/// <summary>
+		/// Background battery file writer, shared by every instance of the rom, null without a battery
+		/// </summary>
+		std::shared_ptr<BatteryWriter> batteryWriter;
+
+
+		/// <summary>
+		/// Gets the battery file size, the ram banks and the mapper footer
+		/// </summary>
+		size_t batterySize();
+
+
 		/**
 		 * @brief Prints the values from a loaded cartridge
 		 */
@@ -219,17 +337,6 @@ namespace TheBoy {
 		bool cartridgeCheckSum();
 
 
-		/// <summary>
-		/// Get if the cart is a MBC1 
-		/// </summary>
-		bool isMBCOne();
-
-		/// <summary>
-		/// Get if the cart is a MBC3 type
-		/// </summary>
-		/// <returns>Is a mbc3 type</returns>
-		bool isMBCThree();
-
 		/**
 		 * @brief Assigned the loaded data to the correct struct values
 		 */
@@ -1,4 +1,5 @@
 #include "cpu.h"
+#include "machineState.h"
 #include "emulatorController.h"
 
 namespace TheBoy {
@@ -8,7 +9,6 @@ namespace TheBoy {
 	Cpu::Cpu(EmulatorController* ctrl) : emuCtrl(ctrl) {
 		regs = std::make_shared<Registers>();
 		reset();
-		startTime = std::chrono::high_resolution_clock::now();
 		std::cout << "[CPU] ::: Cpu has been created!" << std::endl;
 	}
 
@@ -45,22 +45,24 @@ namespace TheBoy {
 	 * @brief Defines the cpu iteration
 	 */
 	void Cpu::step() {
-		if (!cpuHLT) {
-#if VERBOSE
-			bit16 tempPc = regs->PC;
+#if PERFCOUNT
+		bool halted = cpuHLT;
+		bit64 startTicks = emuCtrl->getTicks();
 #endif
 
+		if (profiler) { profiler->step(regs->PC, emuCtrl->getTicks()); }
+
+		if (!cpuHLT) {
+			if (tracer) { tracer->begin(regs.get(), emuCtrl->getTicks(), getIntMasterState()); }
+
 			fetch_inst();
 			requestCycles(1);
 			fetch_data();
 
-#if VERBOSE
-			printf(
-				"[CPU] ::: [%08lX] Regs State { A: %2.2X F: %2.2X BC: %2.2X %2.2X DE: %2.2X %2.2X HL: %2.2X %2.2X SP: %4.4X PC %4.4X }\n",
-				static_cast<unsigned long>(emuCtrl->getTicks()), regs->A, regs->F, regs->B, regs->C, regs->D, regs->E, regs->H, regs->L, regs->SP, regs->PC
-			);
-			printf("[CPU] ::: ->  OPCODE: %2.2X | PC: %2.2X\n", currOpcode, tempPc);
-			fflush(stdout);
+#if PERFCOUNT
+			PerfCounters* perf = emuCtrl->getPerf();
+			perf->opcodes[currOpcode]++;
+			if (currOpcode == 0xCB) { perf->cbOpcodes[intMem.fetchData & 0xFF]++; }
 #endif
 
 			//emuCtrl->getView()->setRegistorsVals(regs.get());
@@ -77,6 +79,21 @@ namespace TheBoy {
 
 		}
 
+		finishStep();
+
+#if PERFCOUNT
+		bit64 cycles = (emuCtrl->getTicks() - startTicks) / 4;
+		if (halted) { emuCtrl->getPerf()->haltCycles += cycles; }
+		else { emuCtrl->getPerf()->cpuCycles += cycles; }
+#endif
+	}
+
+
+	/// <summary>
+	/// Runs the interrupt handling that closes every step
+	/// Public so an instruction executed outside of step (batched lanes) ends the same way
+	/// </summary>
+	void Cpu::finishStep() {
 		if (interruptMasterState) {
 			InterruptFuncs::handle_interrupt(this);
 			enablingIntMaster = false;
@@ -88,6 +105,24 @@ namespace TheBoy {
 	}
 
 
+	/// <summary>
+	/// Checks if finishStep would change any state
+	/// </summary>
+	/// <returns>An interrupt is dispatched or the IME is being enabled</returns>
+	bool Cpu::needsFinishStep() {
+		return enablingIntMaster || (interruptMasterState && (interruptFlags & interruptEnable));
+	}
+
+
+	/// <summary>
+	/// Gets the registers storage, used to copy the whole register file at once
+	/// </summary>
+	/// <returns>Pointer to the registers</returns>
+	Registers* Cpu::getRegisters() {
+		return regs.get();
+	}
+
+
 	/**
 	 * @brief Get the Register Value object
 	 * @param regType Defined register to get
@@ -257,9 +292,9 @@ namespace TheBoy {
 
 	/**
 	 * @brief Get the Curr Instruct object
-	 * @return Instruc* Pointer to the current instruction
+	 * @return const Instruc* Pointer to the current instruction
 	 */
-	Instruc* Cpu::getCurrInstruct() {
+	const Instruc* Cpu::getCurrInstruct() {
 		return currInstruct;
 	}
 
@@ -313,6 +348,7 @@ namespace TheBoy {
 	 * @param val Value to be setted on the address
 	 */
 	void Cpu::requestBusWrite(bit16 addr, bit8 val) {
+		if (tracer) { tracer->access(addr, val, TRACE_WRITE); }
 		emuCtrl->getBus()->abWrite(addr, val);
 	}
 
@@ -323,6 +359,7 @@ namespace TheBoy {
 	 * @param val 16bit Value to be setted on the address
 	 */
 	void Cpu::requestBusWrite16(bit16 addr, bit16 val) {
+		if (tracer) { tracer->access(addr, val & 0xFF, TRACE_WRITE); }
 		emuCtrl->getBus()->abWrite16(addr, val);
 	}
 
@@ -333,7 +370,9 @@ namespace TheBoy {
 	 * @return bit8 Readed value
 	 */
 	bit8 Cpu::requestBusRead(bit16 addr) {
-		return emuCtrl->getBus()->abRead(addr);
+		bit8 val = emuCtrl->getBus()->abRead(addr);
+		if (tracer) { tracer->access(addr, val, TRACE_READ); }
+		return val;
 	}
 
 
@@ -418,6 +457,33 @@ namespace TheBoy {
 	}
 
 
+	/**
+	 * @brief Get the Interrupt Master state (IME), enabled or being enabled
+	 * @return true/false Current IME value
+	 */
+	bool Cpu::getIntMasterState() {
+		return interruptMasterState || enablingIntMaster;
+	}
+
+
+	/// <summary>
+	/// Hooks a guest profiler on the instructions, calls and returns, null unhooks it
+	/// </summary>
+	/// <param name="prof">Profiler</param>
+	void Cpu::setProfiler(GuestProfiler* prof) {
+		profiler = prof;
+	}
+
+
+	/// <summary>
+	/// Hooks a trace recorder on the instructions and data accesses, null unhooks it
+	/// </summary>
+	/// <param name="trace">Trace recorder</param>
+	void Cpu::setTracer(TraceRecorder* trace) {
+		tracer = trace;
+	}
+
+
 	/**
 	 * @brief Get the Interr Flags Vvalue
 	 * @return bit8 Flags value
@@ -476,18 +542,6 @@ namespace TheBoy {
 	void Cpu::fetch_inst() {
 		currOpcode = emuCtrl->getBus()->abRead(regs->PC);
 		currInstruct = TheBoy::getByOpcode(currOpcode);
-
-		char* bfr(new char[64]{});
-		if (currInstruct == nullptr) {
-			sprintf_s(bfr, 64, "-> Opcode %2.2X failed to load", currOpcode);
-		}
-		else {
-			sprintf_s(bfr, 64, "-> Opcode %2.2X", currOpcode);
-		}
-
-		//emuCtrl->getView()->setCurrOperation(bfr);
-		delete[] bfr;
-
 		regs->PC++;
 	}
 
@@ -685,10 +739,9 @@ so the possible range is 0xFF00-0xFFFF.
 
 
 		default:			// If none, this is a unknow operation mode
-			char* m(new char[128]{});
+			char m[128];
 			sprintf_s(m, 128, "[CPU] ::: Unknown Operation mode on the instruction [OPCODE: %2.2X]\n", currOpcode);
 			emuCtrl->forceEmuStop(m);
-			delete[] m;
 			return;
 		}
 	}
@@ -699,10 +752,9 @@ so the possible range is 0xFF00-0xFFFF.
 	void Cpu::executeInst() {
 		CpuFuncs::INST_FUNC exe = CpuFuncs::getInstructProcess(currInstruct->insType);
 		if (!exe || currInstruct->insType == INST_NONE) {
-			char* m(new char[128]{});
+			char m[128];
 			sprintf_s(m, 128, "[CPU] ::: Unknown execution function for [OPCODE: %2.2X]\n", currOpcode);
 			emuCtrl->forceEmuStop(m);
-			delete[] m;
 			return;
 		}
 		exe(this);
@@ -710,21 +762,41 @@ so the possible range is 0xFF00-0xFFFF.
 
 
 	/// <summary>
-	/// Gets the current Cpu execution tick value
+	/// Copies the registers and interrupt state to the machine state
 	/// </summary>
-	/// <returns>Execution tick value</returns>
-	bit32 Cpu::getTicks() {
-		std::chrono::time_point current = std::chrono::high_resolution_clock::now();
-		return static_cast<bit32>(
-			std::chrono::duration_cast<std::chrono::milliseconds>(current - startTime).count()
-			);
+	/// <param name="st">Target state</param>
+	void Cpu::saveState(MachineState* st) {
+		CpuState& s = st->cpu;
+		s.regs = *regs;
+		s.fetchData = intMem.fetchData;
+		s.memDest = intMem.memDest;
+		s.destIsMem = intMem.destIsMem;
+		s.halted = cpuHLT;
+		s.ime = interruptMasterState;
+		s.enablingIme = enablingIntMaster;
+		s.ie = interruptEnable;
+		s.iflags = interruptFlags;
+		s.opcode = currOpcode;
 	}
 
+
 	/// <summary>
-	/// Sleeps the cpu thread for a defined ms value
+	/// Restores the registers and interrupt state from a machine state
 	/// </summary>
-	/// <param name="msVal">Sleep ms value</param>
-	void Cpu::sleepCpu(bit32 msVal) {
-		std::this_thread::sleep_for(std::chrono::milliseconds(msVal));
+	/// <param name="st">Source state</param>
+	void Cpu::loadState(const MachineState* st) {
+		const CpuState& s = st->cpu;
+		*regs = s.regs;
+		intMem.fetchData = s.fetchData;
+		intMem.memDest = s.memDest;
+		intMem.destIsMem = s.destIsMem;
+		cpuHLT = s.halted;
+		interruptMasterState = s.ime;
+		enablingIntMaster = s.enablingIme;
+		interruptEnable = s.ie;
+		interruptFlags = s.iflags;
+		currOpcode = s.opcode;
+		currInstruct = TheBoy::getByOpcode(currOpcode);
 	}
+
 }
\ No newline at end of file
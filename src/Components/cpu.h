@@ -5,10 +5,12 @@
 #include "interrupt.h"
 #include "addressbus.h"
 #include "instruc_funcs.h"
-#include <chrono>
 
 namespace TheBoy {
+	struct MachineState;
 	class EmulatorController;
+	class GuestProfiler;
+	class TraceRecorder;
 
 /*
 	16-bit	Hi	Lo	Name/Function
@@ -67,6 +69,27 @@ As shown above, most registers can be accessed either as one 16-bit register,
 		 */
 		void step();
 
+
+		/// <summary>
+		/// Runs the interrupt handling that closes every step
+		/// Public so an instruction executed outside of step (batched lanes) ends the same way
+		/// </summary>
+		void finishStep();
+
+
+		/// <summary>
+		/// Checks if finishStep would change any state
+		/// </summary>
+		/// <returns>An interrupt is dispatched or the IME is being enabled</returns>
+		bool needsFinishStep();
+
+
+		/// <summary>
+		/// Gets the registers storage, used to copy the whole register file at once
+		/// </summary>
+		/// <returns>Pointer to the registers</returns>
+		Registers* getRegisters();
+
 		/**
 		 * @brief Get the Register Value object
 		 * @param regType Defined register to get
@@ -152,9 +175,9 @@ As shown above, most registers can be accessed either as one 16-bit register,
 
 		/**
 		 * @brief Get the Curr Instruct object
-		 * @return Instruc* Pointer to the current instruction
+		 * @return const Instruc* Pointer to the current instruction
 		 */
-		Instruc* getCurrInstruct();
+		const Instruc* getCurrInstruct();
 
 		/**
 		 * @brief Get the Fetched Data value
@@ -266,6 +289,13 @@ As shown above, most registers can be accessed either as one 16-bit register,
 		bool getHaltedState();
 
 
+		/**
+		 * @brief Get the Interrupt Master state (IME), enabled or being enabled
+		 * @return true/false Current IME value
+		 */
+		bool getIntMasterState();
+
+
 		/**
 		 * @brief Get the Interr Flags Vvalue
 		 * @return bit8 Flags value
@@ -296,17 +326,46 @@ As shown above, most registers can be accessed either as one 16-bit register,
 
 
 		/// <summary>
-		/// Gets the current Cpu execution tick value
+		/// Copies the registers and interrupt state to the machine state
 		/// </summary>
-		/// <returns>Execution tick value</returns>
-		bit32 getTicks();
+		/// <param name="st">Target state</param>
+		void saveState(MachineState* st);
 
 
 		/// <summary>
-		/// Sleeps the cpu thread for a defined ms value
+		/// Restores the registers and interrupt state from a machine state
 		/// </summary>
-		/// <param name="msVal">Sleep ms value</param>
-		void sleepCpu(bit32 msVal);
+		/// <param name="st">Source state</param>
+		void loadState(const MachineState* st);
+
+
+		/// <summary>
+		/// Hooks a guest profiler on the instructions, calls and returns, null unhooks it
+		/// </summary>
+		/// <param name="prof">Profiler</param>
+		void setProfiler(GuestProfiler* prof);
+
+
+		/// <summary>
+		/// Gets the hooked guest profiler
+		/// </summary>
+		/// <returns>Profiler, null when not profiling</returns>
+		GuestProfiler* getProfiler() { return profiler; }
+
+
+		/// <summary>
+		/// Hooks a trace recorder on the instructions and data accesses, null unhooks it
+		/// </summary>
+		/// <param name="trace">Trace recorder</param>
+		void setTracer(TraceRecorder* trace);
+
+
+		/// <summary>
+		/// Gets the hooked trace recorder
+		/// </summary>
+		/// <returns>Trace recorder, null when not tracing</returns>
+		TraceRecorder* getTracer() { return tracer; }
+
 
 	private:
 		/**
@@ -321,12 +380,6 @@ As shown above, most registers can be accessed either as one 16-bit register,
 		std::shared_ptr<Registers> regs;
 
 
-		/// <summary>
-		/// Marks the starting time stamp
-		/// </summary>
-		std::chrono::high_resolution_clock::time_point startTime;
-
-
 		/**
 		 * @brief Defined and declared instruction memory map
 		 */
@@ -337,6 +390,18 @@ As shown above, most registers can be accessed either as one 16-bit register,
 		} intMem;
 
 
+		/// <summary>
+		/// Hooked guest profiler, null when not profiling
+		/// </summary>
+		GuestProfiler* profiler = nullptr;
+
+
+		/// <summary>
+		/// Hooked trace recorder, null when not tracing
+		/// </summary>
+		TraceRecorder* tracer = nullptr;
+
+
 		/**
 		 * @brief Marks if the current cpu has been halted, its in idle mode
 		 */
@@ -375,7 +440,7 @@ As shown above, most registers can be accessed either as one 16-bit register,
 		/**
 		 * @brief Pointer to the current target instruction 
 		 */
-		Instruc *currInstruct;
+		const Instruc *currInstruct;
 
 
 		/**
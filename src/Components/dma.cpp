@@ -1,4 +1,5 @@
 #include "dma.h"
+#include "machineState.h"
 
 
 namespace TheBoy {
@@ -28,6 +29,10 @@ namespace TheBoy {
 			return;
 		}
 
+#if PERFCOUNT
+		emulCtrl->getPerf()->dmaCycles++;
+#endif
+
 		if(s_Delay) {
 			s_Delay--;
 			return;
@@ -58,5 +63,29 @@ namespace TheBoy {
 	bool Dma::isTransfering() {
 		return enabled;
 	}
-	
+
+
+	/// <summary>
+	/// Copies the transfer state to the machine state
+	/// </summary>
+	/// <param name="st">Target state</param>
+	void Dma::saveState(MachineState* st) {
+		st->dma.enabled = enabled;
+		st->dma.currByte = currByte;
+		st->dma.currVal = currVal;
+		st->dma.delay = s_Delay;
+	}
+
+
+	/// <summary>
+	/// Restores the transfer state from a machine state
+	/// </summary>
+	/// <param name="st">Source state</param>
+	void Dma::loadState(const MachineState* st) {
+		enabled = st->dma.enabled;
+		currByte = st->dma.currByte;
+		currVal = st->dma.currVal;
+		s_Delay = st->dma.delay;
+	}
+
 } // namespace TheBoy
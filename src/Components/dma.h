@@ -4,6 +4,8 @@
 #include "emulatorController.h"
 
 namespace TheBoy {
+	struct MachineState;
+
 	/*
 		FF46 - DMA (DMA Transfer and Start Address) (R/W)
 			Writing to this register launches a DMA transfer from ROM or RAM to OAM (Object Attribute Memory).
@@ -44,6 +46,20 @@ namespace TheBoy {
 		 */
 		bool isTransfering();
 
+		/// <summary>
+		/// Copies the transfer state to the machine state
+		/// </summary>
+		/// <param name="st">Target state</param>
+		void saveState(MachineState* st);
+
+
+		/// <summary>
+		/// Restores the transfer state from a machine state
+		/// </summary>
+		/// <param name="st">Source state</param>
+		void loadState(const MachineState* st);
+
+
 	private:	
 		
 		/**
@@ -1,4 +1,8 @@
 #include "inputController.h"
+#include "machineState.h"
+#include "movie.h"
+#include "rewinder.h"
+#include <chrono>
 
 namespace TheBoy
 {
@@ -6,16 +10,11 @@ namespace TheBoy
 	/// InputController class constructor
 	/// </summary>
 	/// <param name="ctrl">Target Emulator controller ref</param>
-	InputController::InputController(EmulatorController* ctrl) : emulCtrl(ctrl) {
-		states = new InputStates();
-
-	}
+	InputController::InputController(EmulatorController* ctrl) : emulCtrl(ctrl) { }
 	/// <summary>
 	/// Class destructor
 	/// </summary>
-	InputController::~InputController() {
-		delete states;
-	}
+	InputController::~InputController() { }
 	/// <summary>
 	/// Get if it's currently selecting a button
 	/// </summary>
@@ -37,13 +36,103 @@ namespace TheBoy
 	void InputController::setSelection(bit8 val) {
 		_buttonSelected = static_cast<bool>(val & 0x20); //(0b 0010 0000)
 		_directionSelected = static_cast<bool>(val & 0x10); // (ob 0001 0000)
+
+		// Selecting a group with a held button also pulls a line low
+		checkLines();
+	}
+	/// <summary>
+	/// Publishes a new pressed button mask, called from the view thread when input events arrive
+	/// </summary>
+	/// <param name="pressed">Pressed buttons, JOYPADBIT flags</param>
+	void InputController::publishState(bit8 pressed) {
+		if (pressedMask.exchange(pressed, std::memory_order_release) == pressed) { return; }
+
+		inputStamp.store(static_cast<bit64>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count()), std::memory_order_relaxed);
+		pendingChange.store(true, std::memory_order_release);
+	}
+	/// <summary>
+	/// Gets the last published pressed button mask
+	/// </summary>
+	/// <returns>Pressed buttons, JOYPADBIT flags</returns>
+	bit8 InputController::getPressedMask() {
+		return pressedMask.load(std::memory_order_acquire);
+	}
+	/// <summary>
+	/// Gets the time stamp of the last published input change
+	/// </summary>
+	/// <returns>Steady clock time stamp in nanoseconds</returns>
+	bit64 InputController::getLastInputTime() {
+		return inputStamp.load(std::memory_order_relaxed);
+	}
+	/// <summary>
+	/// Checks for a published input change, called from the emulation thread
+	/// Requests the joypad interrupt on a falling P1 line
+	/// </summary>
+	void InputController::pollInterrupt() {
+		if (movie != nullptr && movie->isPlaying()) {
+			bit8 mask;
+			if (movie->poll(emulCtrl->getTicks(), &mask)) {
+				activeMask = mask;
+				checkLines();
+			}
+			return;
+		}
+		if (rewinder != nullptr && rewinder->isReplaying()) {
+			bit8 mask;
+			if (rewinder->poll(emulCtrl->getTicks(), &mask)) {
+				activeMask = mask;
+				checkLines();
+			}
+			return;
+		}
+
+		// Plain load first, this runs every instruction
+		if (!pendingChange.load(std::memory_order_relaxed)) { return; }
+		if (!pendingChange.exchange(false, std::memory_order_acquire)) { return; }
+
+		bit8 mask = getPressedMask();
+		if (mask == activeMask) { return; }
+		activeMask = mask;
+
+		// Speculative frames are rolled back, their latches are not part of the recording
+		if (!emulCtrl->isSpeculative()) {
+			if (movie != nullptr) { movie->record(emulCtrl->getTicks(), mask); }
+			if (rewinder != nullptr) { rewinder->record(emulCtrl->getTicks(), mask); }
+		}
+		checkLines();
+	}
+	/// <summary>
+	/// Attaches a movie, recording it takes the latched changes, playing it replaces the host input
+	/// </summary>
+	/// <param name="target">Target movie, null to detach</param>
+	void InputController::setMovie(Movie* target) {
+		movie = target;
+		// Back to the host mask, it may have changed during the playback
+		if (movie == nullptr) { pendingChange = true; }
+	}
+	/// <summary>
+	/// Attaches the rewinder, it keeps the latched changes and replays them when stepping back
+	/// </summary>
+	/// <param name="target">Target rewinder, null to detach</param>
+	void InputController::setRewinder(Rewinder* target) {
+		rewinder = target;
+	}
+	/// <summary>
+	/// Latches the host mask again on the next instruction, once a replay stopped overriding it
+	/// </summary>
+	void InputController::resyncHost() {
+		pendingChange = true;
 	}
 	/// <summary>
-	/// Get a pointer to the current input state object
+	/// Compares the current P1 input lines with the last ones, a High to Low change requests the interrupt
 	/// </summary>
-	/// <returns>Current state object pointer</returns>
-	InputStates* InputController::getState() {
-		return states;
+	void InputController::checkLines() {
+		bit8 lines = getOutput() & 0x0F;
+		if (lastLines & ~lines) {
+			emulCtrl->getCpu()->requestInterrupt(InterruptFuncs::INTR_JOYPAD);
+		}
+		lastLines = lines;
 	}
 	/// <summary>
 	/// Get the inputOutput result
@@ -51,20 +140,39 @@ namespace TheBoy
 	/// <returns>Input output values</returns>
 	bit8 InputController::getOutput() {
 		bit8 out = 0xCF;
+		bit8 pressed = activeMask;
 
-		if (!selectedButton()) {
-			if (states->start) { out &= ~(1 << 3); }
-			if (states->select) { out &= ~(1 << 2); }
-			if (states->a) { out &= ~(1 << 0); }
-			if (states->b) { out &= ~(1 << 1); }
-		}
-
-		if (!selectedDirection()) {
-			if (states->left) { out &= ~(1 << 1); }
-			if (states->right) { out &= ~(1 << 0); }
-			if (states->up) { out &= ~(1 << 2); }
-			if (states->down) { out &= ~(1 << 3); }
-		}
+		// Pressed buttons pull the selected group lines low
+		if (!selectedButton()) { out &= ~(pressed & 0x0F); }
+		if (!selectedDirection()) { out &= ~(pressed >> 4); }
 		return out;
 	}
+
+
+	/// <summary>
+	/// Copies the joypad selection state to the machine state
+	/// </summary>
+	/// <param name="st">Target state</param>
+	void InputController::saveState(MachineState* st) {
+		st->input.buttonSelected = _buttonSelected;
+		st->input.directionSelected = _directionSelected;
+		st->input.lastLines = lastLines;
+		st->input.activeMask = activeMask;
+	}
+
+
+	/// <summary>
+	/// Restores the joypad selection state from a machine state
+	/// </summary>
+	/// <param name="st">Source state</param>
+	void InputController::loadState(const MachineState* st) {
+		_buttonSelected = st->input.buttonSelected;
+		_directionSelected = st->input.directionSelected;
+		lastLines = st->input.lastLines;
+		activeMask = st->input.activeMask;
+
+		// The host mask may differ from the restored one, latched again on the next instruction
+		if (activeMask != getPressedMask()) { pendingChange = true; }
+	}
+
 }
\ No newline at end of file
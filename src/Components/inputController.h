@@ -3,29 +3,28 @@
 #define INPUTCONTROLLER_H
 
 #include "emulatorController.h"
+#include <atomic>
 
 namespace TheBoy
 {
+	struct MachineState;
+	class Movie;
+	class Rewinder;
+
 	/// <summary>
-	/// Defined structure for holding the current inputState
+	/// Joypad button bits on the published pressed mask (1=Pressed)
+	/// Low nibble matches the P1 action lines, high nibble the direction lines
 	/// </summary>
-	typedef struct InputStates {
-		bool start;
-		bool select;
-		bool a;
-		bool b;
-		bool up;
-		bool down;
-		bool left;
-		bool right;
-
-		/// <summary>
-		/// Initialize the state values
-		/// </summary>
-		void init() {
-
-		}
-	} InputStates;
+	typedef enum JOYPADBIT {
+		JOYP_A = 0x01,
+		JOYP_B = 0x02,
+		JOYP_SELECT = 0x04,
+		JOYP_START = 0x08,
+		JOYP_RIGHT = 0x10,
+		JOYP_LEFT = 0x20,
+		JOYP_UP = 0x40,
+		JOYP_DOWN = 0x80
+	} JOYPADBIT;
 
 	/// <summary>
 	/// Input manager class
@@ -80,16 +79,67 @@ namespace TheBoy
 		void setSelection(bit8 val);
 
 		/// <summary>
-		/// Get a pointer to the current input state object
+		/// Publishes a new pressed button mask, called from the view thread when input events arrive
+		/// </summary>
+		/// <param name="pressed">Pressed buttons, JOYPADBIT flags</param>
+		void publishState(bit8 pressed);
+
+		/// <summary>
+		/// Gets the last published pressed button mask
+		/// </summary>
+		/// <returns>Pressed buttons, JOYPADBIT flags</returns>
+		bit8 getPressedMask();
+
+		/// <summary>
+		/// Gets the time stamp of the last published input change
+		/// </summary>
+		/// <returns>Steady clock time stamp in nanoseconds</returns>
+		bit64 getLastInputTime();
+
+		/// <summary>
+		/// Checks for a published input change, called from the emulation thread
+		/// Requests the joypad interrupt on a falling P1 line
 		/// </summary>
-		/// <returns>Current state object pointer</returns>
-		InputStates* getState();
+		void pollInterrupt();
+
+		/// <summary>
+		/// Attaches a movie, recording it takes the latched changes, playing it replaces the host input
+		/// </summary>
+		/// <param name="target">Target movie, null to detach</param>
+		void setMovie(Movie* target);
+
+		/// <summary>
+		/// Attaches the rewinder, it keeps the latched changes and replays them when stepping back
+		/// </summary>
+		/// <param name="target">Target rewinder, null to detach</param>
+		void setRewinder(Rewinder* target);
+
+		/// <summary>
+		/// Latches the host mask again on the next instruction, once a replay stopped overriding it
+		/// </summary>
+		void resyncHost();
 
 		/// <summary>
 		/// Get the inputOutput result
 		/// </summary>
 		/// <returns>Input output values</returns>
 		bit8 getOutput();
+
+
+		/// <summary>
+		/// Copies the joypad selection state to the machine state
+		/// </summary>
+		/// <param name="st">Target state</param>
+		void saveState(MachineState* st);
+
+
+		/// <summary>
+		/// Restores the joypad selection state from a machine state
+		/// </summary>
+		/// <param name="st">Source state</param>
+		void loadState(const MachineState* st);
+
+
 	private:
 
 		/// <summary>
@@ -98,9 +148,40 @@ namespace TheBoy
 		EmulatorController* emulCtrl;
 
 		/// <summary>
-		/// Input controller internal reference
+		/// Pressed buttons mask, written by the view thread
+		/// </summary>
+		std::atomic<bit8> pressedMask{ 0 };
+
+		/// <summary>
+		/// Time stamp of the last pressed mask change
 		/// </summary>
-		InputStates* states;
+		std::atomic<bit64> inputStamp{ 0 };
+
+		/// <summary>
+		/// Marks a published change not yet checked by the emulation thread
+		/// </summary>
+		std::atomic<bool> pendingChange{ false };
+
+		/// <summary>
+		/// Pressed buttons seen by the guest, owned by the emulation thread
+		/// The host mask is latched here only on instruction boundaries, at a known tick
+		/// </summary>
+		bit8 activeMask = 0;
+
+		/// <summary>
+		/// Attached movie
+		/// </summary>
+		Movie* movie = nullptr;
+
+		/// <summary>
+		/// Attached rewinder
+		/// </summary>
+		Rewinder* rewinder = nullptr;
+
+		/// <summary>
+		/// Last P1 input lines (bits 0-3) seen by the emulation thread
+		/// </summary>
+		bit8 lastLines = 0x0F;
 
 		/// <summary>
 		/// Select Action buttons
@@ -111,6 +192,11 @@ namespace TheBoy
 		/// Select Direction buttons
 		/// </summary>
 		bool _directionSelected = false;
+
+		/// <summary>
+		/// Compares the current P1 input lines with the last ones, a High to Low change requests the interrupt
+		/// </summary>
+		void checkLines();
 	};
 }
 
@@ -1,5 +1,6 @@
 #include "instruc_funcs.h"
 #include "cpu.h"
+#include "guestProfiler.h"
 
 namespace TheBoy{
 	namespace CpuFuncs {
@@ -65,6 +66,8 @@ namespace TheBoy{
 			}
 
 			if(validateCondition(cpu)){
+				if (cpu->getProfiler()) { cpu->getProfiler()->ret(cpu->getRegisterValue(REG_SP)); }
+
 				bit16 lo = cpu->pop();
 				cpu->requestCycles(1);
 
@@ -847,6 +850,7 @@ namespace TheBoy{
 					// 2 cycles for a bit16 push
 					cpu->requestCycles(2);
 					cpu->push16(cpu->getRegisterValue(REG_PC));
+					if (cpu->getProfiler()) { cpu->getProfiler()->call(addr, cpu->getRegisterValue(REG_SP)); }
 				}
 				cpu->setRegisterValue(REG_PC, addr);
 				cpu->requestCycles(1);
@@ -856,7 +860,7 @@ namespace TheBoy{
 		/**
 		 * @brief Defines Instruction type to the resolvers
 		 */
-		static INST_FUNC instructResolvers[] = {
+		static const INST_FUNC instructResolvers[] = {
 			/*INST_NONE*/	instNone,
 			/*INST_NOP*/ 	instNOP,
 			/*INST_LD*/		instLD,
@@ -1,5 +1,6 @@
 #include "interrupt.h"
 #include "cpu.h"
+#include "guestProfiler.h"
 
 namespace TheBoy {
 	namespace InterruptFuncs {
@@ -7,7 +8,7 @@ namespace TheBoy {
 		/**
 		 * @brief Maps the address to the corresponding interrupt type
 		 */
-		static std::tuple<bit8, InterruptType> InterruptAddres[] = {
+		static const std::tuple<bit8, InterruptType> InterruptAddres[] = {
 			std::make_tuple(0x40, INTR_VBLANK),
 			std::make_tuple(0x48, INTR_STAT),
 			std::make_tuple(0x50, INTR_TIMER),
@@ -23,6 +24,7 @@ namespace TheBoy {
 		 */
 		void manage_interrupt(Cpu* cpu, bit16 addr) {
 			cpu->push16(cpu->getRegisterValue(REG_PC));
+			if (cpu->getProfiler()) { cpu->getProfiler()->call(addr, cpu->getRegisterValue(REG_SP)); }
 			cpu->setRegisterValue(REG_PC, addr);
 		}
 
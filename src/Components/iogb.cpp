@@ -1,4 +1,6 @@
 #include "iogb.h"
+#include "machineState.h"
+#include <cstring>
 
 namespace TheBoy {
 	/**
@@ -8,6 +10,8 @@ namespace TheBoy {
 	IO::IO(EmulatorController* ctrl) : emulCtrl(ctrl) {
 		std::cout << "[IO] ::: IO has been created" << std::endl;
 		seriaData = new bit8[2] {};
+		serialEvent = NoTransfer;
+		link = nullptr;
 	}
 
 	/**
@@ -90,6 +94,17 @@ namespace TheBoy {
 
 		if(addr == 0xFF02){
 			seriaData[1] = val;
+			// Transfer start on the internal clock, ends after the 8 bits are clocked
+			// With the external clock the transfer waits for the link partner
+			if ((val & 0x81) == 0x81) {
+				if (serialHook) { serialHook(seriaData[0]); }
+				serialEvent = emulCtrl->getTicks() + TransferTicks;
+				// Speculative frames are rolled back, they run unplugged and never reach the partner
+				if (link && !emulCtrl->isSpeculative()) { link->start(seriaData[0], serialEvent); }
+			}
+			else {
+				serialEvent = NoTransfer;
+			}
 			return;
 		}
 	
@@ -115,5 +130,81 @@ namespace TheBoy {
 			return;
 		}
 	}
-	
+
+
+	/// <summary>
+	/// Copies the serial registers to the machine state
+	/// </summary>
+	/// <param name="st">Target state</param>
+	void IO::saveState(MachineState* st) {
+		memcpy(st->io.serialData, seriaData, sizeof(st->io.serialData));
+		st->io.serialEvent = serialEvent;
+	}
+
+
+	/// <summary>
+	/// Restores the serial registers from a machine state
+	/// </summary>
+	/// <param name="st">Source state</param>
+	void IO::loadState(const MachineState* st) {
+		memcpy(seriaData, st->io.serialData, sizeof(st->io.serialData));
+		serialEvent = st->io.serialEvent;
+	}
+
+
+	/// <summary>
+	/// Defines the serial output hook, replaces the previous one
+	/// </summary>
+	/// <param name="hook">Serial byte callback, empty to drop the bytes</param>
+	void IO::setSerialHook(SerialHook hook) {
+		serialHook = hook;
+	}
+
+
+	/// <summary>
+	/// Plugs a link cable, null unplugs it
+	/// </summary>
+	/// <param name="link">Link backend, owned by the controller</param>
+	void IO::setLink(SerialLink* link) {
+		this->link = link;
+	}
+
+
+	/// <summary>
+	/// Ends the running internal clock transfer, the partner byte is shifted in
+	/// </summary>
+	void IO::serialComplete() {
+		serialEvent = NoTransfer;
+
+		bool plugged = link && !emulCtrl->isSpeculative();
+		seriaData[0] = plugged ? link->finish(emulCtrl->getTicks(), seriaData[0]) : 0xFF;
+		seriaData[1] &= 0x7F;
+		emulCtrl->getCpu()->requestInterrupt(InterruptFuncs::INTR_SERIAL);
+	}
+
+
+	/// <summary>
+	/// Shifts in the byte of a partner transfer and answers it, then syncs the time
+	/// </summary>
+	/// <param name="ticks">Current emulated tick</param>
+	void IO::serviceLink(bit64 ticks) {
+		// The partner waits until the real frames reach its tick
+		if (emulCtrl->isSpeculative()) { return; }
+
+		bit8 in;
+		if (link->takeRequest(ticks, &in)) {
+			if ((seriaData[1] & 0x81) == 0x80) {
+				// Transfer armed on the external clock, clocked by the partner
+				link->reply(seriaData[0]);
+				seriaData[0] = in;
+				seriaData[1] &= 0x7F;
+				emulCtrl->getCpu()->requestInterrupt(InterruptFuncs::INTR_SERIAL);
+			}
+			else {
+				// Own clock running, the line carries the own byte, or idle and the partner reads it high
+				link->reply((seriaData[1] & 0x81) == 0x81 ? seriaData[0] : 0xFF);
+			}
+		}
+		link->sync(ticks);
+	}
 } // namespace TheBoy
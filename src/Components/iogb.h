@@ -2,8 +2,11 @@
 #define IO_H
 
 #include "emulatorController.h"
+#include "serialLink.h"
+#include <functional>
 
 namespace TheBoy {
+	struct MachineState;
 
 	/**
 	 * @brief Class managing the IO Operrations
@@ -38,6 +41,63 @@ namespace TheBoy {
 		 */
 		void write(bit16 addr, bit8 val);
 	
+		/// <summary>
+		/// Copies the serial registers to the machine state
+		/// </summary>
+		/// <param name="st">Target state</param>
+		void saveState(MachineState* st);
+
+
+		/// <summary>
+		/// Restores the serial registers from a machine state
+		/// </summary>
+		/// <param name="st">Source state</param>
+		void loadState(const MachineState* st);
+
+
+		/// <summary>
+		/// Receives every byte sent on the serial port
+		/// </summary>
+		typedef std::function<void(bit8)> SerialHook;
+
+
+		/// <summary>
+		/// Defines the serial output hook, replaces the previous one
+		/// </summary>
+		/// <param name="hook">Serial byte callback, empty to drop the bytes</param>
+		void setSerialHook(SerialHook hook);
+
+
+		/// <summary>
+		/// Plugs a link cable, null unplugs it
+		/// </summary>
+		/// <param name="link">Link backend, owned by the controller</param>
+		void setLink(SerialLink* link);
+
+
+		/// <summary>
+		/// Gets if the running transfer ends on this tick, checked every machine cycle
+		/// </summary>
+		/// <param name="ticks">Current emulated tick</param>
+		/// <returns>Transfer end state</returns>
+		bool serialDue(bit64 ticks) { return ticks >= serialEvent; }
+
+
+		/// <summary>
+		/// Ends the running internal clock transfer, the partner byte is shifted in
+		/// </summary>
+		void serialComplete();
+
+
+		/// <summary>
+		/// Runs the link cable work (partner transfers, time sync), checked every instruction
+		/// </summary>
+		/// <param name="ticks">Current emulated tick</param>
+		void linkPoll(bit64 ticks) {
+			if (link && link->pending(ticks)) { serviceLink(ticks); }
+		}
+
+
 	private:
 		/**
 		 * @brief Pointer to the target emulator controller
@@ -49,6 +109,43 @@ namespace TheBoy {
 		 * @brief Holds the current IO Serial data
 		 */
 		bit8* seriaData;
+
+
+		/// <summary>
+		/// Serial output hook
+		/// </summary>
+		SerialHook serialHook;
+
+
+		/// <summary>
+		/// Transfer length, 8 bits on the 8192 Hz clock
+		/// </summary>
+		static const bit64 TransferTicks = 8 * 512;
+
+
+		/// <summary>
+		/// Tick value of no running transfer
+		/// </summary>
+		static const bit64 NoTransfer = ~0ULL;
+
+
+		/// <summary>
+		/// End tick of the running internal clock transfer
+		/// </summary>
+		bit64 serialEvent;
+
+
+		/// <summary>
+		/// Link cable, null when unplugged
+		/// </summary>
+		SerialLink* link;
+
+
+		/// <summary>
+		/// Shifts in the byte of a partner transfer and answers it, then syncs the time
+		/// </summary>
+		/// <param name="ticks">Current emulated tick</param>
+		void serviceLink(bit64 ticks);
 	};	
 } // namespace TheBoy
 #endif
\ No newline at end of file
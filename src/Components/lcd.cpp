@@ -1,4 +1,6 @@
 #include "lcd.h"
+#include "machineState.h"
+#include <cstring>
 
 namespace TheBoy {
 
@@ -42,9 +44,19 @@ namespace TheBoy {
 	bit8 Lcd::read(bit16 address) {
 		// Since the order on the struct is the same as the defined, using offset
 		bit8 offSet = (address - 0xFF40);
+		if (lyStub && address == 0xFF44) { return 0x90; }
 		return ((bit8*)&regs)[offSet];
 	}
 
+
+	/// <summary>
+	/// Makes the bus reads of LY return 0x90, the state the gameboy-doctor reference logs were taken with
+	/// </summary>
+	/// <param name="state">Stub state</param>
+	void Lcd::setLyStub(bool state) {
+		lyStub = state;
+	}
+
 	/// <summary>
 	/// Writes to the defined addres value
 	/// </summary>
@@ -279,4 +291,29 @@ namespace TheBoy {
 	bit32 Lcd::getSpriteColorTwoById(bit8 id) {
 		return spriteColors2[id];
 	}
+
+
+	/// <summary>
+	/// Copies the lcd registers and pallets to the machine state
+	/// </summary>
+	/// <param name="st">Target state</param>
+	void Lcd::saveState(MachineState* st) {
+		st->lcd.regs = regs;
+		memcpy(st->lcd.bgColors, bgColorPallets, sizeof(st->lcd.bgColors));
+		memcpy(st->lcd.spriteColors1, spriteColors1, sizeof(st->lcd.spriteColors1));
+		memcpy(st->lcd.spriteColors2, spriteColors2, sizeof(st->lcd.spriteColors2));
+	}
+
+
+	/// <summary>
+	/// Restores the lcd registers and pallets from a machine state
+	/// </summary>
+	/// <param name="st">Source state</param>
+	void Lcd::loadState(const MachineState* st) {
+		regs = st->lcd.regs;
+		memcpy(bgColorPallets, st->lcd.bgColors, sizeof(st->lcd.bgColors));
+		memcpy(spriteColors1, st->lcd.spriteColors1, sizeof(st->lcd.spriteColors1));
+		memcpy(spriteColors2, st->lcd.spriteColors2, sizeof(st->lcd.spriteColors2));
+	}
+
 }
\ No newline at end of file
@@ -5,6 +5,7 @@
 #include "emulatorController.h"
 
 namespace TheBoy {
+	struct MachineState;
 
 	/*
 	* FF40 - LCDC (LCD Control) (R/W)
@@ -310,6 +311,27 @@ namespace TheBoy {
 		/// <returns>Defined color</returns>
 		bit32 getSpriteColorTwoById(bit8 id);
 
+		/// <summary>
+		/// Copies the lcd registers and pallets to the machine state
+		/// </summary>
+		/// <param name="st">Target state</param>
+		void saveState(MachineState* st);
+
+
+		/// <summary>
+		/// Restores the lcd registers and pallets from a machine state
+		/// </summary>
+		/// <param name="st">Source state</param>
+		void loadState(const MachineState* st);
+
+
+		/// <summary>
+		/// Makes the bus reads of LY return 0x90, the state the gameboy-doctor reference logs were taken with
+		/// </summary>
+		/// <param name="state">Stub state</param>
+		void setLyStub(bool state);
+
+
 	private:
 		/// <summary>
 		/// Pointer to the target emulator controller
@@ -323,6 +345,12 @@ namespace TheBoy {
 		LcdRegs regs;
 
 
+		/// <summary>
+		/// Marks the LY reads stubbed to 0x90
+		/// </summary>
+		bool lyStub = false;
+
+
 		/// <summary>
 		/// Holds the defined background colors
 		/// </summary>
@@ -0,0 +1,492 @@
+#include "mapper.h"
+#include "cartridge.h"
+#include "machineState.h"
+#include <cstring>
+#include <ctime>
+
+namespace TheBoy {
+
+	/// <summary>
+	/// Mapper constructor
+	/// </summary>
+	/// <param name="cart">Cartridge whose banks are mapped</param>
+	Mapper::Mapper(Cartridge* cart) : cart(cart) {
+		enabledRam = false;
+		bankingMode = 0;
+		romBankVal = 1;
+		ramBankVal = 0;
+	}
+
+
+	/// <summary>
+	/// Creates the mapper of a cartridge type, a rom only mapper for the unsupported ones
+	/// </summary>
+	/// <param name="cartType">Header cartridge type (0x0147)</param>
+	/// <param name="cart">Cartridge whose banks are mapped</param>
+	/// <returns>Mapper, with its power on banks mapped</returns>
+	std::unique_ptr<Mapper> Mapper::create(bit8 cartType, Cartridge* cart) {
+		std::unique_ptr<Mapper> mapper;
+		switch (cartType) {
+		case 0x01: case 0x02: case 0x03:
+			mapper.reset(new MapperMbc1(cart));
+			break;
+		case 0x05: case 0x06:
+			mapper.reset(new MapperMbc2(cart));
+			break;
+		case 0x0F: case 0x10:
+			mapper.reset(new MapperMbc3(cart, true));
+			break;
+		case 0x11: case 0x12: case 0x13:
+			mapper.reset(new MapperMbc3(cart, false));
+			break;
+		case 0x19: case 0x1A: case 0x1B: case 0x1C: case 0x1D: case 0x1E:
+			mapper.reset(new MapperMbc5(cart));
+			break;
+		default:
+			if (cartType != 0x00 && cartType != 0x08 && cartType != 0x09) {
+				printf("[CARTRIDGE] :: Unsupported cartridge type %2.2X, running as rom only\n", cartType);
+			}
+			mapper.reset(new MapperNone(cart));
+			break;
+		}
+		mapper->remap();
+		return mapper;
+	}
+
+
+	/// <summary>
+	/// Reads the external ram area when no ram bank is mapped on it, A000-BFFF
+	/// </summary>
+	/// <param name="addr">Target address</param>
+	/// <returns>Read value, 0xFF on a disabled ram</returns>
+	bit8 Mapper::readRam(bit16 /*addr*/) {
+		return 0xFF;
+	}
+
+
+	/// <summary>
+	/// Writes the external ram area when no ram bank is mapped on it, A000-BFFF
+	/// </summary>
+	/// <param name="addr">Target address</param>
+	/// <param name="val">Written value</param>
+	void Mapper::writeRam(bit16 /*addr*/, bit8 /*val*/) {
+	}
+
+
+	/// <summary>
+	/// Gets the size of the mapper data saved after the ram in the battery file, 0 without any
+	/// </summary>
+	size_t Mapper::getFooterSize() {
+		return 0;
+	}
+
+
+	/// <summary>
+	/// Writes the mapper data saved after the ram in the battery file
+	/// </summary>
+	/// <param name="out">Target, getFooterSize bytes</param>
+	void Mapper::writeFooter(bit8* /*out*/) {
+	}
+
+
+	/// <summary>
+	/// Reads the mapper data saved after the ram in the battery file
+	/// </summary>
+	/// <param name="in">Footer bytes</param>
+	/// <param name="size">Footer size</param>
+	/// <returns>If the footer was recognized</returns>
+	bool Mapper::readFooter(const bit8* /*in*/, size_t /*size*/) {
+		return false;
+	}
+
+
+	/// <summary>
+	/// Copies the mapper registers to the cartridge state
+	/// </summary>
+	/// <param name="st">Target state</param>
+	void Mapper::saveState(CartState* st) {
+		st->enabledRam = enabledRam;
+		st->bankingMode = bankingMode;
+		st->romBankVal = romBankVal;
+		st->ramBankVal = ramBankVal;
+	}
+
+
+	/// <summary>
+	/// Restores the mapper registers from a cartridge state and maps their banks
+	/// </summary>
+	/// <param name="st">Source state</param>
+	void Mapper::loadState(const CartState* st) {
+		enabledRam = st->enabledRam;
+		bankingMode = st->bankingMode;
+		romBankVal = st->romBankVal;
+		ramBankVal = st->ramBankVal;
+		remap();
+	}
+
+
+
+	/// <summary>
+	/// Rom only constructor
+	/// </summary>
+	MapperNone::MapperNone(Cartridge* cart) : Mapper(cart) { }
+
+
+	/// <summary>
+	/// No register to write
+	/// </summary>
+	void MapperNone::write(bit16 /*addr*/, bit8 /*val*/) { }
+
+
+	/// <summary>
+	/// Banks 0 and 1, the ram is always enabled
+	/// </summary>
+	void MapperNone::remap() {
+		cart->mapRom(0, 1);
+		cart->mapRam(0, true);
+	}
+
+
+
+	/// <summary>
+	/// MBC1 constructor
+	/// </summary>
+	MapperMbc1::MapperMbc1(Cartridge* cart) : Mapper(cart) { }
+
+
+	/// <summary>
+	/// MBC1 registers
+	/// </summary>
+	void MapperMbc1::write(bit16 addr, bit8 val) {
+		switch (addr & 0x6000) {
+		case 0x0000:
+			// 0000-1FFF - RAM Enable, 0x0A on the low nibble
+			enabledRam = (val & 0xF) == 0xA;
+			break;
+		case 0x2000:
+			// 2000-3FFF - ROM Bank Number, 5 bits, 0 reads as 1 before the upper bits are added
+			romBankVal = val & 0x1F;
+			if (romBankVal == 0) { romBankVal = 1; }
+			break;
+		case 0x4000:
+			// 4000-5FFF - RAM Bank Number or Upper Bits of ROM Bank Number
+			ramBankVal = val & 0x3;
+			break;
+		default:
+			// 6000-7FFF - Banking Mode Select
+			bankingMode = val & 1;
+			break;
+		}
+		remap();
+	}
+
+
+	/// <summary>
+	/// The upper bits always apply to 4000-7FFF, in mode 1 to 0000-3FFF and to the ram too
+	/// </summary>
+	void MapperMbc1::remap() {
+		bit32 upper = static_cast<bit32>(ramBankVal) << 5;
+		cart->mapRom(bankingMode ? upper : 0, upper | romBankVal);
+		cart->mapRam(bankingMode ? ramBankVal : 0, enabledRam);
+	}
+
+
+
+	/// <summary>
+	/// MBC2 constructor
+	/// </summary>
+	MapperMbc2::MapperMbc2(Cartridge* cart) : Mapper(cart) { }
+
+
+	/// <summary>
+	/// MBC2 registers, the address bit 8 picks the register
+	/// </summary>
+	void MapperMbc2::write(bit16 addr, bit8 val) {
+		if (addr >= 0x4000) { return; }
+
+		if (addr & 0x100) {
+			romBankVal = val & 0xF;
+			if (romBankVal == 0) { romBankVal = 1; }
+		}
+		else {
+			enabledRam = (val & 0xF) == 0xA;
+		}
+		remap();
+	}
+
+
+	/// <summary>
+	/// Built in ram, 512 half bytes mirrored on the whole area, the upper bits read as set
+	/// </summary>
+	bit8 MapperMbc2::readRam(bit16 addr) {
+		bit8* ram = cart->getRam();
+		if (!enabledRam || !ram) { return 0xFF; }
+		return 0xF0 | ram[addr & 0x1FF];
+	}
+
+
+	/// <summary>
+	/// Built in ram, only the low half byte is kept
+	/// </summary>
+	void MapperMbc2::writeRam(bit16 addr, bit8 val) {
+		bit8* ram = cart->getRam();
+		if (!enabledRam || !ram) { return; }
+		ram[addr & 0x1FF] = val & 0xF;
+		cart->ramWritten(&ram[addr & 0x1FF]);
+	}
+
+
+	/// <summary>
+	/// The ram is never mapped directly, its reads go through readRam
+	/// </summary>
+	void MapperMbc2::remap() {
+		cart->mapRom(0, romBankVal);
+		cart->mapRam(0, false);
+	}
+
+
+
+	/// <summary>
+	/// Emulated clock, ticks per second
+	/// </summary>
+	static const bit64 ClockHz = 4194304;
+
+
+	/// <summary>
+	/// Adds seconds to clock registers, the day counter sets the carry when it overflows 511
+	/// </summary>
+	/// <param name="regs">Clock registers</param>
+	/// <param name="seconds">Seconds to add</param>
+	static void rtcAdd(bit8* regs, bit64 seconds) {
+		if (seconds == 0) { return; }
+
+		bit64 sec = regs[RTC_S] + seconds;
+		bit64 min = regs[RTC_M] + sec / 60;
+		bit64 hour = regs[RTC_H] + min / 60;
+		bit64 day = (regs[RTC_DL] | ((regs[RTC_DH] & 1) << 8)) + hour / 24;
+
+		regs[RTC_S] = static_cast<bit8>(sec % 60);
+		regs[RTC_M] = static_cast<bit8>(min % 60);
+		regs[RTC_H] = static_cast<bit8>(hour % 24);
+		regs[RTC_DL] = static_cast<bit8>(day & 0xFF);
+		regs[RTC_DH] = (regs[RTC_DH] & 0xC0) | ((day >> 8) & 1) | (day > 0x1FF ? 0x80 : 0);
+	}
+
+
+	/// <summary>
+	/// MBC3 constructor, the clock starts on the load tick from 0
+	/// </summary>
+	MapperMbc3::MapperMbc3(Cartridge* cart, bool hasClock) : Mapper(cart), hasClock(hasClock) {
+		memset(rtcRegs, 0, sizeof(rtcRegs));
+		memset(rtcLatched, 0, sizeof(rtcLatched));
+		rtcLatch = 0xFF;
+		rtcBaseTicks = cart->getTicks();
+	}
+
+
+	/// <summary>
+	/// MBC3 registers
+	/// </summary>
+	void MapperMbc3::write(bit16 addr, bit8 val) {
+		switch (addr & 0x6000) {
+		case 0x0000:
+			// 0000-1FFF - RAM and Timer Enable
+			enabledRam = (val & 0xF) == 0xA;
+			break;
+		case 0x2000:
+			// 2000-3FFF - ROM Bank Number, 7 bits, 0 selects 1
+			romBankVal = val & 0x7F;
+			if (romBankVal == 0) { romBankVal = 1; }
+			break;
+		case 0x4000:
+			// 4000-5FFF - RAM Bank Number 00-03, or RTC Register Select 08-0C
+			ramBankVal = val & 0xF;
+			break;
+		default:
+			// 6000-7FFF - Latch Clock Data, 00 then 01 copies the running registers
+			if (hasClock && rtcLatch == 0x00 && val == 0x01) { rtcNow(rtcLatched); }
+			rtcLatch = val;
+			return;
+		}
+		remap();
+	}
+
+
+	/// <summary>
+	/// Clock registers, the latched values
+	/// </summary>
+	bit8 MapperMbc3::readRam(bit16 /*addr*/) {
+		if (!enabledRam || !hasClock || ramBankVal < 0x8 || ramBankVal > 0xC) { return 0xFF; }
+		return rtcLatched[ramBankVal - 0x8];
+	}
+
+
+	/// <summary>
+	/// Clock registers, written on the running clock
+	/// </summary>
+	void MapperMbc3::writeRam(bit16 /*addr*/, bit8 val) {
+		if (!enabledRam || !hasClock || ramBankVal < 0x8 || ramBankVal > 0xC) { return; }
+
+		static const bit8 Masks[RTC_REG_COUNT] = { 0x3F, 0x3F, 0x1F, 0xFF, 0xC1 };
+		RTC_REG reg = static_cast<RTC_REG>(ramBankVal - 0x8);
+		bool wasHalted = rtcRegs[RTC_DH] & 0x40;
+
+		rtcRebase();
+		rtcRegs[reg] = val & Masks[reg];
+		rtcLatched[reg] = rtcRegs[reg];
+
+		// Writing the seconds clears the part of second, so does leaving the halt
+		bit64 ticks = cart->getTicks();
+		if (reg == RTC_S || (wasHalted && !(rtcRegs[RTC_DH] & 0x40))) { rtcBaseTicks = ticks; }
+		cart->footerWritten();
+	}
+
+
+	/// <summary>
+	/// Computes the current registers from the base ones and the emulated time since
+	/// </summary>
+	/// <param name="out">Current registers</param>
+	void MapperMbc3::rtcNow(bit8* out) {
+		memcpy(out, rtcRegs, RTC_REG_COUNT);
+		if (rtcRegs[RTC_DH] & 0x40) { return; }
+		rtcAdd(out, (cart->getTicks() - rtcBaseTicks) / ClockHz);
+	}
+
+
+	/// <summary>
+	/// Moves the base to the current tick, keeping the part of second already counted
+	/// </summary>
+	void MapperMbc3::rtcRebase() {
+		bit64 ticks = cart->getTicks();
+		if (rtcRegs[RTC_DH] & 0x40) {
+			rtcBaseTicks = ticks;
+			return;
+		}
+
+		bit64 elapsed = ticks - rtcBaseTicks;
+		rtcAdd(rtcRegs, elapsed / ClockHz);
+		rtcBaseTicks = ticks - elapsed % ClockHz;
+	}
+
+
+	/// <summary>
+	/// Footer of the clock cartridges
+	/// </summary>
+	size_t MapperMbc3::getFooterSize() {
+		return hasClock ? FooterSize : 0;
+	}
+
+
+	/// <summary>
+	/// Writes the running and latched registers and the host time, little endian
+	/// </summary>
+	void MapperMbc3::writeFooter(bit8* out) {
+		bit8 now[RTC_REG_COUNT];
+		rtcNow(now);
+		memset(out, 0, FooterSize);
+		for (int i = 0; i < RTC_REG_COUNT; i++) {
+			out[i * 4] = now[i];
+			out[20 + i * 4] = rtcLatched[i];
+		}
+
+		bit64 host = static_cast<bit64>(time(nullptr));
+		for (int i = 0; i < 8; i++) { out[40 + i] = static_cast<bit8>(host >> (i * 8)); }
+	}
+
+
+	/// <summary>
+	/// Reads the registers, with the host sync on the time spent since the save is added
+	/// </summary>
+	bool MapperMbc3::readFooter(const bit8* in, size_t size) {
+		if (!hasClock || (size != FooterSize && size != FooterSize32)) { return false; }
+
+		for (int i = 0; i < RTC_REG_COUNT; i++) {
+			rtcRegs[i] = in[i * 4];
+			rtcLatched[i] = in[20 + i * 4];
+		}
+		rtcBaseTicks = cart->getTicks();
+
+		bit64 saved = 0;
+		for (size_t i = 0; i < size - 40; i++) { saved |= static_cast<bit64>(in[40 + i]) << (i * 8); }
+		bit64 host = static_cast<bit64>(time(nullptr));
+		if (cart->getClockHostSync() && !(rtcRegs[RTC_DH] & 0x40) && host > saved) { rtcAdd(rtcRegs, host - saved); }
+		return true;
+	}
+
+
+	/// <summary>
+	/// Mapper registers and the clock
+	/// </summary>
+	void MapperMbc3::saveState(CartState* st) {
+		Mapper::saveState(st);
+		memcpy(st->rtcRegs, rtcRegs, sizeof(st->rtcRegs));
+		memcpy(st->rtcLatched, rtcLatched, sizeof(st->rtcLatched));
+		st->rtcLatch = rtcLatch;
+		st->rtcBaseTicks = rtcBaseTicks;
+	}
+
+
+	/// <summary>
+	/// Mapper registers and the clock, the state ticks are restored with it
+	/// </summary>
+	void MapperMbc3::loadState(const CartState* st) {
+		memcpy(rtcRegs, st->rtcRegs, sizeof(rtcRegs));
+		memcpy(rtcLatched, st->rtcLatched, sizeof(rtcLatched));
+		rtcLatch = st->rtcLatch;
+		rtcBaseTicks = st->rtcBaseTicks;
+		Mapper::loadState(st);
+	}
+
+
+	/// <summary>
+	/// A ram bank is mapped only when selected, the clock registers go through readRam
+	/// </summary>
+	void MapperMbc3::remap() {
+		cart->mapRom(0, romBankVal);
+		bool ramSelected = ramBankVal < 0x8;
+		cart->mapRam(ramSelected ? ramBankVal : 0, enabledRam && ramSelected);
+	}
+
+
+
+	/// <summary>
+	/// MBC5 constructor
+	/// </summary>
+	MapperMbc5::MapperMbc5(Cartridge* cart) : Mapper(cart) { }
+
+
+	/// <summary>
+	/// MBC5 registers
+	/// </summary>
+	void MapperMbc5::write(bit16 addr, bit8 val) {
+		if (addr < 0x2000) {
+			// 0000-1FFF - RAM Enable
+			enabledRam = (val & 0xF) == 0xA;
+		}
+		else if (addr < 0x3000) {
+			// 2000-2FFF - 8 least significant bits of ROM bank number
+			romBankVal = (romBankVal & 0x100) | val;
+		}
+		else if (addr < 0x4000) {
+			// 3000-3FFF - 9th bit of ROM bank number
+			romBankVal = (romBankVal & 0xFF) | ((val & 1) << 8);
+		}
+		else if (addr < 0x6000) {
+			// 4000-5FFF - RAM bank number
+			ramBankVal = val & 0xF;
+		}
+		else {
+			return;
+		}
+		remap();
+	}
+
+
+	/// <summary>
+	/// No bank 0 quirk, any bank maps on 4000-7FFF
+	/// </summary>
+	void MapperMbc5::remap() {
+		cart->mapRom(0, romBankVal);
+		cart->mapRam(ramBankVal, enabledRam);
+	}
+} // namespace TheBoy
@@ -0,0 +1,284 @@
+#pragma once
+#ifndef MAPPER_H
+#define MAPPER_H
+
+#include "common.h"
+#include <memory>
+
+namespace TheBoy {
+	class Cartridge;
+	struct CartState;
+
+	/// <summary>
+	/// Cartridge memory bank controllers
+	/// </summary>
+	typedef enum CART_MAPPER {
+		MAPPER_NONE,
+		MAPPER_MBC1,
+		MAPPER_MBC2,
+		MAPPER_MBC3,
+		MAPPER_MBC5
+	} CART_MAPPER;
+
+
+	/// <summary>
+	/// Memory bank controller of a cartridge, picked once from the header type on load
+	/// Reads never reach the mapper: the cartridge reads through its rom and ram bank pointers, the mapper only
+	/// repoints them when its registers are written. The external ram goes through the mapper when it is not
+	/// plain memory (disabled, MBC2 half bytes, MBC3 clock registers)
+	/// </summary>
+	class Mapper {
+	public:
+		/// <summary>
+		/// Mapper constructor
+		/// </summary>
+		/// <param name="cart">Cartridge whose banks are mapped</param>
+		Mapper(Cartridge* cart);
+
+
+		/// <summary>
+		/// Mapper destructor
+		/// </summary>
+		virtual ~Mapper() = default;
+
+
+		/// <summary>
+		/// Creates the mapper of a cartridge type, a rom only mapper for the unsupported ones
+		/// </summary>
+		/// <param name="cartType">Header cartridge type (0x0147)</param>
+		/// <param name="cart">Cartridge whose banks are mapped</param>
+		/// <returns>Mapper, with its power on banks mapped</returns>
+		static std::unique_ptr<Mapper> create(bit8 cartType, Cartridge* cart);
+
+
+		/// <summary>
+		/// Gets the mapper type
+		/// </summary>
+		virtual CART_MAPPER getType() = 0;
+
+
+		/// <summary>
+		/// Gets the mapper name
+		/// </summary>
+		virtual const char* getName() = 0;
+
+
+		/// <summary>
+		/// Writes a control register, 0000-7FFF
+		/// </summary>
+		/// <param name="addr">Target address</param>
+		/// <param name="val">Written value</param>
+		virtual void write(bit16 addr, bit8 val) = 0;
+
+
+		/// <summary>
+		/// Reads the external ram area when no ram bank is mapped on it, A000-BFFF
+		/// </summary>
+		/// <param name="addr">Target address</param>
+		/// <returns>Read value, 0xFF on a disabled ram</returns>
+		virtual bit8 readRam(bit16 addr);
+
+
+		/// <summary>
+		/// Writes the external ram area when no ram bank is mapped on it, A000-BFFF
+		/// </summary>
+		/// <param name="addr">Target address</param>
+		/// <param name="val">Written value</param>
+		virtual void writeRam(bit16 addr, bit8 val);
+
+
+		/// <summary>
+		/// Gets the size of the mapper data saved after the ram in the battery file, 0 without any
+		/// </summary>
+		virtual size_t getFooterSize();
+
+
+		/// <summary>
+		/// Writes the mapper data saved after the ram in the battery file
+		/// </summary>
+		/// <param name="out">Target, getFooterSize bytes</param>
+		virtual void writeFooter(bit8* out);
+
+
+		/// <summary>
+		/// Reads the mapper data saved after the ram in the battery file
+		/// </summary>
+		/// <param name="in">Footer bytes</param>
+		/// <param name="size">Footer size</param>
+		/// <returns>If the footer was recognized</returns>
+		virtual bool readFooter(const bit8* in, size_t size);
+
+
+		/// <summary>
+		/// Copies the mapper registers to the cartridge state
+		/// </summary>
+		/// <param name="st">Target state</param>
+		virtual void saveState(CartState* st);
+
+
+		/// <summary>
+		/// Restores the mapper registers from a cartridge state and maps their banks
+		/// </summary>
+		/// <param name="st">Source state</param>
+		virtual void loadState(const CartState* st);
+
+	protected:
+		/// <summary>
+		/// Cartridge whose banks are mapped
+		/// </summary>
+		Cartridge* cart;
+
+
+		/// <summary>
+		/// Registers, their meaning depends on the mapper
+		/// </summary>
+		bool enabledRam;
+		bit8 bankingMode;
+		bit16 romBankVal;
+		bit8 ramBankVal;
+
+
+		/// <summary>
+		/// Maps the banks selected by the registers
+		/// </summary>
+		virtual void remap() = 0;
+	};
+
+
+	/// <summary>
+	/// No controller, 32 KiB of rom and the optional 8 KiB of ram always mapped
+	/// </summary>
+	class MapperNone : public Mapper {
+	public:
+		MapperNone(Cartridge* cart);
+		CART_MAPPER getType() override { return MAPPER_NONE; }
+		const char* getName() override { return "ROM ONLY"; }
+		void write(bit16 addr, bit8 val) override;
+
+	protected:
+		void remap() override;
+	};
+
+
+	/// <summary>
+	/// MBC1, 5 bit rom bank and a 2 bit register selecting the upper rom bits or the ram bank
+	/// Mode 1 also applies that register to the 0000-3FFF bank and to the ram
+	/// </summary>
+	class MapperMbc1 : public Mapper {
+	public:
+		MapperMbc1(Cartridge* cart);
+		CART_MAPPER getType() override { return MAPPER_MBC1; }
+		const char* getName() override { return "MBC1"; }
+		void write(bit16 addr, bit8 val) override;
+
+	protected:
+		void remap() override;
+	};
+
+
+	/// <summary>
+	/// MBC2, 4 bit rom bank and a built in 512 x 4 bits ram mirrored on A000-BFFF
+	/// Address bit 8 picks the register on 0000-3FFF, clear the ram enable, set the rom bank
+	/// </summary>
+	class MapperMbc2 : public Mapper {
+	public:
+		MapperMbc2(Cartridge* cart);
+		CART_MAPPER getType() override { return MAPPER_MBC2; }
+		const char* getName() override { return "MBC2"; }
+		void write(bit16 addr, bit8 val) override;
+		bit8 readRam(bit16 addr) override;
+		void writeRam(bit16 addr, bit8 val) override;
+
+	protected:
+		void remap() override;
+	};
+
+
+	/// <summary>
+	/// MBC3 clock registers, seconds, minutes, hours, day low and day high (bit 0 day 8, bit 6 halt, bit 7 carry)
+	/// </summary>
+	typedef enum RTC_REG {
+		RTC_S,
+		RTC_M,
+		RTC_H,
+		RTC_DL,
+		RTC_DH,
+		RTC_REG_COUNT
+	} RTC_REG;
+
+
+	/// <summary>
+	/// MBC3, 7 bit rom bank, 4 ram banks or the clock registers selected on 4000-5FFF
+	/// The clock is not ticked: its registers are kept as they were on a base emulated tick and the time since
+	/// is added when they are latched or written. Emulated time keeps headless and turbo runs deterministic,
+	/// the host time only moves it on a battery load with the host sync on
+	/// </summary>
+	class MapperMbc3 : public Mapper {
+	public:
+		/// <summary>
+		/// Battery footer, the 5 registers and the 5 latched ones as 32 bit values and a 64 bit unix time
+		/// The same layout as VBA-M and BGB, the older 32 bit time variant is read too
+		/// </summary>
+		static const size_t FooterSize = 48;
+		static const size_t FooterSize32 = 44;
+
+		MapperMbc3(Cartridge* cart, bool hasClock);
+		CART_MAPPER getType() override { return MAPPER_MBC3; }
+		const char* getName() override { return hasClock ? "MBC3+TIMER" : "MBC3"; }
+		void write(bit16 addr, bit8 val) override;
+		bit8 readRam(bit16 addr) override;
+		void writeRam(bit16 addr, bit8 val) override;
+		size_t getFooterSize() override;
+		void writeFooter(bit8* out) override;
+		bool readFooter(const bit8* in, size_t size) override;
+		void saveState(CartState* st) override;
+		void loadState(const CartState* st) override;
+
+	protected:
+		void remap() override;
+
+	private:
+		/// <summary>
+		/// Cartridge with the clock chip
+		/// </summary>
+		bool hasClock;
+
+
+		/// <summary>
+		/// Registers on the base tick, the latched copy read by the guest and the last latch write
+		/// </summary>
+		bit8 rtcRegs[RTC_REG_COUNT];
+		bit8 rtcLatched[RTC_REG_COUNT];
+		bit8 rtcLatch;
+		bit64 rtcBaseTicks;
+
+
+		/// <summary>
+		/// Computes the current registers from the base ones and the emulated time since
+		/// </summary>
+		/// <param name="out">Current registers</param>
+		void rtcNow(bit8* out);
+
+
+		/// <summary>
+		/// Moves the base to the current tick, keeping the part of second already counted
+		/// </summary>
+		void rtcRebase();
+	};
+
+
+	/// <summary>
+	/// MBC5, 9 bit rom bank split on 2000-2FFF and 3000-3FFF, 16 ram banks, bank 0 can be mapped on 4000-7FFF
+	/// </summary>
+	class MapperMbc5 : public Mapper {
+	public:
+		MapperMbc5(Cartridge* cart);
+		CART_MAPPER getType() override { return MAPPER_MBC5; }
+		const char* getName() override { return "MBC5"; }
+		void write(bit16 addr, bit8 val) override;
+
+	protected:
+		void remap() override;
+	};
+} // namespace TheBoy
+#endif // !MAPPER_H
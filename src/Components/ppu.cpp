@@ -1,4 +1,5 @@
 #include "ppu.h"
+#include "machineState.h"
 #include <cstring>
 
 
@@ -15,6 +16,10 @@ namespace TheBoy {
 
 		buffer = new bit32[yRes * xRes * sizeof(32)]{ 0 };
 
+		snapshot = new VRamSnapshot{ };
+		memset(pendingTiles, 0, sizeof(pendingTiles));
+		memset(pendingMap, 0, sizeof(pendingMap));
+
 		cFrame = 0;
 		cLineTicks = 0;
 
@@ -40,6 +45,7 @@ namespace TheBoy {
 		delete[] oam_ram;
 		delete[] buffer;
 		delete fifo;
+		delete snapshot;
 	}
 
 	/// <summary>
@@ -56,6 +62,10 @@ namespace TheBoy {
 	void Ppu::step() {
 		cLineTicks++;
 
+#if PERFCOUNT
+		emulCtrl->getPerf()->ppuTicks[emulCtrl->getLcd()->getLCDSMode()]++;
+#endif
+
 		switch (emulCtrl->getLcd()->getLCDSMode()) {
 		case Lcd::LCDMODE::OAM:
 			PpuStates::mode_OAM(emulCtrl);
@@ -120,6 +130,18 @@ namespace TheBoy {
 	void Ppu::write(bit16 addr, bit8 val) {
 		// Tile data is stored in VRAM in the memory area at $8000-$97FF;
 		vRam[addr - 0x8000] = val;
+
+		// Track the changes for the debug viewers
+		if (snapshotEnabled.load(std::memory_order_relaxed)) {
+			bit16 offset = addr - 0x8000;
+			if (offset < 0x1800) {
+				pendingTiles[offset >> 7] |= 1 << ((offset >> 4) & 7);
+			}
+			else {
+				offset -= 0x1800;
+				pendingMap[offset >> 3] |= 1 << (offset & 7);
+			}
+		}
 	}
 
 
@@ -164,69 +186,6 @@ namespace TheBoy {
 	}
 
 
-	/// <summary>
-	/// Gets the defined target frame Time
-	/// </summary>
-	/// <returns>Defined Frame time value</returns>
-	bit32 Ppu::getTargetFrameTime() {
-		return targetFrameTime;
-	}
-
-
-	/// <summary>
-	/// Gets the last frame time value
-	/// </summary>
-	/// <returns>Last frame time value</returns>
-	long Ppu::getPreviousFrameTime() {
-		return prevFrameTime;
-	}
-
-	/// <summary>
-	/// Initial frame group time stamp
-	/// </summary>
-	/// <returns>Initial frame group time</returns>
-	long Ppu::getInitialTimer() {
-		return  initTimer;
-	}
-
-	/// <summary>
-	/// Defines the initial frame group time stamp
-	/// </summary>
-	/// <param name="val">Target frame group stamp</param>
-	void Ppu::setInitialTimer(bit32 val) {
-		initTimer = val;
-	}
-
-	/// <summary>
-	/// Updates the Frame time to the current tick value
-	/// </summary>
-	void Ppu::updateFrameTime() {
-		prevFrameTime = static_cast<long>(emulCtrl->getCpu()->getTicks());
-	}
-
-	/// <summary>
-	/// Gets the current frameCount value
-	/// </summary>
-	/// <returns>Frame count value</returns>
-	long Ppu::getFrameCount() {
-		return frameCounter;
-	}
-
-	/// <summary>
-	/// Resets the internal frame counter
-	/// </summary>
-	void Ppu::resetFrameCount() {
-		frameCounter = 0;
-	}
-
-	/// <summary>
-	/// Add a defined amount of frames to the counter
-	/// </summary>
-	/// <param name="val">Increment amount</param>
-	void Ppu::addFrameCount(bit8 val) {
-		frameCounter += val;
-	}
-
 	/// <summary>
 	/// Defines the video buffer value on a defined position
 	/// </summary>
@@ -377,4 +336,171 @@ namespace TheBoy {
 	/// </summary>
 	/// <returns>Current window line value</returns>
 	bit8 Ppu::getWindowLine() { return windowL;  }
+
+	/// <summary>
+	/// Defines the fixed frame skip, the amount of frames skipped after each drawn frame
+	/// </summary>
+	/// <param name="frames">Skipped frames after each drawn frame</param>
+	void Ppu::setFrameSkip(bit8 frames) { frameSkip.store(frames, std::memory_order_relaxed); }
+
+	/// <summary>
+	/// Gets the defined fixed frame skip value
+	/// </summary>
+	/// <returns>Skipped frames after each drawn frame</returns>
+	bit8 Ppu::getFrameSkip() { return frameSkip.load(std::memory_order_relaxed); }
+
+	/// <summary>
+	/// Enables or disables the automatic frame skip, used when the emulation falls behind real time
+	/// </summary>
+	/// <param name="enabled">Automatic frame skip state</param>
+	void Ppu::setAutoFrameSkip(bool enabled) { autoFrameSkip.store(enabled, std::memory_order_relaxed); }
+
+	/// <summary>
+	/// Gets if the automatic frame skip is enabled
+	/// </summary>
+	/// <returns>Automatic frame skip state</returns>
+	bool Ppu::getAutoFrameSkip() { return autoFrameSkip.load(std::memory_order_relaxed); }
+
+	/// <summary>
+	/// Marks if the last completed frame took longer than the target frame time
+	/// </summary>
+	/// <param name="late">Frame was late</param>
+	void Ppu::setFrameLate(bool late) { frameLate = late; }
+
+	/// <summary>
+	/// Evaluates if the starting frame should be drawn or only timed
+	/// </summary>
+	void Ppu::beginFrame() {
+		// Fixed skip draws one frame and skips the next frameSkip ones
+		bool fixedSkip = skippedCount < frameSkip.load(std::memory_order_relaxed);
+		// Automatic skip only kicks in while late, and never hides more than MaxAutoSkip frames in a row
+		bool lateSkip = autoFrameSkip.load(std::memory_order_relaxed) && frameLate && skippedCount < MaxAutoSkip;
+
+		skipFrame = fixedSkip || lateSkip;
+		skippedCount = skipFrame ? skippedCount + 1 : 0;
+	}
+
+	/// <summary>
+	/// Gets if the current frame is being skipped, only timing and interrupts are emulated
+	/// </summary>
+	/// <returns>Current frame is skipped</returns>
+	bool Ppu::isFrameSkipped() { return skipFrame; }
+
+	/// <summary>
+	/// Enables or disables the VRam snapshot publishing, only needed while a viewer is visible
+	/// </summary>
+	/// <param name="enabled">Publishing state</param>
+	void Ppu::setVRamSnapshotEnabled(bool enabled) {
+		snapshotEnabled.store(enabled, std::memory_order_relaxed);
+	}
+
+	/// <summary>
+	/// Publishes the current VRam/OAM state, called by the emulation thread on VBlank
+	/// </summary>
+	void Ppu::publishVRamSnapshot() {
+		if (!snapshotEnabled.load(std::memory_order_relaxed)) {
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock(snapshotLock);
+		memcpy(snapshot->vRam, vRam, sizeof(snapshot->vRam));
+		memcpy(snapshot->oam, oam_ram, sizeof(snapshot->oam));
+		snapshot->lcdc = emulCtrl->getLcd()->getLcdRegistors()->lcdc;
+
+		// Accumulate, the viewer may skip some published frames
+		for (size_t i = 0; i < sizeof(pendingTiles); i++) { snapshot->dirtyTiles[i] |= pendingTiles[i]; }
+		for (size_t i = 0; i < sizeof(pendingMap); i++) { snapshot->dirtyMap[i] |= pendingMap[i]; }
+		memset(pendingTiles, 0, sizeof(pendingTiles));
+		memset(pendingMap, 0, sizeof(pendingMap));
+
+		snapshot->frame = cFrame;
+	}
+
+	/// <summary>
+	/// Copies the last published snapshot and clears its dirty sets
+	/// </summary>
+	/// <param name="out">Target snapshot copy</param>
+	/// <param name="lastFrame">Last frame taken by the caller</param>
+	/// <returns>If a newer snapshot was available</returns>
+	bool Ppu::takeVRamSnapshot(VRamSnapshot* out, bit32 lastFrame) {
+		std::lock_guard<std::mutex> lock(snapshotLock);
+		if (snapshot->frame == lastFrame) {
+			return false;
+		}
+
+		memcpy(out, snapshot, sizeof(VRamSnapshot));
+		memset(snapshot->dirtyTiles, 0, sizeof(snapshot->dirtyTiles));
+		memset(snapshot->dirtyMap, 0, sizeof(snapshot->dirtyMap));
+		return true;
+	}
+
+
+	/// <summary>
+	/// Copies the video memory, pipeline and line state to the machine state
+	/// </summary>
+	/// <param name="st">Target state</param>
+	void Ppu::saveState(MachineState* st) {
+		PpuState& s = st->ppu;
+		memcpy(s.vRam, vRam, sizeof(s.vRam));
+		memcpy(s.oam, oam_ram, sizeof(s.oam));
+		s.fifo = *fifo;
+
+		// The line sprite list links are pointers into lSpriteData, saved as indexes
+		auto spriteIndex = [this](const OamLineElement* e) {
+			return e ? static_cast<bit8>(e - lSpriteData) : PpuState::NoSprite;
+		};
+		for (int i = 0; i < 10; i++) {
+			s.lineSprites[i] = lSpriteData[i].elm;
+			s.lineSpriteNext[i] = spriteIndex(lSpriteData[i].next);
+		}
+		s.lineSpriteHead = spriteIndex(lSprites);
+		s.lineSpriteCount = lineSpriteCount;
+
+		memcpy(s.fetchedEntries, fetchedEntries, sizeof(s.fetchedEntries));
+		s.fetchedEntryCount = fetchedEntryCounter;
+
+		s.frame = cFrame;
+		s.lineTicks = cLineTicks;
+		s.windowLine = windowL;
+		s.skipFrame = skipFrame;
+		s.skippedCount = skippedCount;
+		memcpy(s.buffer, buffer, sizeof(s.buffer));
+	}
+
+
+	/// <summary>
+	/// Restores the video memory, pipeline and line state from a machine state
+	/// </summary>
+	/// <param name="st">Source state</param>
+	void Ppu::loadState(const MachineState* st) {
+		const PpuState& s = st->ppu;
+		memcpy(vRam, s.vRam, sizeof(s.vRam));
+		memcpy(oam_ram, s.oam, sizeof(s.oam));
+		*fifo = s.fifo;
+
+		auto spritePointer = [this](bit8 id) {
+			return id < 10 ? &lSpriteData[id] : static_cast<OamLineElement*>(NULL);
+		};
+		for (int i = 0; i < 10; i++) {
+			lSpriteData[i].elm = s.lineSprites[i];
+			lSpriteData[i].next = spritePointer(s.lineSpriteNext[i]);
+		}
+		lSprites = spritePointer(s.lineSpriteHead);
+		lineSpriteCount = s.lineSpriteCount;
+
+		memcpy(fetchedEntries, s.fetchedEntries, sizeof(s.fetchedEntries));
+		fetchedEntryCounter = s.fetchedEntryCount;
+
+		cFrame = s.frame;
+		cLineTicks = s.lineTicks;
+		windowL = s.windowLine;
+		skipFrame = s.skipFrame;
+		skippedCount = s.skippedCount;
+		memcpy(buffer, s.buffer, sizeof(s.buffer));
+
+		// Every tile and map entry may differ from what the viewers hold
+		memset(pendingTiles, 0xFF, sizeof(pendingTiles));
+		memset(pendingMap, 0xFF, sizeof(pendingMap));
+	}
+
 } // namespace TheBoy
@@ -5,8 +5,11 @@
 #include "ppu_states.h"
 #include "FIFOData.h"
 #include "PixelPipeline.h"
+#include <atomic>
+#include <mutex>
 
 namespace TheBoy {
+	struct MachineState;
 
 	/**
 	 * @brief Defined struct using the 
@@ -34,6 +37,41 @@ namespace TheBoy {
 		OamLineElement* next = NULL;
 	}OamLineElement;
 
+	/// <summary>
+	/// Consistent copy of the video memory, published by the emulation thread at VBlank
+	/// Used by the debug viewers so they never read the live VRam
+	/// </summary>
+	typedef struct VRamSnapshot {
+		/// <summary>
+		/// Total tiles on the tile data area ($8000-$97FF)
+		/// </summary>
+		static const int TileCount = 384;
+
+		/// <summary>
+		/// Total entries on both tile maps ($9800-$9FFF)
+		/// </summary>
+		static const int MapEntries = 0x800;
+
+		bit8 vRam[0x2000];
+		bit8 oam[0xA0];
+		bit8 lcdc;
+
+		/// <summary>
+		/// Tiles written since the last snapshot was taken, one bit per tile
+		/// </summary>
+		bit8 dirtyTiles[TileCount / 8];
+
+		/// <summary>
+		/// Tile map entries written since the last snapshot was taken, one bit per entry
+		/// </summary>
+		bit8 dirtyMap[MapEntries / 8];
+
+		/// <summary>
+		/// Published frame number
+		/// </summary>
+		bit32 frame;
+	} VRamSnapshot;
+
 	class Ppu {	
 		/*
 		VRAM Sprite Attribute Table (OAM)
@@ -174,56 +212,6 @@ namespace TheBoy {
 		void incrementCurrentFrame();
 
 
-		/// <summary>
-		/// Gets the defined target frame Time
-		/// </summary>
-		/// <returns>Defined Frame time value</returns>
-		bit32 getTargetFrameTime();
-
-
-		/// <summary>
-		/// Gets the last frame time value
-		/// </summary>
-		/// <returns>Last frame time value</returns>
-		long getPreviousFrameTime();
-
-
-		/// <summary>
-		/// Initial frame group time stamp
-		/// </summary>
-		/// <returns>Initial frame group time</returns>
-		long getInitialTimer();
-
-		/// <summary>
-		/// Defines the initial frame group time stamp
-		/// </summary>
-		/// <param name="val">Target frame group stamp</param>
-		void setInitialTimer(bit32 val);
-
-
-		/// <summary>
-		/// Updates the Frame time to the current tick value
-		/// </summary>
-		void updateFrameTime();
-
-		/// <summary>
-		/// Gets the current frameCount value
-		/// </summary>
-		/// <returns>Frame count value</returns>
-		long getFrameCount();
-		
-		/// <summary>
-		/// Resets the internal frame counter
-		/// </summary>
-		void resetFrameCount();
-
-		/// <summary>
-		/// Add a defined amount of frames to the counter
-		/// </summary>
-		/// <param name="val">Increment amount</param>
-		void addFrameCount(bit8 val);
-
-
 		/// <summary>
 		/// Defines the video buffer value on a defined position
 		/// </summary>
@@ -355,6 +343,91 @@ namespace TheBoy {
 		/// <returns>Current window line value</returns>
 		bit8 getWindowLine();
 
+
+		/// <summary>
+		/// Defines the fixed frame skip, the amount of frames skipped after each drawn frame
+		/// Ex: 3 will only draw every 4th frame
+		/// </summary>
+		/// <param name="frames">Skipped frames after each drawn frame</param>
+		void setFrameSkip(bit8 frames);
+
+
+		/// <summary>
+		/// Gets the defined fixed frame skip value
+		/// </summary>
+		/// <returns>Skipped frames after each drawn frame</returns>
+		bit8 getFrameSkip();
+
+
+		/// <summary>
+		/// Enables or disables the automatic frame skip, used when the emulation falls behind real time
+		/// </summary>
+		/// <param name="enabled">Automatic frame skip state</param>
+		void setAutoFrameSkip(bool enabled);
+
+
+		/// <summary>
+		/// Gets if the automatic frame skip is enabled
+		/// </summary>
+		/// <returns>Automatic frame skip state</returns>
+		bool getAutoFrameSkip();
+
+
+		/// <summary>
+		/// Marks if the last completed frame took longer than the target frame time
+		/// </summary>
+		/// <param name="late">Frame was late</param>
+		void setFrameLate(bool late);
+
+
+		/// <summary>
+		/// Evaluates if the starting frame should be drawn or only timed
+		/// </summary>
+		void beginFrame();
+
+
+		/// <summary>
+		/// Gets if the current frame is being skipped, only timing and interrupts are emulated
+		/// </summary>
+		/// <returns>Current frame is skipped</returns>
+		bool isFrameSkipped();
+
+
+		/// <summary>
+		/// Enables or disables the VRam snapshot publishing, only needed while a viewer is visible
+		/// </summary>
+		/// <param name="enabled">Publishing state</param>
+		void setVRamSnapshotEnabled(bool enabled);
+
+
+		/// <summary>
+		/// Publishes the current VRam/OAM state, called by the emulation thread on VBlank
+		/// </summary>
+		void publishVRamSnapshot();
+
+
+		/// <summary>
+		/// Copies the last published snapshot and clears its dirty sets
+		/// </summary>
+		/// <param name="out">Target snapshot copy</param>
+		/// <param name="lastFrame">Last frame taken by the caller</param>
+		/// <returns>If a newer snapshot was available</returns>
+		bool takeVRamSnapshot(VRamSnapshot* out, bit32 lastFrame);
+
+		/// <summary>
+		/// Copies the video memory, pipeline and line state to the machine state
+		/// </summary>
+		/// <param name="st">Target state</param>
+		void saveState(MachineState* st);
+
+
+		/// <summary>
+		/// Restores the video memory, pipeline and line state from a machine state
+		/// </summary>
+		/// <param name="st">Source state</param>
+		void loadState(const MachineState* st);
+
+
 	private:
 		/**
 		 * @brief Pointer to the target emulator controller
@@ -429,33 +502,75 @@ namespace TheBoy {
 
 
 		/// <summary>
-		/// Target Frame time, default is the 60 frames per second in ms
-		/// Looking for a 1000 ms total divided by the frame target
+		/// Current window line draw
 		/// </summary>
-		bit32 targetFrameTime = 1000 / 60;
+		bit8 windowL;
+
 
 		/// <summary>
-		/// Current window line draw
+		/// Maximum consecutive frames skipped by the automatic frame skip
 		/// </summary>
-		bit8 windowL;
+		static const bit8 MaxAutoSkip = 4;
+
+
+		/// <summary>
+		/// Fixed frame skip value, frames skipped after each drawn frame. Set from the view thread
+		/// </summary>
+		std::atomic<bit8> frameSkip{ 0 };
+
+
+		/// <summary>
+		/// Marks if the automatic frame skip is enabled. Set from the view thread
+		/// </summary>
+		std::atomic<bool> autoFrameSkip{ false };
+
+
+		/// <summary>
+		/// Counts the frames skipped since the last drawn frame
+		/// </summary>
+		bit8 skippedCount = 0;
+
+
+		/// <summary>
+		/// Marks if the last completed frame was late
+		/// </summary>
+		bool frameLate = false;
+
+
+		/// <summary>
+		/// Marks if the current frame is skipped
+		/// </summary>
+		bool skipFrame = false;
+
+
+		/// <summary>
+		/// Marks if a viewer is waiting for VRam snapshots
+		/// </summary>
+		std::atomic<bool> snapshotEnabled{ false };
+
+
+		/// <summary>
+		/// Guards the published snapshot
+		/// </summary>
+		std::mutex snapshotLock;
 
 
 		/// <summary>
-		/// Holds the previous frame time stamp
+		/// Last published snapshot
 		/// </summary>
-		long prevFrameTime = 0;
+		VRamSnapshot* snapshot;
 
 
 		/// <summary>
-		/// Holds the initial frame time stamp
+		/// Tiles written since the last publish, owned by the emulation thread
 		/// </summary>
-		long initTimer = 0;
+		bit8 pendingTiles[VRamSnapshot::TileCount / 8];
 
 
 		/// <summary>
-		/// Holds the total frames on the current second
+		/// Tile map entries written since the last publish, owned by the emulation thread
 		/// </summary>
-		long frameCounter = 0;
+		bit8 pendingMap[VRamSnapshot::MapEntries / 8];
 	};
 } // namespace TheBoy
 #endif
\ No newline at end of file
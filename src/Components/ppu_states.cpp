@@ -55,6 +55,9 @@ namespace TheBoy {
 					ctrl->getLcd()->setLCDSMode(Lcd::LCDMODE::OAM);
 					ctrl->getLcd()->resetLyValue();
 					ctrl->getPpu()->resetWindowLine();
+
+					// New frame starting, decide if the pixels should be drawn
+					ctrl->getPpu()->beginFrame();
 				}
 
 				ctrl->getPpu()->resetLineTicks();
@@ -78,34 +81,7 @@ namespace TheBoy {
 						ctrl->getCpu()->requestInterrupt(InterruptFuncs::InterruptType::INTR_STAT);
 					}
 					ctrl->getPpu()->incrementCurrentFrame();
-
-					// Fps Counting
-					bit32 currTick = ctrl->getCpu()->getTicks();
-					bit32 frameTime = currTick - ctrl->getPpu()->getPreviousFrameTime();
-
-					if (frameTime < ctrl->getPpu()->getTargetFrameTime()) {
-						ctrl->getCpu()->sleepCpu(ctrl->getPpu()->getTargetFrameTime() - frameTime);
-					}
-
-					if (currTick - ctrl->getPpu()->getInitialTimer() >= 1000) {
-						char* msgBuffer(new char[64] {});
-						sprintf_s(msgBuffer, 64,
-							"-> Ppu Frames: %d", ctrl->getPpu()->getFrameCount());
-
-						ctrl->getView()->setPpuFrameCount(msgBuffer);
-						delete[] msgBuffer;
-
-						ctrl->getPpu()->setInitialTimer(currTick);
-						ctrl->getPpu()->resetFrameCount();
-
-						// 
-						if (ctrl->getCartridge()->needSave()) {
-							ctrl->getCartridge()->batterySave();
-						}
-					}
-
-					ctrl->getPpu()->addFrameCount(1);
-					ctrl->getPpu()->updateFrameTime();
+					ctrl->getPpu()->publishVRamSnapshot();
 				}
 				else {
 					ctrl->getLcd()->setLCDSMode(Lcd::LCDMODE::OAM);
@@ -1,5 +1,7 @@
 #include "ram.h"
+#include "machineState.h"
 #include "emulatorController.h"
+#include <cstring>
 
 
 namespace TheBoy {
@@ -37,10 +39,6 @@ namespace TheBoy {
 			fflush(stdout);
 			return 0x0;
 		}
-#if VERBOSE
-		printf("[RAM] ::: Reading Work RAM at  %.4X! -> %2.2X\n", (addr + 0xC000), workRam[addr]);
-		fflush(stdout);
-#endif
 
 		return workRam[addr];
 	}
@@ -54,10 +52,6 @@ namespace TheBoy {
 	void Ram::wWrite(bit16 addr, bit8 val) {
 		// Since this memory block start at $C000
 		addr -= 0xC000;
-#if VERBOSE
-		printf("[RAM] ::: Writing Work RAM at %.4X -> %2.2X!\n", (addr + 0xC000), val);
-		fflush(stdout);
-#endif
 
 		workRam[addr] = val;
 	}
@@ -71,10 +65,6 @@ namespace TheBoy {
 	bit8 Ram::hRead(bit16 addr) {
 		// Since this memory block start at $FF80
 		addr -= 0xFF80;
-#if VERBOSE
-		printf("[RAM] ::: Reading High RAM at  %.4X\n!", (addr + 0xC000));
-		fflush(stdout);
-#endif
 		return highRam[addr];
 	}
 
@@ -87,12 +77,28 @@ namespace TheBoy {
 	void Ram::hWrite(bit16 addr, bit8 val) {
 		// Since this memory block start at $FF80
 		addr -= 0xFF80;
-#if VERBOSE
-		printf("[RAM] ::: Writing High RAM at %.4X -> %2.2X!\n", (addr + 0xC000), val);
-		fflush(stdout);
-#endif
 		highRam[addr] = val;
 	}
 
+
+	/// <summary>
+	/// Copies the work and high ram to the machine state
+	/// </summary>
+	/// <param name="st">Target state</param>
+	void Ram::saveState(MachineState* st) {
+		memcpy(st->ram.workRam, workRam, sizeof(st->ram.workRam));
+		memcpy(st->ram.highRam, highRam, sizeof(st->ram.highRam));
+	}
+
+
+	/// <summary>
+	/// Restores the work and high ram from a machine state
+	/// </summary>
+	/// <param name="st">Source state</param>
+	void Ram::loadState(const MachineState* st) {
+		memcpy(workRam, st->ram.workRam, sizeof(st->ram.workRam));
+		memcpy(highRam, st->ram.highRam, sizeof(st->ram.highRam));
+	}
+
 } // namespace TheBoy
 
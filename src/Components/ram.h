@@ -4,6 +4,7 @@
 #include "common.h"
 
 namespace TheBoy {
+	struct MachineState;
 	class EmulatorController;
 
 	class Ram {
@@ -53,6 +54,20 @@ namespace TheBoy {
 		 */
 		void hWrite(bit16 addr, bit8 val);
 
+		/// <summary>
+		/// Copies the work and high ram to the machine state
+		/// </summary>
+		/// <param name="st">Target state</param>
+		void saveState(MachineState* st);
+
+
+		/// <summary>
+		/// Restores the work and high ram from a machine state
+		/// </summary>
+		/// <param name="st">Source state</param>
+		void loadState(const MachineState* st);
+
+
 	private:
 		/**
 		 * @brief work RAM Memory allocation
@@ -0,0 +1,80 @@
+#include "romCache.h"
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <unordered_map>
+
+namespace TheBoy {
+
+	/// <summary>
+	/// Loads a rom file
+	/// </summary>
+	/// <param name="path">Rom path</param>
+	/// <returns>If the rom was loaded</returns>
+	bool RomImage::open(const char* path) {
+		if (!file.open(path) || file.size() == 0) { return false; }
+
+		length = file.size();
+		if (length >= MinSize) {
+			bytes = file.data();
+			return true;
+		}
+
+		// Reads past a short file end would fault on the mapping
+		padded.assign(MinSize, 0xFF);
+		memcpy(padded.data(), file.data(), length);
+		file.close();
+		bytes = padded.data();
+		return true;
+	}
+
+
+	/// <summary>
+	/// Cached images by canonical path, guarded by the cache lock
+	/// </summary>
+	static std::mutex cacheLock;
+	static std::unordered_map<std::string, std::weak_ptr<const RomImage>> cache;
+
+
+	/// <summary>
+	/// Gets the image of a rom, mapping it when no instance holds it yet
+	/// </summary>
+	/// <param name="path">Rom path</param>
+	/// <returns>Shared image, null when the file could not be loaded</returns>
+	std::shared_ptr<const RomImage> RomCache::acquire(const char* path) {
+		std::error_code err;
+		std::string key = std::filesystem::weakly_canonical(path, err).string();
+		if (err) { key = path; }
+
+		std::lock_guard<std::mutex> lock(cacheLock);
+		std::shared_ptr<const RomImage> image = cache[key].lock();
+		if (image) { return image; }
+
+		std::shared_ptr<RomImage> loaded = std::make_shared<RomImage>();
+		if (!loaded->open(path)) {
+			cache.erase(key);
+			return nullptr;
+		}
+		cache[key] = loaded;
+
+		// Drops the entries of the released roms
+		for (auto it = cache.begin(); it != cache.end();) {
+			if (it->second.expired()) { it = cache.erase(it); }
+			else { ++it; }
+		}
+		return loaded;
+	}
+
+
+	/// <summary>
+	/// Gets the roms currently mapped
+	/// </summary>
+	size_t RomCache::count() {
+		std::lock_guard<std::mutex> lock(cacheLock);
+		size_t alive = 0;
+		for (const std::pair<const std::string, std::weak_ptr<const RomImage>>& entry : cache) {
+			alive += entry.second.expired() ? 0 : 1;
+		}
+		return alive;
+	}
+} // namespace TheBoy
@@ -0,0 +1,79 @@
+#pragma once
+#ifndef ROMCACHE_H
+#define ROMCACHE_H
+
+#include "common.h"
+#include "mappedFile.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace TheBoy {
+
+	/// <summary>
+	/// Read only rom image, mapped from its file and shared by every cartridge running it
+	/// </summary>
+	class RomImage {
+	public:
+		/// <summary>
+		/// Smallest image, the cartridge reads 0000-7FFF without banking, shorter files are copied and padded
+		/// </summary>
+		static const size_t MinSize = 0x8000;
+
+
+		/// <summary>
+		/// Loads a rom file
+		/// </summary>
+		/// <param name="path">Rom path</param>
+		/// <returns>If the rom was loaded</returns>
+		bool open(const char* path);
+
+
+		/// <summary>
+		/// Gets the rom bytes
+		/// </summary>
+		const bit8* data() const { return bytes; }
+
+
+		/// <summary>
+		/// Gets the rom size, the padding excluded
+		/// </summary>
+		size_t size() const { return length; }
+
+
+		/// <summary>
+		/// Gets if the image is a file mapping, false on the padded copies
+		/// </summary>
+		bool isMapped() const { return padded.empty(); }
+
+	private:
+		/// <summary>
+		/// File mapping, or the padded copy of a short rom
+		/// </summary>
+		MappedFile file;
+		std::vector<bit8> padded;
+		const bit8* bytes = nullptr;
+		size_t length = 0;
+	};
+
+
+	/// <summary>
+	/// Process wide rom cache, every instance of a rom shares one mapping
+	/// The cache only keeps weak references, the mapping is released with the last cartridge using it
+	/// </summary>
+	namespace RomCache {
+		/// <summary>
+		/// Gets the image of a rom, mapping it when no instance holds it yet
+		/// </summary>
+		/// <param name="path">Rom path</param>
+		/// <returns>Shared image, null when the file could not be loaded</returns>
+		std::shared_ptr<const RomImage> acquire(const char* path);
+
+
+		/// <summary>
+		/// Gets the roms currently mapped
+		/// </summary>
+		size_t count();
+	}
+} // namespace TheBoy
+#endif // !ROMCACHE_H
@@ -0,0 +1,272 @@
+#include "serialLink.h"
+#include <chrono>
+#include <iostream>
+
+namespace TheBoy {
+
+	/// <summary>
+	/// Serial link constructor, disconnected
+	/// </summary>
+	SerialLink::SerialLink() {
+		connected = false;
+		replyPending = false;
+		replyByte = 0xFF;
+		replyTicks = 0;
+		requestByte = 0xFF;
+		requestTicks = 0;
+
+		nextPublish = NoLimit;
+		announced = NoLimit;
+
+		sent = 0;
+		served = 0;
+		waitUs = 0;
+		horizonUs = 0;
+	}
+
+
+	/// <summary>
+	/// Serial link destructor
+	/// </summary>
+	SerialLink::~SerialLink() {
+	}
+
+
+	/// <summary>
+	/// Announces a transfer clocked by this side
+	/// </summary>
+	/// <param name="out">Byte shifted out</param>
+	/// <param name="endTicks">Emulated tick of the transfer end</param>
+	void SerialLink::start(bit8 out, bit64 endTicks) {
+		if (!isConnected()) { return; }
+
+		announced = endTicks;
+		send(LinkMessage{ LINK_MSG_TRANSFER, out, endTicks });
+	}
+
+
+	/// <summary>
+	/// Ends the announced transfer, blocks until the partner reaches its end tick and answers
+	/// </summary>
+	/// <param name="ticks">Current emulated tick</param>
+	/// <param name="line">Byte on this side line, answered to a partner transfer taken meanwhile</param>
+	/// <returns>Byte shifted in, 0xFF with no partner</returns>
+	bit8 SerialLink::finish(bit64 ticks, bit8 line) {
+		bit64 end = announced;
+		announced = NoLimit;
+		if (end == NoLimit) { return 0xFF; }
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		// The partner may be blocked on the horizon short of the end tick
+		publish(ticks);
+
+		bit8 in = 0xFF;
+		std::unique_lock<std::mutex> lock(stateLock);
+		while (true) {
+			bool woken = stateCond.wait_for(lock, std::chrono::milliseconds(TimeoutMs), [this, ticks, end] {
+				return (replyPending && replyTicks == end) || !connected ||
+					(requestPending.load(std::memory_order_relaxed) && requestTicks <= ticks);
+			});
+			if (!woken || !connected) { break; }
+
+			if (replyPending && replyTicks == end) {
+				in = replyByte;
+				replyPending = false;
+				break;
+			}
+
+			// Both sides clocked, each line carries its own byte
+			requestPending.store(false, std::memory_order_release);
+			served++;
+			lock.unlock();
+			reply(line);
+			lock.lock();
+		}
+		lock.unlock();
+
+		sent++;
+		waitUs += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+		return in;
+	}
+
+
+	/// <summary>
+	/// Takes the partner transfer once the emulation reaches its end tick, the caller must answer with reply
+	/// </summary>
+	/// <param name="ticks">Current emulated tick</param>
+	/// <param name="in">Byte shifted in</param>
+	/// <returns>If a transfer was taken</returns>
+	bool SerialLink::takeRequest(bit64 ticks, bit8* in) {
+		std::lock_guard<std::mutex> lock(stateLock);
+		if (!requestPending.load(std::memory_order_relaxed) || ticks < requestTicks) { return false; }
+
+		*in = requestByte;
+		requestPending.store(false, std::memory_order_release);
+		served++;
+		return true;
+	}
+
+
+	/// <summary>
+	/// Answers the taken partner transfer
+	/// </summary>
+	/// <param name="out">Byte shifted out, 0xFF when no transfer was armed</param>
+	void SerialLink::reply(bit8 out) {
+		bit64 end;
+		{
+			std::lock_guard<std::mutex> lock(stateLock);
+			end = requestTicks;
+		}
+		send(LinkMessage{ LINK_MSG_REPLY, out, end });
+	}
+
+
+	/// <summary>
+	/// Publishes the emulated time when due and waits while the horizon is reached
+	/// </summary>
+	/// <param name="ticks">Current emulated tick</param>
+	void SerialLink::sync(bit64 ticks) {
+		if (ticks >= nextPublish) { publish(ticks); }
+		if (ticks < horizon.load(std::memory_order_acquire)) { return; }
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		std::unique_lock<std::mutex> lock(stateLock);
+		// A partner transfer due now ends the wait, the partner is blocked until it is answered
+		stateCond.wait_for(lock, std::chrono::milliseconds(TimeoutMs), [this, ticks] {
+			return ticks < horizon.load(std::memory_order_relaxed) ||
+				(requestPending.load(std::memory_order_relaxed) && requestTicks <= ticks);
+		});
+		lock.unlock();
+		horizonUs += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+	}
+
+
+	/// <summary>
+	/// Gets if the partner is connected
+	/// </summary>
+	/// <returns>Connected state</returns>
+	bool SerialLink::isConnected() {
+		std::lock_guard<std::mutex> lock(stateLock);
+		return connected;
+	}
+
+
+	/// <summary>
+	/// Gets the link counters, emulation thread only
+	/// </summary>
+	/// <returns>Link stats</returns>
+	LinkStats SerialLink::getStats() {
+		LinkStats stats{};
+		stats.sent = sent;
+		stats.served = served;
+		stats.avgWaitUs = sent > 0 ? waitUs / sent : 0.0;
+		stats.horizonWaitMs = horizonUs / 1000.0;
+		return stats;
+	}
+
+
+	/// <summary>
+	/// Sends the emulated time
+	/// </summary>
+	/// <param name="ticks">Current emulated tick</param>
+	void SerialLink::publish(bit64 ticks) {
+		nextPublish = ticks + PublishTicks;
+		send(LinkMessage{ LINK_MSG_TIME, 0, ticks });
+	}
+
+
+	/// <summary>
+	/// Applies a partner message, called by the transport
+	/// </summary>
+	/// <param name="msg">Message</param>
+	void SerialLink::receive(const LinkMessage& msg) {
+		{
+			std::lock_guard<std::mutex> lock(stateLock);
+			switch (msg.type) {
+			case LINK_MSG_TRANSFER:
+				requestByte = msg.data;
+				requestTicks = msg.ticks;
+				requestPending.store(true, std::memory_order_release);
+				break;
+			case LINK_MSG_REPLY:
+				replyByte = msg.data;
+				replyTicks = msg.ticks;
+				replyPending = true;
+				break;
+			case LINK_MSG_TIME:
+				if (connected) { horizon.store(msg.ticks + Lookahead, std::memory_order_release); }
+				break;
+			case LINK_MSG_CLOSE:
+				connected = false;
+				horizon.store(NoLimit, std::memory_order_release);
+				break;
+			}
+		}
+		stateCond.notify_all();
+	}
+
+
+	/// <summary>
+	/// Marks the partner connected, or gone
+	/// </summary>
+	/// <param name="state">Connected state</param>
+	void SerialLink::setConnected(bool state) {
+		{
+			std::lock_guard<std::mutex> lock(stateLock);
+			connected = state;
+			// Both sides start on the tick 0
+			horizon.store(state ? Lookahead : NoLimit, std::memory_order_release);
+			if (state) { nextPublish = 0; }
+		}
+		stateCond.notify_all();
+	}
+
+
+	/// <summary>
+	/// Local link constructor, connected by createPair
+	/// </summary>
+	LocalLink::LocalLink() {
+		partner = nullptr;
+	}
+
+
+	/// <summary>
+	/// Local link destructor, disconnects the partner
+	/// </summary>
+	LocalLink::~LocalLink() {
+		if (!pairLock) { return; }
+
+		std::lock_guard<std::mutex> lock(*pairLock);
+		if (partner) {
+			partner->receive(LinkMessage{ LINK_MSG_CLOSE, 0, 0 });
+			partner->partner = nullptr;
+		}
+	}
+
+
+	/// <summary>
+	/// Creates both connected ends of a cable
+	/// </summary>
+	/// <returns>The two ends</returns>
+	std::pair<std::unique_ptr<SerialLink>, std::unique_ptr<SerialLink>> LocalLink::createPair() {
+		std::unique_ptr<LocalLink> a(new LocalLink());
+		std::unique_ptr<LocalLink> b(new LocalLink());
+
+		a->pairLock = b->pairLock = std::make_shared<std::mutex>();
+		a->partner = b.get();
+		b->partner = a.get();
+		a->setConnected(true);
+		b->setConnected(true);
+		return std::make_pair(std::unique_ptr<SerialLink>(std::move(a)), std::unique_ptr<SerialLink>(std::move(b)));
+	}
+
+
+	/// <summary>
+	/// Sends a message to the partner
+	/// </summary>
+	/// <param name="msg">Message</param>
+	void LocalLink::send(const LinkMessage& msg) {
+		std::lock_guard<std::mutex> lock(*pairLock);
+		if (partner) { partner->receive(msg); }
+	}
+} // namespace TheBoy
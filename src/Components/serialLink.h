@@ -0,0 +1,270 @@
+#pragma once
+#ifndef SERIALLINK_H
+#define SERIALLINK_H
+
+#include "common.h"
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+namespace TheBoy {
+
+	/// <summary>
+	/// Link cable counters
+	/// </summary>
+	typedef struct LinkStats {
+		/// <summary>
+		/// Transfers clocked by this side, and clocked by the partner
+		/// </summary>
+		bit64 sent;
+		bit64 served;
+
+		/// <summary>
+		/// Average emulation time spent waiting for the partner, on the transfer ends and on the time horizon
+		/// </summary>
+		double avgWaitUs;
+		double horizonWaitMs;
+	} LinkStats;
+
+
+	/// <summary>
+	/// Link cable between two emulated machines, kept in lockstep without syncing every cycle
+	/// A transfer can not end sooner than Lookahead ticks after its start, so each side announces its transfers
+	/// on the start and publishes its emulated time every PublishTicks. A side never runs past the partner time
+	/// plus Lookahead: a partner transfer is always known before its end tick is reached, and it is answered
+	/// exactly on that tick (on the first instruction boundary past it). The clocking side waits on the end tick
+	/// for the answer only.
+	/// Both machines count the ticks from their load, they must start together.
+	/// Transports implement send, and feed the partner messages to receive from any thread
+	/// </summary>
+	class SerialLink {
+	public:
+		/// <summary>
+		/// Shortest transfer, 8 bits on the 8192 Hz clock, the largest lead of a side over the partner
+		/// </summary>
+		static const bit64 Lookahead = 8 * 512;
+
+
+		/// <summary>
+		/// Emulated time between two time messages
+		/// </summary>
+		static const bit64 PublishTicks = Lookahead / 4;
+
+
+		/// <summary>
+		/// Wall time a transfer waits for a silent partner before it reads the line high
+		/// </summary>
+		static constexpr int TimeoutMs = 1000;
+
+
+		/// <summary>
+		/// Serial link destructor
+		/// </summary>
+		virtual ~SerialLink();
+
+
+		/// <summary>
+		/// Announces a transfer clocked by this side
+		/// </summary>
+		/// <param name="out">Byte shifted out</param>
+		/// <param name="endTicks">Emulated tick of the transfer end</param>
+		void start(bit8 out, bit64 endTicks);
+
+
+		/// <summary>
+		/// Ends the announced transfer, blocks until the partner reaches its end tick and answers
+		/// </summary>
+		/// <param name="ticks">Current emulated tick</param>
+		/// <param name="line">Byte on this side line, answered to a partner transfer taken meanwhile</param>
+		/// <returns>Byte shifted in, 0xFF with no partner</returns>
+		bit8 finish(bit64 ticks, bit8 line);
+
+
+		/// <summary>
+		/// Gets if the link needs the emulation thread, checked every instruction:
+		/// a partner transfer, a time message or the horizon are due
+		/// </summary>
+		/// <param name="ticks">Current emulated tick</param>
+		/// <returns>Pending work state</returns>
+		bool pending(bit64 ticks) {
+			return requestPending.load(std::memory_order_acquire) || ticks >= nextPublish ||
+				ticks >= horizon.load(std::memory_order_acquire);
+		}
+
+
+		/// <summary>
+		/// Takes the partner transfer once the emulation reaches its end tick, the caller must answer with reply
+		/// </summary>
+		/// <param name="ticks">Current emulated tick</param>
+		/// <param name="in">Byte shifted in</param>
+		/// <returns>If a transfer was taken</returns>
+		bool takeRequest(bit64 ticks, bit8* in);
+
+
+		/// <summary>
+		/// Answers the taken partner transfer
+		/// </summary>
+		/// <param name="out">Byte shifted out, 0xFF when no transfer was armed</param>
+		void reply(bit8 out);
+
+
+		/// <summary>
+		/// Publishes the emulated time when due and waits while the horizon is reached
+		/// </summary>
+		/// <param name="ticks">Current emulated tick</param>
+		void sync(bit64 ticks);
+
+
+		/// <summary>
+		/// Gets if the partner is connected
+		/// </summary>
+		/// <returns>Connected state</returns>
+		bool isConnected();
+
+
+		/// <summary>
+		/// Gets the link counters, emulation thread only
+		/// </summary>
+		/// <returns>Link stats</returns>
+		LinkStats getStats();
+
+	protected:
+		/// <summary>
+		/// Messages between the sides
+		/// </summary>
+		typedef enum LINK_MSG {
+			LINK_MSG_TRANSFER,
+			LINK_MSG_REPLY,
+			LINK_MSG_TIME,
+			LINK_MSG_CLOSE
+		} LINK_MSG;
+
+
+		/// <summary>
+		/// Link message, the tick is the transfer end on transfers and replies, the emulated time on time messages
+		/// </summary>
+		typedef struct LinkMessage {
+			bit8 type;
+			bit8 data;
+			bit64 ticks;
+		} LinkMessage;
+
+
+		/// <summary>
+		/// Serial link constructor, disconnected
+		/// </summary>
+		SerialLink();
+
+
+		/// <summary>
+		/// Sends a message to the partner
+		/// </summary>
+		/// <param name="msg">Message</param>
+		virtual void send(const LinkMessage& msg) = 0;
+
+
+		/// <summary>
+		/// Applies a partner message, called by the transport
+		/// </summary>
+		/// <param name="msg">Message</param>
+		void receive(const LinkMessage& msg);
+
+
+		/// <summary>
+		/// Marks the partner connected, or gone
+		/// </summary>
+		/// <param name="state">Connected state</param>
+		void setConnected(bool state);
+
+	private:
+		/// <summary>
+		/// Tick value of no limit
+		/// </summary>
+		static const bit64 NoLimit = ~0ULL;
+
+
+		/// <summary>
+		/// Partner state, guarded by stateLock
+		/// </summary>
+		std::mutex stateLock;
+		std::condition_variable stateCond;
+		bool connected;
+		bool replyPending;
+		bit8 replyByte;
+		bit64 replyTicks;
+		bit8 requestByte;
+		bit64 requestTicks;
+
+
+		/// <summary>
+		/// Partner transfer flag and the partner time plus Lookahead, read without the lock every instruction
+		/// </summary>
+		std::atomic<bool> requestPending{ false };
+		std::atomic<bit64> horizon{ NoLimit };
+
+
+		/// <summary>
+		/// Emulation thread state, the next time message and the announced transfer end
+		/// </summary>
+		bit64 nextPublish;
+		bit64 announced;
+
+
+		/// <summary>
+		/// Counters
+		/// </summary>
+		bit64 sent;
+		bit64 served;
+		double waitUs;
+		double horizonUs;
+
+
+		/// <summary>
+		/// Sends the emulated time
+		/// </summary>
+		/// <param name="ticks">Current emulated tick</param>
+		void publish(bit64 ticks);
+	};
+
+
+	/// <summary>
+	/// In process link, two cores of the same process on their own threads
+	/// </summary>
+	class LocalLink : public SerialLink {
+	public:
+		/// <summary>
+		/// Creates both connected ends of a cable
+		/// </summary>
+		/// <returns>The two ends</returns>
+		static std::pair<std::unique_ptr<SerialLink>, std::unique_ptr<SerialLink>> createPair();
+
+
+		/// <summary>
+		/// Local link destructor, disconnects the partner
+		/// </summary>
+		~LocalLink();
+
+	protected:
+		/// <summary>
+		/// Sends a message to the partner
+		/// </summary>
+		/// <param name="msg">Message</param>
+		void send(const LinkMessage& msg) override;
+
+	private:
+		/// <summary>
+		/// Other end, guarded by the lock shared by both ends
+		/// </summary>
+		LocalLink* partner;
+		std::shared_ptr<std::mutex> pairLock;
+
+
+		/// <summary>
+		/// Local link constructor, connected by createPair
+		/// </summary>
+		LocalLink();
+	};
+} // namespace TheBoy
+#endif // !SERIALLINK_H
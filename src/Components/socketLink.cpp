@@ -0,0 +1,165 @@
+#include "socketLink.h"
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace TheBoy {
+
+#ifndef _WIN32
+	/// <summary>
+	/// Fills a unix socket address
+	/// </summary>
+	/// <returns>If the path fits the address</returns>
+	static bool socketAddress(const char* path, sockaddr_un* addr) {
+		memset(addr, 0, sizeof(sockaddr_un));
+		addr->sun_family = AF_UNIX;
+		if (strlen(path) >= sizeof(addr->sun_path)) {
+			std::cout << "[LINK] ::: Socket path too long: " << path << std::endl;
+			return false;
+		}
+		strcpy(addr->sun_path, path);
+		return true;
+	}
+#endif
+
+
+	/// <summary>
+	/// Creates the socket and waits for the partner to join
+	/// </summary>
+	/// <param name="path">Socket path, replaced if it exists</param>
+	/// <returns>Connected link, null on failure</returns>
+	std::unique_ptr<SerialLink> SocketLink::host(const char* path) {
+#ifdef _WIN32
+		std::cout << "[LINK] ::: Unix socket links are not available on this platform" << std::endl;
+		return nullptr;
+#else
+		sockaddr_un addr;
+		if (!socketAddress(path, &addr)) { return nullptr; }
+
+		int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+		unlink(path);
+		if (listener < 0 || bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(listener, 1) != 0) {
+			std::cout << "[LINK] ::: Failed to host " << path << ": " << strerror(errno) << std::endl;
+			if (listener >= 0) { close(listener); }
+			return nullptr;
+		}
+
+		std::cout << "[LINK] ::: Waiting for the partner on " << path << std::endl;
+		int fd = accept(listener, nullptr, nullptr);
+		close(listener);
+		unlink(path);
+		if (fd < 0) {
+			std::cout << "[LINK] ::: Failed to accept the partner: " << strerror(errno) << std::endl;
+			return nullptr;
+		}
+
+		std::cout << "[LINK] ::: Partner joined" << std::endl;
+		return std::unique_ptr<SerialLink>(new SocketLink(fd));
+#endif
+	}
+
+
+	/// <summary>
+	/// Joins a hosted socket
+	/// </summary>
+	/// <param name="path">Socket path</param>
+	/// <returns>Connected link, null on failure</returns>
+	std::unique_ptr<SerialLink> SocketLink::join(const char* path) {
+#ifdef _WIN32
+		std::cout << "[LINK] ::: Unix socket links are not available on this platform" << std::endl;
+		return nullptr;
+#else
+		sockaddr_un addr;
+		if (!socketAddress(path, &addr)) { return nullptr; }
+
+		int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+			std::cout << "[LINK] ::: Failed to join " << path << ": " << strerror(errno) << std::endl;
+			if (fd >= 0) { close(fd); }
+			return nullptr;
+		}
+
+		std::cout << "[LINK] ::: Joined " << path << std::endl;
+		return std::unique_ptr<SerialLink>(new SocketLink(fd));
+#endif
+	}
+
+
+	/// <summary>
+	/// Socket link constructor, starts the reader
+	/// </summary>
+	/// <param name="fd">Connected socket</param>
+	SocketLink::SocketLink(int fd) {
+		this->fd = fd;
+		setConnected(true);
+		reader = std::thread(&SocketLink::readLoop, this);
+	}
+
+
+	/// <summary>
+	/// Socket link destructor, closes the socket and stops the reader
+	/// </summary>
+	SocketLink::~SocketLink() {
+#ifndef _WIN32
+		send(LinkMessage{ LINK_MSG_CLOSE, 0, 0 });
+		// Wakes the reader, the descriptor is only closed once it is done
+		shutdown(fd, SHUT_RDWR);
+		if (reader.joinable()) { reader.join(); }
+		close(fd);
+#endif
+	}
+
+
+	/// <summary>
+	/// Sends a message to the partner
+	/// </summary>
+	/// <param name="msg">Message</param>
+	void SocketLink::send(const LinkMessage& msg) {
+#ifndef _WIN32
+		bit8 record[RecordSize];
+		record[0] = msg.type;
+		record[1] = msg.data;
+		for (int i = 0; i < 8; i++) { record[2 + i] = static_cast<bit8>(msg.ticks >> (i * 8)); }
+
+		std::lock_guard<std::mutex> lock(sendLock);
+		size_t done = 0;
+		while (done < sizeof(record)) {
+			ssize_t res = ::send(fd, record + done, sizeof(record) - done, MSG_NOSIGNAL);
+			if (res <= 0) {
+				setConnected(false);
+				return;
+			}
+			done += static_cast<size_t>(res);
+		}
+#endif
+	}
+
+
+	/// <summary>
+	/// Reader thread loop, the socket closing disconnects the link
+	/// </summary>
+	void SocketLink::readLoop() {
+#ifndef _WIN32
+		bit8 record[RecordSize];
+		size_t filled = 0;
+		while (true) {
+			ssize_t res = recv(fd, record + filled, sizeof(record) - filled, 0);
+			if (res <= 0) { break; }
+			filled += static_cast<size_t>(res);
+			if (filled < sizeof(record)) { continue; }
+			filled = 0;
+
+			LinkMessage msg{ record[0], record[1], 0 };
+			for (int i = 0; i < 8; i++) { msg.ticks |= static_cast<bit64>(record[2 + i]) << (i * 8); }
+			receive(msg);
+		}
+		setConnected(false);
+#endif
+	}
+} // namespace TheBoy
@@ -0,0 +1,84 @@
+#pragma once
+#ifndef SOCKETLINK_H
+#define SOCKETLINK_H
+
+#include "serialLink.h"
+#include <string>
+#include <thread>
+
+namespace TheBoy {
+
+	/// <summary>
+	/// Link cable between two processes over a local Unix socket
+	/// One process hosts the socket path and waits for the other to join, then both start emulating.
+	/// A reader thread feeds the partner messages to the link, each one a fixed 10 byte record
+	/// </summary>
+	class SocketLink : public SerialLink {
+	public:
+		/// <summary>
+		/// Creates the socket and waits for the partner to join
+		/// </summary>
+		/// <param name="path">Socket path, replaced if it exists</param>
+		/// <returns>Connected link, null on failure</returns>
+		static std::unique_ptr<SerialLink> host(const char* path);
+
+
+		/// <summary>
+		/// Joins a hosted socket
+		/// </summary>
+		/// <param name="path">Socket path</param>
+		/// <returns>Connected link, null on failure</returns>
+		static std::unique_ptr<SerialLink> join(const char* path);
+
+
+		/// <summary>
+		/// Socket link destructor, closes the socket and stops the reader
+		/// </summary>
+		~SocketLink();
+
+	protected:
+		/// <summary>
+		/// Sends a message to the partner
+		/// </summary>
+		/// <param name="msg">Message</param>
+		void send(const LinkMessage& msg) override;
+
+	private:
+		/// <summary>
+		/// Wire record size: type, data and the tick little endian
+		/// </summary>
+		static const int RecordSize = 10;
+
+
+		/// <summary>
+		/// Connected socket
+		/// </summary>
+		int fd;
+
+
+		/// <summary>
+		/// Serializes the writes of the emulation thread and the destructor
+		/// </summary>
+		std::mutex sendLock;
+
+
+		/// <summary>
+		/// Partner message reader
+		/// </summary>
+		std::thread reader;
+
+
+		/// <summary>
+		/// Socket link constructor, starts the reader
+		/// </summary>
+		/// <param name="fd">Connected socket</param>
+		SocketLink(int fd);
+
+
+		/// <summary>
+		/// Reader thread loop, the socket closing disconnects the link
+		/// </summary>
+		void readLoop();
+	};
+} // namespace TheBoy
+#endif // !SOCKETLINK_H
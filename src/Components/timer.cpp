@@ -1,4 +1,5 @@
 #include "timer.h"
+#include "machineState.h"
 #include "interrupt.h"
 
 namespace TheBoy {
@@ -35,8 +36,15 @@ namespace TheBoy {
 		tUpdate = (oldDiv & (1 << offMatch[(regs.TAC & 0b11)])) &&
 				(!(regs.DIV & (1 << offMatch[(regs.TAC & 0b11)])));
 
+#if PERFCOUNT
+		if (regs.TAC & (1 << 2)) { emulCtrl->getPerf()->timerTicks++; }
+#endif
+
 		// Bit  2   - Timer Enable
 		if(tUpdate && regs.TAC & (1 << 2)){
+#if PERFCOUNT
+			emulCtrl->getPerf()->timerIncrements++;
+#endif
 			regs.TIMA++;
 			if(regs.TIMA == 0xFF){
 				regs.TIMA = regs.TMA;
@@ -127,6 +135,29 @@ namespace TheBoy {
 	void Timer::setRegisterDIV(bit16 val) {
 		regs.DIV = val;
 	}
-	
-	
+
+
+	/// <summary>
+	/// Copies the timer registers to the machine state
+	/// </summary>
+	/// <param name="st">Target state</param>
+	void Timer::saveState(MachineState* st) {
+		st->timer.div = regs.DIV;
+		st->timer.tima = regs.TIMA;
+		st->timer.tma = regs.TMA;
+		st->timer.tac = regs.TAC;
+	}
+
+
+	/// <summary>
+	/// Restores the timer registers from a machine state
+	/// </summary>
+	/// <param name="st">Source state</param>
+	void Timer::loadState(const MachineState* st) {
+		regs.DIV = st->timer.div;
+		regs.TIMA = st->timer.tima;
+		regs.TMA = st->timer.tma;
+		regs.TAC = st->timer.tac;
+	}
+
 } // namespace TheBoy
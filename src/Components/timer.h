@@ -4,6 +4,8 @@
 #include "emulatorController.h"
 
 namespace TheBoy {
+	struct MachineState;
+
 	class Timer {
 	/*
 		Timer and Divider Registers
@@ -71,6 +73,20 @@ namespace TheBoy {
 	void setRegisterDIV(bit16 val);
 
 
+		/// <summary>
+		/// Copies the timer registers to the machine state
+		/// </summary>
+		/// <param name="st">Target state</param>
+		void saveState(MachineState* st);
+
+
+		/// <summary>
+		/// Restores the timer registers from a machine state
+		/// </summary>
+		/// <param name="st">Source state</param>
+		void loadState(const MachineState* st);
+
+
 	private:
 		/**
 		 * @brief Pointer to the target emulator controller
@@ -0,0 +1,162 @@
+#include "debugHud.h"
+#include "emulatorController.h"
+
+namespace TheBoy {
+
+	/// <summary>
+	/// Debug hud constructor
+	/// </summary>
+	/// <param name="ctrl">Target emulator controller</param>
+	/// <param name="font">Font used by the text elements</param>
+	DebugHud::DebugHud(EmulatorController* ctrl, std::shared_ptr<sf::Font> font) :
+		emulCtrl(ctrl), hudFont(font) {
+		enabled = true;
+		layoutDirty = true;
+		refreshPending = true;
+		bottom = 0.0f;
+		setRefreshRate(4);
+
+		for (int i = 0; i < LINE_COUNT; i++) {
+			texts[i].setFont(*hudFont.get());
+			texts[i].setCharacterSize(12);
+			pendingSet[i] = false;
+			applyLine(static_cast<HUDLINE>(i), " - ");
+		}
+
+		applyLine(TITLE, "|TheBoy - Game boy Emulator\n - - - - - - - - - - -\n");
+		applyLine(CART_HEADER, "|:: Cartrige Information");
+	}
+
+
+	/// <summary>
+	/// Enables or disables the hud, a disabled hud is not refreshed nor drawn
+	/// </summary>
+	/// <param name="state">New hud state</param>
+	void DebugHud::setEnabled(bool state) {
+		enabled = state;
+		layoutDirty = true;
+		// Show fresh values as soon as it is back
+		refreshPending = true;
+	}
+
+
+	/// <summary>
+	/// Gets if the hud is enabled
+	/// </summary>
+	/// <returns>Hud state</returns>
+	bool DebugHud::isEnabled() { return enabled; }
+
+
+	/// <summary>
+	/// Defines how many times per second the hud values are gathered
+	/// </summary>
+	/// <param name="hz">Refresh rate, 0 refreshes on every draw</param>
+	void DebugHud::setRefreshRate(bit16 hz) {
+		refreshInterval = hz == 0 ? sf::Time::Zero : sf::seconds(1.0f / hz);
+	}
+
+
+	/// <summary>
+	/// Defines a hud line text, can be called from any thread
+	/// The value is applied on the next refresh
+	/// </summary>
+	/// <param name="line">Target line</param>
+	/// <param name="inf">Line text</param>
+	void DebugHud::setLine(HUDLINE line, const char* inf) {
+		std::lock_guard<std::mutex> lock(pendingLock);
+		pending[line].assign(inf);
+		pendingSet[line] = true;
+	}
+
+
+	/// <summary>
+	/// Defines the hud top left position
+	/// </summary>
+	/// <param name="x">Left position</param>
+	/// <param name="y">Top position</param>
+	void DebugHud::setPosition(float x, float y) {
+		if (origin.x == x && origin.y == y) { return; }
+		origin = sf::Vector2f(x, y);
+		layoutDirty = true;
+	}
+
+
+	/// <summary>
+	/// Gets the bottom of the last hud line, top position when disabled
+	/// </summary>
+	/// <returns>Hud bottom position</returns>
+	float DebugHud::getBottom() {
+		if (!enabled) { return origin.y; }
+		if (layoutDirty) { layout(); }
+		return bottom;
+	}
+
+
+	/// <summary>
+	/// Refreshes the hud values if the refresh interval elapsed, called from the view thread
+	/// </summary>
+	void DebugHud::update() {
+		if (!enabled || (!refreshPending && refreshClock.getElapsedTime() < refreshInterval)) { return; }
+		refreshClock.restart();
+		refreshPending = false;
+
+		{
+			std::lock_guard<std::mutex> lock(pendingLock);
+			for (int i = 0; i < LINE_COUNT; i++) {
+				if (!pendingSet[i]) { continue; }
+				applyLine(static_cast<HUDLINE>(i), pending[i].c_str());
+				pendingSet[i] = false;
+			}
+		}
+
+		char regBuffer[256]{};
+		char opBuffer[64]{};
+		emulCtrl->getCpu()->getCpuSummary(regBuffer, opBuffer);
+		applyLine(REGISTORS, regBuffer);
+		applyLine(OPCODE, opBuffer);
+
+		if (layoutDirty) { layout(); }
+	}
+
+
+	/// <summary>
+	/// Draws the hud on the target
+	/// </summary>
+	/// <param name="target">Render target</param>
+	void DebugHud::draw(sf::RenderTarget& target) {
+		if (!enabled) { return; }
+
+		for (int i = 0; i < LINE_COUNT; i++) {
+			target.draw(texts[i]);
+		}
+	}
+
+
+	/// <summary>
+	/// Applies a string to a text element if it changed
+	/// </summary>
+	/// <param name="line">Target line</param>
+	/// <param name="inf">New line text</param>
+	void DebugHud::applyLine(HUDLINE line, const char* inf) {
+		if (shown[line] == inf) { return; }
+
+		shown[line].assign(inf);
+		texts[line].setString(inf);
+		layoutDirty = true;
+	}
+
+
+	/// <summary>
+	/// Updates the text elements positions
+	/// </summary>
+	void DebugHud::layout() {
+		float y = origin.y;
+		for (int i = 0; i < LINE_COUNT; i++) {
+			texts[i].setPosition(origin.x, y);
+			sf::FloatRect bounds = texts[i].getGlobalBounds();
+			y = bounds.top + bounds.height;
+		}
+		bottom = y;
+		layoutDirty = false;
+	}
+} // namespace TheBoy
@@ -0,0 +1,206 @@
+#pragma once
+#ifndef DEBUGHUD_H
+#define DEBUGHUD_H
+
+#include "common.h"
+#include <mutex>
+#include <string>
+
+namespace TheBoy {
+	class EmulatorController;
+
+	/// <summary>
+	/// Debug text overlay (cartridge, registors and ppu information)
+	/// Refreshed at a fixed rate and only re-laid out when one of the strings changes
+	/// </summary>
+	class DebugHud {
+	public:
+		/// <summary>
+		/// Hud text lines, drawn from top to bottom
+		/// </summary>
+		typedef enum HUDLINE {
+			TITLE,
+			CART_HEADER,
+			CART_INFO,
+			CART_CHECKSUM,
+			REGISTORS,
+			OPCODE,
+			PPU_FRAMES,
+			PRESENT,
+			REWIND,
+			PERF,
+			LINE_COUNT
+		} HUDLINE;
+
+
+		/// <summary>
+		/// Debug hud constructor
+		/// </summary>
+		/// <param name="ctrl">Target emulator controller</param>
+		/// <param name="font">Font used by the text elements</param>
+		DebugHud(EmulatorController* ctrl, std::shared_ptr<sf::Font> font);
+
+
+		/// <summary>
+		/// Debug hud destructor
+		/// </summary>
+		~DebugHud() = default;
+
+
+		/// <summary>
+		/// Enables or disables the hud, a disabled hud is not refreshed nor drawn
+		/// </summary>
+		/// <param name="state">New hud state</param>
+		void setEnabled(bool state);
+
+
+		/// <summary>
+		/// Gets if the hud is enabled
+		/// </summary>
+		/// <returns>Hud state</returns>
+		bool isEnabled();
+
+
+		/// <summary>
+		/// Defines how many times per second the hud values are gathered
+		/// </summary>
+		/// <param name="hz">Refresh rate, 0 refreshes on every draw</param>
+		void setRefreshRate(bit16 hz);
+
+
+		/// <summary>
+		/// Defines a hud line text, can be called from any thread
+		/// The value is applied on the next refresh
+		/// </summary>
+		/// <param name="line">Target line</param>
+		/// <param name="inf">Line text</param>
+		void setLine(HUDLINE line, const char* inf);
+
+
+		/// <summary>
+		/// Defines the hud top left position
+		/// </summary>
+		/// <param name="x">Left position</param>
+		/// <param name="y">Top position</param>
+		void setPosition(float x, float y);
+
+
+		/// <summary>
+		/// Gets the bottom of the last hud line, top position when disabled
+		/// </summary>
+		/// <returns>Hud bottom position</returns>
+		float getBottom();
+
+
+		/// <summary>
+		/// Refreshes the hud values if the refresh interval elapsed, called from the view thread
+		/// </summary>
+		void update();
+
+
+		/// <summary>
+		/// Draws the hud on the target
+		/// </summary>
+		/// <param name="target">Render target</param>
+		void draw(sf::RenderTarget& target);
+
+	private:
+		/// <summary>
+		/// Pointer to the target emulator controller
+		/// </summary>
+		EmulatorController* emulCtrl;
+
+
+		/// <summary>
+		/// Font used by the text elements
+		/// </summary>
+		std::shared_ptr<sf::Font> hudFont;
+
+
+		/// <summary>
+		/// Hud text elements
+		/// </summary>
+		sf::Text texts[LINE_COUNT];
+
+
+		/// <summary>
+		/// Strings currently on the text elements
+		/// </summary>
+		std::string shown[LINE_COUNT];
+
+
+		/// <summary>
+		/// Strings set from other threads, waiting for the next refresh
+		/// </summary>
+		std::string pending[LINE_COUNT];
+
+
+		/// <summary>
+		/// Marks the pending lines with a new value
+		/// </summary>
+		bool pendingSet[LINE_COUNT];
+
+
+		/// <summary>
+		/// Guards the pending lines
+		/// </summary>
+		std::mutex pendingLock;
+
+
+		/// <summary>
+		/// Hud state
+		/// </summary>
+		bool enabled;
+
+
+		/// <summary>
+		/// Marks that the text elements need to be re-positioned
+		/// </summary>
+		bool layoutDirty;
+
+
+		/// <summary>
+		/// Marks that the next update refreshes without waiting for the interval
+		/// </summary>
+		bool refreshPending;
+
+
+		/// <summary>
+		/// Hud top left position
+		/// </summary>
+		sf::Vector2f origin;
+
+
+		/// <summary>
+		/// Bottom position of the last laid out line
+		/// </summary>
+		float bottom;
+
+
+		/// <summary>
+		/// Time between refreshes
+		/// </summary>
+		sf::Time refreshInterval;
+
+
+		/// <summary>
+		/// Time since the last refresh
+		/// </summary>
+		sf::Clock refreshClock;
+
+
+		/// <summary>
+		/// Applies a string to a text element if it changed
+		/// </summary>
+		/// <param name="line">Target line</param>
+		/// <param name="inf">New line text</param>
+		void applyLine(HUDLINE line, const char* inf);
+
+
+		/// <summary>
+		/// Updates the text elements positions
+		/// </summary>
+		void layout();
+	};
+} // namespace TheBoy
+#endif // !DEBUGHUD_H
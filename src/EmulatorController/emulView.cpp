@@ -1,9 +1,28 @@
 #include "emulView.h"
 #include "emulatorController.h"
 #include <math.h>
+#include <algorithm>
 
 namespace TheBoy {
 
+	/**
+	 * @brief Hashes a ppu frame, used to detect unchanged frames
+	 * Four independent lanes keep the multiplies from chaining on each other
+	 * @param frame Pointer to the frame pixels
+	 * @param count Pixel count, multiple of 4
+	 * @return bit64 Frame hash
+	 */
+	static bit64 hashFrame(const bit32* frame, int count) {
+		bit64 h[4] = { 0xCBF29CE484222325ULL, 0x84222325CBF29CE4ULL, 0x9E3779B97F4A7C15ULL, 0xC2B2AE3D27D4EB4FULL };
+
+		for (int i = 0; i < count; i += 4) {
+			for (int l = 0; l < 4; l++) {
+				h[l] = (h[l] ^ frame[i + l]) * 0x100000001B3ULL;
+			}
+		}
+		return h[0] ^ (h[1] << 1) ^ (h[2] << 2) ^ (h[3] << 3);
+	}
+
 	/**
 	 * @brief Construct a new Emul View:: Emul View object
 	 * @param ctrl Target emulator controller
@@ -14,13 +33,8 @@ namespace TheBoy {
 			sf::Style::Titlebar | sf::Style::Titlebar | sf::Style::Close
 			);
 
-		viewInput = new InputStates();
-
-		window->setFramerateLimit(30);
 		mainLoad();
-
-		wText[0]->setString("|TheBoy - Game boy Emulator\n - - - - - - - - - - -\n");
-		wText[1]->setString("|:: Cartrige Information");
+		setVsync(false);
 
 		std::cout << "[VIEW] :: Window created! " << std::endl;
 	}
@@ -32,7 +46,6 @@ namespace TheBoy {
 	 */
 	EmulView::~EmulView() {
 		delete[] viewPixels;
-		delete viewInput;
 	}
 
 
@@ -40,10 +53,10 @@ namespace TheBoy {
 	 * @brief Manages the window events
 	 */
 	void EmulView::ManageEvents() {
-		sf::Event* evt = new sf::Event();
+		sf::Event evt;
 
-		while (window->pollEvent(*evt)) {
-			switch (evt->type) {
+		while (window->pollEvent(evt)) {
+			switch (evt.type) {
 			case sf::Event::Closed:
 				emulCtrl->forceEmuStop("Close event found!");
 				window->close();
@@ -51,33 +64,111 @@ namespace TheBoy {
 
 			case sf::Event::KeyPressed:
 			case sf::Event::KeyReleased: {
-				switch (evt->key.code)
+				bit8 button = 0;
+				switch (evt.key.code)
 				{
-				case sf::Keyboard::A: {
-					viewInput->a = evt->type == sf::Event::KeyPressed; break; }
-				case sf::Keyboard::Z: {
-					viewInput->b = evt->type == sf::Event::KeyPressed; break; }
-				case sf::Keyboard::Enter: {
-					viewInput->start = evt->type == sf::Event::KeyPressed; break; }
-				case sf::Keyboard::Backspace: {
-					viewInput->select = evt->type == sf::Event::KeyPressed; break; }
-				case sf::Keyboard::Up: {
-					viewInput->up = evt->type == sf::Event::KeyPressed; break; }
-				case sf::Keyboard::Down: {
-					viewInput->down = evt->type == sf::Event::KeyPressed; break; }
-				case sf::Keyboard::Left: {
-					viewInput->left = evt->type == sf::Event::KeyPressed; break; }
-				case sf::Keyboard::Right: {
-					viewInput->right = evt->type == sf::Event::KeyPressed; break; }
+				case sf::Keyboard::A: { button = JOYP_A; break; }
+				case sf::Keyboard::Z: { button = JOYP_B; break; }
+				case sf::Keyboard::Enter: { button = JOYP_START; break; }
+				case sf::Keyboard::Backspace: { button = JOYP_SELECT; break; }
+				case sf::Keyboard::Up: { button = JOYP_UP; break; }
+				case sf::Keyboard::Down: { button = JOYP_DOWN; break; }
+				case sf::Keyboard::Left: { button = JOYP_LEFT; break; }
+				case sf::Keyboard::Right: { button = JOYP_RIGHT; break; }
+				case sf::Keyboard::F1: {
+					if (evt.type == sf::Event::KeyPressed) { vramViewer->cycleMode(); }
+					break; }
+				case sf::Keyboard::F2: {
+					if (evt.type == sf::Event::KeyPressed) { hud->setEnabled(!hud->isEnabled()); }
+					break; }
+				case sf::Keyboard::F3: {
+					if (evt.type == sf::Event::KeyPressed) { setVsync(!presenter.getVsync()); }
+					break; }
+				case sf::Keyboard::F4: {
+					// Cycles the frame skip: off, automatic while late, then drawing every 2nd to 4th frame
+					if (evt.type == sf::Event::KeyPressed) {
+						std::shared_ptr<Ppu> ppu = emulCtrl->getPpu();
+						bit8 skip = ppu->getFrameSkip();
+						bool autoSkip = ppu->getAutoFrameSkip();
+						if (!autoSkip && skip == 0) { autoSkip = true; }
+						else if (autoSkip) { autoSkip = false; skip = 1; }
+						else { skip = (skip + 1) % 4; }
+						ppu->setAutoFrameSkip(autoSkip);
+						ppu->setFrameSkip(skip);
+						std::cout << "[VIEW] :: Frame skip " << (autoSkip ? std::string("auto") :
+							(skip == 0 ? std::string("off") : "draws 1 of " + std::to_string(skip + 1))) << std::endl;
+					}
+					break; }
+				case sf::Keyboard::F5: {
+					if (evt.type == sf::Event::KeyPressed) { emulCtrl->requestStateSave(); }
+					break; }
+				case sf::Keyboard::F6: {
+					// Cycles the run ahead frames, 0 disables
+					if (evt.type == sf::Event::KeyPressed) {
+						RunAhead* ra = emulCtrl->getRunAhead();
+						ra->setFrames((ra->getFrames() + 1) % (RunAhead::MaxFrames + 1));
+					}
+					break; }
+				case sf::Keyboard::F7: {
+					if (evt.type == sf::Event::KeyPressed) { emulCtrl->getRunAhead()->setThreaded(!emulCtrl->getRunAhead()->isThreaded()); }
+					break; }
+				case sf::Keyboard::F8: {
+					if (evt.type == sf::Event::KeyPressed) { emulCtrl->requestStateLoad(); }
+					break; }
+				case sf::Keyboard::R: {
+					// Rewinds while held
+					if (emulCtrl->getRewinder()) { emulCtrl->getRewinder()->setRewinding(evt.type == sf::Event::KeyPressed); }
+					break; }
+				case sf::Keyboard::F9: {
+					// Starts a movie, a second press saves it next to the rom
+					if (evt.type == sf::Event::KeyPressed) { emulCtrl->requestMovieToggle(); }
+					break; }
+				case sf::Keyboard::F10: {
+					// Saves the performance counters next to the rom
+					if (evt.type == sf::Event::KeyPressed) { emulCtrl->requestPerfDump(); }
+					break; }
+				case sf::Keyboard::F11: {
+					// Starts the guest profiler, a second press saves the folded stacks next to the rom
+					if (evt.type == sf::Event::KeyPressed) { emulCtrl->requestProfileToggle(); }
+					break; }
+				case sf::Keyboard::F12: {
+					// Starts the execution trace, a second press closes <rom>.trace
+					if (evt.type == sf::Event::KeyPressed) { emulCtrl->requestTraceToggle(); }
+					break; }
+				case sf::Keyboard::Tab: {
+					// Turbo while held, back to the selected speed on release
+					emulCtrl->getPacer()->setSpeed(
+						evt.type == sf::Event::KeyPressed ? Pacer::Unlimited : speedSteps[speedIndex]);
+					break; }
+				case sf::Keyboard::Hyphen:
+				case sf::Keyboard::Equal: {
+					if (evt.type != sf::Event::KeyPressed) { break; }
+					speedIndex += (evt.key.code == sf::Keyboard::Equal) ? 1 : -1;
+					speedIndex = std::max(0, std::min(speedIndex, static_cast<int>(sizeof(speedSteps) / sizeof(speedSteps[0])) - 1));
+					emulCtrl->getPacer()->setSpeed(speedSteps[speedIndex]);
+					break; }
 				default:break;
 				}
-				return;
+
+				if (button != 0) {
+					viewInput = (evt.type == sf::Event::KeyPressed) ? (viewInput | button) : (viewInput & ~button);
+					// Published per event, the emulation thread sees it on the next P1 read
+					emulCtrl->getInput()->publishState(viewInput);
+				}
+				break;
 			}
 			default:
 				break;
 			}
 		}
-		delete evt;
+	}
+
+
+	/// <summary>
+	/// Waits for the next present, events are polled right after it for the lowest latency
+	/// </summary>
+	void EmulView::WaitPresent() {
+		presenter.waitNextPresent();
 	}
 
 
@@ -85,20 +176,44 @@ namespace TheBoy {
 	 * @brief Updates the current window
 	 */
 	void EmulView::Draw() {
+		// Frame about to be shown, the ppu may finish the next one while this is drawn
+		bit32 frame = emulCtrl->getPpu()->getCurrentFrame();
 		window->clear(sf::Color::Black);
 
-		setRegistorsVals();
-		positionTextElms();
-		buildDebugView();
+		hud->update();
+		positionDebugElms();
+		vramViewer->update();
 		buildOutView();
 
-		for (int i = 0; i < (sizeof(wText) / sizeof(wText[0])); i++) {
-			window->draw(*wText[i].get());
-		}
-		window->draw(*sGRam.get());
+		hud->draw(*window.get());
 		window->draw(*sView.get());
+		vramViewer->draw(*window.get(), vramViewPos,
+			sf::Vector2f(winSize.x - vramViewPos.x - 10.0f, winSize.y - vramViewPos.y - 10.0f));
 
 		window->display();
+		presenter.markPresented(frame);
+
+		if (presenter.statsUpdated()) {
+			const PresentStats& stats = presenter.getStats();
+			char msgBuffer[128]{};
+			sprintf_s(msgBuffer, 128,
+				"-> Present: %.3f ms (%s)\n   jitter %.3f ms  worst %.3f ms\n   dropped %u  repeated %u",
+				stats.meanMs, presenter.getVsync() ? "vsync" : "native",
+				stats.jitterMs, stats.worstMs, stats.dropped, stats.repeated);
+			hud->setLine(DebugHud::PRESENT, msgBuffer);
+		}
+	}
+
+
+	/// <summary>
+	/// Defines if the presents follow the display vsync or the emulated refresh rate
+	/// </summary>
+	/// <param name="enabled">Vsync state</param>
+	void EmulView::setVsync(bool enabled) {
+		// Only one of them may pace, sfml framerate limit is a ms sleep and would add its own judder
+		window->setFramerateLimit(0);
+		window->setVerticalSyncEnabled(enabled);
+		presenter.setVsync(enabled);
 	}
 
 
@@ -107,7 +222,7 @@ namespace TheBoy {
 	 * @param inf information String
 	 */
 	void EmulView::setCartInfo(const char* inf) {
-		wText[2]->setString(inf);
+		hud->setLine(DebugHud::CART_INFO, inf);
 	}
 
 
@@ -116,7 +231,7 @@ namespace TheBoy {
 	 * @param inf Checksum result string
 	 */
 	void EmulView::setCartChecksum(const char* inf) {
-		wText[3]->setString(inf);
+		hud->setLine(DebugHud::CART_CHECKSUM, inf);
 	}
 
 
@@ -125,24 +240,7 @@ namespace TheBoy {
 	/// </summary>
 	/// <param name="inf"></param>
 	void EmulView::setPpuFrameCount(const char* inf) {
-		wText[6]->setString(inf);
-	}
-
-
-	/**
-	 * @brief Set the Registors Vals on screen
-	 * @param regs Target CPU registors
-	*/
-	void EmulView::setRegistorsVals() {
-		char* regBuffer(new char[256] {});
-		char* opBuffer(new char[64] {});
-
-		emulCtrl->getCpu()->getCpuSummary(regBuffer, opBuffer);
-
-		wText[4]->setString(regBuffer);
-		wText[5]->setString(opBuffer);
-		delete[] regBuffer;
-		delete[] opBuffer;
+		hud->setLine(DebugHud::PPU_FRAMES, inf);
 	}
 
 
@@ -153,28 +251,16 @@ namespace TheBoy {
 		winSize = window->getSize();
 
 
-		// 384 = 24 * 16 disposal
-		iGRam = std::make_shared<sf::Image>();
-		iGRam->create(tileSizeView.x * 8, tileSizeView.y * 8, sf::Color::Black);
-
-
-		// Ram representation
-		tGRam = std::make_shared<sf::Texture>();
-		tGRam->loadFromImage(*iGRam.get());
-
-		sGRam = std::make_shared<sf::Sprite>();
-		sGRam->setTexture(*tGRam.get());
-		sGRam->setScale(1.5f, 1.5f);
+		// vRam viewers, starts on the tile data
+		vramViewer = std::make_unique<VRamViewer>(emulCtrl);
+		vramViewer->setMode(VRamViewer::TILES);
 
 
 		// OutPut view
-		viewPixels = new sf::Uint8[kBaseScreen[0] * kBaseScreen[1] * 4]{};
-
-		iView = std::make_shared <sf::Image>();
-		iView->create(Ppu::xRes, Ppu::yRes, sf::Color::White);
+		viewPixels = new bit32[kBaseScreen[0] * kBaseScreen[1]]{};
 
 		tView = std::make_shared<sf::Texture>();
-		tView->loadFromImage(*iView.get());
+		tView->create(Ppu::xRes, Ppu::yRes);
 
 
 		sView = std::make_shared<sf::Sprite>();
@@ -194,115 +280,55 @@ namespace TheBoy {
 			std::cout << "[VIEW] :: Failed to load window icon! " << std::endl;
 		}
 
-		for (int i = 0; i < (sizeof(wText) / sizeof(wText[0])); i++) {
-			wText[i] = std::make_shared<sf::Text>();
-			wText[i]->setFont(*wFont.get());
-			wText[i]->setCharacterSize(12);
-			wText[i]->setString(" - ");
-		}
+		hud = std::make_unique<DebugHud>(emulCtrl, wFont);
 	}
 
 
 	/**
-	 * @brief Updates the text elements positions
+	 * @brief Updates the debug elements positions
 	 */
-	void EmulView::positionTextElms() {
-		for (int i = 0; i < (sizeof(wText) / sizeof(wText[0])); i++) {
-			wText[i]->setPosition(
-				winSize.x * 0.65f,
-				(i == 0) ? 0.0f : wText[i - 1]->getGlobalBounds().top + wText[i - 1]->getGlobalBounds().height
-			);
-		}
-		sGRam->setPosition(
-			winSize.x * 0.65f,
-			// calculate the bottom position for the last text element
-			wText[(sizeof(wText) / sizeof(wText[0])) - 1]->getGlobalBounds().top +
-			wText[(sizeof(wText) / sizeof(wText[0])) - 1]->getGlobalBounds().height + 10
-		);
+	void EmulView::positionDebugElms() {
+		hud->setPosition(winSize.x * 0.65f, 0.0f);
+		// vRam viewer goes below the hud, takes the whole column when the hud is off
+		vramViewPos = sf::Vector2f(winSize.x * 0.65f, hud->getBottom() + 10);
 	}
 
-	/**
-	 * @brief Updates the debug view texture
-	 */
-	void EmulView::buildDebugView() {
-		/*
-			Tile data is stored in VRAM in the memory area at $8000-$97FF;
-			with each tile taking 16 bytes, this area defines data for 384 tiles
-			Each tile has 8x8 pixels and has a color depth of 4 colors/gray shades
-			384 = 16 * 24 disposal
-		*/
-		bit16 addr = 0x8000;
-		// Making the display table
-		//iGRam->create(tileSizeView.x * 8, tileSizeView.y * 8, sf::Color::White);
-		for (unsigned int y = 0; y < tileSizeView.y; y++) {
-			for (unsigned int x = 0; x < tileSizeView.x; x++) {
-				addTileToDebug(addr, ((y * 24) + x));
-			}
-		}
-		tGRam->update(*iGRam.get());
-	}
+	/// <summary>
+	/// Creates the output view
+	/// </summary>
+	void EmulView::buildOutView() {
+		const bit32* frame = emulCtrl->getOutputBuffer();
+		const int pixelCount = Ppu::xRes * Ppu::yRes;
 
+		// Same frame as the last upload (paused, skipped or static screen), nothing to do
+		bit64 hash = hashFrame(frame, pixelCount);
+		if (hash == viewHash) {
+			return;
+		}
+		viewHash = hash;
 
-	/**
-	 * @brief Adds the target mem tile to the debug pixel array
-	 * @param addr Target reading addressGETBIT(byte2, b)
-	 * @param tileId Current tile iD
-	 */
-	void EmulView::addTileToDebug(bit16 addr, int tileId) {
-		/*
-			with each tile taking 16 bytes
-			Each tile occupies 16 bytes, where each line is represented by 2 bytes
-			For each line, the first byte specifies the least significant bit of the color ID of each pixel,
-			and the second byte specifies the most significant bit. In both bytes, bit 7 represents the leftmost pixel,
-			and bit 0 the rightmost.
-
-		*/
-		int yTileOff = static_cast<int>(floor(tileId / tileSizeView.x));
-		int xTileOff = tileId - (yTileOff * tileSizeView.x);
-
-		for (int t = 0; t < 16; t += 2) {
-			// For each tile line, needs to be readed 2 bytes
-			// High and Low tile line value
-			bit8 byte1 = emulCtrl->getBus()->abRead(addr + (tileId * 16) + t);
-			bit8 byte2 = emulCtrl->getBus()->abRead(addr + (tileId * 16) + t + 1);
-
-			// for each bit on the gathered line, the low nib value is the most significat one and vice versa
-			// Place the target bit value from the 1st byte on the left of the target bit from the 2st byte
-			for (int b = 0; b < 8; b++) {
-				bit8 pixelID = (GETBIT(byte1, b) << 1) | GETBIT(byte2, b);
-				// Pixel ID makes the target pixel color value, for the gb is 1 of 4 colors
-				// Since each pixel needs a 4 value entrance
-				// 64 pixels per tile
-
-				iGRam->setPixel(
-					(8 * xTileOff) + (7 - b),
-					(8 * yTileOff) + static_cast<int>(floor(t / 2)),
-					sf::Color(gbPallet[pixelID])
-				);
-			}
+		// Ppu colors are 0xRRGGBBAA values, the texture expects the R, G, B, A bytes in memory order
+		// A plain byte swap per pixel, kept branchless so it vectorizes
+		for (int i = 0; i < pixelCount; i++) {
+			bit32 c = frame[i];
+			viewPixels[i] = (c >> 24) | ((c >> 8) & 0xFF00) | ((c << 8) & 0xFF0000) | (c << 24);
 		}
+		tView->update(reinterpret_cast<const sf::Uint8*>(viewPixels));
 	}
 
 	/// <summary>
-	/// Creates the output view
+	/// Gets the debug hud
 	/// </summary>
-	void EmulView::buildOutView() {
-		for (int row = 0; row < Ppu::yRes; row++) {
-			for (int line = 0; line < Ppu::xRes; line++) {
-				iView->setPixel(
-					line, row,
-					sf::Color(emulCtrl->getPpu()->getPpuBuffer()[line + (Ppu::xRes * row)])
-				);
-			}
-		}
-		tView->update(*iView.get());
+	/// <returns>Pointer to the debug hud</returns>
+	DebugHud* EmulView::getHud() {
+		return hud.get();
 	}
 
 	/// <summary>
 	/// Get the registed input
 	/// </summary>
-	/// <returns>Registed input values</returns>
-	InputStates* EmulView::getInputState() {
+	/// <returns>Pressed buttons, JOYPADBIT flags</returns>
+	bit8 EmulView::getInputState() {
 		return viewInput;
 	}
 } // namespace TheBoy
@@ -4,10 +4,12 @@
 #include <SFML/System.hpp>
 #include "emulatorController.h"
 #include "cpu.h"
+#include "vramViewer.h"
+#include "debugHud.h"
+#include "presentScheduler.h"
+#include "pacer.h"
 
 namespace TheBoy {
-	struct InputStates;
-
 	class EmulView {
 	public:
 		/**
@@ -29,11 +31,24 @@ namespace TheBoy {
 		void ManageEvents();
 
 
+		/// <summary>
+		/// Waits for the next present, events are polled right after it for the lowest latency
+		/// </summary>
+		void WaitPresent();
+
+
 		/**
 		 * @brief Updates the current window
 		 */
 		void Draw();
 
+
+		/// <summary>
+		/// Defines if the presents follow the display vsync or the emulated refresh rate
+		/// </summary>
+		/// <param name="enabled">Vsync state</param>
+		void setVsync(bool enabled);
+
 		/**
 		 * @brief Set the Cart Informations on screen
 		 * @param inf information String
@@ -54,11 +69,17 @@ namespace TheBoy {
 		/// <param name="inf"></param>
 		void setPpuFrameCount(const char* inf);
 
+		/// <summary>
+		/// Gets the debug hud
+		/// </summary>
+		/// <returns>Pointer to the debug hud</returns>
+		DebugHud* getHud();
+
 		/// <summary>
 		/// Get the registed input
 		/// </summary>
-		/// <returns>Registed input values</returns>
-		InputStates* getInputState();
+		/// <returns>Pressed buttons, JOYPADBIT flags</returns>
+		bit8 getInputState();
 
 	private:
 #pragma region Properties
@@ -73,12 +94,6 @@ namespace TheBoy {
 		 */
 		sf::Vector2u winSize;
 
-		/**
-		 * @brief Defined vRam Tile arrangement
-		 */
-		const sf::Vector2u tileSizeView = sf::Vector2u(24, 16);
-
-
 		/**
 		 * @brief Pointer to the inUse window
 		 */
@@ -98,47 +113,46 @@ namespace TheBoy {
 
 
 		/**
-		 * @brief Array with the debug text elements
+		 * @brief Window present pacing, native Game Boy rate by default
 		 */
-		std::shared_ptr<sf::Text> wText[7];
-
+		PresentScheduler presenter;
 
 
 		/**
-		 * @brief Buffer holding the current
+		 * @brief Debug text overlay, toggled with F2
 		 */
-		sf::Uint8* viewPixels;
+		std::unique_ptr<DebugHud> hud;
+
 
 
 		/**
-		 * @brief Current vRam image representation
+		 * @brief Buffer holding the current output frame as contiguous RGBA8 pixels
 		 */
-		std::shared_ptr<sf::Image> iGRam;
+		bit32* viewPixels;
 
 
 		/**
-		 * @brief Current visual output image
+		 * @brief Hash of the last uploaded output frame
 		 */
-		std::shared_ptr<sf::Image> iView;
-
+		bit64 viewHash = 0;
 
 
 		/**
-		 * @brief Curent vRam graphical representation
+		 * @brief Current visual output
 		 */
-		std::shared_ptr<sf::Texture> tGRam;
+		std::shared_ptr<sf::Texture> tView;
 
 
 		/**
-		 * @brief Current visual output
+		 * @brief VRam debug viewers (tiles, background map, OAM), cycled with F1
 		 */
-		std::shared_ptr<sf::Texture> tView;
+		std::unique_ptr<VRamViewer> vramViewer;
 
 
 		/**
-		 * @brief Current graphic vRam sprite representation
+		 * @brief Top left position of the vRam viewer, below the debug text
 		 */
-		std::shared_ptr<sf::Sprite> sGRam;
+		sf::Vector2f vramViewPos;
 
 
 		/**
@@ -156,42 +170,34 @@ namespace TheBoy {
 		};
 
 		/// <summary>
-		/// Internal input view values
+		/// Selectable emulation speeds, the turbo key runs unlimited while held
 		/// </summary>
-		InputStates* viewInput;
-
-#pragma endregion
-
-		/**
-		 * @brief Loads all the needed objects to memory
-		 */
-		void mainLoad();
+		const double speedSteps[6] = { 0.25, 0.5, 1.0, 2.0, 4.0, Pacer::Unlimited };
 
 
 		/// <summary>
-		/// Set the Registors Vals on screen
+		/// Selected speed step
 		/// </summary>
-		void setRegistorsVals();
+		int speedIndex = 2;
 
 
 		/// <summary>
-		/// Updates the text elements positions
+		/// Internal input view values, JOYPADBIT flags
 		/// </summary>
-		void positionTextElms();
+		bit8 viewInput = 0;
 
+#pragma endregion
 
 		/**
-		 * @brief Updates the debug view texture
+		 * @brief Loads all the needed objects to memory
 		 */
-		void buildDebugView();
+		void mainLoad();
 
 
-		/**
-		 * @brief Adds the target mem tile to the debug pixel array
-		 * @param addr Target reading address
-		 * @param tileId Current tile iD
-		 */
-		void addTileToDebug(bit16 addr, int tileId);
+		/// <summary>
+		/// Updates the debug elements positions
+		/// </summary>
+		void positionDebugElms();
 
 
 		/// <summary>
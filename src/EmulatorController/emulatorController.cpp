@@ -1,6 +1,10 @@
 #include "emulatorController.h"
+#include "machineState.h"
 #include <SFML/Window.hpp>
 #include <functional>
+#include <fstream>
+#include <chrono>
+#include <cstring>
 
 namespace TheBoy {
 	/**
@@ -12,6 +16,9 @@ namespace TheBoy {
 
 		_pendingNewOut = false;
 		emu_state.reset();
+		pacer = std::make_unique<Pacer>();
+		rewindBudget = Rewinder::DefaultBudget;
+		rewindInterval = 0;
 	}
 
 
@@ -30,6 +37,7 @@ namespace TheBoy {
 		instThread = std::make_unique<std::thread>(&EmulatorController::cpuStep, this, &emu_state, comps.cpu);
 
 		while (emu_state.running) {
+			comps.view->WaitPresent();
 			comps.view->ManageEvents();
 			comps.view->Draw();
 			debugOutput();
@@ -43,10 +51,18 @@ namespace TheBoy {
 	 * @param cpu Target step cpu
 	 */
 	void EmulatorController::cpuStep(EmulatorState* state, std::shared_ptr<Cpu> cpu) {
+		bit32 pacedFrame = comps.ppu->getCurrentFrame();
+
 		while (state->running) {
-			gatherInput();
+			comps.inputCtrl->pollInterrupt();
+			comps.io->linkPoll(emu_state.ticks);
 			cpu->step();
-			debugUpdate();
+			emu_state.instructions++;
+
+			if (comps.ppu->getCurrentFrame() != pacedFrame) {
+				pacedFrame = comps.ppu->getCurrentFrame();
+				frameEnd();
+			}
 		}
 	}
 
@@ -56,6 +72,22 @@ namespace TheBoy {
 	 * @param size Window size
 	 */
 	void EmulatorController::Start(const char* rom_path) {
+		if (!Load(rom_path, false)) {
+			return;
+		}
+		this->_run();
+	}
+
+
+	/// <summary>
+	/// Creates the components and loads the cartridge, without starting any loop
+	/// </summary>
+	/// <param name="rom_path">Path to the target rom</param>
+	/// <param name="headless">Run without a view, the caller drives the emulation with runFrame</param>
+	/// <returns>If the cartridge was loaded</returns>
+	bool EmulatorController::Load(const char* rom_path, bool headless) {
+		_headless = headless;
+
 		comps.bus = std::make_shared<AddressBus>(this);
 		comps.dma = std::make_shared<Dma>(this);
 		comps.ram = std::make_shared<Ram>(this);
@@ -63,6 +95,8 @@ namespace TheBoy {
 		comps.lcd = std::make_shared<Lcd>(this);
 
 		comps.io = std::make_shared<IO>(this);
+		comps.io->setSerialHook([this](bit8 val) { serialOut(val); });
+		comps.io->setLink(link.get());
 		comps.timer = std::make_shared<Timer>(this);
 
 		emu_state.reset();
@@ -70,22 +104,312 @@ namespace TheBoy {
 
 		comps.cart = std::make_shared<Cartridge>(this, rom_path);
 
-		comps.view = std::make_shared<EmulView>(this);
+		if (!_headless) {
+			comps.view = std::make_shared<EmulView>(this);
+		}
 
 		comps.inputCtrl = std::make_shared<InputController>(this);
 
 		if (!comps.cart->loadCartridgeFromFile()) {
 			std::cout << "[Emulator] ::: Fail to load cartridge!" << std::endl;
-			return;
+			emu_state.running = false;
+			return false;
 		}
 
 		std::cout << "[Emulator] ::: Cartridge was loaded!" << std::endl;
+		statePath = std::string(rom_path) + ".state";
+		moviePath = std::string(rom_path) + ".movie";
+		perfPath = std::string(rom_path) + ".perf.json";
+		perf.reset();
+		debugBuffer.clear();
+		debugBuffer.reserve(DebugBufferSize);
+
+		// Symbols of a RGBDS build next to the rom, game.gb -> game.sym
+		std::string romPath(rom_path);
+		size_t ext = romPath.find_last_of('.');
+		profilePath = romPath + ".folded";
+		profiler = std::make_unique<GuestProfiler>(this);
+		tracePath = romPath + ".trace";
+		tracer = std::make_unique<TraceRecorder>(this);
+		profiler->loadSymbols(((ext == std::string::npos) ? romPath : romPath.substr(0, ext)).append(".sym").c_str());
+		movie = std::make_unique<Movie>(this);
+
+		if (!_headless) {
+			rewinder = std::make_unique<Rewinder>(this, rewindBudget, rewindInterval > 0 ? rewindInterval : Rewinder::DefaultInterval);
+			// An interval asked for is kept, whatever the capture cost
+			if (rewindInterval > 0) { rewinder->setAutoInterval(false); }
+			runAhead = std::make_unique<RunAhead>(this, rom_path);
+		}
+		comps.inputCtrl->setRewinder(rewinder.get());
 
 		getLcd()->setLCDSMode(Lcd::LCDMODE::OAM);
-		this->_run();
+		return true;
+	}
+
+
+	/// <summary>
+	/// Runs the emulation until the ppu completes a frame, on the calling thread
+	/// No pacing, used by the headless instances
+	/// </summary>
+	/// <returns>If the emulator is still running</returns>
+	bool EmulatorController::runFrame() {
+		bit32 frame = comps.ppu->getCurrentFrame();
+		// A frame is 70224 ticks, the limit only matters if the ppu stops counting frames
+		bit64 tickLimit = emu_state.ticks + (Ppu::LinePerFrame * Ppu::TicksPerLine * 2);
+
+		while (emu_state.running && comps.ppu->getCurrentFrame() == frame && emu_state.ticks < tickLimit) {
+			beginInstruction();
+			if (_componentTiming && ++timingCounter == TimingSampleRate) {
+				timingCounter = 0;
+				stepTimed();
+			}
+			else {
+				comps.cpu->step();
+			}
+			endInstruction();
+		}
+
+		headlessFrameEnd();
+		return emu_state.running;
+	}
+
+
+	/// <summary>
+	/// Controller work done before every cpu instruction (joypad interrupt and link partner poll)
+	/// Exposed for the callers that execute instructions without Cpu::step
+	/// </summary>
+	void EmulatorController::beginInstruction() {
+		comps.inputCtrl->pollInterrupt();
+		comps.io->linkPoll(emu_state.ticks);
+	}
+
+
+	/// <summary>
+	/// Controller work done after every cpu instruction (instruction count)
+	/// </summary>
+	void EmulatorController::endInstruction() {
+		emu_state.instructions++;
+	}
+
+
+	/// <summary>
+	/// Controller work done after every headless frame (periodic battery save)
+	/// Exposed for the callers that run frames without runFrame
+	/// </summary>
+	void EmulatorController::headlessFrameEnd() {
+		// Headless runs never reach frameEnd, a crash would lose every ram write since the load
+		if (_headless && !_speculative && comps.ppu->getCurrentFrame() % HeadlessSaveFrames == 0 && comps.cart->needSave()) {
+			comps.cart->batterySave();
+		}
+	}
+
+
+	/// <summary>
+	/// Marks the next frames as speculative, they are rolled back by the caller
+	/// </summary>
+	/// <param name="state">Speculative state</param>
+	void EmulatorController::setSpeculative(bool state) {
+		_speculative = state;
+		if (profiler && profiler->isRunning()) { profiler->setSpeculative(state, emu_state.ticks); }
+		if (tracer && tracer->isRunning()) { tracer->setPaused(state); }
+	}
+
+
+	/// <summary>
+	/// Gets if the current frames are speculative
+	/// </summary>
+	/// <returns>Speculative state</returns>
+	bool EmulatorController::isSpeculative() {
+		return _speculative;
+	}
+
+
+
+	/// <summary>
+	/// Copies the whole machine to a state blob, plain copies only, no allocation
+	/// Must run on the emulation thread (or with it stopped), between instructions
+	/// </summary>
+	/// <param name="out">Target state</param>
+	void EmulatorController::saveState(MachineState* out) {
+		memcpy(out->header.magic, "TBST", 4);
+		out->header.version = StateHeader::CurrentVersion;
+		out->header.size = sizeof(MachineState);
+		out->ticks = emu_state.ticks;
+
+		comps.cpu->saveState(out);
+		comps.timer->saveState(out);
+		comps.dma->saveState(out);
+		comps.ram->saveState(out);
+		comps.io->saveState(out);
+		comps.ppu->saveState(out);
+		comps.lcd->saveState(out);
+		comps.cart->saveState(out);
+		comps.inputCtrl->saveState(out);
+	}
+
+
+	/// <summary>
+	/// Restores the whole machine from a state blob, same threading rules as saveState
+	/// </summary>
+	/// <param name="in">Source state</param>
+	/// <returns>If the state was valid for the loaded cartridge</returns>
+	bool EmulatorController::loadState(const MachineState* in) {
+		if (memcmp(in->header.magic, "TBST", 4) != 0 ||
+			in->header.version != StateHeader::CurrentVersion || in->header.size != sizeof(MachineState)) {
+			std::cout << "[STATE] ::: Unknown state format or version" << std::endl;
+			return false;
+		}
+		if (!comps.cart->stateMatches(in)) {
+			std::cout << "[STATE] ::: State was taken from another cartridge" << std::endl;
+			return false;
+		}
+
+		emu_state.ticks = in->ticks;
+		comps.cpu->loadState(in);
+		comps.timer->loadState(in);
+		comps.dma->loadState(in);
+		comps.ram->loadState(in);
+		comps.io->loadState(in);
+		comps.ppu->loadState(in);
+		comps.lcd->loadState(in);
+		comps.cart->loadState(in);
+		comps.inputCtrl->loadState(in);
+		if (profiler && profiler->isRunning()) { profiler->timeJump(in->ticks); }
+		return true;
+	}
+
+
+	/// <summary>
+	/// Saves the machine state to a file
+	/// </summary>
+	/// <param name="path">Target file path</param>
+	/// <returns>If the file was written</returns>
+	bool EmulatorController::saveStateFile(const char* path) {
+		std::unique_ptr<MachineState> state = std::make_unique<MachineState>();
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		saveState(state.get());
+		double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		if (!file.is_open()) {
+			std::cout << "[STATE] ::: Failed to open " << path << std::endl;
+			return false;
+		}
+		file.write(reinterpret_cast<const char*>(state.get()), sizeof(MachineState));
+		if (!file.good()) {
+			std::cout << "[STATE] ::: Failed to write " << path << std::endl;
+			return false;
+		}
+
+		printf("[STATE] ::: Saved %s (%zu bytes, captured in %.1f us)\n", path, sizeof(MachineState), us);
+		return true;
+	}
+
+
+	/// <summary>
+	/// Loads the machine state from a file
+	/// </summary>
+	/// <param name="path">Source file path</param>
+	/// <returns>If the state was loaded</returns>
+	bool EmulatorController::loadStateFile(const char* path) {
+		// The partner time can not go back
+		if (link && link->isConnected()) {
+			std::cout << "[STATE] ::: States can not be loaded while linked" << std::endl;
+			return false;
+		}
+		// The movie events are stamped on the current timeline, a jump would desync the replay
+		if (movie->isRecording() || movie->isPlaying()) {
+			std::cout << "[STATE] ::: States can not be loaded while a movie is recorded or played" << std::endl;
+			return false;
+		}
+
+		std::ifstream file(path, std::ios::binary);
+		if (!file.is_open()) {
+			std::cout << "[STATE] ::: No state file at " << path << std::endl;
+			return false;
+		}
+
+		std::unique_ptr<MachineState> state = std::make_unique<MachineState>();
+		file.read(reinterpret_cast<char*>(state.get()), sizeof(MachineState));
+		if (file.gcount() != static_cast<std::streamsize>(sizeof(MachineState))) {
+			std::cout << "[STATE] ::: Truncated state file " << path << std::endl;
+			return false;
+		}
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		if (!loadState(state.get())) { return false; }
+		// The snapshots belong to the timeline that was left
+		if (rewinder) { rewinder->clear(); }
+		double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+		printf("[STATE] ::: Loaded %s (restored in %.1f us)\n", path, us);
+		return true;
+	}
+
+
+	/// <summary>
+	/// Requests a quick save, thread safe, used by the view
+	/// </summary>
+	void EmulatorController::requestStateSave() {
+		pendingStateSave = true;
+	}
+
+
+	/// <summary>
+	/// Requests a quick load, thread safe, used by the view
+	/// </summary>
+	void EmulatorController::requestStateLoad() {
+		pendingStateLoad = true;
+	}
+
+
+	/// <summary>
+	/// Requests the movie recording start or stop, thread safe, used by the view
+	/// </summary>
+	void EmulatorController::requestMovieToggle() {
+		pendingMovieToggle = true;
+	}
+
+
+	/// <summary>
+	/// Requests the performance counters dump, thread safe, used by the view
+	/// </summary>
+	void EmulatorController::requestPerfDump() {
+		pendingPerfDump = true;
+	}
+
+
+	/// <summary>
+	/// Requests the guest profiler start or stop, thread safe, used by the view
+	/// </summary>
+	void EmulatorController::requestProfileToggle() {
+		pendingProfileToggle = true;
+	}
+
+
+	/// <summary>
+	/// Requests the execution trace start or stop, thread safe, used by the view
+	/// </summary>
+	void EmulatorController::requestTraceToggle() {
+		pendingTraceToggle = true;
 	}
 
 
+	/// <summary>
+	/// Gets if the controller runs without a view
+	/// </summary>
+	/// <returns>Headless state</returns>
+	bool EmulatorController::isHeadless() { return _headless; }
+
+
+	/// <summary>
+	/// Gets if the emulation is running
+	/// </summary>
+	/// <returns>Running state</returns>
+	bool EmulatorController::isRunning() { return emu_state.running; }
+
+
 	/**
 	 * @brief Stops the emulation execution with a defined message
 	 * @param msg Stop message
@@ -102,12 +426,18 @@ namespace TheBoy {
 	 * @param cycles
 	 */
 	void EmulatorController::emulCycles(const int& cycles) {
+		if (timingStep) {
+			emulCyclesTimed(cycles);
+			return;
+		}
+
 		for (int i = 0; i < cycles; i++) {
 			for (int n = 0; n < 4; n++) {
 				emu_state.ticks++;
 				comps.timer->tick();
 				comps.ppu->step();
 			}
+			if (comps.io->serialDue(emu_state.ticks)) { comps.io->serialComplete(); }
 			comps.dma->step();
 		}
 	}
@@ -122,19 +452,114 @@ namespace TheBoy {
 	}
 
 
-	/**
-	 * @brief Updates the debug, information if available
-	 */
-	void EmulatorController::debugUpdate() {
-		// Some tests marks this address for pending information
-		bit8 res = comps.bus->abRead(0xFF02);
-		if (res == 0x81) {
-			_pendingNewOut = true;
-			char r = comps.bus->abRead(0xFF01);
+	/// <summary>
+	/// Gets the executed instructions count
+	/// </summary>
+	/// <returns>Instructions since the load</returns>
+	bit64 EmulatorController::getInstructions() {
+		return emu_state.instructions;
+	}
 
-			debugBuffer.push_back(r);
-			getBus()->abWrite(0xFF02, 0);
+
+	/// <summary>
+	/// Enables the sampled component timing, for the benchmarks, clears the times
+	/// </summary>
+	/// <param name="state">Timing state</param>
+	void EmulatorController::setComponentTiming(bool state) {
+		componentTimes = ComponentTimes{};
+		timingCounter = 0;
+
+		if (state) {
+			// Cost of a clock read pair, taken out of every timed call. The fastest batch, the others were interrupted
+			const int probes = 1000;
+			clockOverheadNs = 0.0;
+			for (int batch = 0; batch < 16; batch++) {
+				std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+				for (int i = 0; i < probes; i++) { std::chrono::steady_clock::now(); }
+				double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / probes;
+				if (batch == 0 || ns < clockOverheadNs) { clockOverheadNs = ns; }
+			}
 		}
+		_componentTiming = state;
+	}
+
+
+	/// <summary>
+	/// Gets the sampled component times, scaled to the whole run
+	/// </summary>
+	/// <returns>Component times</returns>
+	ComponentTimes EmulatorController::getComponentTimes() {
+		ComponentTimes times = componentTimes;
+		times.cpuNs *= TimingSampleRate;
+		times.ppuNs *= TimingSampleRate;
+		times.timerNs *= TimingSampleRate;
+		times.dmaNs *= TimingSampleRate;
+		return times;
+	}
+
+
+	/// <summary>
+	/// Runs a cpu step with the cpu and every component call timed
+	/// The cpu time is the step time out of its emulCycles spans, every part comes from the same instructions
+	/// </summary>
+	void EmulatorController::stepTimed() {
+		typedef std::chrono::steady_clock Clock;
+		cyclesSpanNs = 0.0;
+		timingStep = true;
+		Clock::time_point start = Clock::now();
+		comps.cpu->step();
+		double stepNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() - clockOverheadNs;
+		timingStep = false;
+
+		componentTimes.cpuNs += stepNs - cyclesSpanNs;
+		componentTimes.samples++;
+	}
+
+
+	/// <summary>
+	/// emulCycles with every component call timed, same call order
+	/// </summary>
+	/// <param name="cycles">Machine cycles</param>
+	void EmulatorController::emulCyclesTimed(const int& cycles) {
+		typedef std::chrono::steady_clock Clock;
+		// Unclamped, the clock overhead is an average and the sums only stay unbiased with the negative samples
+		auto elapsed = [this](Clock::time_point from, Clock::time_point to) {
+			return std::chrono::duration<double, std::nano>(to - from).count() - clockOverheadNs;
+		};
+
+		Clock::time_point span = Clock::now();
+		for (int i = 0; i < cycles; i++) {
+			for (int n = 0; n < 4; n++) {
+				emu_state.ticks++;
+				Clock::time_point t0 = Clock::now();
+				comps.timer->tick();
+				Clock::time_point t1 = Clock::now();
+				comps.ppu->step();
+				Clock::time_point t2 = Clock::now();
+				componentTimes.timerNs += elapsed(t0, t1);
+				componentTimes.ppuNs += elapsed(t1, t2);
+			}
+			if (comps.io->serialDue(emu_state.ticks)) { comps.io->serialComplete(); }
+			Clock::time_point t0 = Clock::now();
+			comps.dma->step();
+			componentTimes.dmaNs += elapsed(t0, Clock::now());
+		}
+		cyclesSpanNs += elapsed(span, Clock::now());
+	}
+
+
+	/// <summary>
+	/// Default serial hook, keeps the bytes for the debug output
+	/// Test roms print their results on the serial port
+	/// </summary>
+	/// <param name="val">Serial byte</param>
+	void EmulatorController::serialOut(bit8 val) {
+		// Speculative frames are rolled back, their bytes are sent again
+		if (_speculative) { return; }
+
+		if (debugBuffer.size() == DebugBufferSize) { debugBuffer.erase(0, DebugBufferSize / 2); }
+		debugBuffer.push_back(static_cast<char>(val));
+		_pendingNewOut = true;
 	}
 
 
@@ -151,17 +576,80 @@ namespace TheBoy {
 	}
 
 	/// <summary>
-	/// Gather the input information
+	/// Runs the per frame controller work, pacing, fps count and battery save
+	/// Called from the emulation thread once the ppu completes a frame
 	/// </summary>
-	void EmulatorController::gatherInput() {
-		comps.inputCtrl->getState()->start = getView()->getInputState()->start;
-		comps.inputCtrl->getState()->select = getView()->getInputState()->select;
-		comps.inputCtrl->getState()->a = getView()->getInputState()->a;
-		comps.inputCtrl->getState()->b = getView()->getInputState()->b;
-		comps.inputCtrl->getState()->up = getView()->getInputState()->up;
-		comps.inputCtrl->getState()->down = getView()->getInputState()->down;
-		comps.inputCtrl->getState()->left = getView()->getInputState()->left;
-		comps.inputCtrl->getState()->right = getView()->getInputState()->right;
+	void EmulatorController::frameEnd() {
+		if (pendingStateSave.exchange(false)) { saveStateFile(statePath.c_str()); }
+		if (pendingStateLoad.exchange(false)) { loadStateFile(statePath.c_str()); }
+		if (pendingMovieToggle.exchange(false)) {
+			if (movie->isRecording()) { movie->stopRecording(moviePath.c_str()); }
+			else { movie->startRecording(); }
+		}
+		if (pendingPerfDump.exchange(false)) {
+#if PERFCOUNT
+			if (perf.writeJson(perfPath.c_str())) { std::cout << "[PERF] ::: Counters saved to " << perfPath << std::endl; }
+#else
+			std::cout << "[PERF] ::: Built without PERF_COUNTERS" << std::endl;
+#endif
+		}
+		if (pendingProfileToggle.exchange(false)) {
+			if (profiler->isRunning()) {
+				profiler->stop();
+				profiler->writeFolded(profilePath.c_str());
+				std::cout << "[PROFILER] ::: " << profiler->report(10);
+			}
+			else {
+				std::cout << "[PROFILER] ::: Profiling" << std::endl;
+				profiler->start();
+			}
+		}
+		if (pendingTraceToggle.exchange(false)) {
+			if (tracer->isRunning()) { tracer->stop(); }
+			else { tracer->start(tracePath.c_str()); }
+		}
+
+		if (rewinder) { rewinder->frameEnd(); }
+		if (runAhead) { runAhead->frameEnd(); }
+
+		comps.ppu->setFrameLate(pacer->frameDone());
+
+		if (pacer->fpsUpdated()) {
+			char msgBuffer[128]{};
+			double speed = pacer->getSpeed();
+			int len;
+			if (speed == Pacer::Unlimited) {
+				len = sprintf_s(msgBuffer, 128, "-> Ppu Frames: %.1f (unlimited)", pacer->getFps());
+			}
+			else {
+				len = sprintf_s(msgBuffer, 128, "-> Ppu Frames: %.1f (x%.2f)", pacer->getFps(), speed);
+			}
+			if (runAhead && runAhead->getFrames() > 0) {
+				RunAheadStats ra = runAhead->getStats();
+				sprintf_s(msgBuffer + len, 128 - len, "\n   run ahead %u %s, %.0f us/frame (state %.1f us)",
+					ra.frames, ra.threaded ? "threaded" : "inline", ra.avgCostUs, ra.avgStateUs);
+			}
+			if (!_headless) { getView()->setPpuFrameCount(msgBuffer); }
+
+			if (rewinder && !_headless) {
+				RewindStats rw = rewinder->getStats();
+				char rwBuffer[128]{};
+				sprintf_s(rwBuffer, 128,
+					"-> Rewind: %.1f s  %.1f/%.0f MB\n   %.2f MB/min  every %u frames\n   capture %.0f us (%.2f%%)  worst %.0f us",
+					rw.secondsCovered, rw.bytesUsed / 1048576.0, rw.budget / 1048576.0,
+					rw.bytesPerMinute / 1048576.0, rw.interval, rw.avgCaptureUs, rw.frameCostPct, rw.worstCaptureUs);
+				getView()->getHud()->setLine(DebugHud::REWIND, rwBuffer);
+			}
+
+#if PERFCOUNT
+			if (!_headless) { getView()->getHud()->setLine(DebugHud::PERF, ("-> Perf: " + perf.table(6)).c_str()); }
+#endif
+
+			// Handed to the battery writer, the file is written from its thread
+			if (comps.cart->needSave()) {
+				comps.cart->batterySave();
+			}
+		}
 	}
 
 
@@ -169,7 +657,7 @@ namespace TheBoy {
 	 * @brief Get the Cartridge object
 	 * @return std::shared_ptr<Cartridge> Shared pointer to the inUse cartridge
 	 */
-	std::shared_ptr<Cartridge> EmulatorController::getCartridge() {
+	const std::shared_ptr<Cartridge>& EmulatorController::getCartridge() {
 		if (!comps.cart) {
 			std::cout << "[Emulator] ::: Get Cartridge on a null shared!" << std::endl;
 		}
@@ -180,7 +668,7 @@ namespace TheBoy {
 	 * @brief Get the Bus object
 	 * @return std::shared_ptr<AddressBus> Shared pointer to the inUse AddressBus
 	 */
-	std::shared_ptr<AddressBus> EmulatorController::getBus() {
+	const std::shared_ptr<AddressBus>& EmulatorController::getBus() {
 		if (!comps.bus) {
 			std::cout << "[Emulator] ::: Get Bus on a null shared!" << std::endl;
 		}
@@ -191,7 +679,7 @@ namespace TheBoy {
 	 * @brief Get the Dma object
 	 * @return std::shared_ptr<Dma> Shared pointer to the inUse Dma
 	 */
-	std::shared_ptr<Dma> EmulatorController::getDma() {
+	const std::shared_ptr<Dma>& EmulatorController::getDma() {
 		if (!comps.dma) {
 			std::cout << "[Emulator] ::: Get Dma on a null shared!" << std::endl;
 		}
@@ -203,7 +691,7 @@ namespace TheBoy {
 	 * @brief Get the Ram object
 	 * @return std::shared_ptr<Ram> Shared pointer to the inUse Ram
 	 */
-	std::shared_ptr<Ram> EmulatorController::getRam() {
+	const std::shared_ptr<Ram>& EmulatorController::getRam() {
 		if (!comps.ram) {
 			std::cout << "[Emulator] ::: Get Ram on a null shared!" << std::endl;
 		}
@@ -215,7 +703,7 @@ namespace TheBoy {
 	 * @brief Get the Ppu object
 	 * @return std::shared_ptr<Ppu> Shared pointer to the inUse Ppu
 	 */
-	std::shared_ptr<Ppu> EmulatorController::getPpu() {
+	const std::shared_ptr<Ppu>& EmulatorController::getPpu() {
 		if (!comps.ppu) {
 			std::cout << "[Emulator] ::: Get Ppu on a null shared!" << std::endl;
 		}
@@ -227,7 +715,7 @@ namespace TheBoy {
 	 * @brief Get the Cpu object
 	 * @return std::shared_ptr<Ram> Shared pointer to the inUse Cpu
 	 */
-	std::shared_ptr<Cpu> EmulatorController::getCpu() {
+	const std::shared_ptr<Cpu>& EmulatorController::getCpu() {
 		if (!comps.cpu) {
 			std::cout << "[Emulator] ::: Get Cpu on a null shared!" << std::endl;
 		}
@@ -239,7 +727,7 @@ namespace TheBoy {
 	 * @brief Gets the IO object
 	 * @return std::shared_ptr<IO> Shared pointer to the inUse IO
 	 */
-	std::shared_ptr<IO> EmulatorController::getIO() {
+	const std::shared_ptr<IO>& EmulatorController::getIO() {
 		if (!comps.io) {
 			std::cout << "[Emulator] ::: Get IO on a null shared!" << std::endl;
 		}
@@ -250,7 +738,7 @@ namespace TheBoy {
 	* @brief Get the Timer object
 	* @return std::shared_ptr<Timer> Shared pointer to the inUse Timer
 	*/
-	std::shared_ptr<Timer> EmulatorController::getTimer() {
+	const std::shared_ptr<Timer>& EmulatorController::getTimer() {
 		if (!comps.timer) {
 			std::cout << "[Emulator] ::: Get Timer on a null shared!" << std::endl;
 		}
@@ -259,11 +747,11 @@ namespace TheBoy {
 
 
 	/**
-	* @brief Get the Timer object
-	* @return std::shared_ptr<Timer> Shared pointer to the inUse Timer
+	* @brief Get the ViewHandler object
+	* @return std::shared_ptr<EmulView> Shared pointer to the inUse ViewHandler, null when headless
 	*/
-	std::shared_ptr<EmulView> EmulatorController::getView() {
-		if (!comps.timer) {
+	const std::shared_ptr<EmulView>& EmulatorController::getView() {
+		if (!comps.view && !_headless) {
 			std::cout << "[Emulator] ::: Get View on a null shared!" << std::endl;
 		}
 		return comps.view;
@@ -273,7 +761,7 @@ namespace TheBoy {
 	/// Gets the Lcd object
 	/// </summary>
 	/// <returns>Shared pointer to the inUse Lcd</returns>
-	std::shared_ptr<Lcd> EmulatorController::getLcd() {
+	const std::shared_ptr<Lcd>& EmulatorController::getLcd() {
 		if (!comps.lcd) {
 			std::cout << "[Emulator] ::: Get View on a null shared!" << std::endl;
 		}
@@ -284,10 +772,95 @@ namespace TheBoy {
 	/// Gets the input controller pointer
 	/// </summary>
 	/// <returns>Shared pointer to the inUse Input controller</returns>
-	std::shared_ptr<InputController> EmulatorController::getInput() {
+	const std::shared_ptr<InputController>& EmulatorController::getInput() {
 		if (!comps.inputCtrl) {
 			std::cout << "[Emulator] ::: Get Input Conrtoller on a null shared!" << std::endl;
 		}
 		return comps.inputCtrl;
 	}
+
+	/// <summary>
+	/// Gets the emulation pacer
+	/// </summary>
+	/// <returns>Pointer to the inUse pacer</returns>
+	Pacer* EmulatorController::getPacer() {
+		return pacer.get();
+	}
+
+	/// <summary>
+	/// Gets the rewind buffer
+	/// </summary>
+	/// <returns>Pointer to the inUse rewinder, null when headless</returns>
+	Rewinder* EmulatorController::getRewinder() {
+		return rewinder.get();
+	}
+
+	/// <summary>
+	/// Defines the rewind memory, applied on the next load
+	/// </summary>
+	/// <param name="budget">Arena size in bytes</param>
+	/// <param name="interval">Frames between two snapshots, 0 starts from the default and grows with the capture cost</param>
+	void EmulatorController::setRewindConfig(size_t budget, bit32 interval) {
+		rewindBudget = budget;
+		rewindInterval = interval;
+	}
+
+	/// <summary>
+	/// Gets the run ahead
+	/// </summary>
+	/// <returns>Pointer to the inUse run ahead, null when headless</returns>
+	RunAhead* EmulatorController::getRunAhead() {
+		return runAhead.get();
+	}
+
+	/// <summary>
+	/// Gets the joypad movie
+	/// </summary>
+	/// <returns>Pointer to the inUse movie</returns>
+	Movie* EmulatorController::getMovie() {
+		return movie.get();
+	}
+
+	/// <summary>
+	/// Plugs a link cable, before or after the load, null unplugs it
+	/// Both linked machines must start emulating together
+	/// </summary>
+	/// <param name="link">Link backend</param>
+	void EmulatorController::setLink(std::unique_ptr<SerialLink> link) {
+		if (comps.io) { comps.io->setLink(link.get()); }
+		this->link = std::move(link);
+	}
+
+	/// <summary>
+	/// Gets the link cable
+	/// </summary>
+	/// <returns>Pointer to the inUse link, null when unplugged</returns>
+	SerialLink* EmulatorController::getLink() {
+		return link.get();
+	}
+
+	/// <summary>
+	/// Gets the guest code profiler
+	/// </summary>
+	/// <returns>Pointer to the inUse profiler</returns>
+	GuestProfiler* EmulatorController::getProfiler() {
+		return profiler.get();
+	}
+
+	/// <summary>
+	/// Gets the execution trace recorder
+	/// </summary>
+	/// <returns>Pointer to the inUse trace recorder</returns>
+	TraceRecorder* EmulatorController::getTracer() {
+		return tracer.get();
+	}
+
+	/// <summary>
+	/// Gets the frame to show, the run ahead frame when enabled or the ppu one
+	/// </summary>
+	/// <returns>Frame buffer</returns>
+	const bit32* EmulatorController::getOutputBuffer() {
+		const bit32* ahead = runAhead ? runAhead->getFrame() : nullptr;
+		return ahead ? ahead : comps.ppu->getPpuBuffer();
+	}
 }
\ No newline at end of file
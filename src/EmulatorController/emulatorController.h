@@ -3,6 +3,7 @@
 
 #include <iostream>
 #include <thread>
+#include <atomic>
 
 #include <SFML/Graphics.hpp>
 #include "Cartridge.h"
@@ -16,6 +17,14 @@
 #include "inputController.h"
 
 #include "emulView.h"
+#include "pacer.h"
+#include "rewinder.h"
+#include "runAhead.h"
+#include "movie.h"
+#include "serialLink.h"
+#include "perfCounters.h"
+#include "guestProfiler.h"
+#include "traceRecorder.h"
 
 /**
  * @brief Core Project Namespace 
@@ -31,6 +40,7 @@ namespace TheBoy {
 	class Timer;
 	class EmulView;
 	class InputController;
+	struct MachineState;
 
 	
 	/**
@@ -100,6 +110,25 @@ namespace TheBoy {
 	
 
 
+	/// <summary>
+	/// Sampled time spent on the components stepped by emulCycles, the rest of the run is the cpu and controller
+	/// </summary>
+	typedef struct ComponentTimes {
+		/// <summary>
+		/// Cpu step time out of the component calls
+		/// </summary>
+		double cpuNs;
+		double ppuNs;
+		double timerNs;
+		double dmaNs;
+
+		/// <summary>
+		/// Timed instructions, every one stands for SampleRate instructions
+		/// </summary>
+		bit64 samples;
+	} ComponentTimes;
+
+
 	/**
 	 * @brief Base emulator controller class
 	 */
@@ -123,22 +152,172 @@ namespace TheBoy {
 		std::unique_ptr<std::thread> instThread;
 
 
+		/// <summary>
+		/// Wall clock pacing of the emulated frames
+		/// </summary>
+		std::unique_ptr<Pacer> pacer;
+
+
+		/// <summary>
+		/// Rewind snapshots, only with a view
+		/// </summary>
+		std::unique_ptr<Rewinder> rewinder;
+
+
+		/// <summary>
+		/// Rewind arena size and snapshot interval used by the next load, a zero interval starts from the default and grows
+		/// </summary>
+		size_t rewindBudget;
+		bit32 rewindInterval;
+
+
+		/// <summary>
+		/// Run ahead frames, only with a view
+		/// </summary>
+		std::unique_ptr<RunAhead> runAhead;
+
+
+		/// <summary>
+		/// Marks the frames run ahead and rolled back, their serial output is not kept
+		/// </summary>
+		bool _speculative = false;
+
+
+		/// <summary>
+		/// Joypad movie record and playback
+		/// </summary>
+		std::unique_ptr<Movie> movie;
+
+
+		/// <summary>
+		/// Link cable, null when unplugged
+		/// </summary>
+		std::unique_ptr<SerialLink> link;
+
+
+		/// <summary>
+		/// Opcode, component and bus counters, only filled with PERF_COUNTERS
+		/// </summary>
+		PerfCounters perf;
+
+
+		/// <summary>
+		/// Performance counters dump, next to the rom
+		/// </summary>
+		std::string perfPath = "";
+
+
+		/// <summary>
+		/// Guest code profiler, hooked on the cpu while started
+		/// </summary>
+		std::unique_ptr<GuestProfiler> profiler;
+
+
+		/// <summary>
+		/// Folded stacks saved from the view, next to the rom
+		/// </summary>
+		std::string profilePath = "";
+
+
+		/// <summary>
+		/// Binary execution trace, hooked on the cpu while recording
+		/// </summary>
+		std::unique_ptr<TraceRecorder> tracer;
+
+
+		/// <summary>
+		/// Trace file recorded from the view, next to the rom
+		/// </summary>
+		std::string tracePath = "";
+
+
+		/// <summary>
+		/// Movie file recorded from the view, next to the rom
+		/// </summary>
+		std::string moviePath = "";
+
+
 		/**
 		 * @brief Debug message buffer pointer
 		 */
 		std::string debugBuffer = "";
 
 
+		/// <summary>
+		/// Debug buffer capacity, reserved on load, the oldest half is dropped when full so the serial output never allocates
+		/// </summary>
+		static const size_t DebugBufferSize = 0x1000;
+
+
+		/// <summary>
+		/// Frames between the headless battery saves, about an emulated second
+		/// </summary>
+		static const bit32 HeadlessSaveFrames = 60;
+
+
 		/// <summary>
 		/// Marks if has pending output from Serial Transfer (Link Cable)
 		/// </summary>
 		bool _pendingNewOut = false;
 
 
-		/**
-		 * @brief Updates the debug, information if available
-		 */
-		void debugUpdate();
+		/// <summary>
+		/// Marks if the controller runs without a view, driven by runFrame
+		/// </summary>
+		bool _headless = false;
+
+
+		/// <summary>
+		/// Quick save state file, next to the rom
+		/// </summary>
+		std::string statePath = "";
+
+
+		/// <summary>
+		/// State file operations requested by the view, served by the emulation thread on the next frame end
+		/// </summary>
+		std::atomic<bool> pendingStateSave{ false };
+		std::atomic<bool> pendingStateLoad{ false };
+		std::atomic<bool> pendingMovieToggle{ false };
+		std::atomic<bool> pendingPerfDump{ false };
+		std::atomic<bool> pendingProfileToggle{ false };
+		std::atomic<bool> pendingTraceToggle{ false };
+
+
+		/// <summary>
+		/// Sampled component timing, off by default
+		/// </summary>
+		bool _componentTiming = false;
+		bit32 timingCounter = 0;
+		double clockOverheadNs = 0.0;
+		ComponentTimes componentTimes{};
+
+
+		/// <summary>
+		/// Set while a sampled instruction runs, its emulCycles calls are timed and their span kept
+		/// </summary>
+		bool timingStep = false;
+		double cyclesSpanNs = 0.0;
+
+
+		/// <summary>
+		/// Runs a cpu step with the cpu and every component call timed
+		/// </summary>
+		void stepTimed();
+
+
+		/// <summary>
+		/// emulCycles with every component call timed, same call order
+		/// </summary>
+		/// <param name="cycles">Machine cycles</param>
+		void emulCyclesTimed(const int& cycles);
+
+
+		/// <summary>
+		/// Default serial hook, keeps the bytes for the debug output
+		/// </summary>
+		/// <param name="val">Serial byte</param>
+		void serialOut(bit8 val);
 
 
 		/**
@@ -148,9 +327,10 @@ namespace TheBoy {
 
 
 		/// <summary>
-		/// Gather the input information
+		/// Runs the per frame controller work, pacing, fps count and battery save
+		/// Called from the emulation thread once the ppu completes a frame
 		/// </summary>
-		void gatherInput();
+		void frameEnd();
 
 	private:
 
@@ -189,6 +369,135 @@ namespace TheBoy {
 		 */
 		void Start(const char* rom_path);
 
+
+		/// <summary>
+		/// Creates the components and loads the cartridge, without starting any loop
+		/// </summary>
+		/// <param name="rom_path">Path to the target rom</param>
+		/// <param name="headless">Run without a view, the caller drives the emulation with runFrame</param>
+		/// <returns>If the cartridge was loaded</returns>
+		bool Load(const char* rom_path, bool headless);
+
+
+		/// <summary>
+		/// Runs the emulation until the ppu completes a frame, on the calling thread
+		/// No pacing, used by the headless instances. The battery is saved every HeadlessSaveFrames when headless
+		/// </summary>
+		/// <returns>If the emulator is still running</returns>
+		bool runFrame();
+
+
+		/// <summary>
+		/// Controller work done before every cpu instruction (joypad interrupt and link partner poll)
+		/// Exposed for the callers that execute instructions without Cpu::step
+		/// </summary>
+		void beginInstruction();
+
+
+		/// <summary>
+		/// Controller work done after every cpu instruction (instruction count)
+		/// </summary>
+		void endInstruction();
+
+
+		/// <summary>
+		/// Controller work done after every headless frame (periodic battery save)
+		/// Exposed for the callers that run frames without runFrame
+		/// </summary>
+		void headlessFrameEnd();
+
+
+		/// <summary>
+		/// Marks the next frames as speculative, they are rolled back by the caller
+		/// </summary>
+		/// <param name="state">Speculative state</param>
+		void setSpeculative(bool state);
+
+
+		/// <summary>
+		/// Gets if the current frames are speculative
+		/// </summary>
+		/// <returns>Speculative state</returns>
+		bool isSpeculative();
+
+
+
+		/// <summary>
+		/// Copies the whole machine to a state blob, plain copies only, no allocation
+		/// Must run on the emulation thread (or with it stopped), between instructions
+		/// </summary>
+		/// <param name="out">Target state</param>
+		void saveState(MachineState* out);
+
+
+		/// <summary>
+		/// Restores the whole machine from a state blob, same threading rules as saveState
+		/// </summary>
+		/// <param name="in">Source state</param>
+		/// <returns>If the state was valid for the loaded cartridge</returns>
+		bool loadState(const MachineState* in);
+
+
+		/// <summary>
+		/// Saves the machine state to a file
+		/// </summary>
+		/// <param name="path">Target file path</param>
+		/// <returns>If the file was written</returns>
+		bool saveStateFile(const char* path);
+
+
+		/// <summary>
+		/// Loads the machine state from a file
+		/// </summary>
+		/// <param name="path">Source file path</param>
+		/// <returns>If the state was loaded</returns>
+		bool loadStateFile(const char* path);
+
+
+		/// <summary>
+		/// Requests a quick save/load, thread safe, used by the view
+		/// </summary>
+		void requestStateSave();
+		void requestStateLoad();
+
+
+		/// <summary>
+		/// Requests the movie recording start or stop, thread safe, used by the view
+		/// </summary>
+		void requestMovieToggle();
+
+
+		/// <summary>
+		/// Requests the performance counters dump, thread safe, used by the view
+		/// </summary>
+		void requestPerfDump();
+
+
+		/// <summary>
+		/// Requests the guest profiler start or stop, thread safe, used by the view
+		/// </summary>
+		void requestProfileToggle();
+
+
+		/// <summary>
+		/// Requests the execution trace start or stop, thread safe, used by the view
+		/// </summary>
+		void requestTraceToggle();
+
+
+		/// <summary>
+		/// Gets if the controller runs without a view
+		/// </summary>
+		/// <returns>Headless state</returns>
+		bool isHeadless();
+
+
+		/// <summary>
+		/// Gets if the emulation is running
+		/// </summary>
+		/// <returns>Running state</returns>
+		bool isRunning();
+
 		/**
 		 * @brief Stops the emulation execution with a defined message
 		 * @param msg Stop message
@@ -206,80 +515,174 @@ namespace TheBoy {
 		 * @return bit16 Current tick count
 		 */
 		bit64 getTicks();
+
+		/// <summary>
+		/// Gets the executed instructions count
+		/// </summary>
+		/// <returns>Instructions since the load</returns>
+		bit64 getInstructions();
+
+
+		/// <summary>
+		/// Instructions between two timed ones
+		/// </summary>
+		static const bit32 TimingSampleRate = 64;
+
+
+		/// <summary>
+		/// Enables the sampled component timing, for the benchmarks, clears the times
+		/// </summary>
+		/// <param name="state">Timing state</param>
+		void setComponentTiming(bool state);
+
+
+		/// <summary>
+		/// Gets the sampled component times, scaled to the whole run
+		/// </summary>
+		/// <returns>Component times</returns>
+		ComponentTimes getComponentTimes();
 		
 		/**
 		 * @brief Get the Cartridge object
 		 * @return std::shared_ptr<Cartridge> Shared pointer to the inUse cartridge
 		 */
-		std::shared_ptr<Cartridge> getCartridge();
+		const std::shared_ptr<Cartridge>& getCartridge();
 
 
 		/**
 		 * @brief Get the Bus object
 		 * @return std::shared_ptr<AddressBus> Shared pointer to the inUse AddressBus
 		 */
-		std::shared_ptr<AddressBus> getBus();
+		const std::shared_ptr<AddressBus>& getBus();
 
 
 		/**
 		 * @brief Get the Dma object
 		 * @return std::shared_ptr<Dma> Shared pointer to the inUse Dma
 		 */
-		std::shared_ptr<Dma> getDma();
+		const std::shared_ptr<Dma>& getDma();
 
 
 		/**
 		 * @brief Get the Ram object
 		 * @return std::shared_ptr<Ram> Shared pointer to the inUse Ram
 		 */
-		std::shared_ptr<Ram> getRam();
+		const std::shared_ptr<Ram>& getRam();
 
 
 		/**
 		 * @brief Get the Ppu object
 		 * @return std::shared_ptr<Ppu> Shared pointer to the inUse Ppu
 		 */
-		std::shared_ptr<Ppu> getPpu();
+		const std::shared_ptr<Ppu>& getPpu();
 
 
 		/**
 		 * @brief Get the Cpu object
 		 * @return std::shared_ptr<Cpu> Shared pointer to the inUse Cpu
 		 */
-		std::shared_ptr<Cpu> getCpu();
+		const std::shared_ptr<Cpu>& getCpu();
 
 		/**
 		 * @brief Gets the IO object
 		 * @return std::shared_ptr<IO> Shared pointer to the inUse IO
 		 */
-		std::shared_ptr<IO> getIO();
+		const std::shared_ptr<IO>& getIO();
 
 
 		/**
 		 * @brief Get the Timer object
 		 * @return std::shared_ptr<Timer> Shared pointer to the inUse Timer
 		 */
-		std::shared_ptr<Timer> getTimer();
+		const std::shared_ptr<Timer>& getTimer();
 
 
 		/**
 		 * @brief Get the ViewHandler object
 		 * @return std::shared_ptr<EmulView> Shared pointer to the inUse ViewHandler
 		 */
-		std::shared_ptr<EmulView> getView();
+		const std::shared_ptr<EmulView>& getView();
 
 
 		/// <summary>
 		/// Gets the Lcd object
 		/// </summary>
 		/// <returns>Shared pointer to the inUse Lcd</returns>
-		std::shared_ptr<Lcd> getLcd();
+		const std::shared_ptr<Lcd>& getLcd();
 
 		/// <summary>
 		/// Gets the input controller pointer
 		/// </summary>
 		/// <returns>Shared pointer to the inUse Input controller</returns>
-		std::shared_ptr<InputController> getInput();
+		const std::shared_ptr<InputController>& getInput();
+
+		/// <summary>
+		/// Gets the emulation pacer
+		/// </summary>
+		/// <returns>Pointer to the inUse pacer</returns>
+		Pacer* getPacer();
+
+		/// <summary>
+		/// Gets the rewind buffer
+		/// </summary>
+		/// <returns>Pointer to the inUse rewinder, null when headless</returns>
+		Rewinder* getRewinder();
+
+		/// <summary>
+		/// Defines the rewind memory, applied on the next load
+		/// </summary>
+		/// <param name="budget">Arena size in bytes</param>
+		/// <param name="interval">Frames between two snapshots, 0 starts from the default and grows with the capture cost</param>
+		void setRewindConfig(size_t budget, bit32 interval);
+
+		/// <summary>
+		/// Gets the run ahead
+		/// </summary>
+		/// <returns>Pointer to the inUse run ahead, null when headless</returns>
+		RunAhead* getRunAhead();
+
+		/// <summary>
+		/// Gets the joypad movie
+		/// </summary>
+		/// <returns>Pointer to the inUse movie</returns>
+		Movie* getMovie();
+
+		/// <summary>
+		/// Plugs a link cable, before or after the load, null unplugs it
+		/// Both linked machines must start emulating together
+		/// </summary>
+		/// <param name="link">Link backend</param>
+		void setLink(std::unique_ptr<SerialLink> link);
+
+		/// <summary>
+		/// Gets the link cable
+		/// </summary>
+		/// <returns>Pointer to the inUse link, null when unplugged</returns>
+		SerialLink* getLink();
+
+		/// <summary>
+		/// Gets the performance counters, inlined for the hooks in the hot paths
+		/// </summary>
+		/// <returns>Pointer to the inUse counters</returns>
+		PerfCounters* getPerf() { return &perf; }
+
+		/// <summary>
+		/// Gets the guest code profiler
+		/// </summary>
+		/// <returns>Pointer to the inUse profiler</returns>
+		GuestProfiler* getProfiler();
+
+		/// <summary>
+		/// Gets the execution trace recorder
+		/// </summary>
+		/// <returns>Pointer to the inUse trace recorder</returns>
+		TraceRecorder* getTracer();
+
+		/// <summary>
+		/// Gets the frame to show, the run ahead frame when enabled or the ppu one
+		/// </summary>
+		/// <returns>Frame buffer</returns>
+		const bit32* getOutputBuffer();
 	};
 	
 } // namespace TheBoy
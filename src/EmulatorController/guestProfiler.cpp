@@ -0,0 +1,335 @@
+#include "guestProfiler.h"
+#include "emulatorController.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+namespace TheBoy {
+
+	/// <summary>
+	/// Default names of the interrupt vectors
+	/// </summary>
+	static const char* VectorNames[5] = { "int_vblank", "int_stat", "int_timer", "int_serial", "int_joypad" };
+
+
+	/// <summary>
+	/// Guest profiler constructor
+	/// </summary>
+	/// <param name="ctrl">Controller reference</param>
+	GuestProfiler::GuestProfiler(EmulatorController* ctrl) {
+		this->ctrl = ctrl;
+		cart = nullptr;
+		running = false;
+		paused = false;
+		interval = DefaultInterval;
+		nextSample = 0;
+		lastSample = 0;
+		lastPc = 0;
+		lastNode = 0;
+		savedTicks = 0;
+		totalTicks = 0;
+
+		// Frames are only pushed and popped while profiling
+		stack.reserve(MaxDepth);
+		savedStack.reserve(MaxDepth);
+	}
+
+
+	/// <summary>
+	/// Guest profiler destructor
+	/// </summary>
+	GuestProfiler::~GuestProfiler() {
+	}
+
+
+	/// <summary>
+	/// Loads a RGBDS .sym file, used to name the frames
+	/// Lines are "bank:address label", comments start with ';'
+	/// </summary>
+	/// <param name="path">Symbol file path</param>
+	/// <returns>If the file was read</returns>
+	bool GuestProfiler::loadSymbols(const char* path) {
+		std::ifstream file(path);
+		if (!file.is_open()) { return false; }
+
+		std::string line;
+		size_t count = 0;
+		while (std::getline(file, line)) {
+			size_t comment = line.find(';');
+			if (comment != std::string::npos) { line.resize(comment); }
+
+			unsigned int bank, addr;
+			char label[256];
+			if (sscanf(line.c_str(), "%x:%x %255s", &bank, &addr, label) != 3) { continue; }
+			symbols[((bank & 0xFFFF) << 16) | (addr & 0xFFFF)] = label;
+			count++;
+		}
+
+		std::cout << "[PROFILER] ::: " << count << " symbols loaded from " << path << std::endl;
+		return true;
+	}
+
+
+	/// <summary>
+	/// Sets the ticks between two samples
+	/// </summary>
+	/// <param name="ticks">Sample interval</param>
+	void GuestProfiler::setInterval(bit32 ticks) {
+		interval = std::max<bit32>(ticks, 4);
+	}
+
+
+	/// <summary>
+	/// Clears the samples and hooks the cpu, the current pc is the stack root
+	/// </summary>
+	void GuestProfiler::start() {
+		cart = ctrl->getCartridge().get();
+
+		nodes.clear();
+		children.clear();
+		pcTicks.clear();
+		totalTicks = 0;
+		paused = false;
+
+		resetStack();
+		lastSample = ctrl->getTicks();
+		nextSample = lastSample + interval;
+
+		running = true;
+		ctrl->getCpu()->setProfiler(this);
+	}
+
+
+	/// <summary>
+	/// Unhooks the cpu, the samples are kept for the exports
+	/// </summary>
+	void GuestProfiler::stop() {
+		if (!running) { return; }
+
+		ctrl->getCpu()->setProfiler(nullptr);
+		running = false;
+	}
+
+
+	/// <summary>
+	/// Gets if the profiler is hooked
+	/// </summary>
+	/// <returns>Running state</returns>
+	bool GuestProfiler::isRunning() {
+		return running;
+	}
+
+
+	/// <summary>
+	/// Pushes a frame, called once the return address is pushed
+	/// </summary>
+	/// <param name="target">Called address</param>
+	/// <param name="sp">Stack pointer, on the return address</param>
+	void GuestProfiler::call(bit16 target, bit16 sp) {
+		if (stack.size() >= static_cast<size_t>(MaxDepth)) { return; }
+
+		stack.push_back(ProfileFrame{ childOf(stack.back().node, keyOf(target)), sp });
+	}
+
+
+	/// <summary>
+	/// Pops the frame of a return, called before the return address is popped
+	/// </summary>
+	/// <param name="sp">Stack pointer, on the return address</param>
+	void GuestProfiler::ret(bit16 sp) {
+		// The stack grows down, frames pushed below this return address were left without a return
+		while (stack.size() > 1 && stack.back().sp < sp) { stack.pop_back(); }
+		// A return on an address pushed by hand (push + ret jumps) matches no frame
+		if (stack.size() > 1 && stack.back().sp == sp) { stack.pop_back(); }
+	}
+
+
+	/// <summary>
+	/// Pauses the sampling over the speculative frames, the shadow stack is kept for their roll back
+	/// </summary>
+	/// <param name="state">Speculative state</param>
+	/// <param name="ticks">Current emulated tick</param>
+	void GuestProfiler::setSpeculative(bool state, bit64 ticks) {
+		if (state) {
+			// The pending sample belongs to the real timeline
+			sample(ticks);
+			savedStack = stack;
+			savedTicks = ticks;
+		}
+		paused = state;
+	}
+
+
+	/// <summary>
+	/// Follows a machine state load, the stack saved on the speculation start is restored on its tick,
+	/// any other jump restarts the stack from the current pc
+	/// </summary>
+	/// <param name="ticks">Loaded emulated tick</param>
+	void GuestProfiler::timeJump(bit64 ticks) {
+		if (ticks == savedTicks && !savedStack.empty()) { stack = savedStack; }
+		else { resetStack(); }
+		savedStack.clear();
+
+		lastSample = ticks;
+		nextSample = ticks + interval;
+		lastNode = stack.back().node;
+	}
+
+
+	/// <summary>
+	/// Gets the (rom bank, address) key of an address, the bank is 0 outside of the switchable rom
+	/// </summary>
+	/// <param name="addr">Bus address</param>
+	/// <returns>Frame key</returns>
+	bit32 GuestProfiler::keyOf(bit16 addr) {
+		bit32 bank = (addr >= 0x4000 && addr < 0x8000) ? cart->getRomBank() : 0;
+		return (bank << 16) | addr;
+	}
+
+
+	/// <summary>
+	/// Charges the ticks since the last sample
+	/// </summary>
+	/// <param name="ticks">Current emulated tick</param>
+	void GuestProfiler::sample(bit64 ticks) {
+		bit64 elapsed = ticks - lastSample;
+		lastSample = ticks;
+		nextSample = ticks + interval;
+		if (paused || elapsed == 0) { return; }
+
+		nodes[lastNode].self += elapsed;
+		pcTicks[keyOf(lastPc)] += elapsed;
+		totalTicks += elapsed;
+	}
+
+
+	/// <summary>
+	/// Drops the stack, the frame of the current pc is the new root
+	/// </summary>
+	void GuestProfiler::resetStack() {
+		stack.clear();
+		stack.push_back(ProfileFrame{ childOf(-1, keyOf(ctrl->getCpu()->getRegisterValue(REG_PC))), 0xFFFF });
+		lastNode = stack.back().node;
+	}
+
+
+	/// <summary>
+	/// Gets the call tree node of a frame key under a parent, added when new
+	/// </summary>
+	int GuestProfiler::childOf(int parent, bit32 key) {
+		bit64 id = (static_cast<bit64>(static_cast<bit32>(parent)) << 32) | key;
+		std::unordered_map<bit64, int>::iterator it = children.find(id);
+		if (it != children.end()) { return it->second; }
+
+		int node = static_cast<int>(nodes.size());
+		nodes.push_back(ProfileNode{ key, parent, 0 });
+		children.emplace(id, node);
+		return node;
+	}
+
+
+	/// <summary>
+	/// Gets the name of a frame key, its symbol or bank:address
+	/// </summary>
+	std::string GuestProfiler::nameOf(bit32 key) {
+		std::map<bit32, std::string>::iterator it = symbols.find(key);
+		if (it != symbols.end()) { return it->second; }
+
+		bit16 addr = key & 0xFFFF;
+		if (key <= 0x60 && (addr & 0x7) == 0 && addr >= 0x40) { return VectorNames[(addr - 0x40) >> 3]; }
+
+		char name[16];
+		snprintf(name, sizeof(name), "%02X:%04X", key >> 16, addr);
+		return name;
+	}
+
+
+	/// <summary>
+	/// Gets the name of an instruction key, the nearest symbol before it plus the offset
+	/// </summary>
+	std::string GuestProfiler::locationOf(bit32 key) {
+		char name[16];
+		snprintf(name, sizeof(name), "%02X:%04X", key >> 16, key & 0xFFFF);
+
+		std::map<bit32, std::string>::iterator it = symbols.upper_bound(key);
+		if (it == symbols.begin()) { return name; }
+		--it;
+		// Symbols of another bank do not cover this one
+		if ((it->first >> 16) != (key >> 16)) { return name; }
+
+		char offset[16];
+		snprintf(offset, sizeof(offset), "+0x%X", key - it->first);
+		return std::string(name) + " " + it->second + (key != it->first ? offset : "");
+	}
+
+
+	/// <summary>
+	/// Writes the samples as folded stacks (flamegraph.pl, speedscope, inferno), weighted in ticks
+	/// One "root;caller;callee ticks" line per stack with samples
+	/// </summary>
+	/// <param name="path">Target file path</param>
+	/// <returns>If the file was written</returns>
+	bool GuestProfiler::writeFolded(const char* path) {
+		std::ofstream out(path);
+		if (!out.is_open()) {
+			std::cout << "[PROFILER] ::: Failed to open " << path << std::endl;
+			return false;
+		}
+
+		std::vector<std::string> paths(nodes.size());
+		// Parents are always added before their children
+		for (size_t i = 0; i < nodes.size(); i++) {
+			std::string name = nameOf(nodes[i].key);
+			paths[i] = nodes[i].parent < 0 ? name : paths[nodes[i].parent] + ";" + name;
+			if (nodes[i].self > 0) { out << paths[i] << " " << nodes[i].self << "\n"; }
+		}
+
+		std::cout << "[PROFILER] ::: " << nodes.size() << " stacks saved to " << path << std::endl;
+		return true;
+	}
+
+
+	/// <summary>
+	/// Builds a text report of the hottest functions and instructions
+	/// </summary>
+	/// <param name="rows">Rows per table</param>
+	/// <returns>Report text</returns>
+	std::string GuestProfiler::report(int rows) {
+		typedef std::pair<bit64, bit32> Ranked;
+		auto byTicks = [](const Ranked& a, const Ranked& b) { return a.first > b.first; };
+		double pct = totalTicks > 0 ? 100.0 / totalTicks : 0.0;
+		char line[160];
+
+		// Self time of the functions over every stack they show up on
+		std::unordered_map<bit32, bit64> self;
+		for (size_t i = 0; i < nodes.size(); i++) { self[nodes[i].key] += nodes[i].self; }
+
+		std::vector<Ranked> functions;
+		for (std::unordered_map<bit32, bit64>::iterator it = self.begin(); it != self.end(); ++it) {
+			if (it->second) { functions.emplace_back(it->second, it->first); }
+		}
+		std::sort(functions.begin(), functions.end(), byTicks);
+
+		std::vector<Ranked> instructions;
+		for (std::unordered_map<bit32, bit64>::iterator it = pcTicks.begin(); it != pcTicks.end(); ++it) {
+			instructions.emplace_back(it->second, it->first);
+		}
+		std::sort(instructions.begin(), instructions.end(), byTicks);
+
+		std::ostringstream out;
+		snprintf(line, sizeof(line), "%llu ticks sampled every %u, %zu stacks\n",
+			static_cast<unsigned long long>(totalTicks), interval, nodes.size());
+		out << line << "  self   function\n";
+		for (int i = 0; i < rows && i < static_cast<int>(functions.size()); i++) {
+			snprintf(line, sizeof(line), "  %5.1f%% %s\n", functions[i].first * pct, nameOf(functions[i].second).c_str());
+			out << line;
+		}
+		out << "  self   instruction\n";
+		for (int i = 0; i < rows && i < static_cast<int>(instructions.size()); i++) {
+			snprintf(line, sizeof(line), "  %5.1f%% %s\n", instructions[i].first * pct, locationOf(instructions[i].second).c_str());
+			out << line;
+		}
+		return out.str();
+	}
+} // namespace TheBoy
@@ -0,0 +1,253 @@
+#pragma once
+#ifndef GUESTPROFILER_H
+#define GUESTPROFILER_H
+
+#include "common.h"
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace TheBoy {
+	class EmulatorController;
+	class Cartridge;
+
+	/// <summary>
+	/// Guest code sampling profiler
+	/// Keeps a shadow call stack from the CALL/RST/RET/RETI instructions and the interrupt entries, and every
+	/// Interval ticks charges the elapsed ticks to the running instruction, (rom bank, pc), and to its stack.
+	/// A return pops the frame pushed on the same stack pointer, frames left by a stack switch or a popped
+	/// return address are dropped by the next return below them.
+	/// Runs on the emulation thread, hooked by the cpu only while started
+	/// </summary>
+	class GuestProfiler {
+	public:
+		/// <summary>
+		/// Default ticks between two samples
+		/// </summary>
+		static const bit32 DefaultInterval = 64;
+
+
+		/// <summary>
+		/// Deepest shadow stack, deeper calls are charged to the last kept frame
+		/// </summary>
+		static const int MaxDepth = 128;
+
+
+		/// <summary>
+		/// Guest profiler constructor
+		/// </summary>
+		/// <param name="ctrl">Controller reference</param>
+		GuestProfiler(EmulatorController* ctrl);
+
+
+		/// <summary>
+		/// Guest profiler destructor
+		/// </summary>
+		~GuestProfiler();
+
+
+		/// <summary>
+		/// Loads a RGBDS .sym file, used to name the frames
+		/// </summary>
+		/// <param name="path">Symbol file path</param>
+		/// <returns>If the file was read</returns>
+		bool loadSymbols(const char* path);
+
+
+		/// <summary>
+		/// Sets the ticks between two samples
+		/// </summary>
+		/// <param name="ticks">Sample interval</param>
+		void setInterval(bit32 ticks);
+
+
+		/// <summary>
+		/// Clears the samples and hooks the cpu, the current pc is the stack root
+		/// </summary>
+		void start();
+
+
+		/// <summary>
+		/// Unhooks the cpu, the samples are kept for the exports
+		/// </summary>
+		void stop();
+
+
+		/// <summary>
+		/// Gets if the profiler is hooked
+		/// </summary>
+		/// <returns>Running state</returns>
+		bool isRunning();
+
+
+		/// <summary>
+		/// Called by the cpu before each instruction, samples when the interval is crossed
+		/// </summary>
+		/// <param name="pc">Instruction address</param>
+		/// <param name="ticks">Current emulated tick</param>
+		void step(bit16 pc, bit64 ticks) {
+			if (ticks >= nextSample) { sample(ticks); }
+			lastPc = pc;
+			lastNode = stack.back().node;
+		}
+
+
+		/// <summary>
+		/// Pushes a frame, called once the return address is pushed
+		/// </summary>
+		/// <param name="target">Called address</param>
+		/// <param name="sp">Stack pointer, on the return address</param>
+		void call(bit16 target, bit16 sp);
+
+
+		/// <summary>
+		/// Pops the frame of a return, called before the return address is popped
+		/// </summary>
+		/// <param name="sp">Stack pointer, on the return address</param>
+		void ret(bit16 sp);
+
+
+		/// <summary>
+		/// Pauses the sampling over the speculative frames, the shadow stack is kept for their roll back
+		/// </summary>
+		/// <param name="state">Speculative state</param>
+		/// <param name="ticks">Current emulated tick</param>
+		void setSpeculative(bool state, bit64 ticks);
+
+
+		/// <summary>
+		/// Follows a machine state load, the stack saved on the speculation start is restored on its tick,
+		/// any other jump restarts the stack from the current pc
+		/// </summary>
+		/// <param name="ticks">Loaded emulated tick</param>
+		void timeJump(bit64 ticks);
+
+
+		/// <summary>
+		/// Writes the samples as folded stacks (flamegraph.pl, speedscope, inferno), weighted in ticks
+		/// </summary>
+		/// <param name="path">Target file path</param>
+		/// <returns>If the file was written</returns>
+		bool writeFolded(const char* path);
+
+
+		/// <summary>
+		/// Builds a text report of the hottest functions and instructions
+		/// </summary>
+		/// <param name="rows">Rows per table</param>
+		/// <returns>Report text</returns>
+		std::string report(int rows);
+
+	private:
+		/// <summary>
+		/// Call tree node, one per distinct stack
+		/// </summary>
+		typedef struct ProfileNode {
+			bit32 key;
+			int parent;
+			bit64 self;
+		} ProfileNode;
+
+
+		/// <summary>
+		/// Shadow stack frame
+		/// </summary>
+		typedef struct ProfileFrame {
+			int node;
+			bit16 sp;
+		} ProfileFrame;
+
+
+		/// <summary>
+		/// Controller reference
+		/// </summary>
+		EmulatorController* ctrl;
+
+
+		/// <summary>
+		/// Cartridge of the controller, reads the mapped rom bank
+		/// </summary>
+		Cartridge* cart;
+
+
+		/// <summary>
+		/// Sampling state
+		/// </summary>
+		bool running;
+		bool paused;
+		bit32 interval;
+		bit64 nextSample;
+		bit64 lastSample;
+		bit16 lastPc;
+		int lastNode;
+
+
+		/// <summary>
+		/// Call tree, the children indexed by parent node and frame key
+		/// </summary>
+		std::vector<ProfileNode> nodes;
+		std::unordered_map<bit64, int> children;
+
+
+		/// <summary>
+		/// Shadow stack, and its copy taken on the speculation start
+		/// </summary>
+		std::vector<ProfileFrame> stack;
+		std::vector<ProfileFrame> savedStack;
+		bit64 savedTicks;
+
+
+		/// <summary>
+		/// Ticks per instruction, by (rom bank, pc) key
+		/// </summary>
+		std::unordered_map<bit32, bit64> pcTicks;
+		bit64 totalTicks;
+
+
+		/// <summary>
+		/// Symbols by (bank, address) key
+		/// </summary>
+		std::map<bit32, std::string> symbols;
+
+
+		/// <summary>
+		/// Gets the (rom bank, address) key of an address, the bank is 0 outside of the switchable rom
+		/// </summary>
+		/// <param name="addr">Bus address</param>
+		/// <returns>Frame key</returns>
+		bit32 keyOf(bit16 addr);
+
+
+		/// <summary>
+		/// Charges the ticks since the last sample
+		/// </summary>
+		/// <param name="ticks">Current emulated tick</param>
+		void sample(bit64 ticks);
+
+
+		/// <summary>
+		/// Drops the stack, the frame of the current pc is the new root
+		/// </summary>
+		void resetStack();
+
+
+		/// <summary>
+		/// Gets the call tree node of a frame key under a parent, added when new
+		/// </summary>
+		int childOf(int parent, bit32 key);
+
+
+		/// <summary>
+		/// Gets the name of a frame key, its symbol or bank:address
+		/// </summary>
+		std::string nameOf(bit32 key);
+
+
+		/// <summary>
+		/// Gets the name of an instruction key, the nearest symbol before it plus the offset
+		/// </summary>
+		std::string locationOf(bit32 key);
+	};
+} // namespace TheBoy
+#endif // !GUESTPROFILER_H
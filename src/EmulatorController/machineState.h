@@ -0,0 +1,192 @@
+#pragma once
+#ifndef MACHINESTATE_H
+#define MACHINESTATE_H
+
+#include "emulatorController.h"
+
+namespace TheBoy {
+
+	/// <summary>
+	/// Save state blob header
+	/// Any change on the structs below must bump the version, old blobs are refused instead of misread
+	/// </summary>
+	typedef struct StateHeader {
+		static const bit32 CurrentVersion = 5;
+
+		/// <summary>
+		/// 'TBST'
+		/// </summary>
+		char magic[4];
+		bit32 version;
+
+		/// <summary>
+		/// sizeof(MachineState), catches blobs from builds with another struct layout
+		/// </summary>
+		bit32 size;
+
+		/// <summary>
+		/// Cartridge identity, a state only loads on the rom it was taken from
+		/// </summary>
+		char title[16];
+		bit16 romChecksum;
+		bit8 headerChecksum;
+	} StateHeader;
+
+
+	/// <summary>
+	/// Cpu registers and interrupt state
+	/// </summary>
+	typedef struct CpuState {
+		Registers regs;
+		bit16 fetchData;
+		bit16 memDest;
+		bool destIsMem;
+		bool halted;
+		bool ime;
+		bool enablingIme;
+		bit8 ie;
+		bit8 iflags;
+		bit8 opcode;
+	} CpuState;
+
+
+	/// <summary>
+	/// Timer registers
+	/// </summary>
+	typedef struct TimerState {
+		bit16 div;
+		bit8 tima;
+		bit8 tma;
+		bit8 tac;
+	} TimerState;
+
+
+	/// <summary>
+	/// OAM Dma transfer
+	/// </summary>
+	typedef struct DmaState {
+		bool enabled;
+		bit8 currByte;
+		bit8 currVal;
+		bit8 delay;
+	} DmaState;
+
+
+	/// <summary>
+	/// Work and high ram
+	/// </summary>
+	typedef struct RamState {
+		bit8 workRam[0x2000];
+		bit8 highRam[0x80];
+	} RamState;
+
+
+	/// <summary>
+	/// Serial registers and the end tick of the running transfer
+	/// </summary>
+	typedef struct IoState {
+		bit64 serialEvent;
+		bit8 serialData[2];
+	} IoState;
+
+
+	/// <summary>
+	/// Ppu memory, pipeline and line state
+	/// The line sprites are a linked list over lineSprites, the links are stored as indexes
+	/// </summary>
+	typedef struct PpuState {
+		static const bit8 NoSprite = 0xFF;
+
+		bit8 vRam[0x2000];
+		OamElement oam[40];
+		FIFO_DATA fifo;
+
+		OamElement lineSprites[10];
+		bit8 lineSpriteNext[10];
+		bit8 lineSpriteHead;
+		bit8 lineSpriteCount;
+
+		OamElement fetchedEntries[3];
+		bit8 fetchedEntryCount;
+
+		bit32 frame;
+		bit32 lineTicks;
+		bit8 windowLine;
+		bool skipFrame;
+		bit8 skippedCount;
+
+		/// <summary>
+		/// Output frame, a state taken mid frame restores the lines already drawn
+		/// </summary>
+		bit32 buffer[Ppu::xRes * Ppu::yRes];
+	} PpuState;
+
+
+	/// <summary>
+	/// Lcd registers and decoded pallets
+	/// </summary>
+	typedef struct LcdState {
+		LcdRegs regs;
+		bit32 bgColors[4];
+		bit32 spriteColors1[4];
+		bit32 spriteColors2[4];
+	} LcdState;
+
+
+	/// <summary>
+	/// Cartridge banking and external ram
+	/// Only the allocated banks are copied, the others stay zeroed
+	/// </summary>
+	typedef struct CartState {
+		/// <summary>
+		/// Mapper registers, the bank pointers are rebuilt from them on load
+		/// </summary>
+		bool enabledRam;
+		bit8 bankingMode;
+		bit16 romBankVal;
+		bit8 ramBankVal;
+		bool needsSave;
+		bit8 ramBankCount;
+
+		/// <summary>
+		/// MBC3 clock, the registers on the base tick, the latched ones and the last latch write
+		/// </summary>
+		bit8 rtcRegs[5];
+		bit8 rtcLatched[5];
+		bit8 rtcLatch;
+		bit64 rtcBaseTicks;
+
+		bit8 ramBanks[16][0x2000];
+	} CartState;
+
+
+	/// <summary>
+	/// Joypad selection, interrupt edge state and the buttons latched for the guest
+	/// The host pressed mask is not saved, it is latched again after a load
+	/// </summary>
+	typedef struct InputState {
+		bool buttonSelected;
+		bool directionSelected;
+		bit8 lastLines;
+		bit8 activeMask;
+	} InputState;
+
+
+	/// <summary>
+	/// Full machine state, flat and without pointers so it is saved and loaded with plain copies
+	/// </summary>
+	typedef struct MachineState {
+		StateHeader header;
+		bit64 ticks;
+		CpuState cpu;
+		TimerState timer;
+		DmaState dma;
+		RamState ram;
+		IoState io;
+		PpuState ppu;
+		LcdState lcd;
+		CartState cart;
+		InputState input;
+	} MachineState;
+} // namespace TheBoy
+#endif // !MACHINESTATE_H
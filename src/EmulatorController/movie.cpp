@@ -0,0 +1,265 @@
+#include "movie.h"
+#include "emulatorController.h"
+#include "machineState.h"
+#include "lzCodec.h"
+#include <cstring>
+#include <fstream>
+
+namespace TheBoy {
+
+	/// <summary>
+	/// Movie constructor
+	/// </summary>
+	/// <param name="ctrl">Controller reference</param>
+	Movie::Movie(EmulatorController* ctrl) {
+		this->ctrl = ctrl;
+		mode = MODE_IDLE;
+
+		start = std::make_unique<MachineState>();
+		scratch = std::make_unique<MachineState>();
+
+		next = 0;
+		nextTick = NoEvent;
+		startFrame = 0;
+		frames = 0;
+		endTicks = 0;
+		endHash = 0;
+	}
+
+
+	/// <summary>
+	/// Movie destructor
+	/// </summary>
+	Movie::~Movie() {
+	}
+
+
+	/// <summary>
+	/// Starts recording from the current machine state, between instructions
+	/// </summary>
+	void Movie::startRecording() {
+		stop();
+
+		ctrl->saveState(start.get());
+		startFrame = ctrl->getPpu()->getCurrentFrame();
+		events.clear();
+		events.reserve(4096);
+
+		mode = MODE_RECORD;
+		ctrl->getInput()->setMovie(this);
+		std::cout << "[MOVIE] ::: Recording" << std::endl;
+	}
+
+
+	/// <summary>
+	/// Stops recording and writes the movie file
+	/// </summary>
+	/// <param name="path">Target file path</param>
+	/// <returns>If the file was written</returns>
+	bool Movie::stopRecording(const char* path) {
+		if (mode != MODE_RECORD) { return false; }
+		stop();
+
+		frames = ctrl->getPpu()->getCurrentFrame() - startFrame;
+		endTicks = ctrl->getTicks();
+		endHash = hashState();
+
+		// Start state, compressed
+		std::vector<bit8> packed(LzCodec::bound(sizeof(MachineState)));
+		std::vector<bit32> table(LzCodec::HashSize);
+		size_t stateSize = LzCodec::compress(reinterpret_cast<const bit8*>(start.get()), sizeof(MachineState),
+			packed.data(), packed.size(), table.data());
+
+		// Events, tick deltas as 7bit varints
+		std::vector<bit8> encoded;
+		encoded.reserve(events.size() * 4);
+		bit64 last = start->ticks;
+		for (const MovieEvent& evt : events) {
+			bit64 delta = evt.ticks - last;
+			last = evt.ticks;
+			while (delta >= 0x80) {
+				encoded.push_back(static_cast<bit8>(delta | 0x80));
+				delta >>= 7;
+			}
+			encoded.push_back(static_cast<bit8>(delta));
+			encoded.push_back(evt.mask);
+		}
+
+		MovieHeader header{};
+		memcpy(header.magic, "TBMV", 4);
+		header.version = MovieHeader::CurrentVersion;
+		header.stateSize = static_cast<bit32>(stateSize);
+		header.eventBytes = static_cast<bit32>(encoded.size());
+		header.eventCount = static_cast<bit32>(events.size());
+		header.frames = frames;
+		header.endTicks = endTicks;
+		header.endHash = endHash;
+
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		if (!file.is_open()) {
+			std::cout << "[MOVIE] ::: Failed to open " << path << std::endl;
+			return false;
+		}
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(packed.data()), stateSize);
+		file.write(reinterpret_cast<const char*>(encoded.data()), encoded.size());
+		if (!file.good()) {
+			std::cout << "[MOVIE] ::: Failed to write " << path << std::endl;
+			return false;
+		}
+
+		printf("[MOVIE] ::: Saved %s (%u frames, %zu changes, %zu bytes)\n",
+			path, frames, events.size(), sizeof(header) + stateSize + encoded.size());
+		return true;
+	}
+
+
+	/// <summary>
+	/// Stores a joypad mask change, called by the input controller while recording
+	/// </summary>
+	/// <param name="ticks">Emulated tick of the change</param>
+	/// <param name="mask">New joypad mask</param>
+	void Movie::record(bit64 ticks, bit8 mask) {
+		events.push_back(MovieEvent{ ticks, mask });
+	}
+
+
+	/// <summary>
+	/// Reads a movie file
+	/// </summary>
+	/// <param name="path">Source file path</param>
+	/// <returns>If the movie was read</returns>
+	bool Movie::load(const char* path) {
+		stop();
+
+		std::ifstream file(path, std::ios::binary);
+		if (!file.is_open()) {
+			std::cout << "[MOVIE] ::: No movie file at " << path << std::endl;
+			return false;
+		}
+
+		MovieHeader header{};
+		file.read(reinterpret_cast<char*>(&header), sizeof(header));
+		if (file.gcount() != static_cast<std::streamsize>(sizeof(header)) ||
+			memcmp(header.magic, "TBMV", 4) != 0 || header.version != MovieHeader::CurrentVersion) {
+			std::cout << "[MOVIE] ::: Unknown movie format or version" << std::endl;
+			return false;
+		}
+
+		std::vector<bit8> packed(header.stateSize);
+		std::vector<bit8> encoded(header.eventBytes);
+		file.read(reinterpret_cast<char*>(packed.data()), packed.size());
+		file.read(reinterpret_cast<char*>(encoded.data()), encoded.size());
+		if (!file.good() ||
+			LzCodec::decompress(packed.data(), packed.size(), reinterpret_cast<bit8*>(start.get()), sizeof(MachineState)) != sizeof(MachineState)) {
+			std::cout << "[MOVIE] ::: Truncated movie file " << path << std::endl;
+			return false;
+		}
+
+		events.clear();
+		events.reserve(header.eventCount);
+		bit64 last = start->ticks;
+		size_t pos = 0;
+		while (pos < encoded.size()) {
+			bit64 delta = 0;
+			int shift = 0;
+			while (pos < encoded.size() && (encoded[pos] & 0x80) && shift < 63) {
+				delta |= static_cast<bit64>(encoded[pos++] & 0x7F) << shift;
+				shift += 7;
+			}
+			if (pos + 2 > encoded.size()) {
+				std::cout << "[MOVIE] ::: Corrupted events on " << path << std::endl;
+				return false;
+			}
+			delta |= static_cast<bit64>(encoded[pos++]) << shift;
+			last += delta;
+			events.push_back(MovieEvent{ last, encoded[pos++] });
+		}
+
+		frames = header.frames;
+		endTicks = header.endTicks;
+		endHash = header.endHash;
+
+		printf("[MOVIE] ::: Loaded %s (%u frames, %zu changes)\n", path, frames, events.size());
+		return true;
+	}
+
+
+	/// <summary>
+	/// Restores the movie start state and starts feeding the recorded input
+	/// </summary>
+	/// <returns>If the start state was valid for the loaded cartridge</returns>
+	bool Movie::startPlayback() {
+		stop();
+		if (!ctrl->loadState(start.get())) { return false; }
+
+		next = 0;
+		nextTick = events.empty() ? NoEvent : events[0].ticks;
+		mode = MODE_PLAY;
+		ctrl->getInput()->setMovie(this);
+		return true;
+	}
+
+
+	/// <summary>
+	/// Stops recording (without saving) or playing
+	/// </summary>
+	void Movie::stop() {
+		if (mode == MODE_IDLE) { return; }
+
+		mode = MODE_IDLE;
+		ctrl->getInput()->setMovie(nullptr);
+	}
+
+
+	/// <summary>
+	/// Gets if the playback reached the recorded end
+	/// </summary>
+	/// <returns>Finished state</returns>
+	bool Movie::finished() {
+		return ctrl->getTicks() >= endTicks;
+	}
+
+
+	/// <summary>
+	/// Compares the machine state with the recorded end state
+	/// </summary>
+	/// <returns>If the replay ended on the recorded state</returns>
+	bool Movie::matchesEnd() {
+		return ctrl->getTicks() == endTicks && hashState() == endHash;
+	}
+
+
+	/// <summary>
+	/// Gets the recorded frame count
+	/// </summary>
+	/// <returns>Frame count</returns>
+	bit32 Movie::getFrames() {
+		return frames;
+	}
+
+
+	/// <summary>
+	/// Gets the recorded joypad changes
+	/// </summary>
+	/// <returns>Event count</returns>
+	size_t Movie::getEventCount() {
+		return events.size();
+	}
+
+
+	/// <summary>
+	/// Hashes the current machine state
+	/// </summary>
+	/// <returns>FNV-1a hash of the state</returns>
+	bit64 Movie::hashState() {
+		ctrl->saveState(scratch.get());
+
+		const bit8* bytes = reinterpret_cast<const bit8*>(scratch.get());
+		bit64 hash = 0xCBF29CE484222325ULL;
+		for (size_t i = 0; i < sizeof(MachineState); i++) {
+			hash = (hash ^ bytes[i]) * 0x100000001B3ULL;
+		}
+		return hash;
+	}
+} // namespace TheBoy
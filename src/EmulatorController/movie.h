@@ -0,0 +1,242 @@
+#pragma once
+#ifndef MOVIE_H
+#define MOVIE_H
+
+#include "common.h"
+#include <memory>
+#include <vector>
+
+namespace TheBoy {
+	class EmulatorController;
+	struct MachineState;
+
+	/// <summary>
+	/// Movie file header
+	/// Followed by the compressed start state and the events, each one a varint tick delta and the joypad mask
+	/// </summary>
+	typedef struct MovieHeader {
+		static const bit32 CurrentVersion = 1;
+
+		/// <summary>
+		/// 'TBMV'
+		/// </summary>
+		char magic[4];
+		bit32 version;
+
+		/// <summary>
+		/// Compressed start state and encoded events sizes
+		/// </summary>
+		bit32 stateSize;
+		bit32 eventBytes;
+		bit32 eventCount;
+
+		/// <summary>
+		/// Recorded length
+		/// </summary>
+		bit32 frames;
+		bit64 endTicks;
+
+		/// <summary>
+		/// Hash of the machine state at the end, a replay is bit exact when it ends on the same hash
+		/// </summary>
+		bit64 endHash;
+	} MovieHeader;
+
+
+	/// <summary>
+	/// Deterministic joypad movie
+	/// Starts from a machine state and holds every change of the joypad mask seen by the guest, stamped with
+	/// the emulated tick of the instruction boundary where it was latched. The input controller latches the
+	/// host mask only there, so the P1 reads and the joypad interrupt see a change at the same tick on a replay.
+	/// Record and playback run on the emulation thread
+	/// </summary>
+	class Movie {
+	public:
+		/// <summary>
+		/// Movie constructor
+		/// </summary>
+		/// <param name="ctrl">Controller reference</param>
+		Movie(EmulatorController* ctrl);
+
+
+		/// <summary>
+		/// Movie destructor
+		/// </summary>
+		~Movie();
+
+
+		/// <summary>
+		/// Starts recording from the current machine state, between instructions
+		/// </summary>
+		void startRecording();
+
+
+		/// <summary>
+		/// Stops recording and writes the movie file
+		/// </summary>
+		/// <param name="path">Target file path</param>
+		/// <returns>If the file was written</returns>
+		bool stopRecording(const char* path);
+
+
+		/// <summary>
+		/// Stores a joypad mask change, called by the input controller while recording
+		/// </summary>
+		/// <param name="ticks">Emulated tick of the change</param>
+		/// <param name="mask">New joypad mask</param>
+		void record(bit64 ticks, bit8 mask);
+
+
+		/// <summary>
+		/// Reads a movie file
+		/// </summary>
+		/// <param name="path">Source file path</param>
+		/// <returns>If the movie was read</returns>
+		bool load(const char* path);
+
+
+		/// <summary>
+		/// Restores the movie start state and starts feeding the recorded input
+		/// </summary>
+		/// <returns>If the start state was valid for the loaded cartridge</returns>
+		bool startPlayback();
+
+
+		/// <summary>
+		/// Stops recording (without saving) or playing
+		/// </summary>
+		void stop();
+
+
+		/// <summary>
+		/// Gets if the playback reached the recorded end
+		/// </summary>
+		/// <returns>Finished state</returns>
+		bool finished();
+
+
+		/// <summary>
+		/// Compares the machine state with the recorded end state
+		/// </summary>
+		/// <returns>If the replay ended on the recorded state</returns>
+		bool matchesEnd();
+
+
+		/// <summary>
+		/// Gets the recorded frame count
+		/// </summary>
+		/// <returns>Frame count</returns>
+		bit32 getFrames();
+
+
+		/// <summary>
+		/// Gets the recorded joypad changes
+		/// </summary>
+		/// <returns>Event count</returns>
+		size_t getEventCount();
+
+
+		/// <summary>
+		/// Gets if a movie is being recorded
+		/// </summary>
+		/// <returns>Recording state</returns>
+		bool isRecording() { return mode == MODE_RECORD; }
+
+
+		/// <summary>
+		/// Gets if a movie is being played
+		/// </summary>
+		/// <returns>Playing state</returns>
+		bool isPlaying() { return mode == MODE_PLAY; }
+
+
+		/// <summary>
+		/// Takes the next recorded mask once its tick is reached, called every instruction on playback
+		/// </summary>
+		/// <param name="ticks">Current emulated tick</param>
+		/// <param name="mask">Recorded mask output</param>
+		/// <returns>If a mask was taken</returns>
+		bool poll(bit64 ticks, bit8* mask) {
+			if (ticks < nextTick) { return false; }
+
+			*mask = events[next].mask;
+			next++;
+			nextTick = next < events.size() ? events[next].ticks : NoEvent;
+			return true;
+		}
+
+	private:
+		/// <summary>
+		/// Movie modes
+		/// </summary>
+		typedef enum MODE {
+			MODE_IDLE,
+			MODE_RECORD,
+			MODE_PLAY
+		} MODE;
+
+
+		/// <summary>
+		/// Joypad change
+		/// </summary>
+		typedef struct MovieEvent {
+			bit64 ticks;
+			bit8 mask;
+		} MovieEvent;
+
+
+		/// <summary>
+		/// Tick value past every event
+		/// </summary>
+		static const bit64 NoEvent = ~0ULL;
+
+
+		/// <summary>
+		/// Controller reference
+		/// </summary>
+		EmulatorController* ctrl;
+
+
+		/// <summary>
+		/// Current mode
+		/// </summary>
+		MODE mode;
+
+
+		/// <summary>
+		/// Start state and a scratch one for the end hash
+		/// </summary>
+		std::unique_ptr<MachineState> start;
+		std::unique_ptr<MachineState> scratch;
+
+
+		/// <summary>
+		/// Joypad changes
+		/// </summary>
+		std::vector<MovieEvent> events;
+
+
+		/// <summary>
+		/// Playback position
+		/// </summary>
+		size_t next;
+		bit64 nextTick;
+
+
+		/// <summary>
+		/// Recording start and recorded end
+		/// </summary>
+		bit32 startFrame;
+		bit32 frames;
+		bit64 endTicks;
+		bit64 endHash;
+
+
+		/// <summary>
+		/// Hashes the current machine state
+		/// </summary>
+		/// <returns>FNV-1a hash of the state</returns>
+		bit64 hashState();
+	};
+} // namespace TheBoy
+#endif // !MOVIE_H
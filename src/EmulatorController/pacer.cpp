@@ -0,0 +1,120 @@
+#include "pacer.h"
+#include <thread>
+#include <algorithm>
+
+namespace TheBoy {
+
+	/// <summary>
+	/// Pacer constructor
+	/// </summary>
+	Pacer::Pacer() {
+		spinMargin = std::chrono::milliseconds(2);
+		deadline = Clock::now();
+		fpsStart = deadline;
+		fpsFrames = 0;
+		fps = 0.0;
+		newFps = false;
+	}
+
+
+	/// <summary>
+	/// Defines the emulation speed multiplier, can be called from any thread
+	/// </summary>
+	/// <param name="mult">Speed multiplier, clamped to MinSpeed, Unlimited runs as fast as possible</param>
+	void Pacer::setSpeed(double mult) {
+		if (mult != Unlimited) { mult = std::max(mult, MinSpeed); }
+		speed.store(mult, std::memory_order_relaxed);
+	}
+
+
+	/// <summary>
+	/// Gets the emulation speed multiplier
+	/// </summary>
+	/// <returns>Speed multiplier, Unlimited when not paced</returns>
+	double Pacer::getSpeed() {
+		return speed.load(std::memory_order_relaxed);
+	}
+
+
+	/// <summary>
+	/// Marks the end of an emulated frame and waits for its deadline
+	/// Sleeps most of the wait and spins the last part, the os sleep is not precise enough for a frame
+	/// </summary>
+	/// <returns>If the frame finished after its deadline</returns>
+	bool Pacer::frameDone() {
+		Clock::time_point now = Clock::now();
+		bool late = false;
+
+		double mult = getSpeed();
+		if (mult == Unlimited) {
+			// Nothing to wait for, keeps the deadline ready for a return to a paced speed
+			deadline = now;
+		}
+		else {
+			// Accumulated deadline, the wait rounding never adds up as drift
+			Clock::duration period = std::chrono::nanoseconds(static_cast<bit64>(FramePeriodNs / mult));
+			deadline += period;
+
+			if (now >= deadline) {
+				late = true;
+				// More than a frame behind, drop the debt instead of running fast to catch up
+				if (now - deadline > period) { deadline = now; }
+			}
+			else {
+				waitUntil(deadline);
+			}
+		}
+
+		// Frames per second over the last wall clock second
+		fpsFrames++;
+		now = Clock::now();
+		Clock::duration elapsed = now - fpsStart;
+		if (elapsed >= std::chrono::seconds(1)) {
+			fps = fpsFrames / std::chrono::duration<double>(elapsed).count();
+			fpsFrames = 0;
+			fpsStart = now;
+			newFps = true;
+		}
+		return late;
+	}
+
+
+	/// <summary>
+	/// Marks if a new frame per second value was measured since the last call
+	/// </summary>
+	/// <returns>New fps measure available</returns>
+	bool Pacer::fpsUpdated() {
+		bool res = newFps;
+		newFps = false;
+		return res;
+	}
+
+
+	/// <summary>
+	/// Gets the last measured emulated frames per second
+	/// </summary>
+	/// <returns>Frames per second</returns>
+	double Pacer::getFps() { return fps; }
+
+
+	/// <summary>
+	/// Waits until the target time point
+	/// </summary>
+	/// <param name="target">Wait target</param>
+	void Pacer::waitUntil(Clock::time_point target) {
+		const Clock::duration minMargin = std::chrono::microseconds(500);
+		const Clock::duration maxMargin = std::chrono::milliseconds(4);
+
+		Clock::time_point wake = target - spinMargin;
+		if (Clock::now() < wake) {
+			std::this_thread::sleep_until(wake);
+
+			// Learn the os oversleep, a late wake grows the margin, an early one lets it decay
+			Clock::duration over = Clock::now() - wake;
+			if (over + minMargin > spinMargin) { spinMargin = std::min(over + minMargin, maxMargin); }
+			else { spinMargin = std::max(spinMargin - (spinMargin - over) / 64, minMargin); }
+		}
+
+		while (Clock::now() < target) { }
+	}
+} // namespace TheBoy
@@ -0,0 +1,135 @@
+#pragma once
+#ifndef PACER_H
+#define PACER_H
+
+#include "common.h"
+#include <atomic>
+#include <chrono>
+
+namespace TheBoy {
+
+	/// <summary>
+	/// Emulation frame pacing, keeps the emulated frames on the wall clock at a defined speed
+	/// Only the emulator controller frame loop calls it, the emulated components never read the clock
+	/// </summary>
+	class Pacer {
+	public:
+		/// <summary>
+		/// Emulated frame period, 70224 ticks of the 4194304 Hz clock, in ns
+		/// </summary>
+		static const bit64 FramePeriodNs = 1000000000ULL * 70224 / 4194304;
+
+
+		/// <summary>
+		/// Slowest allowed speed multiplier
+		/// </summary>
+		static constexpr double MinSpeed = 0.25;
+
+
+		/// <summary>
+		/// Speed multiplier value that disables the pacing
+		/// </summary>
+		static constexpr double Unlimited = 0.0;
+
+
+		/// <summary>
+		/// Pacer constructor
+		/// </summary>
+		Pacer();
+
+
+		/// <summary>
+		/// Pacer destructor
+		/// </summary>
+		~Pacer() = default;
+
+
+		/// <summary>
+		/// Defines the emulation speed multiplier, can be called from any thread
+		/// </summary>
+		/// <param name="mult">Speed multiplier, clamped to MinSpeed, Unlimited runs as fast as possible</param>
+		void setSpeed(double mult);
+
+
+		/// <summary>
+		/// Gets the emulation speed multiplier
+		/// </summary>
+		/// <returns>Speed multiplier, Unlimited when not paced</returns>
+		double getSpeed();
+
+
+		/// <summary>
+		/// Marks the end of an emulated frame and waits for its deadline
+		/// Sleeps most of the wait and spins the last part, the os sleep is not precise enough for a frame
+		/// </summary>
+		/// <returns>If the frame finished after its deadline</returns>
+		bool frameDone();
+
+
+		/// <summary>
+		/// Marks if a new frame per second value was measured since the last call
+		/// </summary>
+		/// <returns>New fps measure available</returns>
+		bool fpsUpdated();
+
+
+		/// <summary>
+		/// Gets the last measured emulated frames per second
+		/// </summary>
+		/// <returns>Frames per second</returns>
+		double getFps();
+
+	private:
+		typedef std::chrono::steady_clock Clock;
+
+		/// <summary>
+		/// Speed multiplier, written by the view thread
+		/// </summary>
+		std::atomic<double> speed{ 1.0 };
+
+
+		/// <summary>
+		/// Current frame deadline
+		/// </summary>
+		Clock::time_point deadline;
+
+
+		/// <summary>
+		/// Time left before the deadline that is spun instead of slept
+		/// Grows with the measured oversleep, slowly decays back
+		/// </summary>
+		Clock::duration spinMargin;
+
+
+		/// <summary>
+		/// Start of the current fps measure
+		/// </summary>
+		Clock::time_point fpsStart;
+
+
+		/// <summary>
+		/// Frames on the current fps measure
+		/// </summary>
+		bit32 fpsFrames;
+
+
+		/// <summary>
+		/// Last measured fps
+		/// </summary>
+		double fps;
+
+
+		/// <summary>
+		/// Marks a fps measure not yet read
+		/// </summary>
+		bool newFps;
+
+
+		/// <summary>
+		/// Waits until the target time point
+		/// </summary>
+		/// <param name="target">Wait target</param>
+		void waitUntil(Clock::time_point target);
+	};
+} // namespace TheBoy
+#endif // !PACER_H
@@ -0,0 +1,149 @@
+#include "presentScheduler.h"
+#include <thread>
+#include <algorithm>
+#include <cmath>
+
+namespace TheBoy {
+
+	/// <summary>
+	/// Present scheduler constructor
+	/// </summary>
+	PresentScheduler::PresentScheduler() {
+		vsync = false;
+		hasPresented = false;
+		lastFrame = 0;
+		intervalCount = 0;
+		dropped = 0;
+		repeated = 0;
+		newStats = false;
+		stats = PresentStats{ };
+
+		setRefreshRate(NativeRefreshHz);
+		deadline = Clock::now();
+	}
+
+
+	/// <summary>
+	/// Defines if the display vsync paces the presents
+	/// </summary>
+	/// <param name="enabled">Vsync state</param>
+	void PresentScheduler::setVsync(bool enabled) {
+		vsync = enabled;
+		deadline = Clock::now();
+	}
+
+
+	/// <summary>
+	/// Gets if the display vsync paces the presents
+	/// </summary>
+	/// <returns>Vsync state</returns>
+	bool PresentScheduler::getVsync() { return vsync; }
+
+
+	/// <summary>
+	/// Defines the present rate
+	/// </summary>
+	/// <param name="hz">Presents per second</param>
+	void PresentScheduler::setRefreshRate(double hz) {
+		period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / hz));
+	}
+
+
+	/// <summary>
+	/// Waits for the next present deadline, returns right away with vsync
+	/// Late presents resync the deadline instead of bursting to catch up
+	/// </summary>
+	void PresentScheduler::waitNextPresent() {
+		if (vsync) { return; }
+
+		// Accumulate the period so rounding on a single wait never drifts the rate
+		deadline += period;
+		Clock::time_point now = Clock::now();
+		if (now >= deadline) {
+			if (now - deadline > period) { deadline = now; }
+			return;
+		}
+
+		// Coarse sleep, the os timer may oversleep by a ms or more, then yield to the deadline
+		const Clock::duration spinMargin = std::chrono::milliseconds(2);
+		if (deadline - now > spinMargin) {
+			std::this_thread::sleep_until(deadline - spinMargin);
+		}
+		while (Clock::now() < deadline) {
+			std::this_thread::yield();
+		}
+	}
+
+
+	/// <summary>
+	/// Registers a present, called right after the window display
+	/// </summary>
+	/// <param name="frame">Emulated frame that was presented</param>
+	void PresentScheduler::markPresented(bit32 frame) {
+		Clock::time_point now = Clock::now();
+
+		if (hasPresented) {
+			intervals[intervalCount++] = std::chrono::duration<double, std::milli>(now - lastPresent).count();
+
+			// The frame counter goes back on a rewind, a state load or a run ahead toggle, nothing is counted then
+			if (frame == lastFrame) { repeated++; }
+			else if (frame > lastFrame && frame - lastFrame > 1) { dropped += frame - lastFrame - 1; }
+
+			if (intervalCount == StatsWindow) { closeWindow(); }
+		}
+
+		hasPresented = true;
+		lastPresent = now;
+		lastFrame = frame;
+	}
+
+
+	/// <summary>
+	/// Gets the last complete stats window
+	/// </summary>
+	/// <returns>Present stats</returns>
+	const PresentStats& PresentScheduler::getStats() { return stats; }
+
+
+	/// <summary>
+	/// Marks if a new stats window was completed since the last call
+	/// </summary>
+	/// <returns>New stats available</returns>
+	bool PresentScheduler::statsUpdated() {
+		bool res = newStats;
+		newStats = false;
+		return res;
+	}
+
+
+	/// <summary>
+	/// Builds the stats from the current window
+	/// </summary>
+	void PresentScheduler::closeWindow() {
+		const double target = std::chrono::duration<double, std::milli>(period).count();
+		double sum = 0.0;
+		double worst = 0.0;
+
+		for (int i = 0; i < intervalCount; i++) {
+			sum += intervals[i];
+			worst = std::max(worst, std::fabs(intervals[i] - target));
+		}
+		double mean = sum / intervalCount;
+
+		double var = 0.0;
+		for (int i = 0; i < intervalCount; i++) {
+			var += (intervals[i] - mean) * (intervals[i] - mean);
+		}
+
+		stats.meanMs = mean;
+		stats.jitterMs = std::sqrt(var / intervalCount);
+		stats.worstMs = worst;
+		stats.dropped = dropped;
+		stats.repeated = repeated;
+		newStats = true;
+
+		intervalCount = 0;
+		dropped = 0;
+		repeated = 0;
+	}
+} // namespace TheBoy
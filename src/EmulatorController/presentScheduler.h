@@ -0,0 +1,195 @@
+#pragma once
+#ifndef PRESENTSCHEDULER_H
+#define PRESENTSCHEDULER_H
+
+#include "common.h"
+#include <chrono>
+
+namespace TheBoy {
+
+	/// <summary>
+	/// Present to present timing statistics, over the last measure window
+	/// </summary>
+	typedef struct PresentStats {
+		/// <summary>
+		/// Average present interval in ms
+		/// </summary>
+		double meanMs;
+
+		/// <summary>
+		/// Present interval standard deviation in ms
+		/// </summary>
+		double jitterMs;
+
+		/// <summary>
+		/// Largest distance from the target period in ms
+		/// </summary>
+		double worstMs;
+
+		/// <summary>
+		/// Emulated frames that were never presented
+		/// </summary>
+		bit32 dropped;
+
+		/// <summary>
+		/// Presents without a new emulated frame
+		/// </summary>
+		bit32 repeated;
+	} PresentStats;
+
+
+	/// <summary>
+	/// Schedules the window presents on the emulated frame rate
+	/// Without vsync the deadlines are kept by the scheduler, with vsync the display paces and only the stats are measured
+	/// </summary>
+	class PresentScheduler {
+	public:
+		/// <summary>
+		/// Native Game Boy refresh rate, 4194304 Hz / 70224 ticks per frame
+		/// </summary>
+		static constexpr double NativeRefreshHz = 4194304.0 / 70224.0;
+
+
+		/// <summary>
+		/// Presents measured per stats window
+		/// </summary>
+		static const int StatsWindow = 120;
+
+
+		/// <summary>
+		/// Present scheduler constructor
+		/// </summary>
+		PresentScheduler();
+
+
+		/// <summary>
+		/// Present scheduler destructor
+		/// </summary>
+		~PresentScheduler() = default;
+
+
+		/// <summary>
+		/// Defines if the display vsync paces the presents
+		/// </summary>
+		/// <param name="enabled">Vsync state</param>
+		void setVsync(bool enabled);
+
+
+		/// <summary>
+		/// Gets if the display vsync paces the presents
+		/// </summary>
+		/// <returns>Vsync state</returns>
+		bool getVsync();
+
+
+		/// <summary>
+		/// Defines the present rate
+		/// </summary>
+		/// <param name="hz">Presents per second</param>
+		void setRefreshRate(double hz);
+
+
+		/// <summary>
+		/// Waits for the next present deadline, returns right away with vsync
+		/// Late presents resync the deadline instead of bursting to catch up
+		/// </summary>
+		void waitNextPresent();
+
+
+		/// <summary>
+		/// Registers a present, called right after the window display
+		/// </summary>
+		/// <param name="frame">Emulated frame that was presented</param>
+		void markPresented(bit32 frame);
+
+
+		/// <summary>
+		/// Gets the last complete stats window
+		/// </summary>
+		/// <returns>Present stats</returns>
+		const PresentStats& getStats();
+
+
+		/// <summary>
+		/// Marks if a new stats window was completed since the last call
+		/// </summary>
+		/// <returns>New stats available</returns>
+		bool statsUpdated();
+
+	private:
+		typedef std::chrono::steady_clock Clock;
+
+		/// <summary>
+		/// Vsync state
+		/// </summary>
+		bool vsync;
+
+
+		/// <summary>
+		/// Target present period
+		/// </summary>
+		Clock::duration period;
+
+
+		/// <summary>
+		/// Next present deadline
+		/// </summary>
+		Clock::time_point deadline;
+
+
+		/// <summary>
+		/// Last present time stamp
+		/// </summary>
+		Clock::time_point lastPresent;
+
+
+		/// <summary>
+		/// Marks that a present was already registered
+		/// </summary>
+		bool hasPresented;
+
+
+		/// <summary>
+		/// Last presented emulated frame
+		/// </summary>
+		bit32 lastFrame;
+
+
+		/// <summary>
+		/// Present intervals on the current window, in ms
+		/// </summary>
+		double intervals[StatsWindow];
+
+
+		/// <summary>
+		/// Intervals on the current window
+		/// </summary>
+		int intervalCount;
+
+
+		/// <summary>
+		/// Dropped and repeated frames on the current window
+		/// </summary>
+		bit32 dropped;
+		bit32 repeated;
+
+
+		/// <summary>
+		/// Last complete window stats
+		/// </summary>
+		PresentStats stats;
+
+
+		/// <summary>
+		/// Marks a complete window not yet read
+		/// </summary>
+		bool newStats;
+
+
+		/// <summary>
+		/// Builds the stats from the current window
+		/// </summary>
+		void closeWindow();
+	};
+} // namespace TheBoy
+#endif // !PRESENTSCHEDULER_H
@@ -0,0 +1,301 @@
+#include "rewinder.h"
+#include "emulatorController.h"
+#include "machineState.h"
+#include "lzCodec.h"
+#include <chrono>
+#include <cstring>
+
+namespace TheBoy {
+
+	/// <summary>
+	/// Xors two buffers, 8 bytes at a time
+	/// </summary>
+	/// <param name="a">First source</param>
+	/// <param name="b">Second source</param>
+	/// <param name="out">Destination, may be one of the sources</param>
+	/// <param name="len">Length in bytes</param>
+	static void xorBlocks(const bit8* a, const bit8* b, bit8* out, size_t len) {
+		size_t i = 0;
+		for (; i + 8 <= len; i += 8) {
+			bit64 va, vb;
+			memcpy(&va, a + i, 8);
+			memcpy(&vb, b + i, 8);
+			va ^= vb;
+			memcpy(out + i, &va, 8);
+		}
+		for (; i < len; i++) { out[i] = a[i] ^ b[i]; }
+	}
+
+
+	/// <summary>
+	/// Rewinder constructor
+	/// </summary>
+	/// <param name="ctrl">Controller reference</param>
+	/// <param name="budget">Arena size in bytes, bounds the rewind memory</param>
+	/// <param name="interval">Frames between two snapshots</param>
+	Rewinder::Rewinder(EmulatorController* ctrl, size_t budget, bit32 interval) {
+		this->ctrl = ctrl;
+
+		// At least two worst case deltas, so a capture never evicts the snapshot it is based on
+		size_t minBudget = LzCodec::bound(sizeof(MachineState)) * 2;
+		arena.resize(budget < minBudget ? minBudget : budget);
+		entries.resize(MaxEntries);
+
+		latest = std::make_unique<MachineState>();
+		work = std::make_unique<MachineState>();
+		delta.resize(sizeof(MachineState));
+		hashTable.resize(LzCodec::HashSize);
+		inputLog.resize(InputLogSize);
+
+		avgCaptureUs = 0;
+		worstCaptureUs = 0;
+		captures = 0;
+		replaying = false;
+
+		autoInterval = true;
+		setInterval(interval);
+		clear();
+
+		printf("[REWIND] ::: %zu KB arena, snapshot every %u frames\n", arena.size() / 1024, this->interval);
+	}
+
+
+	/// <summary>
+	/// Rewinder destructor
+	/// </summary>
+	Rewinder::~Rewinder() {
+	}
+
+
+	/// <summary>
+	/// Per frame work, captures a snapshot or steps back while rewinding
+	/// Called by the controller frame end
+	/// </summary>
+	void Rewinder::frameEnd() {
+		if (rewinding.load(std::memory_order_acquire)) {
+			// Lands on the snapshots, the replay is at most one frame
+			stepBack(interval);
+			return;
+		}
+
+		bit32 frame = ctrl->getPpu()->getCurrentFrame();
+		if (count == 0 || frame - entryAt(count - 1).frame >= interval) {
+			capture(frame);
+		}
+	}
+
+
+	/// <summary>
+	/// Moves the emulation back
+	/// </summary>
+	/// <param name="frames">Frames to go back, clamped to the oldest snapshot</param>
+	/// <returns>If the machine was moved</returns>
+	bool Rewinder::stepBack(bit32 frames) {
+		// A recorded movie and a linked partner only go forward
+		bool linked = ctrl->getLink() && ctrl->getLink()->isConnected();
+		if (count == 0 || ctrl->getMovie()->isRecording() || ctrl->getMovie()->isPlaying() || linked) { return false; }
+
+		std::shared_ptr<Ppu> ppu = ctrl->getPpu();
+		std::shared_ptr<InputController> input = ctrl->getInput();
+
+		bit32 current = ppu->getCurrentFrame();
+		bit32 oldest = entryAt(0).frame;
+		bit32 target = (current - oldest > frames) ? current - frames : oldest;
+		if (target >= current) { return false; }
+
+		// Walks the chain back to the nearest snapshot at or before the target
+		while (count > 1 && entryAt(count - 1).frame > target) {
+			Entry& newest = entryAt(count - 1);
+			size_t size = LzCodec::decompress(&arena[newest.offset], newest.size, delta.data(), delta.size());
+			if (size != sizeof(MachineState)) {
+				std::cout << "[REWIND] ::: Corrupted snapshot, buffer dropped" << std::endl;
+				clear();
+				return false;
+			}
+			xorBlocks(reinterpret_cast<const bit8*>(latest.get()), delta.data(),
+				reinterpret_cast<bit8*>(latest.get()), sizeof(MachineState));
+
+			bytesUsed -= newest.size;
+			arenaHead = newest.offset;
+			count--;
+		}
+
+		if (!ctrl->loadState(latest.get())) { return false; }
+
+		// Re-emulates up to the target with the joypad changes latched after the snapshot, at their ticks
+		bit64 start = ctrl->getTicks();
+		bit64 oldestChange = inputHead > InputLogSize ? inputHead - InputLogSize : 0;
+		replayNext = inputHead;
+		while (replayNext > oldestChange && inputLog[(replayNext - 1) & (InputLogSize - 1)].ticks >= start) { replayNext--; }
+
+		replaying = true;
+		while (ctrl->isRunning() && ppu->getCurrentFrame() < target) {
+			ctrl->runFrame();
+		}
+		replaying = false;
+
+		// The changes past the landing point belong to the timeline that was left
+		inputHead = replayNext;
+		input->resyncHost();
+		return true;
+	}
+
+
+	/// <summary>
+	/// Keeps a latched joypad change, called by the input controller like Movie::record
+	/// </summary>
+	/// <param name="ticks">Emulated tick of the latch</param>
+	/// <param name="mask">Latched mask</param>
+	void Rewinder::record(bit64 ticks, bit8 mask) {
+		inputLog[inputHead & (InputLogSize - 1)] = InputEvent{ ticks, mask };
+		inputHead++;
+	}
+
+
+	/// <summary>
+	/// Drops every snapshot, used when the machine is changed from outside (state load)
+	/// </summary>
+	void Rewinder::clear() {
+		arenaHead = 0;
+		first = 0;
+		count = 0;
+		bytesUsed = 0;
+		inputHead = 0;
+		replayNext = 0;
+	}
+
+
+	/// <summary>
+	/// Starts or stops rewinding, can be called from any thread
+	/// </summary>
+	/// <param name="state">Rewind while true</param>
+	void Rewinder::setRewinding(bool state) {
+		rewinding.store(state, std::memory_order_release);
+	}
+
+
+	/// <summary>
+	/// Defines the frames between two snapshots
+	/// </summary>
+	/// <param name="frames">Snapshot interval, clamped from 1 to MaxInterval</param>
+	void Rewinder::setInterval(bit32 frames) {
+		interval = frames < 1 ? 1 : (frames > MaxInterval ? MaxInterval : frames);
+	}
+
+
+	/// <summary>
+	/// Enables the automatic interval growth when the capture cost goes above MaxFrameCostPct
+	/// </summary>
+	/// <param name="state">Auto interval state</param>
+	void Rewinder::setAutoInterval(bool state) {
+		autoInterval = state;
+	}
+
+
+	/// <summary>
+	/// Gets the buffer usage and cost
+	/// </summary>
+	/// <returns>Rewind stats</returns>
+	RewindStats Rewinder::getStats() {
+		const double fps = 1000000000.0 / Pacer::FramePeriodNs;
+		const double frameUs = Pacer::FramePeriodNs / 1000.0;
+
+		RewindStats stats{};
+		stats.interval = interval;
+		stats.entries = count;
+		stats.bytesUsed = bytesUsed;
+		stats.budget = arena.size();
+		stats.avgCaptureUs = avgCaptureUs;
+		stats.worstCaptureUs = worstCaptureUs;
+		stats.frameCostPct = avgCaptureUs / interval / frameUs * 100.0;
+
+		if (count > 0) {
+			stats.secondsCovered = (ctrl->getPpu()->getCurrentFrame() - entryAt(0).frame) / fps;
+		}
+		if (count > 1) {
+			// The oldest payload is not counted, it is the empty first one or an orphan of an eviction
+			double perEntry = static_cast<double>(bytesUsed - entryAt(0).size) / (count - 1);
+			stats.bytesPerMinute = perEntry * (fps * 60.0 / interval);
+		}
+		return stats;
+	}
+
+
+	/// <summary>
+	/// Captures the current machine as the newest snapshot
+	/// </summary>
+	/// <param name="frame">Current ppu frame</param>
+	void Rewinder::capture(bit32 frame) {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+		ctrl->saveState(work.get());
+
+		Entry entry{ arenaHead, 0, frame };
+		if (count > 0) {
+			xorBlocks(reinterpret_cast<const bit8*>(work.get()), reinterpret_cast<const bit8*>(latest.get()),
+				delta.data(), sizeof(MachineState));
+
+			size_t need = LzCodec::bound(sizeof(MachineState));
+			entry.offset = reserve(need);
+			entry.size = LzCodec::compress(delta.data(), sizeof(MachineState), &arena[entry.offset], need, hashTable.data());
+		}
+
+		if (count == MaxEntries) { evictOldest(); }
+		entryAt(count) = entry;
+		count++;
+		bytesUsed += entry.size;
+		arenaHead = entry.offset + entry.size;
+		latest.swap(work);
+
+		double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+		avgCaptureUs = captures == 0 ? us : avgCaptureUs + (us - avgCaptureUs) / 16.0;
+		if (us > worstCaptureUs) { worstCaptureUs = us; }
+		captures++;
+
+		// Keeps the capture cost bound, the average is spread over the frames of an interval
+		double costPct = avgCaptureUs / interval / (Pacer::FramePeriodNs / 1000.0) * 100.0;
+		if (autoInterval && captures >= 16 && costPct > MaxFrameCostPct && interval < MaxInterval) {
+			setInterval(interval * 2);
+			printf("[REWIND] ::: Capture cost %.1f%% of a frame, snapshot every %u frames\n", costPct, interval);
+		}
+	}
+
+
+	/// <summary>
+	/// Reserves arena space for a new snapshot, evicting the oldest ones on the way
+	/// The snapshots ahead of the head are always older than the ones behind it
+	/// </summary>
+	/// <param name="need">Bytes needed</param>
+	/// <returns>Arena offset</returns>
+	size_t Rewinder::reserve(size_t need) {
+		size_t pos = arenaHead;
+		if (pos + need > arena.size()) {
+			// The arena tail is skipped, the snapshots left there are the oldest
+			while (count > 0 && entryAt(0).offset >= pos) { evictOldest(); }
+			pos = 0;
+		}
+
+		while (count > 0 && entryAt(0).offset >= pos && entryAt(0).offset < pos + need) { evictOldest(); }
+		return pos;
+	}
+
+
+	/// <summary>
+	/// Drops the oldest snapshot
+	/// </summary>
+	void Rewinder::evictOldest() {
+		bytesUsed -= entryAt(0).size;
+		first = (first + 1) % MaxEntries;
+		count--;
+	}
+
+
+	/// <summary>
+	/// Gets a snapshot by age
+	/// </summary>
+	/// <param name="index">0 for the oldest</param>
+	/// <returns>Snapshot entry</returns>
+	Rewinder::Entry& Rewinder::entryAt(bit32 index) {
+		return entries[(first + index) % MaxEntries];
+	}
+} // namespace TheBoy
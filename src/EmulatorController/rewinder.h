@@ -0,0 +1,312 @@
+#pragma once
+#ifndef REWINDER_H
+#define REWINDER_H
+
+#include "common.h"
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace TheBoy {
+	class EmulatorController;
+	struct MachineState;
+
+	/// <summary>
+	/// Rewind buffer usage and cost
+	/// </summary>
+	typedef struct RewindStats {
+		/// <summary>
+		/// Frames between two snapshots
+		/// </summary>
+		bit32 interval;
+
+		/// <summary>
+		/// Snapshots held
+		/// </summary>
+		bit32 entries;
+
+		/// <summary>
+		/// Arena bytes used by the snapshots and the arena size
+		/// </summary>
+		size_t bytesUsed;
+		size_t budget;
+
+		/// <summary>
+		/// Emulated time between the oldest snapshot and now
+		/// </summary>
+		double secondsCovered;
+
+		/// <summary>
+		/// Arena bytes taken by a minute of emulation, at the current interval
+		/// </summary>
+		double bytesPerMinute;
+
+		/// <summary>
+		/// Snapshot capture time (save, delta and compression)
+		/// </summary>
+		double avgCaptureUs;
+		double worstCaptureUs;
+
+		/// <summary>
+		/// Average capture time spread over the interval, as a percent of the emulated frame period
+		/// </summary>
+		double frameCostPct;
+	} RewindStats;
+
+
+	/// <summary>
+	/// Rewind buffer, a fixed memory ring of machine snapshots taken every interval frames
+	/// The newest snapshot is kept whole, every other one is stored as the compressed xor against the
+	/// snapshot after it, so walking back is one decompress and xor per snapshot.
+	/// Stepping back restores the nearest snapshot and replays the recorded joypad changes, at their ticks, up to the target frame.
+	/// Every buffer is allocated on construction, the frame work does not allocate.
+	/// Runs on the emulation thread, only setRewinding may be called from other threads
+	/// </summary>
+	class Rewinder {
+	public:
+		/// <summary>
+		/// Default arena size
+		/// </summary>
+		static constexpr size_t DefaultBudget = 32 * 1024 * 1024;
+
+
+		/// <summary>
+		/// Default frames between two snapshots
+		/// </summary>
+		static constexpr bit32 DefaultInterval = 4;
+
+
+		/// <summary>
+		/// Interval ceiling for the automatic cost bound
+		/// </summary>
+		static constexpr bit32 MaxInterval = 64;
+
+
+		/// <summary>
+		/// Allowed capture cost, percent of the emulated frame period
+		/// </summary>
+		static constexpr double MaxFrameCostPct = 5.0;
+
+
+		/// <summary>
+		/// Snapshot ring size
+		/// </summary>
+		static const bit32 MaxEntries = 1 << 14;
+
+
+		/// <summary>
+		/// Recorded joypad changes ring, a power of 2
+		/// </summary>
+		static const bit32 InputLogSize = 1 << 16;
+
+
+		/// <summary>
+		/// Rewinder constructor
+		/// </summary>
+		/// <param name="ctrl">Controller reference</param>
+		/// <param name="budget">Arena size in bytes, bounds the rewind memory</param>
+		/// <param name="interval">Frames between two snapshots</param>
+		Rewinder(EmulatorController* ctrl, size_t budget = DefaultBudget, bit32 interval = DefaultInterval);
+
+
+		/// <summary>
+		/// Rewinder destructor
+		/// </summary>
+		~Rewinder();
+
+
+		/// <summary>
+		/// Per frame work, captures a snapshot or steps back while rewinding
+		/// Called by the controller frame end
+		/// </summary>
+		void frameEnd();
+
+
+		/// <summary>
+		/// Keeps a latched joypad change, called by the input controller like Movie::record
+		/// </summary>
+		/// <param name="ticks">Emulated tick of the latch</param>
+		/// <param name="mask">Latched mask</param>
+		void record(bit64 ticks, bit8 mask);
+
+
+		/// <summary>
+		/// Gets if a step back is replaying the recorded joypad changes
+		/// </summary>
+		/// <returns>Replay state</returns>
+		bool isReplaying() { return replaying; }
+
+
+		/// <summary>
+		/// Takes the next recorded mask once its tick is reached, called every instruction on replay
+		/// </summary>
+		/// <param name="ticks">Current emulated tick</param>
+		/// <param name="mask">Recorded mask output</param>
+		/// <returns>If a mask was taken</returns>
+		bool poll(bit64 ticks, bit8* mask) {
+			if (replayNext == inputHead || ticks < inputLog[replayNext & (InputLogSize - 1)].ticks) { return false; }
+
+			*mask = inputLog[replayNext & (InputLogSize - 1)].mask;
+			replayNext++;
+			return true;
+		}
+
+
+		/// <summary>
+		/// Moves the emulation back
+		/// </summary>
+		/// <param name="frames">Frames to go back, clamped to the oldest snapshot</param>
+		/// <returns>If the machine was moved</returns>
+		bool stepBack(bit32 frames);
+
+
+		/// <summary>
+		/// Drops every snapshot, used when the machine is changed from outside (state load)
+		/// </summary>
+		void clear();
+
+
+		/// <summary>
+		/// Starts or stops rewinding, can be called from any thread
+		/// </summary>
+		/// <param name="state">Rewind while true</param>
+		void setRewinding(bool state);
+
+
+		/// <summary>
+		/// Defines the frames between two snapshots
+		/// </summary>
+		/// <param name="frames">Snapshot interval, clamped from 1 to MaxInterval</param>
+		void setInterval(bit32 frames);
+
+
+		/// <summary>
+		/// Enables the automatic interval growth when the capture cost goes above MaxFrameCostPct
+		/// </summary>
+		/// <param name="state">Auto interval state</param>
+		void setAutoInterval(bool state);
+
+
+		/// <summary>
+		/// Gets the buffer usage and cost
+		/// </summary>
+		/// <returns>Rewind stats</returns>
+		RewindStats getStats();
+
+	private:
+		/// <summary>
+		/// Snapshot on the arena
+		/// </summary>
+		typedef struct Entry {
+			size_t offset;
+			size_t size;
+			bit32 frame;
+		} Entry;
+
+
+		/// <summary>
+		/// Controller reference
+		/// </summary>
+		EmulatorController* ctrl;
+
+
+		/// <summary>
+		/// Compressed deltas storage
+		/// </summary>
+		std::vector<bit8> arena;
+		size_t arenaHead;
+		size_t bytesUsed;
+
+
+		/// <summary>
+		/// Snapshot ring, oldest at first
+		/// </summary>
+		std::vector<Entry> entries;
+		bit32 first;
+		bit32 count;
+
+
+		/// <summary>
+		/// Newest snapshot, whole
+		/// </summary>
+		std::unique_ptr<MachineState> latest;
+
+
+		/// <summary>
+		/// Capture and restore scratch buffers
+		/// </summary>
+		std::unique_ptr<MachineState> work;
+		std::vector<bit8> delta;
+		std::vector<bit32> hashTable;
+
+
+		/// <summary>
+		/// Joypad change
+		/// </summary>
+		typedef struct InputEvent {
+			bit64 ticks;
+			bit8 mask;
+		} InputEvent;
+
+
+		/// <summary>
+		/// Joypad changes ring, inputHead counts every recorded change
+		/// replayNext is the next change to replay while replaying
+		/// </summary>
+		std::vector<InputEvent> inputLog;
+		bit64 inputHead;
+		bit64 replayNext;
+		bool replaying;
+
+
+		/// <summary>
+		/// Snapshot interval
+		/// </summary>
+		bit32 interval;
+		bool autoInterval;
+
+
+		/// <summary>
+		/// Rewind requested by the view
+		/// </summary>
+		std::atomic<bool> rewinding{ false };
+
+
+		/// <summary>
+		/// Capture timing
+		/// </summary>
+		double avgCaptureUs;
+		double worstCaptureUs;
+		bit64 captures;
+
+
+		/// <summary>
+		/// Captures the current machine as the newest snapshot
+		/// </summary>
+		/// <param name="frame">Current ppu frame</param>
+		void capture(bit32 frame);
+
+
+		/// <summary>
+		/// Reserves arena space for a new snapshot, evicting the oldest ones on the way
+		/// </summary>
+		/// <param name="need">Bytes needed</param>
+		/// <returns>Arena offset</returns>
+		size_t reserve(size_t need);
+
+
+		/// <summary>
+		/// Drops the oldest snapshot
+		/// </summary>
+		void evictOldest();
+
+
+		/// <summary>
+		/// Gets a snapshot by age
+		/// </summary>
+		/// <param name="index">0 for the oldest</param>
+		/// <returns>Snapshot entry</returns>
+		Entry& entryAt(bit32 index);
+	};
+} // namespace TheBoy
+#endif // !REWINDER_H
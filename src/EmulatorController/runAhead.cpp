@@ -0,0 +1,252 @@
+#include "runAhead.h"
+#include "emulatorController.h"
+#include "machineState.h"
+#include <chrono>
+#include <cstring>
+
+namespace TheBoy {
+
+	/// <summary>
+	/// Run ahead constructor
+	/// </summary>
+	/// <param name="ctrl">Controller reference</param>
+	/// <param name="romPath">Loaded rom, the shadow instance loads it again</param>
+	RunAhead::RunAhead(EmulatorController* ctrl, const char* romPath) {
+		this->ctrl = ctrl;
+		this->romPath = romPath;
+
+		saved = std::make_unique<MachineState>();
+		for (int i = 0; i < 3; i++) { output[i] = std::make_unique<bit32[]>(Ppu::xRes * Ppu::yRes); }
+		writeSlot = 0;
+		readSlot = 2;
+		readValid = false;
+
+		handoffInput = 0;
+		handoffFrames = 0;
+		handoffPending = false;
+		shadowStop = false;
+
+		avgCostUs = 0;
+		avgStateUs = 0;
+	}
+
+
+	/// <summary>
+	/// Run ahead destructor, stops the shadow thread
+	/// </summary>
+	RunAhead::~RunAhead() {
+		stopShadow();
+	}
+
+
+	/// <summary>
+	/// Per frame work, runs the speculative frames or hands the state to the shadow instance
+	/// Called by the controller frame end, must not be called while speculating
+	/// </summary>
+	void RunAhead::frameEnd() {
+		bit32 count = frames.load(std::memory_order_relaxed);
+		if (count == 0) { return; }
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		if (threaded.load(std::memory_order_relaxed) && (shadow || startShadow())) {
+			runThreaded(count);
+		}
+		else {
+			runInline(count);
+		}
+		double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+		avgCostUs += (us - avgCostUs) / 16.0;
+	}
+
+
+	/// <summary>
+	/// Defines the frames to run ahead
+	/// </summary>
+	/// <param name="frames">Run ahead frames, 0 disables, clamped to MaxFrames</param>
+	void RunAhead::setFrames(bit32 frames) {
+		frames = frames > MaxFrames ? MaxFrames : frames;
+		if (frames == 0) { cleared = true; }
+		this->frames = frames;
+		printf("[RUNAHEAD] ::: %u frames%s\n", frames, threaded ? " (threaded)" : "");
+	}
+
+
+	/// <summary>
+	/// Gets the frames to run ahead
+	/// </summary>
+	/// <returns>Run ahead frames, 0 when disabled</returns>
+	bit32 RunAhead::getFrames() {
+		return frames;
+	}
+
+
+	/// <summary>
+	/// Moves the speculative frames to the shadow instance thread, or back to the emulation thread
+	/// </summary>
+	/// <param name="state">Threaded state</param>
+	void RunAhead::setThreaded(bool state) {
+		threaded = state;
+		printf("[RUNAHEAD] ::: Speculative frames on the %s thread\n", state ? "shadow" : "emulation");
+	}
+
+
+	/// <summary>
+	/// Gets if the speculative frames run on the shadow instance thread
+	/// </summary>
+	/// <returns>Threaded state</returns>
+	bool RunAhead::isThreaded() {
+		return threaded;
+	}
+
+
+	/// <summary>
+	/// Gets the last speculative frame, view thread only
+	/// The buffer stays untouched until the next call
+	/// </summary>
+	/// <returns>Frame buffer, null when disabled or none published yet</returns>
+	const bit32* RunAhead::getFrame() {
+		if (frames.load(std::memory_order_relaxed) == 0) { return nullptr; }
+		if (cleared.exchange(false, std::memory_order_relaxed)) { readValid = false; }
+
+		// Claims the newest frame, the writers then never touch the claimed slot
+		if (latest.load(std::memory_order_relaxed) & FreshSlot) {
+			readSlot = latest.exchange(readSlot, std::memory_order_acq_rel) & SlotMask;
+			readValid = true;
+		}
+		return readValid ? output[readSlot].get() : nullptr;
+	}
+
+
+	/// <summary>
+	/// Gets the frames and cost, emulation thread only
+	/// </summary>
+	/// <returns>Run ahead stats</returns>
+	RunAheadStats RunAhead::getStats() {
+		RunAheadStats stats{};
+		stats.frames = frames;
+		stats.threaded = threaded && shadow;
+		stats.avgCostUs = avgCostUs;
+		stats.avgStateUs = avgStateUs;
+		stats.published = published;
+		return stats;
+	}
+
+
+	/// <summary>
+	/// Runs the speculative frames on the emulation thread
+	/// </summary>
+	/// <param name="count">Frames ahead</param>
+	void RunAhead::runInline(bit32 count) {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		ctrl->saveState(saved.get());
+		double saveUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+		ctrl->setSpeculative(true);
+		for (bit32 i = 0; i < count && ctrl->isRunning(); i++) {
+			ctrl->runFrame();
+		}
+		ctrl->setSpeculative(false);
+		publish(ctrl->getPpu()->getPpuBuffer());
+
+		start = std::chrono::steady_clock::now();
+		ctrl->loadState(saved.get());
+		double loadUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+		avgStateUs += (saveUs + loadUs - avgStateUs) / 16.0;
+	}
+
+
+	/// <summary>
+	/// Hands the current state to the shadow instance
+	/// </summary>
+	/// <param name="count">Frames ahead</param>
+	void RunAhead::runThreaded(bit32 count) {
+		{
+			std::lock_guard<std::mutex> lock(handoffLock);
+			// Saved straight into the handoff, a state the shadow did not take yet is replaced
+			ctrl->saveState(handoff.get());
+			handoffInput = ctrl->getInput()->getPressedMask();
+			handoffFrames = count;
+			handoffPending = true;
+		}
+		handoffCond.notify_one();
+	}
+
+
+	/// <summary>
+	/// Starts the shadow instance and its thread
+	/// </summary>
+	/// <returns>If the shadow instance is running</returns>
+	bool RunAhead::startShadow() {
+		std::unique_ptr<EmulatorController> instance = std::make_unique<EmulatorController>();
+		if (!instance->Load(romPath.c_str(), true)) {
+			std::cout << "[RUNAHEAD] ::: Failed to load the shadow instance, running inline" << std::endl;
+			threaded = false;
+			return false;
+		}
+		instance->getCartridge()->disableBatterySaves();
+
+		handoff = std::make_unique<MachineState>();
+		shadowState = std::make_unique<MachineState>();
+		shadow = std::move(instance);
+		shadowStop = false;
+		shadowThread = std::make_unique<std::thread>(&RunAhead::shadowLoop, this);
+		return true;
+	}
+
+
+	/// <summary>
+	/// Stops the shadow thread
+	/// </summary>
+	void RunAhead::stopShadow() {
+		if (!shadowThread) { return; }
+		{
+			std::lock_guard<std::mutex> lock(handoffLock);
+			shadowStop = true;
+		}
+		handoffCond.notify_one();
+		shadowThread->join();
+		shadowThread.reset();
+	}
+
+
+	/// <summary>
+	/// Shadow instance thread loop
+	/// </summary>
+	void RunAhead::shadowLoop() {
+		while (true) {
+			bit8 input;
+			bit32 count;
+			{
+				std::unique_lock<std::mutex> lock(handoffLock);
+				handoffCond.wait(lock, [this] { return handoffPending || shadowStop; });
+				if (shadowStop) { return; }
+
+				// Taken out of the lock, the emulation thread may hand a new one meanwhile
+				shadowState.swap(handoff);
+				input = handoffInput;
+				count = handoffFrames;
+				handoffPending = false;
+			}
+
+			if (!shadow->loadState(shadowState.get())) { continue; }
+			shadow->getInput()->publishState(input);
+			for (bit32 i = 0; i < count && shadow->isRunning(); i++) {
+				shadow->runFrame();
+			}
+			publish(shadow->getPpu()->getPpuBuffer());
+		}
+	}
+
+
+	/// <summary>
+	/// Copies a finished frame to the write buffer and publishes it
+	/// </summary>
+	/// <param name="frame">Source frame</param>
+	void RunAhead::publish(const bit32* frame) {
+		std::lock_guard<std::mutex> lock(publishLock);
+		memcpy(output[writeSlot].get(), frame, sizeof(bit32) * Ppu::xRes * Ppu::yRes);
+		writeSlot = latest.exchange(writeSlot | FreshSlot, std::memory_order_acq_rel) & SlotMask;
+		published++;
+	}
+} // namespace TheBoy
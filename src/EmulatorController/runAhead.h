@@ -0,0 +1,247 @@
+#pragma once
+#ifndef RUNAHEAD_H
+#define RUNAHEAD_H
+
+#include "common.h"
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace TheBoy {
+	class EmulatorController;
+	struct MachineState;
+
+	/// <summary>
+	/// Run ahead frames and cost
+	/// </summary>
+	typedef struct RunAheadStats {
+		/// <summary>
+		/// Frames emulated ahead of the real one
+		/// </summary>
+		bit32 frames;
+
+		/// <summary>
+		/// Speculative frames run on the shadow instance thread
+		/// </summary>
+		bool threaded;
+
+		/// <summary>
+		/// Average time taken from the emulation thread per frame (save, run ahead and restore when inline)
+		/// </summary>
+		double avgCostUs;
+
+		/// <summary>
+		/// Average save plus restore time of the machine state
+		/// </summary>
+		double avgStateUs;
+
+		/// <summary>
+		/// Speculative frames published
+		/// </summary>
+		bit64 published;
+	} RunAheadStats;
+
+
+	/// <summary>
+	/// Run ahead input latency reduction
+	/// On each frame end the machine is saved, emulated some frames ahead with the current joypad mask and the
+	/// future frame is published for the view, then the machine is rolled back to the saved state.
+	/// Threaded mode leaves the main instance alone: the state is handed to a headless shadow instance that
+	/// runs the speculative frames on its own thread, the emulation thread only pays the save.
+	/// Called from the emulation thread, the setters and getFrame may be called from any thread
+	/// </summary>
+	class RunAhead {
+	public:
+		/// <summary>
+		/// Largest run ahead, games rarely react later than this
+		/// </summary>
+		static const bit32 MaxFrames = 4;
+
+
+		/// <summary>
+		/// Run ahead constructor
+		/// </summary>
+		/// <param name="ctrl">Controller reference</param>
+		/// <param name="romPath">Loaded rom, the shadow instance loads it again</param>
+		RunAhead(EmulatorController* ctrl, const char* romPath);
+
+
+		/// <summary>
+		/// Run ahead destructor, stops the shadow thread
+		/// </summary>
+		~RunAhead();
+
+
+		/// <summary>
+		/// Per frame work, runs the speculative frames or hands the state to the shadow instance
+		/// Called by the controller frame end, must not be called while speculating
+		/// </summary>
+		void frameEnd();
+
+
+		/// <summary>
+		/// Defines the frames to run ahead
+		/// </summary>
+		/// <param name="frames">Run ahead frames, 0 disables, clamped to MaxFrames</param>
+		void setFrames(bit32 frames);
+
+
+		/// <summary>
+		/// Gets the frames to run ahead
+		/// </summary>
+		/// <returns>Run ahead frames, 0 when disabled</returns>
+		bit32 getFrames();
+
+
+		/// <summary>
+		/// Moves the speculative frames to the shadow instance thread, or back to the emulation thread
+		/// </summary>
+		/// <param name="state">Threaded state</param>
+		void setThreaded(bool state);
+
+
+		/// <summary>
+		/// Gets if the speculative frames run on the shadow instance thread
+		/// </summary>
+		/// <returns>Threaded state</returns>
+		bool isThreaded();
+
+
+		/// <summary>
+		/// Gets the last speculative frame, view thread only
+		/// The buffer stays untouched until the next call
+		/// </summary>
+		/// <returns>Frame buffer, null when disabled or none published yet</returns>
+		const bit32* getFrame();
+
+
+		/// <summary>
+		/// Gets the frames and cost, emulation thread only
+		/// </summary>
+		/// <returns>Run ahead stats</returns>
+		RunAheadStats getStats();
+
+	private:
+		/// <summary>
+		/// Controller reference
+		/// </summary>
+		EmulatorController* ctrl;
+
+
+		/// <summary>
+		/// Rom path for the shadow instance
+		/// </summary>
+		std::string romPath;
+
+
+		/// <summary>
+		/// Run ahead frames and mode, written by the view
+		/// </summary>
+		std::atomic<bit32> frames{ 0 };
+		std::atomic<bool> threaded{ false };
+
+
+		/// <summary>
+		/// Rollback state of the inline mode
+		/// </summary>
+		std::unique_ptr<MachineState> saved;
+
+
+		/// <summary>
+		/// Published speculative frames, triple buffered
+		/// The writer fills writeSlot and swaps it with latest, the reader claims latest by swapping it with readSlot,
+		/// so the slot being read is never written. FreshSlot marks a latest the reader did not claim yet
+		/// </summary>
+		std::unique_ptr<bit32[]> output[3];
+		static constexpr int SlotMask = 0x03;
+		static constexpr int FreshSlot = 0x04;
+		std::atomic<int> latest{ 1 };
+		int writeSlot;
+		int readSlot;
+		bool readValid;
+
+
+		/// <summary>
+		/// Serializes the writers, the emulation and the shadow thread both publish while the mode switches
+		/// </summary>
+		std::mutex publishLock;
+
+
+		/// <summary>
+		/// Set when run ahead is disabled, the reader drops its frame
+		/// </summary>
+		std::atomic<bool> cleared{ false };
+
+
+		/// <summary>
+		/// Headless instance that runs the speculative frames on threaded mode
+		/// </summary>
+		std::unique_ptr<EmulatorController> shadow;
+		std::unique_ptr<std::thread> shadowThread;
+
+
+		/// <summary>
+		/// State handed to the shadow instance, the newest one replaces a pending one
+		/// </summary>
+		std::unique_ptr<MachineState> handoff;
+		std::unique_ptr<MachineState> shadowState;
+		bit8 handoffInput;
+		bit32 handoffFrames;
+		bool handoffPending;
+		bool shadowStop;
+		std::mutex handoffLock;
+		std::condition_variable handoffCond;
+
+
+		/// <summary>
+		/// Cost averages
+		/// </summary>
+		double avgCostUs;
+		double avgStateUs;
+		std::atomic<bit64> published{ 0 };
+
+
+		/// <summary>
+		/// Runs the speculative frames on the emulation thread
+		/// </summary>
+		/// <param name="count">Frames ahead</param>
+		void runInline(bit32 count);
+
+
+		/// <summary>
+		/// Hands the current state to the shadow instance
+		/// </summary>
+		/// <param name="count">Frames ahead</param>
+		void runThreaded(bit32 count);
+
+
+		/// <summary>
+		/// Starts the shadow instance and its thread
+		/// </summary>
+		/// <returns>If the shadow instance is running</returns>
+		bool startShadow();
+
+
+		/// <summary>
+		/// Stops the shadow thread
+		/// </summary>
+		void stopShadow();
+
+
+		/// <summary>
+		/// Shadow instance thread loop
+		/// </summary>
+		void shadowLoop();
+
+
+		/// <summary>
+		/// Copies a finished frame to the write buffer and publishes it
+		/// </summary>
+		/// <param name="frame">Source frame</param>
+		void publish(const bit32* frame);
+	};
+} // namespace TheBoy
+#endif // !RUNAHEAD_H
@@ -0,0 +1,305 @@
+#include "traceRecorder.h"
+#include "emulatorController.h"
+#include <chrono>
+#include <cstring>
+
+namespace TheBoy {
+
+	static_assert(sizeof(TraceRecord) == 32, "Trace records are written as is, keep them 32 bytes");
+
+
+	/// <summary>
+	/// Trace recorder constructor
+	/// </summary>
+	/// <param name="ctrl">Controller reference</param>
+	TraceRecorder::TraceRecorder(EmulatorController* ctrl) {
+		this->ctrl = ctrl;
+		cart = nullptr;
+		bus = nullptr;
+		head = 0;
+		tailSeen = 0;
+		open = false;
+		running = false;
+		paused = false;
+		stalls = 0;
+		file = nullptr;
+		written = 0;
+	}
+
+
+	/// <summary>
+	/// Trace recorder destructor, stops the trace
+	/// </summary>
+	TraceRecorder::~TraceRecorder() {
+		stop();
+	}
+
+
+	/// <summary>
+	/// Opens the trace file, starts the writer and hooks the cpu
+	/// </summary>
+	/// <param name="path">Target file path</param>
+	/// <returns>If the file was opened</returns>
+	bool TraceRecorder::start(const char* path) {
+		if (running) { return false; }
+
+		file = fopen(path, "wb");
+		if (!file) {
+			std::cout << "[TRACE] ::: Failed to open " << path << std::endl;
+			return false;
+		}
+
+		TraceHeader header{};
+		memcpy(header.magic, "TBTR", 4);
+		header.version = TraceHeader::CurrentVersion;
+		header.recordSize = sizeof(TraceRecord);
+		fwrite(&header, sizeof(header), 1, file);
+
+		if (!ring) { ring.reset(new TraceRecord[RingRecords]); }
+		cart = ctrl->getCartridge().get();
+		bus = ctrl->getBus().get();
+		head = 0;
+		tailSeen = 0;
+		published.store(0, std::memory_order_relaxed);
+		drained.store(0, std::memory_order_relaxed);
+		open = false;
+		paused = false;
+		stalls = 0;
+		written = 0;
+
+		stopping.store(false, std::memory_order_relaxed);
+		writer = std::thread(&TraceRecorder::writeLoop, this);
+		running = true;
+		ctrl->getCpu()->setTracer(this);
+
+		std::cout << "[TRACE] ::: Recording to " << path << std::endl;
+		return true;
+	}
+
+
+	/// <summary>
+	/// Unhooks the cpu, drains the ring and closes the file
+	/// </summary>
+	void TraceRecorder::stop() {
+		if (!running) { return; }
+
+		ctrl->getCpu()->setTracer(nullptr);
+		running = false;
+		if (open) {
+			open = false;
+			++head;
+		}
+		published.store(head, std::memory_order_release);
+
+		stopping.store(true, std::memory_order_release);
+		writer.join();
+		fclose(file);
+		file = nullptr;
+
+		std::cout << "[TRACE] ::: " << written << " instructions traced, " << stalls << " waits on the writer" << std::endl;
+	}
+
+
+	/// <summary>
+	/// Gets if the trace is recording
+	/// </summary>
+	/// <returns>Recording state</returns>
+	bool TraceRecorder::isRunning() {
+		return running;
+	}
+
+
+	/// <summary>
+	/// Skips the speculative frames, they are rolled back
+	/// </summary>
+	/// <param name="state">Speculative state</param>
+	void TraceRecorder::setPaused(bool state) {
+		// The open record belongs to the real timeline
+		if (state && open) {
+			open = false;
+			++head;
+		}
+		if (state) { published.store(head, std::memory_order_release); }
+		paused = state;
+	}
+
+
+	/// <summary>
+	/// Gets the records written
+	/// </summary>
+	bit64 TraceRecorder::getRecords() {
+		return written;
+	}
+
+
+	/// <summary>
+	/// Gets the waits on a full ring
+	/// </summary>
+	bit64 TraceRecorder::getStalls() {
+		return stalls;
+	}
+
+
+	/// <summary>
+	/// Called by the cpu before each executed instruction, opens its record
+	/// </summary>
+	/// <param name="regs">Registers</param>
+	/// <param name="ticks">Current emulated tick</param>
+	/// <param name="ime">Interrupt master state</param>
+	void TraceRecorder::begin(const Registers* regs, bit64 ticks, bool ime) {
+		if (open) {
+			open = false;
+			if ((++head & (PublishBatch - 1)) == 0) { published.store(head, std::memory_order_release); }
+		}
+		if (paused) { return; }
+
+		// The writer frees whole batches, the cached tail is only reloaded on a full ring
+		if (head - tailSeen >= RingRecords) {
+			// The writer can only free what it was handed
+			published.store(head, std::memory_order_release);
+			tailSeen = drained.load(std::memory_order_acquire);
+			while (head - tailSeen >= RingRecords) {
+				stalls++;
+				std::this_thread::yield();
+				tailSeen = drained.load(std::memory_order_acquire);
+			}
+		}
+
+		TraceRecord* rec = &ring[head & (RingRecords - 1)];
+		bit16 pc = regs->PC;
+		rec->ticks = ticks;
+		rec->pc = pc;
+		rec->sp = regs->SP;
+		rec->bank = static_cast<bit16>(cart->getRomBank());
+		rec->memAddr = 0;
+		rec->memVal = 0;
+		rec->memKind = TRACE_NONE;
+		memcpy(rec->regs, &regs->A, sizeof(rec->regs));
+		rec->ime = ime ? 1 : 0;
+
+		// Rom instructions are read straight from the cartridge, the other ones through the bus
+		if (pc < 0x7FFD) {
+			for (int i = 0; i < 4; i++) { rec->pcMem[i] = cart->read(pc + i); }
+		}
+		else {
+			for (int i = 0; i < 4; i++) { rec->pcMem[i] = bus->abRead(static_cast<bit16>(pc + i)); }
+		}
+		open = true;
+	}
+
+
+	/// <summary>
+	/// Writer thread loop
+	/// Sleeps between the drains, the records pile up in the ring and leave by large writes
+	/// </summary>
+	void TraceRecorder::writeLoop() {
+		while (true) {
+			bool last = stopping.load(std::memory_order_acquire);
+			while (drain()) { }
+			if (last) { break; }
+			std::this_thread::sleep_for(std::chrono::milliseconds(WriterSleepMs));
+		}
+		fflush(file);
+	}
+
+
+	/// <summary>
+	/// Writes the published records to the file, writer thread only
+	/// </summary>
+	/// <returns>If records were written</returns>
+	bool TraceRecorder::drain() {
+		size_t tail = drained.load(std::memory_order_relaxed);
+		size_t end = published.load(std::memory_order_acquire);
+		if (tail == end) { return false; }
+
+		// Up to the ring end, the wrapped part is written by the next call
+		size_t first = tail & (RingRecords - 1);
+		size_t count = std::min(end - tail, RingRecords - first);
+		fwrite(&ring[first], sizeof(TraceRecord), count, file);
+		written += count;
+		drained.store(tail + count, std::memory_order_release);
+		return true;
+	}
+
+
+	/// <summary>
+	/// Formats one record
+	/// </summary>
+	/// <param name="rec">Record</param>
+	/// <param name="format">Text format</param>
+	/// <param name="line">Target buffer</param>
+	/// <param name="size">Target buffer size</param>
+	/// <returns>Written characters</returns>
+	int TraceRecorder::format(const TraceRecord& rec, TRACE_FORMAT format, char* line, size_t size) {
+		const bit8* r = rec.regs;
+		if (format == TRACE_FORMAT_DOCTOR) {
+			if (size < DoctorLineSize + 1) { return 0; }
+
+			// Fixed layout, the hex digits are patched in a template, the trace diff decodes gigabytes of them
+			static const char Digits[] = "0123456789ABCDEF";
+			memcpy(line, "A:00 F:00 B:00 C:00 D:00 E:00 H:00 L:00 SP:0000 PC:0000 PCMEM:00,00,00,00\n", DoctorLineSize + 1);
+			for (int i = 0; i < 8; i++) {
+				line[i * 5 + 2] = Digits[r[i] >> 4];
+				line[i * 5 + 3] = Digits[r[i] & 0xF];
+			}
+			for (int i = 0; i < 4; i++) {
+				line[43 + i] = Digits[(rec.sp >> (12 - i * 4)) & 0xF];
+				line[51 + i] = Digits[(rec.pc >> (12 - i * 4)) & 0xF];
+				line[62 + i * 3] = Digits[rec.pcMem[i] >> 4];
+				line[63 + i * 3] = Digits[rec.pcMem[i] & 0xF];
+			}
+			return static_cast<int>(DoctorLineSize);
+		}
+
+		int len = snprintf(line, size,
+			"%012llu %02X:%04X  %02X %02X %02X %02X  A:%02X F:%c%c%c%c BC:%02X%02X DE:%02X%02X HL:%02X%02X SP:%04X%s",
+			static_cast<unsigned long long>(rec.ticks), (rec.pc >= 0x4000 && rec.pc < 0x8000) ? rec.bank : 0, rec.pc,
+			rec.pcMem[0], rec.pcMem[1], rec.pcMem[2], rec.pcMem[3],
+			r[0], (r[1] & 0x80) ? 'Z' : '-', (r[1] & 0x40) ? 'N' : '-', (r[1] & 0x20) ? 'H' : '-', (r[1] & 0x10) ? 'C' : '-',
+			r[2], r[3], r[4], r[5], r[6], r[7], rec.sp, rec.ime ? " IME" : "");
+		if (rec.memKind != TRACE_NONE && len > 0 && static_cast<size_t>(len) < size) {
+			len += snprintf(line + len, size - len, "  %s %04X %s %02X", rec.memKind == TRACE_READ ? "rd" : "wr",
+				rec.memAddr, rec.memKind == TRACE_READ ? "->" : "<-", rec.memVal);
+		}
+		if (len > 0 && static_cast<size_t>(len) + 1 < size) {
+			line[len++] = '\n';
+			line[len] = '\0';
+		}
+		return len;
+	}
+
+
+	/// <summary>
+	/// Decodes a trace file to text
+	/// </summary>
+	/// <param name="path">Trace file path</param>
+	/// <param name="out">Text output</param>
+	/// <param name="format">Text format</param>
+	/// <returns>If the whole file was decoded</returns>
+	bool TraceRecorder::decode(const char* path, FILE* out, TRACE_FORMAT format) {
+		FILE* in = fopen(path, "rb");
+		if (!in) {
+			std::cout << "[TRACE] ::: Failed to open " << path << std::endl;
+			return false;
+		}
+
+		TraceHeader header{};
+		if (fread(&header, sizeof(header), 1, in) != 1 || memcmp(header.magic, "TBTR", 4) != 0 ||
+			header.version != TraceHeader::CurrentVersion || header.recordSize != sizeof(TraceRecord)) {
+			std::cout << "[TRACE] ::: Unknown trace format or version" << std::endl;
+			fclose(in);
+			return false;
+		}
+
+		std::unique_ptr<TraceRecord[]> batch(new TraceRecord[4096]);
+		char line[160];
+		size_t count;
+		while ((count = fread(batch.get(), sizeof(TraceRecord), 4096, in)) > 0) {
+			for (size_t i = 0; i < count; i++) {
+				fwrite(line, 1, TraceRecorder::format(batch[i], format, line, sizeof(line)), out);
+			}
+		}
+		fclose(in);
+		return true;
+	}
+} // namespace TheBoy
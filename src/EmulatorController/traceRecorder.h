@@ -0,0 +1,278 @@
+#pragma once
+#ifndef TRACERECORDER_H
+#define TRACERECORDER_H
+
+#include "common.h"
+#include "cpu.h"
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <thread>
+
+namespace TheBoy {
+	class EmulatorController;
+	class Cartridge;
+
+	/// <summary>
+	/// Memory access kept on a trace record
+	/// </summary>
+	typedef enum TRACE_ACCESS {
+		TRACE_NONE,
+		TRACE_READ,
+		TRACE_WRITE
+	} TRACE_ACCESS;
+
+
+	/// <summary>
+	/// One executed instruction, the machine state before it runs
+	/// </summary>
+	typedef struct TraceRecord {
+		/// <summary>
+		/// Emulated tick of the instruction start
+		/// </summary>
+		bit64 ticks;
+
+		/// <summary>
+		/// Instruction address, rom bank mapped on 4000-7FFF and stack pointer
+		/// </summary>
+		bit16 pc;
+		bit16 bank;
+		bit16 sp;
+
+		/// <summary>
+		/// Last data memory access of the instruction (stack included), instruction fetches are not kept
+		/// </summary>
+		bit16 memAddr;
+		bit8 memVal;
+		bit8 memKind;
+
+		/// <summary>
+		/// Registers, A F B C D E H L
+		/// </summary>
+		bit8 regs[8];
+
+		/// <summary>
+		/// Opcode and the 3 next bytes
+		/// </summary>
+		bit8 pcMem[4];
+
+		/// <summary>
+		/// Interrupt master state, enabled or being enabled
+		/// </summary>
+		bit8 ime;
+	} TraceRecord;
+
+
+	/// <summary>
+	/// Trace file header, followed by the records
+	/// </summary>
+	typedef struct TraceHeader {
+		static const bit32 CurrentVersion = 1;
+
+		/// <summary>
+		/// 'TBTR'
+		/// </summary>
+		char magic[4];
+		bit32 version;
+		bit32 recordSize;
+		bit32 reserved;
+	} TraceHeader;
+
+
+	/// <summary>
+	/// Text formats of the trace decoder
+	/// </summary>
+	typedef enum TRACE_FORMAT {
+		/// <summary>
+		/// Tick, bank:pc, bytes, registers and memory access
+		/// </summary>
+		TRACE_FORMAT_TEXT,
+
+		/// <summary>
+		/// gameboy-doctor log lines, "A:01 F:B0 B:00 C:13 D:00 E:D8 H:01 L:4D SP:FFFE PC:0100 PCMEM:00,C3,13,02"
+		/// </summary>
+		TRACE_FORMAT_DOCTOR
+	} TRACE_FORMAT;
+
+
+	/// <summary>
+	/// Binary execution trace
+	/// The cpu fills one fixed size record per instruction straight in a single producer ring buffer, a writer
+	/// thread drains it to the file. Nothing is formatted nor locked on the emulation thread, it only waits when
+	/// the writer falls a whole ring behind.
+	/// Replaces the VERBOSE per instruction and per access prints, decode the file to read it
+	/// </summary>
+	class TraceRecorder {
+	public:
+		/// <summary>
+		/// Ring records, a power of 2
+		/// </summary>
+		static const size_t RingRecords = 1 << 16;
+
+
+		/// <summary>
+		/// Records handed to the writer at once, a shared store per instruction costs more than the record
+		/// </summary>
+		static const size_t PublishBatch = 256;
+
+
+		/// <summary>
+		/// Writer sleep between two drains, the ring holds about 50 ms of emulation
+		/// </summary>
+		static const int WriterSleepMs = 2;
+
+
+		/// <summary>
+		/// Length of a gameboy-doctor line, the new line included
+		/// </summary>
+		static const size_t DoctorLineSize = 74;
+
+
+		/// <summary>
+		/// Trace recorder constructor
+		/// </summary>
+		/// <param name="ctrl">Controller reference</param>
+		TraceRecorder(EmulatorController* ctrl);
+
+
+		/// <summary>
+		/// Trace recorder destructor, stops the trace
+		/// </summary>
+		~TraceRecorder();
+
+
+		/// <summary>
+		/// Opens the trace file, starts the writer and hooks the cpu
+		/// </summary>
+		/// <param name="path">Target file path</param>
+		/// <returns>If the file was opened</returns>
+		bool start(const char* path);
+
+
+		/// <summary>
+		/// Unhooks the cpu, drains the ring and closes the file
+		/// </summary>
+		void stop();
+
+
+		/// <summary>
+		/// Gets if the trace is recording
+		/// </summary>
+		/// <returns>Recording state</returns>
+		bool isRunning();
+
+
+		/// <summary>
+		/// Skips the speculative frames, they are rolled back
+		/// </summary>
+		/// <param name="state">Speculative state</param>
+		void setPaused(bool state);
+
+
+		/// <summary>
+		/// Gets the records written and the waits on a full ring
+		/// </summary>
+		bit64 getRecords();
+		bit64 getStalls();
+
+
+		/// <summary>
+		/// Called by the cpu before each executed instruction, opens its record
+		/// </summary>
+		/// <param name="regs">Registers</param>
+		/// <param name="ticks">Current emulated tick</param>
+		/// <param name="ime">Interrupt master state</param>
+		void begin(const Registers* regs, bit64 ticks, bool ime);
+
+
+		/// <summary>
+		/// Called by the cpu on its data bus accesses, kept on the open record
+		/// </summary>
+		/// <param name="addr">Bus address</param>
+		/// <param name="val">Value read or written</param>
+		/// <param name="kind">Access kind</param>
+		void access(bit16 addr, bit8 val, TRACE_ACCESS kind) {
+			if (!open) { return; }
+
+			TraceRecord* rec = &ring[head & (RingRecords - 1)];
+			// Operand fetches read the instruction bytes
+			if (kind == TRACE_READ && static_cast<bit16>(addr - rec->pc) < 3) { return; }
+			rec->memAddr = addr;
+			rec->memVal = val;
+			rec->memKind = kind;
+		}
+
+
+		/// <summary>
+		/// Decodes a trace file to text
+		/// </summary>
+		/// <param name="path">Trace file path</param>
+		/// <param name="out">Text output</param>
+		/// <param name="format">Text format</param>
+		/// <returns>If the whole file was decoded</returns>
+		static bool decode(const char* path, FILE* out, TRACE_FORMAT format);
+
+
+		/// <summary>
+		/// Formats one record
+		/// </summary>
+		/// <param name="rec">Record</param>
+		/// <param name="format">Text format</param>
+		/// <param name="line">Target buffer</param>
+		/// <param name="size">Target buffer size</param>
+		/// <returns>Written characters</returns>
+		static int format(const TraceRecord& rec, TRACE_FORMAT format, char* line, size_t size);
+
+	private:
+		/// <summary>
+		/// Controller reference, and its cartridge and bus for the instruction bytes
+		/// </summary>
+		EmulatorController* ctrl;
+		Cartridge* cart;
+		AddressBus* bus;
+
+
+		/// <summary>
+		/// Ring buffer, the emulation thread owns head and the writer tail
+		/// The open record is the one on head, the closed ones are published by batches of PublishBatch
+		/// Each counter has its own cache line, the writer stores do not evict the emulation thread ones
+		/// </summary>
+		std::unique_ptr<TraceRecord[]> ring;
+		alignas(64) std::atomic<size_t> published{ 0 };
+		alignas(64) std::atomic<size_t> drained{ 0 };
+		size_t head;
+		size_t tailSeen;
+		bool open;
+
+
+		/// <summary>
+		/// Emulation thread state
+		/// </summary>
+		bool running;
+		bool paused;
+		bit64 stalls;
+
+
+		/// <summary>
+		/// Writer thread and its file
+		/// </summary>
+		std::thread writer;
+		std::atomic<bool> stopping{ false };
+		FILE* file;
+		bit64 written;
+
+
+		/// <summary>
+		/// Writer thread loop
+		/// </summary>
+		void writeLoop();
+
+
+		/// <summary>
+		/// Writes the published records to the file, writer thread only
+		/// </summary>
+		/// <returns>If records were written</returns>
+		bool drain();
+	};
+} // namespace TheBoy
+#endif // !TRACERECORDER_H
@@ -0,0 +1,261 @@
+#include "vramViewer.h"
+#include "emulatorController.h"
+#include <algorithm>
+#include <cstring>
+
+namespace TheBoy {
+
+	/// <summary>
+	/// VRam viewer constructor
+	/// </summary>
+	/// <param name="ctrl">Target emulator controller</param>
+	VRamViewer::VRamViewer(EmulatorController* ctrl) : emulCtrl(ctrl) {
+		mode = HIDDEN;
+		fullRedraw = true;
+		lastFrame = 0;
+		drawnLcdc = 0;
+
+		snap = new VRamSnapshot{ };
+		memset(drawnOam, 0, sizeof(drawnOam));
+
+		tilePixels = new bit32[TilesW * 8 * TilesH * 8]{ };
+		mapPixels = new bit32[256 * 256]{ };
+		oamPixels = new bit32[OamW * 8 * OamH * 16]{ };
+
+		tTiles.create(TilesW * 8, TilesH * 8);
+		tMap.create(256, 256);
+		tOam.create(OamW * 8, OamH * 16);
+
+		// Same gray shades as the output view, byte swapped to the texture memory order
+		const bit32 gbPallet[4] = { 0xFFFFFFFF, 0xACACACFF, 0x555555FF, 0x000000FF };
+		for (int i = 0; i < 4; i++) {
+			bit32 c = gbPallet[i];
+			pallet[i] = (c >> 24) | ((c >> 8) & 0xFF00) | ((c << 8) & 0xFF0000) | (c << 24);
+		}
+	}
+
+
+	/// <summary>
+	/// VRam viewer destructor
+	/// </summary>
+	VRamViewer::~VRamViewer() {
+		emulCtrl->getPpu()->setVRamSnapshotEnabled(false);
+
+		delete snap;
+		delete[] tilePixels;
+		delete[] mapPixels;
+		delete[] oamPixels;
+	}
+
+
+	/// <summary>
+	/// Defines the current viewer mode
+	/// </summary>
+	/// <param name="newMode">New viewer mode</param>
+	void VRamViewer::setMode(VIEWMODE newMode) {
+		mode = newMode;
+		// Dirty sets consumed while on another mode never reached this texture
+		fullRedraw = true;
+		emulCtrl->getPpu()->setVRamSnapshotEnabled(mode != HIDDEN);
+	}
+
+
+	/// <summary>
+	/// Moves to the next viewer mode, wraps to hidden
+	/// </summary>
+	void VRamViewer::cycleMode() {
+		setMode(static_cast<VIEWMODE>((mode + 1) % (OAM + 1)));
+	}
+
+
+	/// <summary>
+	/// Gets the current viewer mode
+	/// </summary>
+	/// <returns>Viewer mode</returns>
+	VRamViewer::VIEWMODE VRamViewer::getMode() { return mode; }
+
+
+	/// <summary>
+	/// Consumes the last published snapshot and redraws the changed elements
+	/// </summary>
+	void VRamViewer::update() {
+		if (mode == HIDDEN) { return; }
+		if (!emulCtrl->getPpu()->takeVRamSnapshot(snap, lastFrame)) { return; }
+		lastFrame = snap->frame;
+
+		if (fullRedraw) {
+			memset(snap->dirtyTiles, 0xFF, sizeof(snap->dirtyTiles));
+			memset(snap->dirtyMap, 0xFF, sizeof(snap->dirtyMap));
+		}
+		// Bit 4 (tile data area), 3 (bg map area) and 2 (obj size) change the decoded layout
+		bool lcdcChanged = fullRedraw || ((snap->lcdc ^ drawnLcdc) & 0x1C);
+		drawnLcdc = snap->lcdc;
+
+		switch (mode) {
+		case TILES:
+			if (updateTiles()) { tTiles.update(reinterpret_cast<const sf::Uint8*>(tilePixels)); }
+			break;
+		case BGMAP:
+			if (updateMap(lcdcChanged)) { tMap.update(reinterpret_cast<const sf::Uint8*>(mapPixels)); }
+			break;
+		case OAM:
+			if (updateOam(lcdcChanged)) { tOam.update(reinterpret_cast<const sf::Uint8*>(oamPixels)); }
+			break;
+		default: break;
+		}
+		fullRedraw = false;
+	}
+
+
+	/// <summary>
+	/// Draws the current viewer on the target
+	/// </summary>
+	/// <param name="target">Render target</param>
+	/// <param name="position">Top left position</param>
+	/// <param name="maxSize">Available area, the viewer is scaled to fit</param>
+	void VRamViewer::draw(sf::RenderTarget& target, sf::Vector2f position, sf::Vector2f maxSize) {
+		const sf::Texture* tex = NULL;
+		switch (mode) {
+		case TILES: tex = &tTiles; break;
+		case BGMAP: tex = &tMap; break;
+		case OAM: tex = &tOam; break;
+		default: return;
+		}
+
+		sf::Vector2u size = tex->getSize();
+		float scale = std::min(maxSize.x / size.x, maxSize.y / size.y);
+		if (scale <= 0.0f) { return; }
+
+		sView.setTexture(*tex, true);
+		sView.setScale(scale, scale);
+		sView.setPosition(position);
+		target.draw(sView);
+	}
+
+
+	/// <summary>
+	/// Decodes a tile from the snapshot to a pixel buffer
+	/// </summary>
+	/// <param name="tile">Tile index (0-383)</param>
+	/// <param name="dst">Pointer to the tile top left pixel</param>
+	/// <param name="stride">Destination line width</param>
+	void VRamViewer::decodeTile(int tile, bit32* dst, int stride) {
+		/*
+			Each tile occupies 16 bytes, where each line is represented by 2 bytes
+			The first byte specifies the least significant bit of the color ID of each pixel,
+			and the second byte specifies the most significant bit. Bit 7 represents the leftmost pixel
+		*/
+		const bit8* data = &snap->vRam[tile * 16];
+		for (int line = 0; line < 8; line++) {
+			bit8 lo = data[line * 2];
+			bit8 hi = data[line * 2 + 1];
+			bit32* row = dst + (line * stride);
+
+			for (int px = 0; px < 8; px++) {
+				int b = 7 - px;
+				row[px] = pallet[(((hi >> b) & 1) << 1) | ((lo >> b) & 1)];
+			}
+		}
+	}
+
+
+	/// <summary>
+	/// Checks the dirty bit for a tile
+	/// </summary>
+	/// <param name="tile">Tile index</param>
+	/// <returns>Tile changed</returns>
+	bool VRamViewer::tileDirty(int tile) {
+		return (snap->dirtyTiles[tile >> 3] >> (tile & 7)) & 1;
+	}
+
+
+	/// <summary>
+	/// Redraws the changed tiles
+	/// </summary>
+	/// <returns>Something was redrawn</returns>
+	bool VRamViewer::updateTiles() {
+		bool drawn = false;
+		const int stride = TilesW * 8;
+
+		for (int tile = 0; tile < VRamSnapshot::TileCount; tile++) {
+			if (!tileDirty(tile)) { continue; }
+
+			int tx = tile % TilesW;
+			int ty = tile / TilesW;
+			decodeTile(tile, &tilePixels[(ty * 8 * stride) + (tx * 8)], stride);
+			drawn = true;
+		}
+		return drawn;
+	}
+
+
+	/// <summary>
+	/// Redraws the changed background map cells
+	/// </summary>
+	/// <param name="lcdcChanged">Map/addressing mode changed since the last draw</param>
+	/// <returns>Something was redrawn</returns>
+	bool VRamViewer::updateMap(bool lcdcChanged) {
+		bool drawn = false;
+		// Bit 3 selects the $9C00 map, bit 4 the $8000 unsigned tile addressing
+		const int mapBase = GETBIT(snap->lcdc, 3) ? 0x400 : 0;
+		const bool unsignedData = GETBIT(snap->lcdc, 4);
+
+		for (int cell = 0; cell < 0x400; cell++) {
+			int entry = mapBase + cell;
+			bit8 idx = snap->vRam[0x1800 + entry];
+			int tile = unsignedData ? idx : (idx < 128 ? 256 + idx : idx);
+
+			// A cell changes with its map entry or with the tile it points to
+			bool dirty = lcdcChanged || ((snap->dirtyMap[entry >> 3] >> (entry & 7)) & 1) || tileDirty(tile);
+			if (!dirty) { continue; }
+
+			decodeTile(tile, &mapPixels[((cell / 32) * 8 * 256) + ((cell % 32) * 8)], 256);
+			drawn = true;
+		}
+		return drawn;
+	}
+
+
+	/// <summary>
+	/// Redraws the changed OAM entries
+	/// </summary>
+	/// <param name="lcdcChanged">Sprite size changed since the last draw</param>
+	/// <returns>Something was redrawn</returns>
+	bool VRamViewer::updateOam(bool lcdcChanged) {
+		bool drawn = false;
+		const int stride = OamW * 8;
+		const bool tall = GETBIT(snap->lcdc, 2);
+		bit32 tmp[8 * 16];
+
+		for (int s = 0; s < 40; s++) {
+			const bit8* entry = &snap->oam[s * 4];
+			int tile = tall ? (entry[2] & 0xFE) : entry[2];
+
+			bool dirty = lcdcChanged || memcmp(entry, &drawnOam[s * 4], 4) != 0 ||
+				tileDirty(tile) || (tall && tileDirty(tile + 1));
+			if (!dirty) { continue; }
+			memcpy(&drawnOam[s * 4], entry, 4);
+
+			// Decode the unflipped sprite, then place it with the attribute flips
+			memset(tmp, 0, sizeof(tmp));
+			decodeTile(tile, tmp, 8);
+			if (tall) { decodeTile(tile + 1, &tmp[8 * 8], 8); }
+
+			const bool xFlip = GETBIT(entry[3], 5);
+			const bool yFlip = GETBIT(entry[3], 6);
+			const int height = tall ? 16 : 8;
+			bit32* dst = &oamPixels[((s / OamW) * 16 * stride) + ((s % OamW) * 8)];
+
+			for (int y = 0; y < 16; y++) {
+				for (int x = 0; x < 8; x++) {
+					if (y >= height) { dst[(y * stride) + x] = 0; continue; }
+					int sy = yFlip ? (height - 1 - y) : y;
+					int sx = xFlip ? (7 - x) : x;
+					dst[(y * stride) + x] = tmp[(sy * 8) + sx];
+				}
+			}
+			drawn = true;
+		}
+		return drawn;
+	}
+} // namespace TheBoy
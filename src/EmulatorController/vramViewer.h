@@ -0,0 +1,198 @@
+#pragma once
+#ifndef VRAMVIEWER_H
+#define VRAMVIEWER_H
+
+#include "common.h"
+
+namespace TheBoy {
+	class EmulatorController;
+	struct VRamSnapshot;
+
+	/// <summary>
+	/// Debug viewers for the video memory (tile data, background map and OAM)
+	/// Built from the VBlank snapshot published by the Ppu, only the changed tiles are redrawn
+	/// </summary>
+	class VRamViewer {
+	public:
+		/// <summary>
+		/// Available viewer modes, only one is decoded at a time
+		/// </summary>
+		typedef enum VIEWMODE {
+			HIDDEN,
+			TILES,
+			BGMAP,
+			OAM
+		} VIEWMODE;
+
+
+		/// <summary>
+		/// VRam viewer constructor
+		/// </summary>
+		/// <param name="ctrl">Target emulator controller</param>
+		VRamViewer(EmulatorController* ctrl);
+
+
+		/// <summary>
+		/// VRam viewer destructor
+		/// </summary>
+		~VRamViewer();
+
+
+		/// <summary>
+		/// Defines the current viewer mode
+		/// </summary>
+		/// <param name="mode">New viewer mode</param>
+		void setMode(VIEWMODE mode);
+
+
+		/// <summary>
+		/// Moves to the next viewer mode, wraps to hidden
+		/// </summary>
+		void cycleMode();
+
+
+		/// <summary>
+		/// Gets the current viewer mode
+		/// </summary>
+		/// <returns>Viewer mode</returns>
+		VIEWMODE getMode();
+
+
+		/// <summary>
+		/// Consumes the last published snapshot and redraws the changed elements
+		/// </summary>
+		void update();
+
+
+		/// <summary>
+		/// Draws the current viewer on the target
+		/// </summary>
+		/// <param name="target">Render target</param>
+		/// <param name="position">Top left position</param>
+		/// <param name="maxSize">Available area, the viewer is scaled to fit</param>
+		void draw(sf::RenderTarget& target, sf::Vector2f position, sf::Vector2f maxSize);
+
+	private:
+		/// <summary>
+		/// Tile data arrangement, 24 * 16 = 384 tiles
+		/// </summary>
+		static const int TilesW = 24;
+		static const int TilesH = 16;
+
+		/// <summary>
+		/// OAM arrangement, 10 * 4 = 40 entries, each cell fits a 8x16 sprite
+		/// </summary>
+		static const int OamW = 10;
+		static const int OamH = 4;
+
+		/// <summary>
+		/// Pointer to the target emulator controller
+		/// </summary>
+		EmulatorController* emulCtrl;
+
+
+		/// <summary>
+		/// Current viewer mode
+		/// </summary>
+		VIEWMODE mode;
+
+
+		/// <summary>
+		/// Marks that every element should be redrawn on the next snapshot
+		/// </summary>
+		bool fullRedraw;
+
+
+		/// <summary>
+		/// Last frame taken from the ppu
+		/// </summary>
+		bit32 lastFrame;
+
+
+		/// <summary>
+		/// Local snapshot copy, decoded outside the ppu lock
+		/// </summary>
+		VRamSnapshot* snap;
+
+
+		/// <summary>
+		/// OAM values of the last drawn sprites, used to find the changed entries
+		/// </summary>
+		bit8 drawnOam[0xA0];
+
+
+		/// <summary>
+		/// Viewer pixel buffers, RGBA8 in memory order
+		/// </summary>
+		bit32* tilePixels;
+		bit32* mapPixels;
+		bit32* oamPixels;
+
+
+		/// <summary>
+		/// Viewer textures
+		/// </summary>
+		sf::Texture tTiles;
+		sf::Texture tMap;
+		sf::Texture tOam;
+
+
+		/// <summary>
+		/// Sprite used to draw the active texture
+		/// </summary>
+		sf::Sprite sView;
+
+
+		/// <summary>
+		/// Color ids converted to RGBA8 memory order
+		/// </summary>
+		bit32 pallet[4];
+
+
+		/// <summary>
+		/// Decodes a tile from the snapshot to a pixel buffer
+		/// </summary>
+		/// <param name="tile">Tile index (0-383)</param>
+		/// <param name="dst">Pointer to the tile top left pixel</param>
+		/// <param name="stride">Destination line width</param>
+		void decodeTile(int tile, bit32* dst, int stride);
+
+
+		/// <summary>
+		/// Checks the dirty bit for a tile
+		/// </summary>
+		/// <param name="tile">Tile index</param>
+		/// <returns>Tile changed</returns>
+		bool tileDirty(int tile);
+
+
+		/// <summary>
+		/// Redraws the changed tiles
+		/// </summary>
+		/// <returns>Something was redrawn</returns>
+		bool updateTiles();
+
+
+		/// <summary>
+		/// Redraws the changed background map cells
+		/// </summary>
+		/// <param name="lcdcChanged">Map/addressing mode changed since the last draw</param>
+		/// <returns>Something was redrawn</returns>
+		bool updateMap(bool lcdcChanged);
+
+
+		/// <summary>
+		/// Redraws the changed OAM entries
+		/// </summary>
+		/// <param name="lcdcChanged">Sprite size changed since the last draw</param>
+		/// <returns>Something was redrawn</returns>
+		bool updateOam(bool lcdcChanged);
+
+
+		/// <summary>
+		/// Last drawn lcdc value
+		/// </summary>
+		bit8 drawnLcdc;
+	};
+} // namespace TheBoy
+#endif // !VRAMVIEWER_H
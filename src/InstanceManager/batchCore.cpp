@@ -0,0 +1,469 @@
+#include "batchCore.h"
+#include "emulatorController.h"
+#include "instruction.h"
+#include <cassert>
+
+namespace TheBoy {
+
+	namespace {
+		/// <summary>
+		/// Runs a register instruction on the masked lanes
+		/// Branchless, every lane computes the result and the mask selects what is written, so the loop vectorizes
+		/// </summary>
+		/// <param name="n">Padded lane count</param>
+		/// <param name="m">Lane mask</param>
+		/// <param name="dst">Destination (and left operand) register</param>
+		/// <param name="src">Right operand copy</param>
+		/// <param name="flags">Flags register</param>
+		/// <param name="flagMask">Flag bits written by the instruction</param>
+		/// <param name="fn">Operation, (a, b, carry, flags out) -> result</param>
+		template <typename OpFunc>
+		inline void laneLoop(int n, const bit8* __restrict m, bit8* __restrict dst, const bit8* __restrict src,
+				bit8* __restrict flags, bit8 flagMask, OpFunc fn) {
+			for (int i = 0; i < n; i++) {
+				int a = dst[i];
+				int b = src[i];
+				int cy = (flags[i] >> 4) & 1;
+				int fl = 0;
+				int r = fn(a, b, cy, fl);
+
+				int sel = m[i];
+				int fm = flagMask & sel;
+				dst[i] = static_cast<bit8>((r & sel) | (a & ~sel));
+				flags[i] = static_cast<bit8>((flags[i] & ~fm) | (fl & fm));
+			}
+		}
+
+
+		/// <summary>
+		/// Register encoded on 3 opcode bits (B C D E H L (HL) A)
+		/// </summary>
+		/// <param name="code">Register code</param>
+		/// <returns>Register type, REG_NONE for (HL)</returns>
+		constexpr bit8 opcodeReg(int code) {
+			constexpr bit8 regs[8] = { REG_B, REG_C, REG_D, REG_E, REG_H, REG_L, REG_NONE, REG_A };
+			return regs[code & 0x07];
+		}
+	}
+
+
+	/// <summary>
+	/// Batch core constructor
+	/// </summary>
+	BatchCore::BatchCore() {
+		capacity = 0;
+		resetStats();
+	}
+
+
+	/// <summary>
+	/// Batch core destructor
+	/// </summary>
+	BatchCore::~BatchCore() { }
+
+
+	/// <summary>
+	/// Decodes the opcode table, the same forms the scalar instruction set resolves
+	/// Only register to register forms are batched, everything touching memory or PC stays scalar
+	/// </summary>
+	/// <returns>Opcode table</returns>
+	constexpr std::array<BatchCore::BatchOp, 0x100> BatchCore::buildOpTable() {
+		std::array<BatchOp, 0x100> table{ };
+		for (int op = 0; op < 0x100; op++) {
+			const bit8 regL = opcodeReg(op >> 3);
+			const bit8 regR = opcodeReg(op);
+			BatchOp bop{ BK_NONE, REG_NONE, REG_NONE, 0 };
+
+			if (op == 0x00) { bop = BatchOp{ BK_NOP, REG_A, REG_A, 0x00 }; }
+			else if (op == 0x2F) { bop = BatchOp{ BK_CPL, REG_A, REG_A, 0x60 }; }
+			else if (op == 0x37) { bop = BatchOp{ BK_SCF, REG_A, REG_A, 0x70 }; }
+			else if (op == 0x3F) { bop = BatchOp{ BK_CCF, REG_A, REG_A, 0x70 }; }
+			// INC r and DEC r, the flag exceptions of the scalar resolvers only hit the 16bit forms
+			else if ((op & 0xC7) == 0x04 && regL != REG_NONE) { bop = BatchOp{ BK_INC, regL, regL, 0xE0 }; }
+			else if ((op & 0xC7) == 0x05 && regL != REG_NONE) { bop = BatchOp{ BK_DEC, regL, regL, 0xE0 }; }
+			// LD r,r' (0x76 is HALT, both its register codes are (HL))
+			else if ((op & 0xC0) == 0x40 && regL != REG_NONE && regR != REG_NONE) { bop = BatchOp{ BK_LD, regL, regR, 0x00 }; }
+			// ALU A,r, the operation on bits 3 to 5
+			else if ((op & 0xC0) == 0x80 && regR != REG_NONE) {
+				constexpr bit8 alu[8] = { BK_ADD, BK_ADC, BK_SUB, BK_SBC, BK_AND, BK_XOR, BK_OR, BK_CP };
+				bop = BatchOp{ alu[(op >> 3) & 0x07], REG_A, regR, 0xF0 };
+			}
+
+			table[op] = bop;
+		}
+		return table;
+	}
+
+
+	/// <summary>
+	/// Opcode to batched instruction, decoded at compile time
+	/// </summary>
+	constexpr std::array<BatchCore::BatchOp, 0x100> BatchCore::opTable = BatchCore::buildOpTable();
+
+
+	/// <summary>
+	/// Adds a loaded headless controller as a new lane
+	/// </summary>
+	/// <param name="ctrl">Target controller, must outlive the batch</param>
+	/// <returns>Lane index</returns>
+	int BatchCore::addLane(EmulatorController* ctrl) {
+		Lane lane{ };
+		lane.ctrl = ctrl;
+		lane.cpu = ctrl->getCpu().get();
+		lane.bus = ctrl->getBus().get();
+		lane.ppu = ctrl->getPpu().get();
+		lanes.push_back(lane);
+
+		// Storage is rebuilt from the Cpu registers on every runFrame, resizing loses nothing
+		capacity = ((static_cast<int>(lanes.size()) + LaneAlign - 1) / LaneAlign) * LaneAlign;
+		regFile.assign((REG_L + 1) * capacity, 0);
+		regSP.assign(capacity, 0);
+		regPC.assign(capacity, 0);
+		laneOp.assign(capacity, NoOp);
+		mask.assign(capacity, 0);
+		operand.assign(capacity, 0);
+		active.assign(capacity, 0);
+		enabled.resize(capacity, 1);
+
+		return static_cast<int>(lanes.size()) - 1;
+	}
+
+
+	/// <summary>
+	/// Gets the lane count
+	/// </summary>
+	/// <returns>Lane count</returns>
+	int BatchCore::getLaneCount() {
+		return static_cast<int>(lanes.size());
+	}
+
+
+	/// <summary>
+	/// Includes or leaves out a lane from the next runFrame calls
+	/// </summary>
+	/// <param name="lane">Lane index</param>
+	/// <param name="enable">Lane runs</param>
+	void BatchCore::setLaneEnabled(int lane, bool enable) {
+		if (lane < 0 || lane >= getLaneCount()) { return; }
+		enabled[lane] = enable ? 1 : 0;
+	}
+
+
+	/// <summary>
+	/// Runs every running lane until its ppu completes a frame
+	/// </summary>
+	/// <returns>If any lane is still running</returns>
+	bool BatchCore::runFrame() {
+		const int count = getLaneCount();
+		for (int l = 0; l < count; l++) {
+			Lane& lane = lanes[l];
+			active[l] = enabled[l] && lane.ctrl->isRunning();
+			lane.startFrame = lane.ppu->getCurrentFrame();
+			// Same limit as EmulatorController::runFrame, only matters if the ppu stops counting frames
+			lane.tickLimit = lane.ctrl->getTicks() + (Ppu::LinePerFrame * Ppu::TicksPerLine * 2);
+			// The lane loops skip the Cpu::step hooks, a hooked lane runs scalar for the whole frame
+#if PERFCOUNT
+			lane.hooked = true;
+#else
+			lane.hooked = lane.cpu->getProfiler() != nullptr || lane.cpu->getTracer() != nullptr;
+#endif
+			loadLane(l);
+		}
+
+		while (lockstep()) { }
+
+		bool running = false;
+		for (int l = 0; l < count; l++) {
+			storeLane(l);
+			if (enabled[l]) { lanes[l].ctrl->headlessFrameEnd(); }
+			running |= lanes[l].ctrl->isRunning();
+		}
+		return running;
+	}
+
+
+	/// <summary>
+	/// Gets the step counters since the last reset
+	/// </summary>
+	/// <returns>Batch counters</returns>
+	BatchStats BatchCore::getStats() {
+		return stats;
+	}
+
+
+	/// <summary>
+	/// Clears the step counters
+	/// </summary>
+	void BatchCore::resetStats() {
+		stats = BatchStats{ };
+	}
+
+
+	/// <summary>
+	/// Gets a register array
+	/// </summary>
+	/// <param name="reg">Register type (REG_A to REG_L)</param>
+	/// <returns>Pointer to the first lane</returns>
+	bit8* BatchCore::reg8(int reg) {
+		return &regFile[reg * capacity];
+	}
+
+
+	/// <summary>
+	/// Copies the Cpu registers of a lane to the arrays
+	/// </summary>
+	/// <param name="lane">Lane index</param>
+	void BatchCore::loadLane(int lane) {
+		const Registers* regs = lanes[lane].cpu->getRegisters();
+		reg8(REG_A)[lane] = regs->A;
+		reg8(REG_F)[lane] = regs->F;
+		reg8(REG_B)[lane] = regs->B;
+		reg8(REG_C)[lane] = regs->C;
+		reg8(REG_D)[lane] = regs->D;
+		reg8(REG_E)[lane] = regs->E;
+		reg8(REG_H)[lane] = regs->H;
+		reg8(REG_L)[lane] = regs->L;
+		regSP[lane] = regs->SP;
+		regPC[lane] = regs->PC;
+	}
+
+
+	/// <summary>
+	/// Copies the lane registers back to its Cpu
+	/// </summary>
+	/// <param name="lane">Lane index</param>
+	void BatchCore::storeLane(int lane) {
+		Registers* regs = lanes[lane].cpu->getRegisters();
+		regs->A = reg8(REG_A)[lane];
+		regs->F = reg8(REG_F)[lane];
+		regs->B = reg8(REG_B)[lane];
+		regs->C = reg8(REG_C)[lane];
+		regs->D = reg8(REG_D)[lane];
+		regs->E = reg8(REG_E)[lane];
+		regs->H = reg8(REG_H)[lane];
+		regs->L = reg8(REG_L)[lane];
+		regs->SP = regSP[lane];
+		regs->PC = regPC[lane];
+	}
+
+
+	/// <summary>
+	/// Runs one instruction on every active lane
+	/// Lanes are grouped by the fetched opcode, each group runs once over all the lanes with its mask.
+	/// Instances of the same rom mostly share the PC, so there is usually a single group
+	/// </summary>
+	/// <returns>If any lane is still active</returns>
+	bool BatchCore::lockstep() {
+		const int count = getLaneCount();
+		bit8 ops[0x100];
+		bit64 seen[4] = { 0, 0, 0, 0 };
+		int opCount = 0;
+
+		for (int l = 0; l < count; l++) {
+			laneOp[l] = NoOp;
+			if (!active[l]) { continue; }
+
+			Lane& lane = lanes[l];
+			lane.ctrl->beginInstruction();
+
+			if (!lane.hooked && !lane.cpu->getHaltedState()) {
+				bit8 op = lane.bus->abRead(regPC[l]);
+				if (opTable[op].kind != BK_NONE) {
+					laneOp[l] = op;
+					if (!((seen[op >> 6] >> (op & 0x3F)) & 1)) {
+						seen[op >> 6] |= 1ULL << (op & 0x3F);
+						ops[opCount++] = op;
+					}
+					continue;
+				}
+			}
+
+			// Split off, the scalar Cpu runs the whole step (fetch, cycles and interrupts)
+			storeLane(l);
+			lane.cpu->step();
+			loadLane(l);
+			stats.scalarSteps++;
+			endLaneStep(l);
+		}
+
+		for (int k = 0; k < opCount; k++) {
+			const bit16 op = ops[k];
+			for (int i = 0; i < capacity; i++) {
+				mask[i] = laneOp[i] == op ? 0xFF : 0x00;
+			}
+			execute(static_cast<bit8>(op));
+		}
+
+		if (opCount > 0) {
+			stats.opGroups += opCount;
+			stats.locksteps++;
+		}
+
+		bool anyActive = false;
+		for (int l = 0; l < count; l++) {
+			if (laneOp[l] != NoOp) {
+				Lane& lane = lanes[l];
+				assert(lane.cpu->getProfiler() == nullptr && lane.cpu->getTracer() == nullptr);
+				// Register instructions take a single machine cycle, the fetch
+				lane.ctrl->emulCycles(1);
+
+				if (lane.cpu->needsFinishStep()) {
+					storeLane(l);
+					lane.cpu->finishStep();
+					loadLane(l);
+				}
+				stats.batchedSteps++;
+				endLaneStep(l);
+			}
+			anyActive |= active[l] != 0;
+		}
+		return anyActive;
+	}
+
+
+	/// <summary>
+	/// Executes an opcode on the masked lanes
+	/// Mirrors the scalar resolvers (instruc_funcs.cpp) flag by flag
+	/// </summary>
+	/// <param name="op">Target opcode</param>
+	void BatchCore::execute(bit8 op) {
+		const BatchOp& bop = opTable[op];
+		const int n = capacity;
+		const bit8* m = mask.data();
+		bit8* dst = reg8(bop.dst);
+		bit8* flags = reg8(REG_F);
+		bit8* src = operand.data();
+
+		// The source is copied, LD B,B and ADD A,A alias the destination
+		const bit8* srcReg = reg8(bop.src);
+		for (int i = 0; i < n; i++) { src[i] = srcReg[i]; }
+
+		switch (bop.kind) {
+		case BK_LD:
+			laneLoop(n, m, dst, src, flags, bop.flagMask, [](int, int b, int, int&) { return b; });
+			break;
+
+		case BK_ADD:
+			laneLoop(n, m, dst, src, flags, bop.flagMask, [](int a, int b, int, int& fl) {
+				int s = a + b;
+				fl = (((s & 0xFF) == 0) << 7) | ((((a & 0xF) + (b & 0xF)) >= 0x10) << 5) | ((s >= 0x100) << 4);
+				return s;
+			});
+			break;
+
+		case BK_ADC:
+			laneLoop(n, m, dst, src, flags, bop.flagMask, [](int a, int b, int cy, int& fl) {
+				int s = a + b + cy;
+				fl = (((s & 0xFF) == 0) << 7) | ((((a & 0xF) + (b & 0xF) + cy) > 0xF) << 5) | ((s > 0xFF) << 4);
+				return s;
+			});
+			break;
+
+		case BK_SUB:
+			laneLoop(n, m, dst, src, flags, bop.flagMask, [](int a, int b, int, int& fl) {
+				fl = ((a == b) << 7) | 0x40 | (((a & 0xF) < (b & 0xF)) << 5) | ((a < b) << 4);
+				return a - b;
+			});
+			break;
+
+		case BK_SBC:
+			laneLoop(n, m, dst, src, flags, bop.flagMask, [](int a, int b, int cy, int& fl) {
+				// The subtracted value wraps on 8bit before the zero test, as on the scalar resolver
+				int v = (b + cy) & 0xFF;
+				fl = ((a == v) << 7) | 0x40 | ((((a & 0xF) - (b & 0xF) - cy) < 0) << 5) | (((a - b - cy) < 0) << 4);
+				return a - v;
+			});
+			break;
+
+		case BK_AND:
+			laneLoop(n, m, dst, src, flags, bop.flagMask, [](int a, int b, int, int& fl) {
+				int r = a & b;
+				fl = ((r == 0) << 7) | 0x20;
+				return r;
+			});
+			break;
+
+		case BK_XOR:
+			laneLoop(n, m, dst, src, flags, bop.flagMask, [](int a, int b, int, int& fl) {
+				int r = a ^ b;
+				fl = (r == 0) << 7;
+				return r;
+			});
+			break;
+
+		case BK_OR:
+			laneLoop(n, m, dst, src, flags, bop.flagMask, [](int a, int b, int, int& fl) {
+				int r = a | b;
+				fl = (r == 0) << 7;
+				return r;
+			});
+			break;
+
+		case BK_CP:
+			laneLoop(n, m, dst, src, flags, bop.flagMask, [](int a, int b, int, int& fl) {
+				fl = ((a == b) << 7) | 0x40 | (((a & 0xF) < (b & 0xF)) << 5) | ((a < b) << 4);
+				return a;
+			});
+			break;
+
+		case BK_INC:
+			laneLoop(n, m, dst, src, flags, bop.flagMask, [](int a, int, int, int& fl) {
+				int r = (a + 1) & 0xFF;
+				fl = ((r == 0) << 7) | (((r & 0xF) == 0) << 5);
+				return r;
+			});
+			break;
+
+		case BK_DEC:
+			laneLoop(n, m, dst, src, flags, bop.flagMask, [](int a, int, int, int& fl) {
+				int r = (a - 1) & 0xFF;
+				fl = ((r == 0) << 7) | 0x40 | (((r & 0xF) == 0xF) << 5);
+				return r;
+			});
+			break;
+
+		case BK_CPL:
+			laneLoop(n, m, dst, src, flags, bop.flagMask, [](int a, int, int, int& fl) {
+				fl = 0x60;
+				return ~a;
+			});
+			break;
+
+		case BK_SCF:
+			laneLoop(n, m, dst, src, flags, bop.flagMask, [](int a, int, int, int& fl) {
+				fl = 0x10;
+				return a;
+			});
+			break;
+
+		case BK_CCF:
+			laneLoop(n, m, dst, src, flags, bop.flagMask, [](int a, int, int cy, int& fl) {
+				fl = (cy ^ 1) << 4;
+				return a;
+			});
+			break;
+
+		default: break;
+		}
+
+		// Every batched instruction is a single byte
+		bit16* pc = regPC.data();
+		for (int i = 0; i < n; i++) {
+			pc[i] = static_cast<bit16>(pc[i] + (m[i] & 1));
+		}
+	}
+
+
+	/// <summary>
+	/// Closes a lane instruction and checks if its frame is done
+	/// </summary>
+	/// <param name="lane">Lane index</param>
+	void BatchCore::endLaneStep(int lane) {
+		Lane& ln = lanes[lane];
+		ln.ctrl->endInstruction();
+
+		if (!ln.ctrl->isRunning() || ln.ppu->getCurrentFrame() != ln.startFrame || ln.ctrl->getTicks() >= ln.tickLimit) {
+			active[lane] = 0;
+		}
+	}
+} // namespace TheBoy
@@ -0,0 +1,285 @@
+#pragma once
+#ifndef BATCHCORE_H
+#define BATCHCORE_H
+
+#include "common.h"
+#include "cpu.h"
+#include <array>
+#include <vector>
+
+namespace TheBoy {
+	class EmulatorController;
+	class AddressBus;
+	class Ppu;
+
+	/// <summary>
+	/// Batched step counters
+	/// </summary>
+	typedef struct BatchStats {
+		/// <summary>
+		/// Instructions executed by the lane loops
+		/// </summary>
+		bit64 batchedSteps;
+
+		/// <summary>
+		/// Instructions executed by the scalar Cpu (halted lanes, memory, jumps, prefix CB...)
+		/// </summary>
+		bit64 scalarSteps;
+
+		/// <summary>
+		/// Distinct opcodes executed per lockstep, 1 means every batched lane ran the same opcode
+		/// </summary>
+		bit64 opGroups;
+
+		/// <summary>
+		/// Lockstep iterations
+		/// </summary>
+		bit64 locksteps;
+	} BatchStats;
+
+
+	/// <summary>
+	/// Runs the cpu of many headless instances in lockstep
+	/// The registers of every lane are kept as structure of arrays, the register only instructions
+	/// (LD r,r / ALU A,r / INC r / DEC r / CPL / SCF / CCF / NOP) run across all the lanes that fetched
+	/// the same opcode with a lane mask, the loops are written to be auto vectorized.
+	/// Lanes on any other instruction, or halted, are split off to the scalar Cpu for that step
+	/// </summary>
+	class BatchCore {
+	public:
+		/// <summary>
+		/// Lane storage is padded to this count, so the lane loops have no remainder
+		/// </summary>
+		static const int LaneAlign = 32;
+
+
+		/// <summary>
+		/// Batch core constructor
+		/// </summary>
+		BatchCore();
+
+
+		/// <summary>
+		/// Batch core destructor
+		/// </summary>
+		~BatchCore();
+
+
+		/// <summary>
+		/// Adds a loaded headless controller as a new lane
+		/// </summary>
+		/// <param name="ctrl">Target controller, must outlive the batch</param>
+		/// <returns>Lane index</returns>
+		int addLane(EmulatorController* ctrl);
+
+
+		/// <summary>
+		/// Gets the lane count
+		/// </summary>
+		/// <returns>Lane count</returns>
+		int getLaneCount();
+
+
+		/// <summary>
+		/// Includes or leaves out a lane from the next runFrame calls
+		/// </summary>
+		/// <param name="lane">Lane index</param>
+		/// <param name="enable">Lane runs</param>
+		void setLaneEnabled(int lane, bool enable);
+
+
+		/// <summary>
+		/// Runs every running lane until its ppu completes a frame
+		/// </summary>
+		/// <returns>If any lane is still running</returns>
+		bool runFrame();
+
+
+		/// <summary>
+		/// Gets the step counters since the last reset
+		/// </summary>
+		/// <returns>Batch counters</returns>
+		BatchStats getStats();
+
+
+		/// <summary>
+		/// Clears the step counters
+		/// </summary>
+		void resetStats();
+
+	private:
+		/// <summary>
+		/// Batched instruction kinds
+		/// </summary>
+		typedef enum BATCHKIND {
+			BK_NONE,		// Runs on the scalar Cpu
+			BK_NOP,
+			BK_LD,
+			BK_ADD,
+			BK_ADC,
+			BK_SUB,
+			BK_SBC,
+			BK_AND,
+			BK_XOR,
+			BK_OR,
+			BK_CP,
+			BK_INC,
+			BK_DEC,
+			BK_CPL,
+			BK_SCF,
+			BK_CCF
+		} BATCHKIND;
+
+
+		/// <summary>
+		/// Decoded batched opcode, registers use the RegisterType values (REG_A to REG_L)
+		/// </summary>
+		typedef struct BatchOp {
+			bit8 kind;
+			bit8 dst;
+			bit8 src;
+
+			/// <summary>
+			/// Flag bits written by the instruction
+			/// </summary>
+			bit8 flagMask;
+		} BatchOp;
+
+
+		/// <summary>
+		/// Per lane component pointers and frame target
+		/// </summary>
+		typedef struct Lane {
+			EmulatorController* ctrl;
+			Cpu* cpu;
+			AddressBus* bus;
+			Ppu* ppu;
+			bit32 startFrame;
+			bit64 tickLimit;
+
+			/// <summary>
+			/// Lane has a profiler or tracer hooked (or counts perf), every step goes through Cpu::step
+			/// </summary>
+			bool hooked;
+		} Lane;
+
+
+		/// <summary>
+		/// Opcode to batched instruction, decoded at compile time
+		/// </summary>
+		static const std::array<BatchOp, 0x100> opTable;
+
+
+		/// <summary>
+		/// Lanes
+		/// </summary>
+		std::vector<Lane> lanes;
+
+
+		/// <summary>
+		/// Padded lane count
+		/// </summary>
+		int capacity;
+
+
+		/// <summary>
+		/// 8bit registers, one array per RegisterType (REG_F holds the flags), capacity lanes each
+		/// </summary>
+		std::vector<bit8> regFile;
+
+
+		/// <summary>
+		/// 16bit registers
+		/// </summary>
+		std::vector<bit16> regSP;
+		std::vector<bit16> regPC;
+
+
+		/// <summary>
+		/// Opcode fetched by each lane on the current lockstep, NoOp when the lane is not batched
+		/// </summary>
+		std::vector<bit16> laneOp;
+		static constexpr bit16 NoOp = 0x100;
+
+
+		/// <summary>
+		/// Lane mask for the opcode being executed, 0xFF on the selected lanes
+		/// </summary>
+		std::vector<bit8> mask;
+
+
+		/// <summary>
+		/// Source operand copy, lets the destination alias the source (ADD A,A)
+		/// </summary>
+		std::vector<bit8> operand;
+
+
+		/// <summary>
+		/// Lanes still inside the current frame
+		/// </summary>
+		std::vector<bit8> active;
+
+
+		/// <summary>
+		/// Lanes included on runFrame
+		/// </summary>
+		std::vector<bit8> enabled;
+
+
+		/// <summary>
+		/// Step counters
+		/// </summary>
+		BatchStats stats;
+
+
+		/// <summary>
+		/// Decodes the opcode table
+		/// </summary>
+		/// <returns>Opcode table</returns>
+		static constexpr std::array<BatchOp, 0x100> buildOpTable();
+
+
+		/// <summary>
+		/// Gets a register array
+		/// </summary>
+		/// <param name="reg">Register type (REG_A to REG_L)</param>
+		/// <returns>Pointer to the first lane</returns>
+		bit8* reg8(int reg);
+
+
+		/// <summary>
+		/// Copies the Cpu registers of a lane to the arrays
+		/// </summary>
+		/// <param name="lane">Lane index</param>
+		void loadLane(int lane);
+
+
+		/// <summary>
+		/// Copies the lane registers back to its Cpu
+		/// </summary>
+		/// <param name="lane">Lane index</param>
+		void storeLane(int lane);
+
+
+		/// <summary>
+		/// Runs one instruction on every active lane
+		/// </summary>
+		/// <returns>If any lane is still active</returns>
+		bool lockstep();
+
+
+		/// <summary>
+		/// Executes an opcode on the masked lanes
+		/// </summary>
+		/// <param name="op">Target opcode</param>
+		void execute(bit8 op);
+
+
+		/// <summary>
+		/// Closes a lane instruction and checks if its frame is done
+		/// </summary>
+		/// <param name="lane">Lane index</param>
+		void endLaneStep(int lane);
+	};
+} // namespace TheBoy
+#endif // !BATCHCORE_H
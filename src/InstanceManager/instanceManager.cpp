@@ -0,0 +1,255 @@
+#include "instanceManager.h"
+#include "emulatorController.h"
+#include <chrono>
+#include <algorithm>
+
+namespace TheBoy {
+
+	/// <summary>
+	/// Instance manager constructor
+	/// </summary>
+	InstanceManager::InstanceManager() { }
+
+
+	/// <summary>
+	/// Instance manager destructor
+	/// </summary>
+	InstanceManager::~InstanceManager() { }
+
+
+	/// <summary>
+	/// Creates and loads a headless instance
+	/// </summary>
+	/// <param name="rom_path">Path to the target rom</param>
+	/// <returns>Instance id, -1 if the cartridge failed to load</returns>
+	int InstanceManager::addInstance(const char* rom_path) {
+		std::unique_ptr<Instance> inst = std::make_unique<Instance>();
+		inst->ctrl = std::make_unique<EmulatorController>();
+
+		if (!inst->ctrl->Load(rom_path, true)) {
+			std::cout << "[INSTANCES] ::: Failed to load instance for " << rom_path << std::endl;
+			return -1;
+		}
+
+		instances.push_back(std::move(inst));
+		return static_cast<int>(instances.size()) - 1;
+	}
+
+
+	/// <summary>
+	/// Gets the loaded instance count
+	/// </summary>
+	/// <returns>Instance count</returns>
+	int InstanceManager::getInstanceCount() {
+		return static_cast<int>(instances.size());
+	}
+
+
+	/// <summary>
+	/// Defines the maximum frames an instance runs per manager run
+	/// </summary>
+	/// <param name="id">Instance id</param>
+	/// <param name="frames">Frame budget, 0 uses the run frame count</param>
+	void InstanceManager::setFrameBudget(int id, bit32 frames) {
+		if (id < 0 || id >= getInstanceCount()) { return; }
+		instances[id]->budget = frames;
+	}
+
+
+	/// <summary>
+	/// Defines the fixed frame skip of an instance, its skipped frames only emulate the timing
+	/// </summary>
+	/// <param name="id">Instance id, -1 for every instance</param>
+	/// <param name="frames">Skipped frames after each drawn frame</param>
+	void InstanceManager::setFrameSkip(int id, bit8 frames) {
+		if (id == -1) {
+			for (std::unique_ptr<Instance>& inst : instances) { inst->ctrl->getPpu()->setFrameSkip(frames); }
+			return;
+		}
+		if (id < 0 || id >= getInstanceCount()) { return; }
+		instances[id]->ctrl->getPpu()->setFrameSkip(frames);
+	}
+
+
+	/// <summary>
+	/// Gets the frames an instance emulated since it was added
+	/// </summary>
+	/// <param name="id">Instance id</param>
+	/// <returns>Emulated frames</returns>
+	bit64 InstanceManager::getFramesRun(int id) {
+		if (id < 0 || id >= getInstanceCount()) { return 0; }
+		return instances[id]->framesRun;
+	}
+
+
+	/// <summary>
+	/// Runs every running instance for a number of frames (or its budget, if lower)
+	/// </summary>
+	/// <param name="threads">Worker threads</param>
+	/// <param name="frames">Frames per instance</param>
+	/// <returns>Run result</returns>
+	InstanceRunResult InstanceManager::run(int threads, bit32 frames) {
+		InstanceRunResult res{ };
+		res.threads = std::max(threads, 1);
+
+		bit64 framesBefore = 0;
+		for (std::unique_ptr<Instance>& inst : instances) {
+			framesBefore += inst->framesRun;
+			inst->remaining = (inst->budget != 0) ? std::min(inst->budget, frames) : frames;
+			inst->doneAt = 0.0;
+		}
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		{
+			WorkStealingPool pool(res.threads);
+			for (std::unique_ptr<Instance>& inst : instances) {
+				Instance* target = inst.get();
+				if (target->remaining == 0 || !target->ctrl->isRunning()) { continue; }
+				pool.submit([this, &pool, target, start]() { runSlice(pool, target, start); });
+			}
+			pool.waitIdle();
+			res.steals = pool.getStealCount();
+		}
+		res.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		res.firstDone = res.seconds;
+		for (std::unique_ptr<Instance>& inst : instances) {
+			res.frames += inst->framesRun;
+			if (inst->doneAt > 0.0) {
+				res.firstDone = std::min(res.firstDone, inst->doneAt);
+				res.lastDone = std::max(res.lastDone, inst->doneAt);
+			}
+		}
+		res.frames -= framesBefore;
+		return res;
+	}
+
+
+	/// <summary>
+	/// Runs every running instance for a number of frames (or its budget, if lower)
+	/// on the calling thread, all the instances as lanes of a lockstep BatchCore
+	/// </summary>
+	/// <param name="frames">Frames per instance</param>
+	/// <returns>Run result</returns>
+	InstanceRunResult InstanceManager::runBatched(bit32 frames) {
+		InstanceRunResult res{ };
+		res.threads = 1;
+
+		if (!batch || batch->getLaneCount() != getInstanceCount()) {
+			batch = std::make_unique<BatchCore>();
+			for (std::unique_ptr<Instance>& inst : instances) {
+				batch->addLane(inst->ctrl.get());
+			}
+		}
+		batch->resetStats();
+
+		bit64 framesBefore = 0;
+		for (std::unique_ptr<Instance>& inst : instances) {
+			framesBefore += inst->framesRun;
+			inst->remaining = (inst->budget != 0) ? std::min(inst->budget, frames) : frames;
+			inst->doneAt = 0.0;
+		}
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		std::vector<bool> lanes(instances.size(), false);
+		bool pending = true;
+
+		while (pending) {
+			pending = false;
+			for (size_t i = 0; i < instances.size(); i++) {
+				lanes[i] = instances[i]->remaining > 0 && instances[i]->ctrl->isRunning();
+				batch->setLaneEnabled(static_cast<int>(i), lanes[i]);
+				pending |= lanes[i];
+			}
+			if (!pending) { break; }
+
+			batch->runFrame();
+			double now = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			for (size_t i = 0; i < instances.size(); i++) {
+				if (!lanes[i]) { continue; }
+				Instance* inst = instances[i].get();
+				inst->framesRun++;
+				inst->remaining--;
+				if (inst->remaining == 0 || !inst->ctrl->isRunning()) { inst->doneAt = now; }
+			}
+		}
+		res.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		res.firstDone = res.seconds;
+		for (std::unique_ptr<Instance>& inst : instances) {
+			res.frames += inst->framesRun;
+			if (inst->doneAt > 0.0) {
+				res.firstDone = std::min(res.firstDone, inst->doneAt);
+				res.lastDone = std::max(res.lastDone, inst->doneAt);
+			}
+		}
+		res.frames -= framesBefore;
+		return res;
+	}
+
+
+	/// <summary>
+	/// Gets the counters of the last batched run
+	/// </summary>
+	/// <returns>Batch counters</returns>
+	BatchStats InstanceManager::getBatchStats() {
+		return batch ? batch->getStats() : BatchStats{ };
+	}
+
+
+	/// <summary>
+	/// Runs the instances with 1 to maxThreads workers and prints the throughput per thread count,
+	/// then the single thread lockstep batch throughput
+	/// </summary>
+	/// <param name="maxThreads">Largest worker count</param>
+	/// <param name="frames">Frames per instance on each run</param>
+	void InstanceManager::printScalingReport(int maxThreads, bit32 frames) {
+		maxThreads = std::max(maxThreads, 1);
+		printf("[INSTANCES] ::: Scaling report, %d instances, %u frames each\n", getInstanceCount(), frames);
+		printf("  threads |   frames/s | frames/s/thread | speedup | efficiency |  steals | finish spread\n");
+
+		double baseRate = 0.0;
+		for (int threads = 1; threads <= maxThreads; threads++) {
+			InstanceRunResult res = run(threads, frames);
+			double rate = res.seconds > 0.0 ? res.frames / res.seconds : 0.0;
+			if (threads == 1) { baseRate = rate; }
+			double speedup = baseRate > 0.0 ? rate / baseRate : 0.0;
+
+			printf("  %7d | %10.1f | %15.1f | %7.2f | %9.1f%% | %7llu | %.3f s\n",
+				threads, rate, rate / threads, speedup, speedup * 100.0 / threads,
+				static_cast<unsigned long long>(res.steals), res.lastDone - res.firstDone);
+		}
+
+		InstanceRunResult bres = runBatched(frames);
+		BatchStats bstats = getBatchStats();
+		double batchRate = bres.seconds > 0.0 ? bres.frames / bres.seconds : 0.0;
+		bit64 steps = bstats.batchedSteps + bstats.scalarSteps;
+
+		printf("[INSTANCES] ::: Lockstep batch, 1 thread: %.1f frames/s (%.2fx the scalar thread), %.1f%% instructions batched, %.2f opcodes per lockstep\n",
+			batchRate, baseRate > 0.0 ? batchRate / baseRate : 0.0,
+			steps > 0 ? bstats.batchedSteps * 100.0 / steps : 0.0,
+			bstats.locksteps > 0 ? static_cast<double>(bstats.opGroups) / bstats.locksteps : 0.0);
+		fflush(stdout);
+	}
+
+
+	/// <summary>
+	/// Runs one frame of an instance and queues its next frame
+	/// </summary>
+	/// <param name="pool">Running pool</param>
+	/// <param name="inst">Target instance</param>
+	/// <param name="start">Run start time stamp</param>
+	void InstanceManager::runSlice(WorkStealingPool& pool, Instance* inst, std::chrono::steady_clock::time_point start) {
+		bool running = inst->ctrl->runFrame();
+		inst->framesRun++;
+		inst->remaining--;
+
+		if (running && inst->remaining > 0) {
+			// Back of the queue, every other waiting instance gets its frame first
+			pool.submit([this, &pool, inst, start]() { runSlice(pool, inst, start); });
+			return;
+		}
+		inst->doneAt = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+} // namespace TheBoy
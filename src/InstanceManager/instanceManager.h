@@ -0,0 +1,188 @@
+#pragma once
+#ifndef INSTANCEMANAGER_H
+#define INSTANCEMANAGER_H
+
+#include "common.h"
+#include "workStealingPool.h"
+#include "batchCore.h"
+#include <vector>
+#include <chrono>
+
+namespace TheBoy {
+	class EmulatorController;
+
+	/// <summary>
+	/// Result of a manager run
+	/// </summary>
+	typedef struct InstanceRunResult {
+		/// <summary>
+		/// Worker threads used
+		/// </summary>
+		int threads;
+
+		/// <summary>
+		/// Frames emulated by all the instances
+		/// </summary>
+		bit64 frames;
+
+		/// <summary>
+		/// Wall clock run time in seconds
+		/// </summary>
+		double seconds;
+
+		/// <summary>
+		/// Slices taken from another worker queue
+		/// </summary>
+		bit64 steals;
+
+		/// <summary>
+		/// Earliest and latest instance finish time, in seconds from the run start
+		/// A small spread means the instances progressed evenly
+		/// </summary>
+		double firstDone;
+		double lastDone;
+	} InstanceRunResult;
+
+
+	/// <summary>
+	/// Runs many headless emulator instances on a work stealing pool
+	/// Every task advances one instance by one frame, then queues the instance again behind the waiting ones
+	/// </summary>
+	class InstanceManager {
+	public:
+		/// <summary>
+		/// Instance manager constructor
+		/// </summary>
+		InstanceManager();
+
+
+		/// <summary>
+		/// Instance manager destructor
+		/// </summary>
+		~InstanceManager();
+
+
+		/// <summary>
+		/// Creates and loads a headless instance
+		/// </summary>
+		/// <param name="rom_path">Path to the target rom</param>
+		/// <returns>Instance id, -1 if the cartridge failed to load</returns>
+		int addInstance(const char* rom_path);
+
+
+		/// <summary>
+		/// Gets the loaded instance count
+		/// </summary>
+		/// <returns>Instance count</returns>
+		int getInstanceCount();
+
+
+		/// <summary>
+		/// Defines the maximum frames an instance runs per manager run
+		/// </summary>
+		/// <param name="id">Instance id</param>
+		/// <param name="frames">Frame budget, 0 uses the run frame count</param>
+		void setFrameBudget(int id, bit32 frames);
+
+
+		/// <summary>
+		/// Defines the fixed frame skip of an instance, its skipped frames only emulate the timing
+		/// Ex: 3 only draws every 4th frame, the one an agent observes
+		/// </summary>
+		/// <param name="id">Instance id, -1 for every instance</param>
+		/// <param name="frames">Skipped frames after each drawn frame</param>
+		void setFrameSkip(int id, bit8 frames);
+
+
+		/// <summary>
+		/// Gets the frames an instance emulated since it was added
+		/// </summary>
+		/// <param name="id">Instance id</param>
+		/// <returns>Emulated frames</returns>
+		bit64 getFramesRun(int id);
+
+
+		/// <summary>
+		/// Runs every running instance for a number of frames (or its budget, if lower)
+		/// </summary>
+		/// <param name="threads">Worker threads</param>
+		/// <param name="frames">Frames per instance</param>
+		/// <returns>Run result</returns>
+		InstanceRunResult run(int threads, bit32 frames);
+
+
+		/// <summary>
+		/// Runs every running instance for a number of frames (or its budget, if lower)
+		/// on the calling thread, all the instances as lanes of a lockstep BatchCore
+		/// </summary>
+		/// <param name="frames">Frames per instance</param>
+		/// <returns>Run result</returns>
+		InstanceRunResult runBatched(bit32 frames);
+
+
+		/// <summary>
+		/// Gets the counters of the last batched run
+		/// </summary>
+		/// <returns>Batch counters</returns>
+		BatchStats getBatchStats();
+
+
+		/// <summary>
+		/// Runs the instances with 1 to maxThreads workers and prints the throughput per thread count,
+		/// then the single thread lockstep batch throughput
+		/// </summary>
+		/// <param name="maxThreads">Largest worker count</param>
+		/// <param name="frames">Frames per instance on each run</param>
+		void printScalingReport(int maxThreads, bit32 frames);
+
+	private:
+		/// <summary>
+		/// Managed instance
+		/// </summary>
+		typedef struct Instance {
+			std::unique_ptr<EmulatorController> ctrl;
+
+			/// <summary>
+			/// Frame budget per run, 0 uses the run frame count
+			/// </summary>
+			bit32 budget = 0;
+
+			/// <summary>
+			/// Frames left on the current run
+			/// </summary>
+			bit32 remaining = 0;
+
+			/// <summary>
+			/// Frames emulated since the instance was added
+			/// </summary>
+			bit64 framesRun = 0;
+
+			/// <summary>
+			/// Finish time on the current run, in seconds from the run start
+			/// </summary>
+			double doneAt = 0.0;
+		} Instance;
+
+
+		/// <summary>
+		/// Managed instances
+		/// </summary>
+		std::vector<std::unique_ptr<Instance>> instances;
+
+
+		/// <summary>
+		/// Lockstep core over the instances, rebuilt when an instance is added
+		/// </summary>
+		std::unique_ptr<BatchCore> batch;
+
+
+		/// <summary>
+		/// Runs one frame of an instance and queues its next frame
+		/// </summary>
+		/// <param name="pool">Running pool</param>
+		/// <param name="inst">Target instance</param>
+		/// <param name="start">Run start time stamp</param>
+		void runSlice(WorkStealingPool& pool, Instance* inst, std::chrono::steady_clock::time_point start);
+	};
+} // namespace TheBoy
+#endif // !INSTANCEMANAGER_H
@@ -0,0 +1,162 @@
+#include "workStealingPool.h"
+
+namespace TheBoy {
+	namespace {
+		// Pool and queue of the calling worker thread, only used to route the submits
+		thread_local WorkStealingPool* tlsPool = nullptr;
+		thread_local int tlsIndex = -1;
+	}
+
+	/// <summary>
+	/// Work stealing pool constructor, starts the workers
+	/// </summary>
+	/// <param name="threadCount">Worker count, at least one</param>
+	WorkStealingPool::WorkStealingPool(int threadCount) {
+		if (threadCount < 1) { threadCount = 1; }
+
+		for (int i = 0; i < threadCount; i++) {
+			queues.push_back(std::make_unique<WorkerQueue>());
+		}
+		for (int i = 0; i < threadCount; i++) {
+			workers.emplace_back(&WorkStealingPool::workerLoop, this, i);
+		}
+	}
+
+
+	/// <summary>
+	/// Work stealing pool destructor, finishes the queued tasks and joins the workers
+	/// </summary>
+	WorkStealingPool::~WorkStealingPool() {
+		waitIdle();
+		{
+			std::lock_guard<std::mutex> lock(idleLock);
+			stopping = true;
+		}
+		wakeCond.notify_all();
+
+		for (std::thread& worker : workers) {
+			worker.join();
+		}
+	}
+
+
+	/// <summary>
+	/// Queues a task, tasks submitted from a worker go to the back of its own queue
+	/// </summary>
+	/// <param name="task">Task to run</param>
+	void WorkStealingPool::submit(Task task) {
+		int index = (tlsPool == this) ? tlsIndex : static_cast<int>(nextQueue++ % queues.size());
+
+		pending++;
+		{
+			std::lock_guard<std::mutex> lock(queues[index]->lock);
+			queues[index]->tasks.push_back(std::move(task));
+		}
+		queued++;
+
+		// Taking the lock orders the push with a worker about to sleep
+		{ std::lock_guard<std::mutex> lock(idleLock); }
+		wakeCond.notify_one();
+	}
+
+
+	/// <summary>
+	/// Blocks until every submitted task, including the ones they submit, is done
+	/// </summary>
+	void WorkStealingPool::waitIdle() {
+		std::unique_lock<std::mutex> lock(idleLock);
+		idleCond.wait(lock, [this]() { return pending.load() == 0; });
+	}
+
+
+	/// <summary>
+	/// Gets the worker count
+	/// </summary>
+	/// <returns>Worker count</returns>
+	int WorkStealingPool::getThreadCount() {
+		return static_cast<int>(workers.size());
+	}
+
+
+	/// <summary>
+	/// Gets how many tasks were taken from another worker queue
+	/// </summary>
+	/// <returns>Stolen task count</returns>
+	bit64 WorkStealingPool::getStealCount() {
+		return steals.load();
+	}
+
+
+	/// <summary>
+	/// Worker main loop
+	/// </summary>
+	/// <param name="index">Worker index</param>
+	void WorkStealingPool::workerLoop(int index) {
+		tlsPool = this;
+		tlsIndex = index;
+
+		while (true) {
+			Task task;
+			if (popLocal(index, task) || steal(index, task)) {
+				queued--;
+				task();
+
+				if (--pending == 0) {
+					std::lock_guard<std::mutex> lock(idleLock);
+					idleCond.notify_all();
+				}
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock(idleLock);
+			wakeCond.wait(lock, [this]() { return stopping.load() || queued.load() > 0; });
+			if (stopping.load() && queued.load() == 0) {
+				break;
+			}
+		}
+
+		tlsPool = nullptr;
+		tlsIndex = -1;
+	}
+
+
+	/// <summary>
+	/// Takes the oldest task from the worker own queue
+	/// </summary>
+	/// <param name="index">Worker index</param>
+	/// <param name="out">Taken task</param>
+	/// <returns>If a task was taken</returns>
+	bool WorkStealingPool::popLocal(int index, Task& out) {
+		WorkerQueue& queue = *queues[index];
+		std::lock_guard<std::mutex> lock(queue.lock);
+		if (queue.tasks.empty()) { return false; }
+
+		out = std::move(queue.tasks.front());
+		queue.tasks.pop_front();
+		return true;
+	}
+
+
+	/// <summary>
+	/// Takes the newest task from another worker queue
+	/// </summary>
+	/// <param name="index">Thief worker index</param>
+	/// <param name="out">Taken task</param>
+	/// <returns>If a task was taken</returns>
+	bool WorkStealingPool::steal(int index, Task& out) {
+		const int count = static_cast<int>(queues.size());
+
+		for (int i = 1; i < count; i++) {
+			WorkerQueue& queue = *queues[(index + i) % count];
+			std::unique_lock<std::mutex> lock(queue.lock, std::try_to_lock);
+			if (!lock.owns_lock() || queue.tasks.empty()) { continue; }
+
+			// Back end, away from the owner working on the front
+			out = std::move(queue.tasks.back());
+			queue.tasks.pop_back();
+			steals++;
+			return true;
+		}
+		return false;
+	}
+} // namespace TheBoy
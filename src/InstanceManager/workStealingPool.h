@@ -0,0 +1,149 @@
+#pragma once
+#ifndef WORKSTEALINGPOOL_H
+#define WORKSTEALINGPOOL_H
+
+#include "common.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace TheBoy {
+
+	/// <summary>
+	/// Thread pool with a task queue per worker
+	/// Workers run their own queue oldest first and steal from the other queues when it is empty
+	/// </summary>
+	class WorkStealingPool {
+	public:
+		typedef std::function<void()> Task;
+
+
+		/// <summary>
+		/// Work stealing pool constructor, starts the workers
+		/// </summary>
+		/// <param name="threadCount">Worker count, at least one</param>
+		WorkStealingPool(int threadCount);
+
+
+		/// <summary>
+		/// Work stealing pool destructor, finishes the queued tasks and joins the workers
+		/// </summary>
+		~WorkStealingPool();
+
+
+		/// <summary>
+		/// Queues a task, tasks submitted from a worker go to the back of its own queue
+		/// </summary>
+		/// <param name="task">Task to run</param>
+		void submit(Task task);
+
+
+		/// <summary>
+		/// Blocks until every submitted task, including the ones they submit, is done
+		/// </summary>
+		void waitIdle();
+
+
+		/// <summary>
+		/// Gets the worker count
+		/// </summary>
+		/// <returns>Worker count</returns>
+		int getThreadCount();
+
+
+		/// <summary>
+		/// Gets how many tasks were taken from another worker queue
+		/// </summary>
+		/// <returns>Stolen task count</returns>
+		bit64 getStealCount();
+
+	private:
+		/// <summary>
+		/// Worker task queue
+		/// </summary>
+		typedef struct WorkerQueue {
+			std::mutex lock;
+			std::deque<Task> tasks;
+		} WorkerQueue;
+
+
+		/// <summary>
+		/// One queue per worker
+		/// </summary>
+		std::vector<std::unique_ptr<WorkerQueue>> queues;
+
+
+		/// <summary>
+		/// Worker threads
+		/// </summary>
+		std::vector<std::thread> workers;
+
+
+		/// <summary>
+		/// Guards the sleeping workers and the idle waiters
+		/// </summary>
+		std::mutex idleLock;
+		std::condition_variable wakeCond;
+		std::condition_variable idleCond;
+
+
+		/// <summary>
+		/// Tasks submitted and not finished
+		/// </summary>
+		std::atomic<int> pending{ 0 };
+
+
+		/// <summary>
+		/// Tasks waiting on a queue
+		/// </summary>
+		std::atomic<int> queued{ 0 };
+
+
+		/// <summary>
+		/// Marks the pool shutdown
+		/// </summary>
+		std::atomic<bool> stopping{ false };
+
+
+		/// <summary>
+		/// Next queue for tasks submitted outside the pool
+		/// </summary>
+		std::atomic<bit32> nextQueue{ 0 };
+
+
+		/// <summary>
+		/// Stolen task count
+		/// </summary>
+		std::atomic<bit64> steals{ 0 };
+
+
+		/// <summary>
+		/// Worker main loop
+		/// </summary>
+		/// <param name="index">Worker index</param>
+		void workerLoop(int index);
+
+
+		/// <summary>
+		/// Takes the oldest task from the worker own queue
+		/// </summary>
+		/// <param name="index">Worker index</param>
+		/// <param name="out">Taken task</param>
+		/// <returns>If a task was taken</returns>
+		bool popLocal(int index, Task& out);
+
+
+		/// <summary>
+		/// Takes the newest task from another worker queue
+		/// </summary>
+		/// <param name="index">Thief worker index</param>
+		/// <param name="out">Taken task</param>
+		/// <returns>If a task was taken</returns>
+		bool steal(int index, Task& out);
+	};
+} // namespace TheBoy
+#endif // !WORKSTEALINGPOOL_H
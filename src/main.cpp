@@ -1,4 +1,10 @@
 ﻿#include "emulatorController.h"
+#include "instanceManager.h"
+#include "socketLink.h"
+#include <cstring>
+#include <chrono>
+#include <thread>
+#include <vector>
 
 
 /**
@@ -7,14 +13,316 @@
  */
 using namespace TheBoy;
 
+/**
+ * @brief Headless multi instance run, prints the scaling report
+ * usage: TheBoy --headless <rom> [instances] [maxThreads] [frames] [--frame-skip N]
+ * --frame-skip draws one frame out of N + 1, the others only emulate the timing
+ * @return int
+ */
+static int runHeadless(int argc, char* argv[]) {
+	const char* rom = argv[2];
+	int frameSkip = 0;
+	std::vector<const char*> args;
+	for (int i = 3; i < argc; i++) {
+		if (strcmp(argv[i], "--frame-skip") == 0 && i + 1 < argc) { frameSkip = atoi(argv[++i]); }
+		else { args.push_back(argv[i]); }
+	}
+	int count = (args.size() > 0) ? atoi(args[0]) : 64;
+	int threads = (args.size() > 1) ? atoi(args[1]) : static_cast<int>(std::thread::hardware_concurrency());
+	bit32 frames = (args.size() > 2) ? static_cast<bit32>(atoi(args[2])) : 600;
+	if (frameSkip < 0 || frameSkip > 0xFF) {
+		printf("[HEADLESS] ::: --frame-skip expects 0 to 255, got %d\n", frameSkip);
+		return 1;
+	}
+
+	InstanceManager manager;
+	for (int i = 0; i < count; i++) {
+		if (manager.addInstance(rom) < 0) {
+			return 1;
+		}
+	}
+	manager.setFrameSkip(-1, static_cast<bit8>(frameSkip));
+
+	manager.printScalingReport(threads, frames);
+	return 0;
+}
+
+/**
+ * @brief Headless movie replay as fast as possible, checks the replay ends on the recorded state
+ * usage: TheBoy --movie <rom> <movie>
+ * @return int 0 when the replay is bit exact
+ */
+static int runMovie(int argc, char* argv[]) {
+	if (argc < 4) {
+		printf("[MOVIE] ::: usage: TheBoy --movie <rom> <movie>\n");
+		return 1;
+	}
+
+	EmulatorController emulator;
+	if (!emulator.Load(argv[2], true)) {
+		return 1;
+	}
+
+	Movie* movie = emulator.getMovie();
+	if (!movie->load(argv[3]) || !movie->startPlayback()) {
+		return 1;
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	bit32 frames = 0;
+	while (emulator.isRunning() && !movie->finished()) {
+		emulator.runFrame();
+		frames++;
+	}
+	double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	bool exact = movie->matchesEnd();
+	printf("[MOVIE] ::: Replayed %u frames in %.2f s (%.1f fps), %s\n",
+		frames, sec, frames / sec, exact ? "bit exact" : "DESYNC");
+	return exact ? 0 : 2;
+}
+
+/**
+ * @brief Headless link cable run, two instances on their own threads connected in process
+ * usage: TheBoy --link <romA> <romB> [frames]
+ * @return int
+ */
+static int runLink(int argc, char* argv[]) {
+	bit32 frames = (argc > 4) ? static_cast<bit32>(atoi(argv[4])) : 3600;
+
+	EmulatorController sides[2];
+	std::pair<std::unique_ptr<SerialLink>, std::unique_ptr<SerialLink>> cable = LocalLink::createPair();
+	sides[0].setLink(std::move(cable.first));
+	sides[1].setLink(std::move(cable.second));
+	if (!sides[0].Load(argv[2], true) || !sides[1].Load(argv[3], true)) {
+		return 1;
+	}
+
+	LinkStats stats[2]{};
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	auto run = [frames](EmulatorController* emulator, LinkStats* out) {
+		for (bit32 i = 0; i < frames && emulator->runFrame(); i++) { }
+		*out = emulator->getLink()->getStats();
+		// Unplugged once done, a partner still running stops waiting on it
+		emulator->setLink(nullptr);
+	};
+	std::thread other(run, &sides[1], &stats[1]);
+	run(&sides[0], &stats[0]);
+	other.join();
+	double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	printf("[LINK] ::: %u frames per side in %.2f s\n", frames, sec);
+	for (int i = 0; i < 2; i++) {
+		printf("  side %d: %llu sent, %llu served, %.1f us per transfer, %.1f ms on the horizon\n", i,
+			static_cast<unsigned long long>(stats[i].sent), static_cast<unsigned long long>(stats[i].served),
+			stats[i].avgWaitUs, stats[i].horizonWaitMs);
+	}
+	return 0;
+}
+
+/**
+ * @brief Headless run with the performance counters, prints the table and saves the json
+ * usage: TheBoy --perf <rom> [frames] [out.json]
+ * @return int
+ */
+static int runPerf(int argc, char* argv[]) {
+#if PERFCOUNT
+	bit32 frames = (argc > 3) ? static_cast<bit32>(atoi(argv[3])) : 600;
+	std::string out = (argc > 4) ? argv[4] : std::string(argv[2]) + ".perf.json";
+
+	EmulatorController emulator;
+	if (!emulator.Load(argv[2], true)) {
+		return 1;
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (bit32 i = 0; i < frames && emulator.runFrame(); i++) { }
+	double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	printf("[PERF] ::: %u frames in %.2f s\n%s\n", frames, sec, emulator.getPerf()->table(10).c_str());
+	return emulator.getPerf()->writeJson(out.c_str()) ? 0 : 1;
+#else
+	(void)argc;
+	(void)argv;
+	printf("[PERF] ::: Built without PERF_COUNTERS\n");
+	return 1;
+#endif
+}
+
+/**
+ * @brief Headless run with the guest profiler, prints the report and saves the folded stacks
+ * usage: TheBoy --profile <rom> [frames] [out.folded] [symbols.sym]
+ * @return int
+ */
+static int runProfile(int argc, char* argv[]) {
+	bit32 frames = (argc > 3) ? static_cast<bit32>(atoi(argv[3])) : 600;
+	std::string out = (argc > 4) ? argv[4] : std::string(argv[2]) + ".folded";
+
+	EmulatorController emulator;
+	if (!emulator.Load(argv[2], true)) {
+		return 1;
+	}
+
+	GuestProfiler* profiler = emulator.getProfiler();
+	if (argc > 5 && !profiler->loadSymbols(argv[5])) {
+		printf("[PROFILER] ::: No symbol file at %s\n", argv[5]);
+		return 1;
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	profiler->start();
+	for (bit32 i = 0; i < frames && emulator.runFrame(); i++) { }
+	profiler->stop();
+	double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	printf("[PROFILER] ::: %u frames in %.2f s\n%s", frames, sec, profiler->report(15).c_str());
+	return profiler->writeFolded(out.c_str()) ? 0 : 1;
+}
+
+/**
+ * @brief Headless run recording the binary execution trace
+ * usage: TheBoy --trace <rom> <out.trace> [frames] [--doctor]
+ * --doctor reads LY as 0x90 like the gameboy-doctor reference logs, to diff them with theboy_tracediff
+ * @return int
+ */
+static int runTrace(int argc, char* argv[]) {
+	bit32 frames = 600;
+	bool doctor = false;
+	for (int i = 4; i < argc; i++) {
+		if (strcmp(argv[i], "--doctor") == 0) { doctor = true; }
+		else { frames = static_cast<bit32>(atoi(argv[i])); }
+	}
+
+	EmulatorController emulator;
+	if (!emulator.Load(argv[2], true)) {
+		return 1;
+	}
+	emulator.getLcd()->setLyStub(doctor);
+	if (!emulator.getTracer()->start(argv[3])) {
+		return 1;
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (bit32 i = 0; i < frames && emulator.runFrame(); i++) { }
+	emulator.getTracer()->stop();
+	double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	printf("[TRACE] ::: %u frames in %.2f s\n", frames, sec);
+	return 0;
+}
+
+/**
+ * @brief Decodes a binary execution trace to the standard output
+ * usage: TheBoy --trace-decode <in.trace> [--doctor]
+ * @return int
+ */
+static int runTraceDecode(int argc, char* argv[]) {
+	if (argc < 3) {
+		printf("[TRACE] ::: usage: TheBoy --trace-decode <in.trace> [--doctor]\n");
+		return 1;
+	}
+
+	TRACE_FORMAT format = (argc > 3 && strcmp(argv[3], "--doctor") == 0) ? TRACE_FORMAT_DOCTOR : TRACE_FORMAT_TEXT;
+	return TraceRecorder::decode(argv[2], stdout, format) ? 0 : 1;
+}
+
+/**
+ * @brief Plugs the socket link asked on the command line
+ * usage: TheBoy <rom> [--link-host <socket> | --link-join <socket>]
+ * @return bool false if a link was asked and failed
+ */
+static bool plugSocketLink(int argc, char* argv[], EmulatorController* emulator) {
+	std::unique_ptr<SerialLink> link;
+	int i = 2;
+	for (; i + 1 < argc; i++) {
+		if (strcmp(argv[i], "--link-host") == 0) {
+			link = SocketLink::host(argv[i + 1]);
+			break;
+		}
+		if (strcmp(argv[i], "--link-join") == 0) {
+			link = SocketLink::join(argv[i + 1]);
+			break;
+		}
+	}
+	if (i + 1 >= argc) {
+		return true;
+	}
+
+	if (!link) {
+		return false;
+	}
+	emulator->setLink(std::move(link));
+	return true;
+}
+
+/**
+ * @brief Applies the rewind memory asked on the command line
+ * usage: TheBoy <rom> [--rewind-budget <MB>] [--rewind-interval <frames>]
+ * --rewind-interval fixes the snapshot interval, without it the interval grows with the capture cost
+ * @return bool false if an option value is invalid
+ */
+static bool setRewindOptions(int argc, char* argv[], EmulatorController* emulator) {
+	size_t budget = Rewinder::DefaultBudget;
+	int interval = 0;
+	for (int i = 2; i + 1 < argc; i++) {
+		if (strcmp(argv[i], "--rewind-budget") == 0) {
+			int mb = atoi(argv[++i]);
+			if (mb < 1) {
+				printf("[REWIND] ::: --rewind-budget expects a size in MB, got %s\n", argv[i]);
+				return false;
+			}
+			budget = static_cast<size_t>(mb) * 1024 * 1024;
+		}
+		else if (strcmp(argv[i], "--rewind-interval") == 0) {
+			interval = atoi(argv[++i]);
+			if (interval < 1 || interval > static_cast<int>(Rewinder::MaxInterval)) {
+				printf("[REWIND] ::: --rewind-interval expects 1 to %u frames, got %s\n", Rewinder::MaxInterval, argv[i]);
+				return false;
+			}
+		}
+	}
+
+	emulator->setRewindConfig(budget, static_cast<bit32>(interval));
+	return true;
+}
+
 int main(int argc, char *argv[]) {
+	if (argc > 2 && strcmp(argv[1], "--headless") == 0) {
+		return runHeadless(argc, argv);
+	}
+	if (argc > 3 && strcmp(argv[1], "--movie") == 0) {
+		return runMovie(argc, argv);
+	}
+	if (argc > 3 && strcmp(argv[1], "--link") == 0) {
+		return runLink(argc, argv);
+	}
+	if (argc > 2 && strcmp(argv[1], "--perf") == 0) {
+		return runPerf(argc, argv);
+	}
+	if (argc > 2 && strcmp(argv[1], "--profile") == 0) {
+		return runProfile(argc, argv);
+	}
+	if (argc > 3 && strcmp(argv[1], "--trace") == 0) {
+		return runTrace(argc, argv);
+	}
+	if (argc > 2 && strcmp(argv[1], "--trace-decode") == 0) {
+		return runTraceDecode(argc, argv);
+	}
 
 	std::shared_ptr<EmulatorController> emulator;
 	emulator = std::make_shared<EmulatorController>();
+	if (!plugSocketLink(argc, argv, emulator.get()) || !setRewindOptions(argc, argv, emulator.get())) {
+		return 1;
+	}
 
 	//! Remove this hammered path
 	//emulator->Start("D:\\Projects\\TheBoy\\ROMS\\tests\\dmg-acid2.gb");
-	emulator->Start("D:\\Projects\\TheBoy\\ROMS\\Legend of Zelda, The - Link's Awakening.gb");
+	if (argc > 1) {
+		emulator->Start(argv[1]);
+	}
+	else {
+		emulator->Start("D:\\Projects\\TheBoy\\ROMS\\Legend of Zelda, The - Link's Awakening.gb");
+	}
 
 	return 0;
 }
\ No newline at end of file